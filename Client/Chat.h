@@ -30,6 +30,7 @@ public:
     const QList<Message>& getMessages() const;
 
     QString getName() const;
+    void setName(const QString& chatName) { name = chatName; }
 
     ~Chat() = default;
 };
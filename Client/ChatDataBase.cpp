@@ -51,6 +51,23 @@ bool ChatDatabase::open(const QString& path) {
         return false;
     }
     logger.log(QtInfoMsg, "Таблица messages успешно создана или уже существует.");
+
+    /*номер сообщения в чате, назначенный сервером: по нему запрашиваются
+     *пропущенные сообщения и отбрасываются повторы. В базах прежнего формата столбца нет*/
+    QSqlQuery columns(db);
+    bool hasSeq = false;
+    if (columns.exec("PRAGMA table_info(messages)")) {
+        while (columns.next()) {
+            hasSeq = hasSeq || columns.value(1).toString() == "seq";
+        }
+    }
+    if (!hasSeq && !query.exec("ALTER TABLE messages ADD COLUMN seq INTEGER")) {
+        logger.log(QtWarningMsg, QString("Ошибка при добавлении столбца seq: %1").arg(query.lastError().text()));
+        return false;
+    }
+    if (!query.exec("CREATE UNIQUE INDEX IF NOT EXISTS idx_messages_seq ON messages (chat_name, seq)")) {
+        logger.log(QtWarningMsg, QString("Ошибка при создании индекса: %1").arg(query.lastError().text()));
+    }
     return true;
 }
 
@@ -72,25 +89,71 @@ void ChatDatabase::close() {
  * @param timestamp Временная метка сообщения.
  * @param firstName Имя отправителя.
  * @param lastName Фамилия отправителя.
+ * @param seq Номер сообщения в чате (0 - неизвестен).
+ * @return true, если сообщение добавлено; false при ошибке или если
+ * сообщение с таким номером уже сохранено.
  */
-void ChatDatabase::addMessage(const QString& chatName, const QString& sender, const QString& text,
-                              const QDateTime& timestamp, const QString& firstName, const QString& lastName) {
+bool ChatDatabase::addMessage(const QString& chatName, const QString& sender, const QString& text,
+                              const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                              quint32 seq) {
     QSqlQuery query(db);
-    query.prepare("INSERT INTO messages (chat_name, sender, text, timestamp, firstName, lastName) "
-                  "VALUES (:chat_name, :sender, :text, :timestamp, :firstName, :lastName)");
+    query.prepare("INSERT OR IGNORE INTO messages (chat_name, sender, text, timestamp, firstName, lastName, seq) "
+                  "VALUES (:chat_name, :sender, :text, :timestamp, :firstName, :lastName, :seq)");
     query.bindValue(":chat_name", chatName);
     query.bindValue(":sender", sender);
     query.bindValue(":text", text);
     query.bindValue(":timestamp", timestamp.toString(Qt::ISODate));
     query.bindValue(":firstName", firstName);
     query.bindValue(":lastName", lastName);
+    query.bindValue(":seq", seq > 0 ? QVariant(seq) : QVariant());
 
     Logger& logger = Logger::getInstance();
     if (!query.exec()) {
         logger.log(QtWarningMsg, QString("Ошибка при добавлении сообщения: %1").arg(query.lastError().text()));
-    } else {
-        logger.log(QtInfoMsg, "Сообщение успешно добавлено в базу данных.");
+        return false;
+    }
+    if (query.numRowsAffected() == 0) {
+        return false;
+    }
+    logger.log(QtInfoMsg, "Сообщение успешно добавлено в базу данных.");
+    return true;
+}
+
+/**
+ * @brief Получает для каждого чата номер, до которого сохраненные сообщения
+ * идут без пропусков, начиная с самого раннего известного.
+ * Сообщения после пропуска не учитываются: пропуск будет запрошен у сервера.
+ * @return Имя чата -> последний номер непрерывного участка.
+ */
+QHash<QString, quint32> ChatDatabase::getContiguousSeqs() {
+    QHash<QString, quint32> lastSeqs;
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT chat_name, seq FROM messages WHERE seq IS NOT NULL ORDER BY chat_name, seq")) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при получении номеров сообщений: %1")
+                                                    .arg(query.lastError().text()));
+        return lastSeqs;
+    }
+
+    QString chatName;
+    quint32 last = 0;
+    bool broken = false;
+    while (query.next()) {
+        QString name = query.value(0).toString();
+        quint32 seq = query.value(1).toUInt();
+        if (name != chatName) {
+            chatName = name;
+            last = seq;
+            broken = false;
+        } else if (!broken && seq == last + 1) {
+            last = seq;
+        } else {
+            broken = true;
+            continue;
+        }
+        lastSeqs.insert(chatName, last);
     }
+    return lastSeqs;
 }
 
 /**
@@ -191,3 +254,22 @@ void ChatDatabase::addChat(const QString& chatName) {
     }
 }
 
+/**
+ * @brief Переименовывает чат во всех сохраненных сообщениях.
+ * @param chatName Текущее имя чата.
+ * @param newName Новое имя чата.
+ * @return true, если запрос выполнен успешно, иначе false.
+ */
+bool ChatDatabase::renameChat(const QString& chatName, const QString& newName) {
+    QSqlQuery query(db);
+    query.prepare("UPDATE messages SET chat_name = ? WHERE chat_name = ?");
+    query.addBindValue(newName);
+    query.addBindValue(chatName);
+
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при переименовании чата '%1': %2")
+                                                    .arg(chatName, query.lastError().text()));
+        return false;
+    }
+    return true;
+}
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QSqlDatabase>
 #include <QString>
+#include <QHash>
 
 /**
  * @brief ChatDatabase - класс для работы с базой данных чатов.
@@ -30,9 +31,14 @@ public:
 
     void addChat(const QString& chatName);
     bool deleteChat(const QString& chatName);
-
-    void addMessage(const QString& chatName, const QString& sender, const QString& text,
-                    const QDateTime& timestamp, const QString& firstName, const QString& lastName);
+    bool renameChat(const QString& chatName, const QString& newName);
+
+    bool addMessage(const QString& chatName, const QString& sender, const QString& text,
+                    const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                    quint32 seq = 0);
+    QHash<QString, quint32> getContiguousSeqs();
+    bool transaction() { return db.transaction(); }
+    bool commit() { return db.commit(); }
     QList<QMap<QString, QString>> getMessages(const QString& chatName);  // Получить все сообщения чата
 };
 
@@ -19,6 +19,10 @@ ChatManager::ChatManager(const QString& dbPath, QObject* parent)
     for (const QString& name : chatNames) {
         loadChat(name);
     }
+    QHash<QString, quint32> lastSeqs = database.getContiguousSeqs();
+    for (auto it = lastSeqs.constBegin(); it != lastSeqs.constEnd(); ++it) {
+        seqStates[it.key()].contiguous = it.value();
+    }
 }
 
 /**
@@ -55,13 +59,138 @@ Chat* ChatManager::getChat(const QString& name) {
  * @param timestamp Временная метка.
  * @param firstName Имя отправителя.
  * @param lastName Фамилия отправителя.
+ * @param seq Номер сообщения в чате (0 - неизвестен).
  */
 void ChatManager::addMessageToChat(const QString& chatName, const QString& sender, const QString& text,
-                                   const QDateTime& timestamp, const QString& firstName, const QString& lastName) {
+                                   const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                                   quint32 seq) {
+    if (storeMessage(chatName, sender, text, timestamp, firstName, lastName, seq)) {
+        emit chatUpdated(chatName);
+    }
+}
+
+/**
+ * @brief Добавляет пачку сообщений, разосланных сервером одним кадром.
+ * Сообщения записываются одной транзакцией, а каждый затронутый чат
+ * обновляется один раз.
+ * @param messages Сообщения, возможно из разных чатов.
+ */
+void ChatManager::addMessageBatch(const QList<PacketMessage>& messages) {
+    QStringList updated;
+    database.transaction();
+    for (const PacketMessage& message : messages) {
+        if (storeMessage(message.getChatName(), message.getFrom(), message.getText(), message.getTimestamp(),
+                         message.getFirstName(), message.getLastName(), message.getSeq())
+            && !updated.contains(message.getChatName())) {
+            updated.append(message.getChatName());
+        }
+    }
+    database.commit();
+
+    for (const QString& chatName : updated) {
+        emit chatUpdated(chatName);
+    }
+}
+
+/**
+ * @brief Сохраняет сообщение в базе и в чате без уведомления об обновлении.
+ * @return true, если сообщение новое и добавлено в чат.
+ */
+bool ChatManager::storeMessage(const QString& chatName, const QString& sender, const QString& text,
+                               const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                               quint32 seq) {
+    Chat* chat = getChat(chatName);
+    if (!chat) {
+        return false;
+    }
+
+    SeqState& state = seqStates[chatName];
+    if (seq > 0 && seq <= state.contiguous) {
+        return false;
+    }
+
+    /*сообщение с номером могло уже прийти в пачке синхронизации*/
+    bool stored = database.addMessage(chatName, sender, text, timestamp, firstName, lastName, seq);
+    if (!stored && seq > 0) {
+        return false;
+    }
+    chat->addMessage(sender, text, timestamp, firstName, lastName);
+
+    if (seq > 0) {
+        advanceSeq(state, seq);
+        if (!state.ahead.isEmpty() && !state.syncPending) {
+            state.syncPending = true;
+            emit syncNeeded(chatName);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Учитывает полученный номер сообщения. Граница непрерывного участка
+ * сдвигается, только если номер следует сразу за ней; номера после пропуска
+ * откладываются до тех пор, пока пропуск не будет заполнен.
+ * @param state Состояние нумерации чата.
+ * @param seq Номер полученного сообщения.
+ */
+void ChatManager::advanceSeq(SeqState& state, quint32 seq) {
+    if (seq <= state.contiguous) {
+        return;
+    }
+    if (state.contiguous != 0 && seq != state.contiguous + 1) {
+        state.ahead.insert(seq);
+        return;
+    }
+    state.contiguous = seq;
+    while (state.ahead.remove(state.contiguous + 1)) {
+        ++state.contiguous;
+    }
+}
+
+/**
+ * @brief Добавляет в чат пачку сообщений, полученных при синхронизации.
+ * Сообщения записываются одной транзакцией, уже сохраненные пропускаются.
+ * @param chatName Имя чата.
+ * @param messages Сообщения с номерами на сервере.
+ */
+void ChatManager::addSyncedMessages(const QString& chatName, const QList<MessageRecord>& messages) {
     Chat* chat = getChat(chatName);
-    if (chat) {
-        chat->addMessage(sender, text, timestamp, firstName, lastName);
-        database.addMessage(chatName, sender, text, timestamp, firstName, lastName);
+    if (!chat) {
+        return;
+    }
+
+    SeqState& state = seqStates[chatName];
+    /*сервер отдает все сообщения после запрошенного номера, поэтому пропуск
+      перед первым из них - сообщения, удаленные на сервере по сроку хранения*/
+    if (!messages.isEmpty() && messages.first().seq > state.contiguous + 1) {
+        const quint32 skipped = messages.first().seq - 1;
+        state.contiguous = skipped;
+        for (auto it = state.ahead.begin(); it != state.ahead.end();) {
+            if (*it <= skipped) {
+                it = state.ahead.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        while (state.ahead.remove(state.contiguous + 1)) {
+            ++state.contiguous;
+        }
+    }
+    int added = 0;
+    database.transaction();
+    for (const MessageRecord& message : messages) {
+        if (database.addMessage(chatName, message.sender, message.text, message.timestamp,
+                                message.firstName, message.lastName, message.seq)) {
+            chat->addMessage(message.sender, message.text, message.timestamp, message.firstName, message.lastName);
+            ++added;
+        }
+        /*номер учитывается и для уже сохраненных сообщений, иначе граница не сдвинется*/
+        advanceSeq(state, message.seq);
+    }
+    database.commit();
+    state.syncPending = false;
+
+    if (added > 0) {
         emit chatUpdated(chatName);
     }
 }
@@ -85,3 +214,51 @@ void ChatManager::loadChat(const QString& name) {
     }
 }
 
+/**
+ * @brief Убирает чат, удаленный на сервере, из списка.
+ * Локальная история сообщений остается в базе данных.
+ * @param name Имя чата.
+ */
+void ChatManager::removeChat(const QString& name) {
+    if (chats.remove(name) == 0) {
+        return;
+    }
+    seqStates.remove(name);
+    for (int row = 0; row < model.rowCount(); ++row) {
+        QStandardItem* item = model.item(row);
+        if (item && item->text() == name) {
+            model.removeRow(row);
+            break;
+        }
+    }
+    emit chatDeleted();
+}
+
+/**
+ * @brief Переименовывает чат вместе с его локальной историей.
+ * @param name Текущее имя чата.
+ * @param newName Новое имя чата.
+ * @return true, если чат переименован.
+ */
+bool ChatManager::renameChat(const QString& name, const QString& newName) {
+    QMap<QString, Chat>::iterator it = chats.find(name);
+    if (it == chats.end() || chats.contains(newName)) {
+        return false;
+    }
+
+    Chat chat = it.value();
+    chat.setName(newName);
+    chats.erase(it);
+    chats.insert(newName, chat);
+    database.renameChat(name, newName);
+    seqStates.insert(newName, seqStates.take(name));
+
+    for (int row = 0; row < model.rowCount(); ++row) {
+        QStandardItem* item = model.item(row);
+        if (item && item->text() == name) {
+            item->setText(newName);
+            break;
+        }
+    }
+    return true;
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <QMap>
+#include <QSet>
 #include <QStandardItemModel>
 #include "Chat.h"
 #include "ChatDatabase.h"
+#include "protocol.h"
 
 
 class ChatManager : public QObject {
@@ -14,13 +16,31 @@ private:
     QStandardItemModel model;
     ChatDatabase database;
 
+    struct SeqState {
+        quint32 contiguous = 0;   /*до этого номера сообщения получены без пропусков*/
+        QSet<quint32> ahead;      /*номера, полученные после пропуска*/
+        bool syncPending = false; /*пропуск уже запрошен у сервера*/
+    };
+    QHash<QString, SeqState> seqStates;
+
+    void advanceSeq(SeqState& state, quint32 seq);
+    bool storeMessage(const QString& chatName, const QString& sender, const QString& text,
+                      const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                      quint32 seq);
+
 public:
     ChatManager(const QString& dbPath, QObject* parent = nullptr);
 
     void createChat(const QString& name);
+    void removeChat(const QString& name);
+    bool renameChat(const QString& name, const QString& newName);
     Chat* getChat(const QString& name);
     void addMessageToChat(const QString& chatName, const QString& sender, const QString& text,
-                     const QDateTime& timestamp, const QString& firstName, const QString& lastName);
+                     const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                     quint32 seq = 0);
+    void addMessageBatch(const QList<PacketMessage>& messages);
+    void addSyncedMessages(const QString& chatName, const QList<MessageRecord>& messages);
+    quint32 lastSeq(const QString& chatName) const { return seqStates.value(chatName).contiguous; }
     bool isOpen() const { return database.isOpen(); }
     void loadChat(const QString& name);
 
@@ -30,4 +50,5 @@ public:
 signals:
     void chatUpdated(const QString& chatName);
     void chatDeleted();
+    void syncNeeded(const QString& chatName); ///< В нумерации сообщений чата обнаружен пропуск.
 };
@@ -0,0 +1,156 @@
+#include "FrameCompression.h"
+#include <QtEndian>
+#include <zlib.h>
+#ifdef MESSENGER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace FrameCompression {
+
+/**
+ * @brief Кодеки, поддерживаемые этой сборкой.
+ * @return Битовая маска Codec.
+ */
+quint8 supportedCodecs() {
+#ifdef MESSENGER_HAVE_ZSTD
+    return Zlib | Zstd;
+#else
+    return Zlib;
+#endif
+}
+
+/**
+ * @brief Выбирает лучший кодек из доступных обеим сторонам.
+ * @param codecs Битовая маска общих кодеков.
+ * @return Кодек или 0, если общих кодеков нет.
+ */
+quint8 preferredCodec(quint8 codecs) {
+    codecs &= supportedCodecs();
+    if (codecs & Zstd) {
+        return Zstd;
+    }
+    if (codecs & Zlib) {
+        return Zlib;
+    }
+    return 0;
+}
+
+/**
+ * @brief Сжимает данные указанным кодеком.
+ * @param data Исходные данные.
+ * @param codec Кодек.
+ * @return Байт кодека и сжатые данные или пустой массив, если кодек не поддерживается.
+ */
+QByteArray compress(const QByteArray& data, quint8 codec) {
+    QByteArray result;
+    switch (codec) {
+    case Zlib:
+        result.append(static_cast<char>(Zlib));
+        result.append(qCompress(data, 6));
+        break;
+#ifdef MESSENGER_HAVE_ZSTD
+    case Zstd: {
+        size_t bound = ZSTD_compressBound(data.size());
+        result.resize(1 + static_cast<int>(bound));
+        result[0] = static_cast<char>(Zstd);
+        size_t written = ZSTD_compress(result.data() + 1, bound, data.constData(), data.size(), 3);
+        if (ZSTD_isError(written)) {
+            return QByteArray();
+        }
+        result.resize(1 + static_cast<int>(written));
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+    return result;
+}
+
+namespace {
+/**
+ * @brief Распаковывает поток zlib, не выходя за maxSize.
+ * Размер, записанный отправителем, не проверяется заранее: распаковка
+ * идет кусками и прерывается, как только результат превысил бы maxSize.
+ */
+bool inflateBounded(const char* input, qint64 inputSize, qint64 maxSize, QByteArray& data) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    stream.avail_in = static_cast<uInt>(inputSize);
+
+    data.clear();
+    char chunk[16384];
+    int status = Z_OK;
+    while (status == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(chunk);
+        stream.avail_out = sizeof(chunk);
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            break;
+        }
+        const qint64 produced = static_cast<qint64>(sizeof(chunk) - stream.avail_out);
+        if (data.size() + produced > maxSize) {
+            status = Z_MEM_ERROR;
+            break;
+        }
+        data.append(chunk, static_cast<int>(produced));
+        /*поток оборвался: данных больше нет, а конца потока не было*/
+        if (status == Z_OK && stream.avail_in == 0 && stream.avail_out != 0) {
+            status = Z_DATA_ERROR;
+        }
+    }
+    inflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+}
+
+/**
+ * @brief Распаковывает данные кадра.
+ * Размер результата ограничен maxSize при самой распаковке, поэтому
+ * маленький кадр не может заставить выделить произвольно большой буфер.
+ * @param compressed Байт кодека и сжатые данные.
+ * @param maxSize Наибольший допустимый размер распакованных данных.
+ * @param data Заполняется распакованными данными.
+ * @return true, если данные распакованы.
+ */
+bool decompress(const QByteArray& compressed, qint64 maxSize, QByteArray& data) {
+    if (compressed.isEmpty()) {
+        return false;
+    }
+    quint8 codec = static_cast<quint8>(compressed.at(0));
+    QByteArray body = compressed.mid(1);
+
+    switch (codec) {
+    case Zlib: {
+        /*qCompress записывает исходный размер первыми 4 байтами big-endian,
+          дальше идет поток zlib; размер сверяется с результатом*/
+        if (body.size() < 4) {
+            return false;
+        }
+        const quint32 declared = qFromBigEndian<quint32>(body.constData());
+        if (declared > maxSize || !inflateBounded(body.constData() + 4, body.size() - 4, maxSize, data)) {
+            return false;
+        }
+        return !data.isEmpty() && static_cast<quint32>(data.size()) == declared;
+    }
+#ifdef MESSENGER_HAVE_ZSTD
+    case Zstd: {
+        unsigned long long size = ZSTD_getFrameContentSize(body.constData(), body.size());
+        if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN
+            || size > static_cast<unsigned long long>(maxSize)) {
+            return false;
+        }
+        data.resize(static_cast<int>(size));
+        size_t read = ZSTD_decompress(data.data(), data.size(), body.constData(), body.size());
+        return !ZSTD_isError(read) && read == size;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+}
@@ -67,6 +67,40 @@ void PacketRouter::routePacket(const QByteArray& data) {
             }
             break;
 
+        case PacketType::SyncBatch:
+            if (dynamic_cast<PacketMessageHandler*>(handler)) {
+                packet->handle(handler);
+                logger.log(QtInfoMsg, QString("Пакет типа SyncBatch обработан обработчиком: %1")
+                                          .arg(reinterpret_cast<quintptr>(handler)));
+                handled = true;
+            }
+            break;
+
+        case PacketType::MessageBatch:
+            if (dynamic_cast<PacketMessageHandler*>(handler)) {
+                packet->handle(handler);
+                logger.log(QtInfoMsg, QString("Пакет типа MessageBatch обработан обработчиком: %1")
+                                          .arg(reinterpret_cast<quintptr>(handler)));
+                handled = true;
+            }
+            break;
+
+        case PacketType::HelloAck:
+            if (dynamic_cast<PacketServerResponseHandler*>(handler)) {
+                packet->handle(handler);
+                logger.log(QtInfoMsg, QString("Пакет типа HelloAck обработан обработчиком: %1")
+                                          .arg(reinterpret_cast<quintptr>(handler)));
+                handled = true;
+            }
+            break;
+
+        case PacketType::SearchResult:
+            if (dynamic_cast<PacketServerResponseHandler*>(handler)) {
+                packet->handle(handler);
+                handled = true;
+            }
+            break;
+
         case PacketType::ServerResponse:
             if (dynamic_cast<PacketServerResponseHandler*>(handler)) {
                 packet->handle(handler);
@@ -85,6 +119,15 @@ void PacketRouter::routePacket(const QByteArray& data) {
             }
             break;
 
+        case PacketType::ChatListDelta:
+            if (dynamic_cast<PacketChatListHandler*>(handler)) {
+                packet->handle(handler);
+                logger.log(QtInfoMsg, QString("Пакет типа ChatListDelta обработан обработчиком: %1")
+                                             .arg(reinterpret_cast<quintptr>(handler)));
+                handled = true;
+            }
+            break;
+
         default:
             logger.log(QtWarningMsg, QString("Не найден подходящий обработчик для типа пакета: %1")
                                                .arg(static_cast<int>(type)));
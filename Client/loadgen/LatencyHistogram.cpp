@@ -0,0 +1,81 @@
+#include "LatencyHistogram.h"
+#include <cmath>
+
+namespace {
+/* номер старшего установленного бита, value > 0*/
+int highestBit(quint64 value) {
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+}
+
+LatencyHistogram::LatencyHistogram()
+    : buckets(2 * SubBuckets + (64 - SubBucketBits - 1) * SubBuckets, 0) {}
+
+/**
+ * @brief Номер корзины: значения до 2 * SubBuckets - сами себе корзина,
+ * большие сдвигаются так, чтобы остались SubBucketBits + 1 старших бит.
+ */
+int LatencyHistogram::indexOf(quint64 value) {
+    if (value < quint64(2 * SubBuckets)) {
+        return int(value);
+    }
+    const int shift = highestBit(value) - SubBucketBits;
+    return 2 * SubBuckets + (shift - 1) * SubBuckets + int((value >> shift) - SubBuckets);
+}
+
+/**
+ * @brief Наибольшее значение, попадающее в корзину.
+ */
+quint64 LatencyHistogram::highestValueAt(int index) {
+    if (index < 2 * SubBuckets) {
+        return quint64(index);
+    }
+    const int shift = (index - 2 * SubBuckets) / SubBuckets + 1;
+    const quint64 sub = quint64((index - 2 * SubBuckets) % SubBuckets + SubBuckets);
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Добавляет значение; отрицательные считаются нулем.
+ */
+void LatencyHistogram::record(qint64 value) {
+    value = qMax<qint64>(0, value);
+    ++buckets[indexOf(quint64(value))];
+    if (total == 0 || value < minValue) {
+        minValue = value;
+    }
+    maxValue = qMax(maxValue, value);
+    sum += double(value);
+    ++total;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(buckets.begin(), buckets.end(), 0);
+    total = 0;
+    minValue = 0;
+    maxValue = 0;
+    sum = 0;
+}
+
+/**
+ * @brief Значение, не меньше которого fraction всех записанных значений.
+ * Возвращается верхняя граница корзины, но не больше максимума.
+ */
+qint64 LatencyHistogram::percentile(double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+    const quint64 target = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, fraction, 1.0) * double(total))));
+    quint64 seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return qMin<qint64>(maxValue, qint64(highestValueAt(int(i))));
+        }
+    }
+    return maxValue;
+}
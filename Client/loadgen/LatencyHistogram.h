@@ -0,0 +1,41 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <vector>
+
+/**
+ * @brief Класс LatencyHistogram - гистограмма задержек с логарифмическими корзинами.
+ *
+ * Значения до 127 хранятся точно, дальше каждая степень двойки делится
+ * на 64 равные корзины, поэтому относительная погрешность процентилей
+ * не больше 1/64 на всем диапазоне qint64. Запись - O(1) без выделения памяти.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(qint64 value);
+    void reset();
+
+    quint64 count() const { return total; }
+    qint64 min() const { return total ? minValue : 0; }
+    qint64 max() const { return maxValue; }
+    double mean() const { return total ? double(sum) / double(total) : 0.0; }
+    qint64 percentile(double fraction) const; /* fraction в [0, 1], например 0.999*/
+
+private:
+    static constexpr int SubBucketBits = 6;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+
+    static int indexOf(quint64 value);
+    static quint64 highestValueAt(int index);
+
+    std::vector<quint64> buckets;
+    quint64 total = 0;
+    qint64 minValue = 0;
+    qint64 maxValue = 0;
+    double sum = 0;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,145 @@
+#include "LoadClient.h"
+#include "FrameCompression.h"
+#include "SecurityUtils.h"
+
+LoadClient::LoadClient(int index, const QString& username, const QString& password, QObject* parent)
+    : QObject(parent), number(index), user(username), password(password) {
+    connect(&socket, &QTcpSocket::connected, this, &LoadClient::onConnected);
+    connect(&socket, &QTcpSocket::readyRead, this, &LoadClient::onReadyRead);
+    connect(&socket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+        ready = false;
+        emit failed(this, socket.errorString());
+    });
+}
+
+/**
+ * @brief Подключается к серверу и начинает регистрацию или аутентификацию.
+ * @param registerFirst Сначала зарегистрировать пользователя; если он уже
+ *                      существует, аутентификация все равно выполняется.
+ */
+void LoadClient::start(const QString& host, quint16 port, bool registerFirst) {
+    this->registerFirst = registerFirst;
+    socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    socket.connectToHost(host, port);
+}
+
+void LoadClient::stop() {
+    ready = false;
+    socket.abort();
+}
+
+void LoadClient::send(const PacketMessage& message) {
+    sendFrame(message.serialize());
+}
+
+void LoadClient::sendFrame(const QByteArray& frame) {
+    socket.write(Packet::compressFrame(frame, codec, FrameCompression::DefaultThreshold));
+}
+
+/**
+ * @brief Первый этап аутентификации - только логин, второй - хэш с солью.
+ */
+void LoadClient::sendAuth(const QString& secret) {
+    PacketAuth packet;
+    packet.setUsername(user);
+    packet.setPassword(secret);
+    sendFrame(packet.serialize());
+}
+
+void LoadClient::onConnected() {
+    PacketHello hello;
+    hello.setVersion(Packet::ProtocolVersion);
+    hello.setCapabilities(Capability::All);
+    hello.setCodecs(FrameCompression::supportedCodecs());
+    socket.write(hello.serialize());
+
+    if (registerFirst) {
+        PacketRegister packet;
+        packet.setUsername(user);
+        packet.setPassword(password);
+        packet.setFirst_name("Load");
+        packet.setLast_name(QString::number(number));
+        sendFrame(packet.serialize());
+    } else {
+        sendAuth(QString());
+    }
+}
+
+/**
+ * @brief Разбирает входящие кадры. Ping обрабатывается здесь же, как
+ * в ManagerNetwork клиента, остальные пакеты - через handle().
+ */
+void LoadClient::onReadyRead() {
+    buf.append(socket.readAll());
+    while (true) {
+        qint64 size = Packet::frameSize(buf);
+        if (size < 0) {
+            break;
+        }
+        if (size < Packet::HeaderSize || size > Packet::MaxPayloadSize) {
+            emit failed(this, QString("Некорректный размер кадра: %1 байт").arg(size));
+            stop();
+            return;
+        }
+        if (buf.size() < size) {
+            break;
+        }
+
+        QByteArray data = buf.left(size);
+        buf.remove(0, size);
+        std::shared_ptr<Packet> packet = Packet::deserialize(data);
+        if (!packet) {
+            continue;
+        }
+        if (packet->getType() == PacketType::Ping) {
+            PacketPong pong;
+            pong.setTimestamp(std::static_pointer_cast<PacketPing>(packet)->getTimestamp());
+            sendFrame(pong.serialize());
+            continue;
+        }
+        packet->handle(this);
+    }
+}
+
+void LoadClient::handle(PacketHelloAck& packet) {
+    capabilities = packet.getCapabilities();
+    codec = (capabilities & Capability::Compression) ? FrameCompression::preferredCodec(packet.getCodecs()) : 0;
+}
+
+void LoadClient::handle(PacketServerResponse& packet) {
+    switch (packet.GetResponseType()) {
+    case PacketServerResponse::ServerResponseType::Register:
+        /*пользователь мог остаться с прошлого запуска, поэтому ответ не важен*/
+        sendAuth(QString());
+        break;
+    case PacketServerResponse::ServerResponseType::Auth:
+        if (packet.GetResponseStatus() == PacketServerResponse::ServerResponseStatus::SuccessUsername) {
+            sendAuth(SecurityUtils::hashPassword(password, packet.GetSalt()));
+        } else if (packet.GetResponseStatus() == PacketServerResponse::ServerResponseStatus::Success) {
+            ready = true;
+            emit authenticated(this);
+            sendFrame(PacketChatList().serialize());
+        } else {
+            emit failed(this, packet.getResponse());
+        }
+        break;
+    case PacketServerResponse::ServerResponseType::RateLimit:
+        emit rateLimited(this);
+        break;
+    }
+}
+
+void LoadClient::handle(PacketChatList& packet) {
+    chats = packet.getChatNames();
+    emit chatListReceived(this);
+}
+
+void LoadClient::handle(PacketMessage& packet) {
+    emit messageReceived(this, packet.getFrom(), packet.getIdempotencyKey());
+}
+
+void LoadClient::handle(PacketMessageBatch& packet) {
+    for (const PacketMessage& message : packet.getMessages()) {
+        emit messageReceived(this, message.getFrom(), message.getIdempotencyKey());
+    }
+}
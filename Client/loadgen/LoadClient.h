@@ -0,0 +1,67 @@
+#ifndef LOADCLIENT_H
+#define LOADCLIENT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QStringList>
+#include "packethandler.h"
+
+/**
+ * @brief Класс LoadClient - одно соединение генератора нагрузки.
+ *
+ * Проходит тот же путь, что и клиент с интерфейсом: Hello, при необходимости
+ * Register, затем Auth с солью. Разбор кадров повторяет ManagerNetwork клиента,
+ * но без записи каждого пакета в журнал, иначе генератор измерял бы диск.
+ * Принятые сообщения передаются генератору сигналом messageReceived.
+ */
+class LoadClient : public QObject, public PacketHandler {
+    Q_OBJECT
+
+public:
+    LoadClient(int index, const QString& username, const QString& password, QObject* parent = nullptr);
+
+    void start(const QString& host, quint16 port, bool registerFirst);
+    void send(const PacketMessage& message);
+    void stop();
+
+    int index() const { return number; }
+    QString username() const { return user; }
+    bool isReady() const { return ready; }
+    const QStringList& chatNames() const { return chats; }
+
+    void handle(PacketRegister& packet) override {}
+    void handle(PacketAuth& packet) override {}
+    void handle(PacketMessage& packet) override;
+    void handle(PacketServerResponse& packet) override;
+    void handle(PacketChatList& packet) override;
+    void handle(PacketMessageBatch& packet) override;
+    void handle(PacketHelloAck& packet) override;
+
+signals:
+    void authenticated(LoadClient* client);
+    void failed(LoadClient* client, const QString& reason);
+    void chatListReceived(LoadClient* client);
+    void messageReceived(LoadClient* client, const QString& sender, const QString& idempotencyKey);
+    void rateLimited(LoadClient* client);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+
+private:
+    void sendFrame(const QByteArray& frame);
+    void sendAuth(const QString& secret);
+
+    QTcpSocket socket;
+    QByteArray buf;
+    int number;
+    QString user;
+    QString password;
+    bool registerFirst = false;
+    bool ready = false;
+    quint32 capabilities = 0;
+    quint8 codec = 0;
+    QStringList chats;
+};
+
+#endif // LOADCLIENT_H
@@ -0,0 +1,321 @@
+#include "LoadGenerator.h"
+#include <QDateTime>
+#include <QTextStream>
+#include <algorithm>
+
+namespace {
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+}
+
+LoadGenerator::LoadGenerator(const LoadConfig& config, QObject* parent)
+    : QObject(parent), config(config) {
+    this->config.connections = qMax(1, config.connections);
+    this->config.connectRate = qMax(1, config.connectRate);
+    this->config.inflight = qMax(1, config.inflight);
+    text = QString(qMax(1, config.messageSize), QChar('x'));
+
+    connectTimer.setInterval(10);
+    connect(&connectTimer, &QTimer::timeout, this, &LoadGenerator::onConnectTick);
+    /*открытый цикл проверяет расписание каждую миллисекунду*/
+    sendTimer.setTimerType(Qt::PreciseTimer);
+    sendTimer.setInterval(1);
+    connect(&sendTimer, &QTimer::timeout, this, &LoadGenerator::onSendTick);
+    reportTimer.setInterval(1000);
+    connect(&reportTimer, &QTimer::timeout, this, &LoadGenerator::onReportTick);
+}
+
+/**
+ * @brief Начинает подключение клиентов со скоростью connectRate в секунду.
+ */
+void LoadGenerator::start() {
+    clock.start();
+    out() << QString("Подключение %1 клиентов к %2:%3").arg(config.connections).arg(config.host).arg(config.port)
+          << Qt::endl;
+    connectTimer.start();
+    reportTimer.start();
+    QTimer::singleShot(config.connectTimeoutSec * 1000, this, [this]() {
+        if (phase == Phase::Connecting) {
+            out() << QString("Не дождались %1 клиентов, нагрузка подается на подключившихся")
+                         .arg(config.connections - settled) << Qt::endl;
+            settled = config.connections;
+            maybeBeginLoad();
+        }
+    });
+}
+
+void LoadGenerator::onConnectTick() {
+    const int perTick = qMax(1, config.connectRate / 100);
+    for (int i = 0; i < perTick && opened < config.connections; ++i, ++opened) {
+        auto* client = new LoadClient(opened, QString("%1%2").arg(config.userPrefix).arg(opened), config.password, this);
+        connect(client, &LoadClient::authenticated, this, &LoadGenerator::onAuthenticated);
+        connect(client, &LoadClient::failed, this, &LoadGenerator::onFailed);
+        connect(client, &LoadClient::chatListReceived, this, &LoadGenerator::onChatListReceived);
+        connect(client, &LoadClient::messageReceived, this, &LoadGenerator::onMessageReceived);
+        connect(client, &LoadClient::rateLimited, this, [this]() { ++rateLimited; });
+        clients.push_back(client);
+        client->start(config.host, config.port, config.registerUsers);
+    }
+    if (opened == config.connections) {
+        connectTimer.stop();
+    }
+}
+
+void LoadGenerator::onAuthenticated(LoadClient* client) {
+    readyClients.push_back(client);
+    ++settled;
+    maybeBeginLoad();
+}
+
+/**
+ * @brief Отказ аутентификации или разрыв соединения.
+ * Во время нагрузки клиент просто выбывает из отправителей.
+ */
+void LoadGenerator::onFailed(LoadClient* client, const QString& reason) {
+    auto it = std::find(readyClients.begin(), readyClients.end(), client);
+    if (it != readyClients.end()) {
+        readyClients.erase(it);
+        ++disconnects;
+    } else if (phase == Phase::Connecting) {
+        ++settled;
+        ++failures;
+    }
+    if (failureReasons.size() < 5 && !failureReasons.contains(reason)) {
+        failureReasons.append(reason);
+    }
+    /*после отказа сокет закрывается, повторные сигналы клиента не нужны*/
+    disconnect(client, nullptr, this, nullptr);
+    client->stop();
+    maybeBeginLoad();
+}
+
+/**
+ * @brief Первый полученный список чатов определяет, куда отправлять сообщения.
+ */
+void LoadGenerator::onChatListReceived(LoadClient* client) {
+    if (!chats.isEmpty()) {
+        return;
+    }
+    const QStringList& available = client->chatNames();
+    if (config.chats.isEmpty()) {
+        if (!available.isEmpty()) {
+            chats.append(available.first());
+        }
+    } else {
+        for (const QString& chat : config.chats) {
+            if (available.contains(chat)) {
+                chats.append(chat);
+            } else {
+                out() << QString("Чата '%1' нет на сервере, пропускаем").arg(chat) << Qt::endl;
+            }
+        }
+    }
+    if (chats.isEmpty()) {
+        out() << "На сервере нет подходящих чатов: создайте чат в окне сервера" << Qt::endl;
+        finish();
+        return;
+    }
+    maybeBeginLoad();
+}
+
+/**
+ * @brief Начинает отправку, когда все клиенты подключились или отказали
+ * и известен список чатов.
+ */
+void LoadGenerator::maybeBeginLoad() {
+    if (phase != Phase::Connecting || settled < config.connections || chats.isEmpty()) {
+        return;
+    }
+    if (readyClients.empty()) {
+        out() << "Ни один клиент не прошел аутентификацию" << Qt::endl;
+        finish();
+        return;
+    }
+
+    out() << QString("Готово клиентов: %1, отказов: %2, чаты: %3")
+                 .arg(readyClients.size()).arg(failures).arg(chats.join(", ")) << Qt::endl;
+    phase = Phase::Warmup;
+    loadStartNs = nowNs();
+    if (config.rate > 0) {
+        out() << QString("Открытый цикл: %1 сообщений/с").arg(config.rate) << Qt::endl;
+        sendTimer.start();
+    } else {
+        out() << QString("Замкнутый цикл: %1 сообщений в полете на соединение").arg(config.inflight) << Qt::endl;
+        const std::vector<LoadClient*> senders = readyClients;
+        for (LoadClient* client : senders) {
+            for (int i = 0; i < config.inflight; ++i) {
+                sendFrom(client, nowNs());
+            }
+        }
+    }
+    QTimer::singleShot(config.warmupSec * 1000, this, &LoadGenerator::beginMeasure);
+}
+
+void LoadGenerator::beginMeasure() {
+    if (phase != Phase::Warmup) {
+        return;
+    }
+    phase = Phase::Measure;
+    measureStartNs = nowNs();
+    sent = echoed = delivered = rateLimited = disconnects = 0;
+    lastSent = lastDelivered = 0;
+    echoLatency.reset();
+    deliveryLatency.reset();
+    QTimer::singleShot(config.durationSec * 1000, this, &LoadGenerator::beginDrain);
+}
+
+void LoadGenerator::beginDrain() {
+    if (phase != Phase::Measure) {
+        return;
+    }
+    phase = Phase::Drain;
+    measureEndNs = nowNs();
+    sendTimer.stop();
+    QTimer::singleShot(config.drainSec * 1000, this, &LoadGenerator::finish);
+}
+
+void LoadGenerator::finish() {
+    if (phase == Phase::Done) {
+        return;
+    }
+    const bool measured = phase == Phase::Drain;
+    phase = Phase::Done;
+    connectTimer.stop();
+    sendTimer.stop();
+    reportTimer.stop();
+    if (measured) {
+        printReport();
+    }
+    for (LoadClient* client : clients) {
+        client->stop();
+    }
+    emit finished(measured ? 0 : 1);
+}
+
+/**
+ * @brief Открытый цикл: отправляет все сообщения, чей момент по расписанию
+ * уже наступил. Если генератор отстал, сообщения уходят пачкой, но каждое
+ * со своим запланированным временем.
+ */
+void LoadGenerator::onSendTick() {
+    if (readyClients.empty()) {
+        return;
+    }
+    const qint64 elapsed = nowNs() - loadStartNs;
+    const quint64 due = quint64(double(elapsed) * config.rate / 1e9);
+    while (scheduled < due && !readyClients.empty()) {
+        const qint64 at = loadStartNs + qint64(double(scheduled) * 1e9 / config.rate);
+        nextSender = (nextSender + 1) % readyClients.size();
+        sendFrom(readyClients[nextSender], at);
+        ++scheduled;
+    }
+}
+
+void LoadGenerator::sendFrom(LoadClient* client, qint64 sentNs) {
+    ++sequence;
+    const QString key = QString("lg%1-%2").arg(client->index()).arg(sequence);
+
+    PacketMessage message;
+    message.setFrom(client->username());
+    message.setChatName(chats.at(int(sequence % quint64(chats.size()))));
+    message.setText(text);
+    message.setTimestamp(QDateTime::currentDateTime());
+    message.setIdempotencyKey(key);
+
+    const bool measured = phase == Phase::Measure;
+    inFlight.insert(key, {sentNs, client->index(), int(readyClients.size()), measured});
+    if (measured) {
+        ++sent;
+    }
+    client->send(message);
+}
+
+/**
+ * @brief Сопоставляет полученное сообщение с моментом отправки.
+ */
+void LoadGenerator::onMessageReceived(LoadClient* client, const QString& sender, const QString& idempotencyKey) {
+    Q_UNUSED(sender);
+    auto it = inFlight.find(idempotencyKey);
+    if (it == inFlight.end() || !client->isReady()) {
+        return;
+    }
+    const qint64 now = nowNs();
+    const qint64 latencyUs = (now - it->sentNs) / 1000;
+    const bool own = it->sender == client->index();
+    if (it->measured) {
+        deliveryLatency.record(latencyUs);
+        ++delivered;
+        if (own) {
+            echoLatency.record(latencyUs);
+            ++echoed;
+        }
+    }
+    if (--it->pending <= 0) {
+        inFlight.erase(it);
+    }
+
+    /*замкнутый цикл: следующее сообщение уходит, когда вернулось свое*/
+    if (own && config.rate <= 0 && (phase == Phase::Warmup || phase == Phase::Measure)) {
+        sendFrom(client, now);
+    }
+}
+
+void LoadGenerator::onReportTick() {
+    const double seconds = clock.elapsed() / 1000.0;
+    switch (phase) {
+    case Phase::Connecting:
+        out() << QString("[%1 с] подключено %2/%3").arg(seconds, 0, 'f', 1).arg(readyClients.size()).arg(config.connections)
+              << Qt::endl;
+        break;
+    case Phase::Warmup:
+        out() << QString("[%1 с] прогрев, в полете %2").arg(seconds, 0, 'f', 1).arg(inFlight.size()) << Qt::endl;
+        break;
+    case Phase::Measure:
+        out() << QString("[%1 с] отправлено %2/с, доставлено %3/с, p99 %4 мкс, в полете %5")
+                     .arg(seconds, 0, 'f', 1)
+                     .arg(sent - lastSent)
+                     .arg(delivered - lastDelivered)
+                     .arg(deliveryLatency.percentile(0.99))
+                     .arg(inFlight.size())
+              << Qt::endl;
+        lastSent = sent;
+        lastDelivered = delivered;
+        break;
+    default:
+        break;
+    }
+}
+
+void LoadGenerator::printReport() const {
+    const double seconds = qMax<qint64>(1, measureEndNs - measureStartNs) / 1e9;
+    auto row = [](const QString& name, const LatencyHistogram& histogram) {
+        return QString("%1 %2 %3 %4 %5 %6 %7 %8")
+            .arg(name, -12)
+            .arg(histogram.count(), 10)
+            .arg(histogram.min(), 9)
+            .arg(histogram.percentile(0.50), 9)
+            .arg(histogram.percentile(0.99), 9)
+            .arg(histogram.percentile(0.999), 9)
+            .arg(histogram.max(), 9)
+            .arg(histogram.mean(), 9, 'f', 0);
+    };
+
+    QTextStream& stream = out();
+    stream << Qt::endl << QString("Измерение: %1 с, клиентов %2").arg(seconds, 0, 'f', 1).arg(readyClients.size()) << Qt::endl;
+    stream << QString("Отправлено:   %1 (%2 сообщений/с)").arg(sent).arg(sent / seconds, 0, 'f', 1) << Qt::endl;
+    stream << QString("Вернулось:    %1, потеряно %2").arg(echoed).arg(sent - qMin(sent, echoed)) << Qt::endl;
+    stream << QString("Доставлено:   %1 (%2 сообщений/с)").arg(delivered).arg(delivered / seconds, 0, 'f', 1) << Qt::endl;
+    stream << QString("Ограничено сервером: %1, разрывов: %2").arg(rateLimited).arg(disconnects) << Qt::endl;
+    if (failures > 0) {
+        stream << QString("Отказов при подключении: %1 (%2)").arg(failures).arg(failureReasons.join("; ")) << Qt::endl;
+    }
+    stream << Qt::endl << QString("%1 %2 %3 %4 %5 %6 %7 %8")
+                              .arg(QString("задержка,мкс"), -12).arg(QString("кол-во"), 10)
+                              .arg(QString("min"), 9).arg(QString("p50"), 9).arg(QString("p99"), 9)
+                              .arg(QString("p999"), 9).arg(QString("max"), 9).arg(QString("mean"), 9)
+           << Qt::endl;
+    stream << row("отправителю", echoLatency) << Qt::endl;
+    stream << row("всем", deliveryLatency) << Qt::endl;
+}
@@ -0,0 +1,124 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHash>
+#include <QStringList>
+#include <vector>
+#include "LoadClient.h"
+#include "LatencyHistogram.h"
+
+/**
+ * @brief Параметры прогона генератора нагрузки.
+ */
+struct LoadConfig {
+    QString host = "127.0.0.1";
+    quint16 port = 3333;
+    int connections = 10;
+    int connectRate = 200;       /* новых подключений в секунду*/
+    bool registerUsers = true;   /* регистрировать пользователей перед аутентификацией*/
+    QString userPrefix = "loadgen";
+    QString password = "loadgen";
+    QStringList chats;           /* пусто - первый чат из списка сервера*/
+    double rate = 100;           /* сообщений в секунду на все соединения, 0 - замкнутый цикл*/
+    int inflight = 1;            /* замкнутый цикл: неподтвержденных сообщений на соединение*/
+    int messageSize = 64;        /* длина текста сообщения в символах*/
+    int warmupSec = 5;
+    int durationSec = 30;
+    int drainSec = 3;            /* ожидание рассылки после остановки отправки*/
+    int connectTimeoutSec = 30;
+};
+
+/**
+ * @brief Класс LoadGenerator - сквозной нагрузочный прогон сервера.
+ *
+ * Открывает connections соединений, проходит аутентификацию и отправляет
+ * сообщения в одном из двух режимов:
+ * - открытый цикл (rate > 0): сообщения уходят по расписанию независимо
+ *   от ответов сервера, а задержка считается от запланированного момента
+ *   отправки, поэтому отставание генератора или сервера не прячется;
+ * - замкнутый цикл (rate = 0): каждое соединение держит inflight
+ *   неподтвержденных сообщений и отправляет следующее, получив свое обратно.
+ *
+ * Каждое сообщение помечается ключом отправки, по нему рассылка сопоставляется
+ * с моментом отправки. Считаются две гистограммы: до возврата сообщения
+ * отправителю и до получения каждым подключенным клиентом. В итог попадают
+ * только сообщения, отправленные после прогрева.
+ */
+class LoadGenerator : public QObject {
+    Q_OBJECT
+
+public:
+    explicit LoadGenerator(const LoadConfig& config, QObject* parent = nullptr);
+
+    void start();
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void onConnectTick();
+    void onAuthenticated(LoadClient* client);
+    void onFailed(LoadClient* client, const QString& reason);
+    void onChatListReceived(LoadClient* client);
+    void onMessageReceived(LoadClient* client, const QString& sender, const QString& idempotencyKey);
+    void onSendTick();
+    void onReportTick();
+
+private:
+    enum class Phase { Connecting, Warmup, Measure, Drain, Done };
+
+    /* Сообщение, рассылка которого еще ожидается*/
+    struct InFlight {
+        qint64 sentNs;     /* момент отправки (в открытом цикле - запланированный)*/
+        int sender;        /* номер соединения-отправителя*/
+        int pending;       /* сколько клиентов еще не получили сообщение*/
+        bool measured;     /* отправлено после прогрева*/
+    };
+
+    void maybeBeginLoad();
+    void beginMeasure();
+    void beginDrain();
+    void finish();
+    void sendFrom(LoadClient* client, qint64 sentNs);
+    void printReport() const;
+    qint64 nowNs() const { return clock.nsecsElapsed(); }
+
+    LoadConfig config;
+    Phase phase = Phase::Connecting;
+    QElapsedTimer clock;
+    QTimer connectTimer;
+    QTimer sendTimer;
+    QTimer reportTimer;
+
+    std::vector<LoadClient*> clients;
+    std::vector<LoadClient*> readyClients;
+    int opened = 0;
+    int settled = 0;               /* прошли аутентификацию или отказали*/
+    int failures = 0;
+    QStringList failureReasons;
+    QStringList chats;
+    QString text;
+
+    QHash<QString, InFlight> inFlight;
+    quint64 sequence = 0;
+    qint64 loadStartNs = 0;
+    quint64 scheduled = 0;         /* открытый цикл: отправлено по расписанию*/
+    size_t nextSender = 0;
+
+    qint64 measureStartNs = 0;
+    qint64 measureEndNs = 0;
+    quint64 sent = 0;
+    quint64 echoed = 0;
+    quint64 delivered = 0;
+    quint64 rateLimited = 0;
+    quint64 disconnects = 0;
+    quint64 lastSent = 0;
+    quint64 lastDelivered = 0;
+    LatencyHistogram echoLatency;     /* отправка -> возврат отправителю, мкс*/
+    LatencyHistogram deliveryLatency; /* отправка -> получение каждым клиентом, мкс*/
+};
+
+#endif // LOADGENERATOR_H
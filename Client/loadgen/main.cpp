@@ -0,0 +1,58 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include "LoadGenerator.h"
+
+/**
+ * @brief messenger-loadgen - сквозной нагрузочный прогон сервера без интерфейса.
+ * Все соединения идут с одного адреса, поэтому лимиты сервера
+ * rate_limit/Address/... на время прогона стоит поднять, иначе будет
+ * измерен ограничитель частоты запросов.
+ */
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("messenger-loadgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Нагрузочный генератор мессенджера: задержка рассылки и пропускная способность");
+    parser.addHelpOption();
+
+    LoadConfig config;
+    QCommandLineOption host("host", "Адрес сервера.", "address", config.host);
+    QCommandLineOption port("port", "Порт сервера.", "port", QString::number(config.port));
+    QCommandLineOption connections({"c", "connections"}, "Число соединений.", "n", QString::number(config.connections));
+    QCommandLineOption connectRate("connect-rate", "Новых подключений в секунду.", "n", QString::number(config.connectRate));
+    QCommandLineOption noRegister("no-register", "Не регистрировать пользователей, только аутентификация.");
+    QCommandLineOption prefix("user-prefix", "Префикс имен пользователей.", "prefix", config.userPrefix);
+    QCommandLineOption password("password", "Пароль пользователей.", "password", config.password);
+    QCommandLineOption chat("chat", "Чат для сообщений, можно несколько раз. По умолчанию первый чат сервера.", "name");
+    QCommandLineOption rate({"r", "rate"}, "Сообщений в секунду на все соединения, 0 - замкнутый цикл.", "n",
+                            QString::number(config.rate));
+    QCommandLineOption inflight("inflight", "Замкнутый цикл: сообщений в полете на соединение.", "n",
+                                QString::number(config.inflight));
+    QCommandLineOption size("size", "Длина текста сообщения.", "chars", QString::number(config.messageSize));
+    QCommandLineOption warmup("warmup", "Прогрев, секунд.", "sec", QString::number(config.warmupSec));
+    QCommandLineOption duration({"d", "duration"}, "Длительность измерения, секунд.", "sec",
+                                QString::number(config.durationSec));
+    parser.addOptions({host, port, connections, connectRate, noRegister, prefix, password, chat, rate, inflight,
+                       size, warmup, duration});
+    parser.process(app);
+
+    config.host = parser.value(host);
+    config.port = quint16(parser.value(port).toUInt());
+    config.connections = parser.value(connections).toInt();
+    config.connectRate = parser.value(connectRate).toInt();
+    config.registerUsers = !parser.isSet(noRegister);
+    config.userPrefix = parser.value(prefix);
+    config.password = parser.value(password);
+    config.chats = parser.values(chat);
+    config.rate = parser.value(rate).toDouble();
+    config.inflight = parser.value(inflight).toInt();
+    config.messageSize = parser.value(size).toInt();
+    config.warmupSec = parser.value(warmup).toInt();
+    config.durationSec = parser.value(duration).toInt();
+
+    LoadGenerator generator(config);
+    QObject::connect(&generator, &LoadGenerator::finished, &app, &QCoreApplication::exit);
+    generator.start();
+    return app.exec();
+}
@@ -8,6 +8,9 @@
 #include "SecurityUtils.h"
 #include <QStandardPaths>
 #include <QCloseEvent>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QUuid>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::MainWindow) {
@@ -57,16 +60,61 @@ MainWindow::MainWindow(QWidget *parent)
     connect(serverResponseHandler, &PacketServerResponseHandler::authFailed,
             this, &MainWindow::handleAuthFailure);
 
+    connect(serverResponseHandler, &PacketServerResponseHandler::helloAckReceived,
+            managerNetwork, &ManagerNetwork::applyHelloAck);
+
+    connect(serverResponseHandler, &PacketServerResponseHandler::sessionTokenReceived,
+            this, [this](const QString& token) {
+        sessionToken = token;
+    });
+
+    /*при обрыве связи сессия возобновляется по токену*/
+    connect(managerNetwork, &ManagerNetwork::disconnected, this, &MainWindow::onConnectionLost);
+    connect(managerNetwork, &ManagerNetwork::connectionError, this, &MainWindow::onConnectionLost);
+
     connect(serverResponseHandler, &PacketServerResponseHandler::RegisterFailed,
             this, &MainWindow::handleRegisterFailed);
 
+    connect(serverResponseHandler, &PacketServerResponseHandler::searchResultReceived,
+            this, &MainWindow::onSearchResultReceived);
+
+    connect(serverResponseHandler, &PacketServerResponseHandler::rateLimited,
+            this, [this](const QString& message, qint32 retryAfterMs) {
+        statusBar()->showMessage(message, 5000);
+        /*отброшенные сообщения остаются неподтвержденными и уходят повторно,
+          когда сервер снова готов их принять*/
+        if (retryAfterMs > 0 && !pendingMessages.isEmpty()) {
+            outboxTimer.stop();
+            outbox.clear();
+            resendQueue = pendingMessages;
+            resendTimer.start(retryAfterMs);
+        }
+    });
+    connect(serverResponseHandler, &PacketServerResponseHandler::messageRejected,
+            this, [this](const QString& idempotencyKey) {
+        statusBar()->showMessage("Сервер не сохранил сообщение, повторная отправка", 5000);
+        QTimer::singleShot(RejectedRetryMs, this, [this, idempotencyKey]() { retryRejectedMessage(idempotencyKey); });
+    });
+
     /*сигнал для получения сообщений*/
     connect(messageHandler, &PacketMessageHandler::messageReceived,
             this, &MainWindow::onMessageReceived);
+    connect(messageHandler, &PacketMessageHandler::syncBatchReceived,
+            this, &MainWindow::onSyncBatchReceived);
+    connect(messageHandler, &PacketMessageHandler::messageBatchReceived,
+            this, &MainWindow::onMessageBatchReceived);
+
+    /*исходящие сообщения копятся OutboxLingerMs и уходят одним кадром*/
+    outboxTimer.setSingleShot(true);
+    connect(&outboxTimer, &QTimer::timeout, this, &MainWindow::flushOutbox);
+    resendTimer.setSingleShot(true);
+    connect(&resendTimer, &QTimer::timeout, this, &MainWindow::resendNextBatch);
 
     /*сигнал для получения списка чатов*/
     connect(chatListHandler, &PacketChatListHandler::chatListReceived,
             this, &MainWindow::onChatListReceived);
+    connect(chatListHandler, &PacketChatListHandler::chatListDeltaReceived,
+            this, &MainWindow::onChatListDeltaReceived);
 
     /* === Очистка ошибок при вводе === */
     connect(ui->login, &QLineEdit::textChanged, this, [this](const QString&) {
@@ -82,8 +130,14 @@ MainWindow::MainWindow(QWidget *parent)
         ui->Error_Label_Register_Page->clear();
     });
 
+    /*пропуск в нумерации сообщений - дозапрос недостающих*/
+    connect(chatManager, &ChatManager::syncNeeded, this, [this](const QString& chatName) {
+        requestSync(QStringList{chatName});
+    });
+
     connect(chatManager, &ChatManager::chatUpdated, this, [this](const QString& chatName) {
-        if (currentChatName == chatName) {
+        /*пока показаны результаты поиска, история не перерисовывается*/
+        if (currentChatName == chatName && searchQuery.isEmpty()) {
             loadChatHistory(chatName);
         }
     });
@@ -127,17 +181,176 @@ void MainWindow::on_SaltReceived(const QString &salt) {
 }
 
 void MainWindow::handleSuccessfulAuth() {
+    resumingSession = false;
     ui->stackedWidget->setCurrentIndex(1);
     ui->ErrorLabel->clear();
 
+    requestChatList();
+    resendPendingMessages();
+}
+
+/**
+ * @brief Повторно отправляет сообщения, подтверждение которых не пришло
+ * до обрыва связи. Сообщения уходят с прежними ключами, поэтому уже
+ * принятые сервером не будут сохранены второй раз.
+ */
+void MainWindow::resendPendingMessages() {
+    /*все сообщения очереди уже есть среди неподтвержденных*/
+    outboxTimer.stop();
+    outbox.clear();
+
+    resendQueue = pendingMessages;
+    if (!resendQueue.isEmpty()) {
+        Logger::getInstance().log(QtInfoMsg, QString("Повторная отправка %1 сообщений").arg(resendQueue.size()));
+    }
+    resendNextBatch();
+}
+
+/**
+ * @brief Отправляет следующую пачку повторной отправки. Сообщения,
+ * подтвержденные за время паузы, пропускаются.
+ */
+void MainWindow::resendNextBatch() {
+    resendTimer.stop();
+    QList<PacketMessage> batch;
+    while (!resendQueue.isEmpty() && batch.size() < ResendBatchMessages) {
+        const PacketMessage mes = resendQueue.takeFirst();
+        for (const PacketMessage& pending : pendingMessages) {
+            if (pending.getIdempotencyKey() == mes.getIdempotencyKey()) {
+                batch.append(mes);
+                break;
+            }
+        }
+    }
+    if (!batch.isEmpty()) {
+        sendMessages(batch);
+    }
+    if (!resendQueue.isEmpty()) {
+        resendTimer.start(ResendIntervalMs);
+    }
+}
+
+/**
+ * @brief Отправляет накопленные исходящие сообщения.
+ */
+void MainWindow::flushOutbox() {
+    sendMessages(outbox);
+    outbox.clear();
+}
+
+/**
+ * @brief Отправляет сообщения серверу. Одиночное сообщение уходит
+ * обычным пакетом, несколько - пачками не больше PacketMessageBatch::MaxMessages,
+ * если сервер согласовал Capability::MessageBatch.
+ * @param messages Сообщения в порядке отправки.
+ */
+void MainWindow::sendMessages(const QList<PacketMessage>& messages) {
+    /*сервер без поддержки пачек получает сообщения по одному*/
+    if (messages.size() == 1 || !managerNetwork->peerSupports(Capability::MessageBatch)) {
+        for (const PacketMessage& mes : messages) {
+            managerNetwork->sendPacket(mes.serialize());
+        }
+        return;
+    }
+    PacketMessageBatch batch;
+    for (const PacketMessage& mes : messages) {
+        batch.addMessage(mes);
+        if (batch.size() == PacketMessageBatch::MaxMessages) {
+            managerNetwork->sendPacket(batch.serialize());
+            batch.clear();
+        }
+    }
+    if (batch.size() > 0) {
+        managerNetwork->sendPacket(batch.serialize());
+    }
+}
+
+/**
+ * @brief Снимает собственное сообщение с повторной отправки,
+ * когда оно вернулось от сервера с номером.
+ */
+void MainWindow::confirmMessage(const QString& sender, const QString& idempotencyKey) {
+    if (sender != username || idempotencyKey.isEmpty()) {
+        return;
+    }
+    for (int i = 0; i < pendingMessages.size(); ++i) {
+        if (pendingMessages[i].getIdempotencyKey() == idempotencyKey) {
+            pendingMessages.removeAt(i);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Повторно отправляет сообщение, которое сервер не смог сохранить,
+ * если оно все еще не подтверждено.
+ */
+void MainWindow::retryRejectedMessage(const QString& idempotencyKey) {
+    for (const PacketMessage& mes : pendingMessages) {
+        if (mes.getIdempotencyKey() == idempotencyKey) {
+            sendMessages({mes});
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Запрашивает у сервера полный список чатов.
+ */
+void MainWindow::requestChatList() {
+    chatListRequested = true;
     PacketChatList packet;
     managerNetwork->sendPacket(packet.serialize());
 }
 
 void MainWindow::handleAuthFailure(const QString &message) {
+    if (resumingSession) {
+        /*токен отвергнут - нужен полный вход с паролем*/
+        resumingSession = false;
+        sessionToken.clear();
+        ui->stackedWidget->setCurrentIndex(0);
+    }
     ui->ErrorLabel->setText(message);
 }
 
+/**
+ * @brief Планирует переподключение после обрыва связи.
+ * Задержка выбирается случайно, чтобы клиенты не переподключались
+ * к серверу одновременно.
+ */
+void MainWindow::onConnectionLost() {
+    if (sessionToken.isEmpty() || reconnectPending) {
+        return;
+    }
+    reconnectPending = true;
+    /*после возобновления сессии повтор начнется заново*/
+    resendTimer.stop();
+    resendQueue.clear();
+    int delay = QRandomGenerator::global()->bounded(500, 3000);
+    Logger::getInstance().log(QtInfoMsg, QString("Соединение потеряно, переподключение через %1 мс").arg(delay));
+    QTimer::singleShot(delay, this, [this]() {
+        reconnectPending = false;
+        resumeSession();
+    });
+}
+
+/**
+ * @brief Переподключается к серверу и возобновляет сессию по токену
+ * одним пакетом, без повторного обмена солью.
+ */
+void MainWindow::resumeSession() {
+    if (sessionToken.isEmpty()) {
+        return;
+    }
+    resumingSession = true;
+
+    PacketSessionResume packet;
+    packet.setUsername(username);
+    packet.setToken(sessionToken);
+    managerNetwork->connectToServer("127.0.0.1", 3333);
+    managerNetwork->sendPacket(packet.serialize());
+}
+
 
 void MainWindow::handleRegisterFailed(const QString &message) {
     ui->Error_Label_Register_Page->setText(message);
@@ -199,6 +412,7 @@ void MainWindow::handleRegistrationFailure() {
 void MainWindow::on_ChatList_clicked(const QModelIndex& index) {
     QString chatName = index.data().toString();
     currentChatName = chatName;
+    resetSearch();
     loadChatHistory(chatName);
 }
 
@@ -234,25 +448,111 @@ void MainWindow::on_SendMessageButton_clicked() {
     mes.setChatName(currentChatName);
     mes.setFrom(username);
     mes.setText(text);
-
-    managerNetwork->sendPacket(mes.serialize());
+    mes.setIdempotencyKey(QUuid::createUuid().toString(QUuid::WithoutBraces));
+    pendingMessages.append(mes);
+    outbox.append(mes);
+    if (!outboxTimer.isActive()) {
+        outboxTimer.start(OutboxLingerMs);
+    }
     ui->MessageInput->clear();
 }
 
-void MainWindow::onMessageReceived(const QString& firstName,const QString& lastName, const QString& chatName, const QString& sender, const QString& text, const QDateTime& timestamp) {
-    chatManager->addMessageToChat(chatName, sender, text, timestamp, firstName, lastName);
-        if (currentChatName == chatName) {
+void MainWindow::onMessageReceived(const QString& firstName,const QString& lastName, const QString& chatName, const QString& sender, const QString& text, const QDateTime& timestamp, quint32 seq, const QString& idempotencyKey) {
+    confirmMessage(sender, idempotencyKey);
+    chatManager->addMessageToChat(chatName, sender, text, timestamp, firstName, lastName, seq);
+        if (currentChatName == chatName && searchQuery.isEmpty()) {
         loadChatHistory(chatName);
     }
 }
 
-void MainWindow::onChatListReceived(const QStringList& chatList) {
+void MainWindow::onMessageBatchReceived(const QList<PacketMessage>& messages) {
+    for (const PacketMessage& mes : messages) {
+        confirmMessage(mes.getFrom(), mes.getIdempotencyKey());
+    }
+    chatManager->addMessageBatch(messages);
+}
+
+void MainWindow::onChatListReceived(const QStringList& chatList, quint32 version) {
+    chatListVersion = version;
+    chatListRequested = false;
     chatListModel->clear();
     for (const QString& chatName : chatList) {
         chatManager->createChat(chatName);
         QStandardItem* item = new QStandardItem(chatName);
         chatListModel->appendRow(item);
     }
+    requestSync(chatList);
+}
+
+/**
+ * @brief Запрашивает сообщения, пропущенные с последнего подключения.
+ * Для каждого чата серверу сообщается номер, до которого сообщения
+ * получены без пропусков, и сервер присылает только более новые.
+ * @param chatNames Чаты для синхронизации.
+ */
+void MainWindow::requestSync(const QStringList& chatNames) {
+    PacketSyncRequest packet;
+    for (const QString& chatName : chatNames) {
+        packet.addChat(chatName, chatManager->lastSeq(chatName));
+    }
+    managerNetwork->sendPacket(packet.serialize());
+}
+
+void MainWindow::onSyncBatchReceived(const QString& chatName, const QList<MessageRecord>& messages, bool hasMore) {
+    chatManager->addSyncedMessages(chatName, messages);
+    if (hasMore) {
+        requestSync(QStringList{chatName});
+    }
+}
+
+/**
+ * @brief Применяет изменение списка чатов.
+ * Если версия изменения не следует сразу за известной, часть изменений
+ * пропущена, и клиент запрашивает полный список.
+ */
+void MainWindow::onChatListDeltaReceived(PacketChatListDelta::Kind kind, quint32 version,
+                                         const QString& chatName, const QString& newName) {
+    if (chatListRequested || version <= chatListVersion) {
+        return;
+    }
+    if (version != chatListVersion + 1) {
+        Logger::getInstance().log(QtInfoMsg, QString("Пропущены изменения списка чатов (%1 -> %2), запрос полного списка")
+                                                 .arg(chatListVersion).arg(version));
+        requestChatList();
+        return;
+    }
+    chatListVersion = version;
+
+    switch (kind) {
+    case PacketChatListDelta::Kind::Added: {
+        chatManager->createChat(chatName);
+        chatListModel->appendRow(new QStandardItem(chatName));
+        break;
+    }
+    case PacketChatListDelta::Kind::Removed: {
+        chatManager->removeChat(chatName);
+        QList<QStandardItem*> items = chatListModel->findItems(chatName);
+        if (!items.isEmpty()) {
+            chatListModel->removeRow(items.first()->row());
+        }
+        if (currentChatName == chatName) {
+            currentChatName.clear();
+            ui->textBrowser->clear();
+        }
+        break;
+    }
+    case PacketChatListDelta::Kind::Renamed: {
+        chatManager->renameChat(chatName, newName);
+        QList<QStandardItem*> items = chatListModel->findItems(chatName);
+        if (!items.isEmpty()) {
+            items.first()->setText(newName);
+        }
+        if (currentChatName == chatName) {
+            currentChatName = newName;
+        }
+        break;
+    }
+    }
 }
 
 void MainWindow::onDataReceived(const QByteArray& data) {
@@ -287,10 +587,106 @@ void MainWindow::closeEvent(QCloseEvent *event) {
 
     logger.log(QtInfoMsg, "Пользователь инициировал закрытие приложения.");
 
-
     if (managerNetwork && managerNetwork->isConnected()) {
+        /*сервер отзывает токен, чтобы им нельзя было возобновить сессию*/
+        if (!sessionToken.isEmpty()) {
+            managerNetwork->sendPacket(PacketLogout().serialize());
+        }
         managerNetwork->disconnectFromServer();
     }
+    sessionToken.clear();
 
     event->accept();
 }
+
+/**
+ * @brief Ищет текст из строки поиска в текущем чате.
+ * Повторный Enter с тем же запросом подгружает следующую страницу,
+ * пустой запрос возвращает историю чата.
+ */
+void MainWindow::on_SearchInput_returnPressed() {
+    const QString query = ui->SearchInput->text().trimmed();
+    if (query.isEmpty()) {
+        if (!searchQuery.isEmpty()) {
+            resetSearch();
+            if (!currentChatName.isEmpty()) {
+                loadChatHistory(currentChatName);
+            }
+        }
+        return;
+    }
+    if (!managerNetwork->peerSupports(Capability::Search)) {
+        statusBar()->showMessage("Сервер не поддерживает поиск", 5000);
+        return;
+    }
+    if (query == searchQuery) {
+        if (!searchHasMore) {
+            return;
+        }
+    } else {
+        searchQuery = query;
+        searchOffset = 0;
+    }
+    searchHasMore = false;
+
+    PacketSearchRequest request;
+    request.setRequestId(++searchRequestId);
+    request.setChatName(currentChatName);
+    request.setQuery(query);
+    request.setOffset(searchOffset);
+    request.setLimit(SearchPageSize);
+    managerNetwork->sendPacket(request.serialize());
+}
+
+void MainWindow::onSearchResultReceived(quint32 requestId, PacketSearchResult::Status status,
+                                        const QList<SearchHit>& hits, bool hasMore) {
+    if (requestId != searchRequestId || searchQuery.isEmpty()) {
+        return;
+    }
+    switch (status) {
+    case PacketSearchResult::Status::Ok:
+        break;
+    case PacketSearchResult::Status::InvalidQuery:
+        statusBar()->showMessage("В запросе нет слов для поиска", 5000);
+        return;
+    case PacketSearchResult::Status::Busy:
+        statusBar()->showMessage("Сервер занят, повторите поиск позже", 5000);
+        return;
+    default:
+        statusBar()->showMessage("Поиск недоступен на сервере", 5000);
+        return;
+    }
+
+    if (searchOffset == 0) {
+        ui->textBrowser->clear();
+        if (hits.isEmpty()) {
+            ui->textBrowser->append("<i>Ничего не найдено</i>");
+        }
+    }
+    for (const SearchHit& hit : hits) {
+        /*найденные слова отмечены управляющими символами, их заменяем после экранирования*/
+        QString snippet = hit.snippet.toHtmlEscaped();
+        snippet.replace(SearchHit::MarkBegin, "<b>").replace(SearchHit::MarkEnd, "</b>");
+        QString chat = currentChatName.isEmpty() ? QString("[%1] ").arg(hit.chatName.toHtmlEscaped()) : QString();
+        ui->textBrowser->append(QString("%1<i>[%2] %3 %4(%5):</i> %6")
+                                    .arg(chat,
+                                         hit.timestamp.toString("dd-hh:mm"),
+                                         hit.firstName.toHtmlEscaped(),
+                                         hit.lastName.toHtmlEscaped(),
+                                         hit.sender.toHtmlEscaped(),
+                                         snippet));
+    }
+    searchOffset += hits.size();
+    searchHasMore = hasMore;
+    if (hasMore) {
+        statusBar()->showMessage("Enter в строке поиска - следующие результаты", 5000);
+    }
+}
+
+void MainWindow::resetSearch() {
+    searchQuery.clear();
+    searchOffset = 0;
+    searchHasMore = false;
+    ++searchRequestId;
+    ui->SearchInput->clear();
+}
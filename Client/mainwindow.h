@@ -6,6 +6,7 @@
 #include "ChatManager.h"
 #include <QItemSelectionModel>
 #include <QStandardItemModel>
+#include <QTimer>
 #include "Packetrouter.h"
 
 QT_BEGIN_NAMESPACE
@@ -53,14 +54,54 @@ private slots:
     void loadChatHistory(const QString& chatName);
     void on_ChatList_clicked(const QModelIndex& index);
     void on_SendMessageButton_clicked();
-    void onMessageReceived(const QString& firstName,const QString& lastName, const QString& chatName, const QString& sender, const QString& text, const QDateTime& timestamp);
-    void onChatListReceived(const QStringList& chatList);
+    void onMessageReceived(const QString& firstName,const QString& lastName, const QString& chatName, const QString& sender, const QString& text, const QDateTime& timestamp, quint32 seq, const QString& idempotencyKey);
+    void onSyncBatchReceived(const QString& chatName, const QList<MessageRecord>& messages, bool hasMore);
+    void requestSync(const QStringList& chatNames);
+    void onChatListReceived(const QStringList& chatList, quint32 version);
+    void onChatListDeltaReceived(PacketChatListDelta::Kind kind, quint32 version,
+                                 const QString& chatName, const QString& newName);
+    void requestChatList();
+    void resendPendingMessages();
+    void resendNextBatch();
+    void flushOutbox();
+    void onMessageBatchReceived(const QList<PacketMessage>& messages);
+    void on_SearchInput_returnPressed();
+    void onSearchResultReceived(quint32 requestId, PacketSearchResult::Status status,
+                                const QList<SearchHit>& hits, bool hasMore);
 
     void onDataReceived(const QByteArray& data);
+    void onConnectionLost();
+    void resumeSession();
     void closeEvent(QCloseEvent *event);
 private:
     QString username;
+    QString sessionToken;         /*токен для возобновления сессии после обрыва связи*/
+    bool resumingSession = false;
+    bool reconnectPending = false;
     QString currentChatName;
+    quint32 chatListVersion = 0;  /*версия списка чатов, известная клиенту*/
+    bool chatListRequested = false;
+    QList<PacketMessage> pendingMessages; /*сообщения без подтверждения сервера в порядке отправки*/
+    QList<PacketMessage> outbox;          /*сообщения, ожидающие отправки пачкой*/
+    QTimer outboxTimer;
+    static const int OutboxLingerMs = 20;
+    static const int RejectedRetryMs = 2000; /*пауза перед повтором сообщения, которое сервер не сохранил*/
+    QList<PacketMessage> resendQueue;     /*неподтвержденные сообщения, ожидающие повторной отправки*/
+    QTimer resendTimer;
+    /*повтор уходит пачками не больше емкости корзины Message сервера на соединение
+      (rate_limit/Connection/Message = "5,10") и с паузой, за которую она восполняется*/
+    static const int ResendBatchMessages = 10;
+    static const int ResendIntervalMs = 2000;
+    QString searchQuery;          /*запрос, результаты которого показаны вместо истории чата*/
+    quint32 searchRequestId = 0;  /*ответы на более ранние запросы отбрасываются*/
+    quint32 searchOffset = 0;
+    bool searchHasMore = false;
+    static const int SearchPageSize = 20;
+    void resetSearch();
+
+    void sendMessages(const QList<PacketMessage>& messages);
+    void confirmMessage(const QString& sender, const QString& idempotencyKey);
+    void retryRejectedMessage(const QString& idempotencyKey);
     QString salt;
     QStandardItemModel* chatListModel;
     Ui::MainWindow *ui;
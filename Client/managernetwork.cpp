@@ -1,15 +1,19 @@
 #include "managernetwork.h"
 #include "logger.h"
+#include "protocol.h"
+#include "FrameCompression.h"
 
 
 ManagerNetwork::ManagerNetwork(QObject *parent)
     : QObject(parent) {
     connect(&socket, &QTcpSocket::readyRead, this, &ManagerNetwork::packetRead);
     connect(&socket, &QTcpSocket::connected, this, &ManagerNetwork::onConnected);
+    connect(&socket, &QTcpSocket::disconnected, this, &ManagerNetwork::disconnected);
 
     connect(&socket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError error) {
         Logger& logger = Logger::getInstance();
         logger.log(QtCriticalMsg, QString("Ошибка сокета: ") + socket.errorString());
+        emit connectionError(socket.errorString());
     });
 }
 
@@ -38,27 +42,84 @@ void ManagerNetwork::connectToServer(const QString &server, qint16 port) {
 void ManagerNetwork::sendPacket(QByteArray data){
     Logger& logger = Logger::getInstance();
     logger.log(QtInfoMsg, QString("Отправка данных на сервер. Размер данных: %1 байт").arg(data.size()));
-    socket.write(data);
+    socket.write(Packet::compressFrame(data, peerCodec, FrameCompression::DefaultThreshold));
 }
 
 /**
  * @brief packetRead - обрабатывает входящие данные от сервера.
- * Эмитирует сигнал dataReceived, если данные не пусты.
+ * TCP не сохраняет границы пакетов, поэтому данные накапливаются,
+ * а сигнал dataReceived эмитируется для каждого полностью полученного пакета.
  */
 void ManagerNetwork::packetRead()
 {
-    QByteArray data = socket.readAll();
+    buf.append(socket.readAll());
     Logger& logger = Logger::getInstance();
-    logger.log(QtInfoMsg, QString("Получен пакет данных с сервера. Размер данных: %1 байт").arg(data.size()));
-    if (!data.isEmpty()) {
+
+    while (true) {
+        qint64 size = Packet::frameSize(buf);
+        if (size < 0) {
+            break;
+        }
+        if (size < Packet::HeaderSize || size > MaxFrameSize) {
+            logger.log(QtWarningMsg, QString("Некорректный размер пакета от сервера (%1 байт), соединение разорвано").arg(size));
+            buf.clear();
+            socket.abort();
+            return;
+        }
+        if (buf.size() < size) {
+            break;
+        }
+
+        QByteArray data = buf.left(size);
+        buf.remove(0, size);
+        logger.log(QtInfoMsg, QString("Получен пакет данных с сервера. Размер данных: %1 байт").arg(data.size()));
+
+        /*на Ping сервера отвечаем сразу, не дожидаясь обработчиков*/
+        if (Packet::frameType(data) == PacketType::Ping) {
+            auto ping = std::dynamic_pointer_cast<PacketPing>(Packet::deserialize(data));
+            if (ping) {
+                PacketPong pong;
+                pong.setTimestamp(ping->getTimestamp());
+                sendPacket(pong.serialize());
+            }
+            continue;
+        }
         emit dataReceived(data);
     }
 }
 
 
+/**
+ * @brief После подключения отправляет серверу Hello с версией протокола
+ * и возможностями клиента. До ответа соединение работает как версия 1:
+ * без сжатия и без пачек сообщений.
+ */
 void ManagerNetwork::onConnected(){
+    buf.clear();
+    peerVersion = 1;
+    peerCapabilities = 0;
+    peerCodec = 0;
+
+    PacketHello hello;
+    hello.setVersion(Packet::ProtocolVersion);
+    hello.setCapabilities(Capability::All);
+    hello.setCodecs(FrameCompression::supportedCodecs());
+    socket.write(hello.serialize());
+
     emit connected();
 }
+
+/**
+ * @brief Применяет параметры, согласованные сервером в HelloAck.
+ * @param version Версия протокола.
+ * @param capabilities Возможности, которые можно использовать.
+ * @param codecs Кодеки сжатия, которые сервер готов принимать.
+ */
+void ManagerNetwork::applyHelloAck(quint16 version, quint32 capabilities, quint8 codecs) {
+    peerVersion = version;
+    peerCapabilities = capabilities;
+    peerCodec = (capabilities & Capability::Compression) ? FrameCompression::preferredCodec(codecs) : 0;
+}
 /**
  * @brief Отключениее от сервера.
  */
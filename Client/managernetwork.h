@@ -15,8 +15,14 @@ public:
     void connectToServer(const QString &server, qint16 port);
     void disconnectFromServer();
     bool isConnected();
+    void applyHelloAck(quint16 version, quint32 capabilities, quint8 codecs); /* Параметры, согласованные с сервером*/
+    bool peerSupports(quint32 capability) const { return (peerCapabilities & capability) == capability; }
+
+    static constexpr qint64 MaxFrameSize = 8 * 1024 * 1024; /* Пакеты большего размера считаются мусором*/
 signals:
     void connected();
+    void disconnected();
+    void connectionError(const QString &message);
     void dataReceived(const QByteArray &data);
 
 private slots:
@@ -24,7 +30,10 @@ private slots:
     void onConnected();
 private:
     QTcpSocket socket;
-    QByteArray buf;
+    QByteArray buf; /*накопленные данные неполного пакета*/
+    quint16 peerVersion = 1;      /*до ответа на Hello действует протокол версии 1*/
+    quint32 peerCapabilities = 0; /*согласованные возможности Capability*/
+    quint8 peerCodec = 0;         /*кодек сжатия исходящих кадров, 0 - без сжатия*/
 };
 
 
@@ -13,12 +13,27 @@ void PacketServerResponseHandler::handle(PacketMessage& packet) {}
 
 void PacketServerResponseHandler::handle(PacketChatList& packet) {}
 
+void PacketServerResponseHandler::handle(PacketHelloAck& packet) {
+    Logger::getInstance().log(QtInfoMsg, QString("Сервер согласовал протокол %1, возможности 0x%2, кодеки %3")
+                                             .arg(packet.getVersion())
+                                             .arg(packet.getCapabilities(), 0, 16)
+                                             .arg(packet.getCodecs()));
+    emit helloAckReceived(packet.getVersion(), packet.getCapabilities(), packet.getCodecs());
+}
+
+void PacketServerResponseHandler::handle(PacketSearchResult& packet) {
+    emit searchResultReceived(packet.getRequestId(), packet.getStatus(), packet.getHits(), packet.getHasMore());
+}
+
 void PacketServerResponseHandler::handle(PacketServerResponse& packet) {
     Logger& logger = Logger::getInstance();
     if (packet.GetResponseType() == PacketServerResponse::ServerResponseType::Auth) {
         switch (packet.GetResponseStatus()) {
         case PacketServerResponse::ServerResponseStatus::Success:
             logger.log(QtInfoMsg, "Авторизация успешна.");
+            if (!packet.GetSessionToken().isEmpty()) {
+                emit sessionTokenReceived(packet.GetSessionToken());
+            }
             emit authSuccess();
             break;
         case PacketServerResponse::ServerResponseStatus::SuccessUsername:
@@ -37,6 +52,16 @@ void PacketServerResponseHandler::handle(PacketServerResponse& packet) {
         }
     }
 
+    if (packet.GetResponseType() == PacketServerResponse::ServerResponseType::RateLimit) {
+        logger.log(QtWarningMsg, QString("Сервер ограничил частоту запросов: %1").arg(packet.getResponse()));
+        emit rateLimited(packet.getResponse(), packet.GetRetryAfterMs());
+    }
+
+    if (packet.GetResponseType() == PacketServerResponse::ServerResponseType::Message) {
+        logger.log(QtWarningMsg, QString("Сервер не сохранил сообщение %1").arg(packet.getResponse()));
+        emit messageRejected(packet.getResponse());
+    }
+
     if (packet.GetResponseType() == PacketServerResponse::ServerResponseType::Register) {
         if (packet.getRegisterStatus()) {
             logger.log(QtInfoMsg, "Регистрация успешна.");
@@ -71,7 +96,21 @@ void PacketMessageHandler::handle(PacketMessage& packet) {
     logger.log(QtInfoMsg, QString("Получено новое сообщение в чате '%1' от %2 %3 (%4): %5")
                               .arg(chatName, firstName, lastName, sender, text));
 
-    emit messageReceived(firstName, lastName, chatName, sender, text, timestamp);
+    emit messageReceived(firstName, lastName, chatName, sender, text, timestamp,
+                         packet.getSeq(), packet.getIdempotencyKey());
+}
+
+void PacketMessageHandler::handle(PacketSyncBatch& packet) {
+    Logger& logger = Logger::getInstance();
+    logger.log(QtInfoMsg, QString("Получено %1 пропущенных сообщений в чате '%2'")
+                              .arg(packet.getMessages().size()).arg(packet.getChatName()));
+    emit syncBatchReceived(packet.getChatName(), packet.getMessages(), packet.getHasMore());
+}
+
+void PacketMessageHandler::handle(PacketMessageBatch& packet) {
+    Logger& logger = Logger::getInstance();
+    logger.log(QtInfoMsg, QString("Получена пачка из %1 сообщений").arg(packet.size()));
+    emit messageBatchReceived(packet.getMessages());
 }
 
 
@@ -90,5 +129,11 @@ void PacketChatListHandler::handle(PacketChatList& packet) {
     QStringList chatList = packet.getChatNames();
     Logger& logger = Logger::getInstance();
     logger.log(QtInfoMsg, "Получен список чатов");
-    emit chatListReceived(chatList);
+    emit chatListReceived(chatList, packet.getVersion());
+}
+
+void PacketChatListHandler::handle(PacketChatListDelta& packet) {
+    Logger& logger = Logger::getInstance();
+    logger.log(QtInfoMsg, QString("Получено изменение списка чатов, версия %1").arg(packet.getVersion()));
+    emit chatListDeltaReceived(packet.getKind(), packet.getVersion(), packet.getChatName(), packet.getNewName());
 }
@@ -42,6 +42,42 @@ public:
      */
     virtual void handle(PacketAuth& packet) = 0;
 
+    /**
+     * @brief Обрабатывает пакет возобновления сессии.
+     * @param packet Пакет с токеном сессии.
+     */
+    virtual void handle(PacketSessionResume& packet) {}
+
+    /**
+     * @brief Обрабатывает пакет изменения списка чатов.
+     * @param packet Пакет изменения списка чатов.
+     */
+    virtual void handle(PacketChatListDelta& packet) {}
+
+    /**
+     * @brief Обрабатывает пачку пропущенных сообщений.
+     * @param packet Пачка сообщений одного чата.
+     */
+    virtual void handle(PacketSyncBatch& packet) {}
+
+    /**
+     * @brief Обрабатывает пакет с несколькими сообщениями.
+     * @param packet Пакет сообщений.
+     */
+    virtual void handle(PacketMessageBatch& packet) {}
+
+    /**
+     * @brief Обрабатывает ответ сервера на приветствие.
+     * @param packet Согласованные версия и возможности.
+     */
+    virtual void handle(PacketHelloAck& packet) {}
+
+    /**
+     * @brief Обрабатывает страницу результатов поиска.
+     * @param packet Пакет с результатами.
+     */
+    virtual void handle(PacketSearchResult& packet) {}
+
 private:
     QString salt; /*Соль для авторизации*/
 };
@@ -61,8 +97,28 @@ public:
     void handle(PacketMessage& packet) override;
     void handle(PacketChatList& packet) override;
     void handle(PacketServerResponse& packet) override;
+    void handle(PacketHelloAck& packet) override;
+    void handle(PacketSearchResult& packet) override;
 
 signals:
+    /**
+     * @brief Сигнал отправляется, когда сервер ответил на приветствие.
+     * @param version Согласованная версия протокола.
+     * @param capabilities Согласованные возможности (Capability).
+     * @param codecs Согласованные кодеки сжатия (FrameCompression::Codec).
+     */
+    void helloAckReceived(quint16 version, quint32 capabilities, quint8 codecs);
+
+    /**
+     * @brief Сигнал отправляется при получении результатов поиска.
+     * @param requestId Номер запроса, на который пришел ответ.
+     * @param status Результат выполнения запроса.
+     * @param hits Найденные сообщения по убыванию релевантности.
+     * @param hasMore true, если на сервере есть следующая страница.
+     */
+    void searchResultReceived(quint32 requestId, PacketSearchResult::Status status,
+                              const QList<SearchHit>& hits, bool hasMore);
+
     /**
      * @brief Сигнал отправляется при получении соли для авторизации.
      * @param salt Соль для авторизации.
@@ -80,6 +136,12 @@ signals:
      */
     void authSuccess();
 
+    /**
+     * @brief Сигнал отправляется, когда сервер выдал токен сессии.
+     * @param token Токен для возобновления сессии после переподключения.
+     */
+    void sessionTokenReceived(const QString& token);
+
     /**
      * @brief Сигнал отправляется при успешной регистрации.
      */
@@ -90,6 +152,19 @@ signals:
      * @param message Сообщение об ошибке.
      */
     void RegisterFailed(const QString& message);
+
+    /**
+     * @brief Сигнал отправляется, когда сервер отбросил пакет из-за превышения лимита запросов.
+     * @param message Сообщение сервера.
+     * @param retryAfterMs Через сколько мс сервер снова примет запрос, 0 - неизвестно.
+     */
+    void rateLimited(const QString& message, qint32 retryAfterMs);
+
+    /**
+     * @brief Сигнал отправляется, когда сервер не смог сохранить сообщение.
+     * @param idempotencyKey Ключ отправки несохраненного сообщения.
+     */
+    void messageRejected(const QString& idempotencyKey);
 };
 
 /**
@@ -107,6 +182,8 @@ public:
     void handle(PacketServerResponse& packet) override;
     void handle(PacketChatList& packet) override;
     void handle(PacketMessage& packet) override;
+    void handle(PacketSyncBatch& packet) override;
+    void handle(PacketMessageBatch& packet) override;
 
 signals:
     /**
@@ -117,10 +194,27 @@ signals:
      * @param sender Отправитель.
      * @param text Текст сообщения.
      * @param timestamp Временная метка.
+     * @param seq Номер сообщения в чате.
+     * @param idempotencyKey Ключ отправки, с которым сообщение было отправлено.
      */
     void messageReceived(const QString& firstName, const QString& lastName,
                          const QString& chatName, const QString& sender,
-                         const QString& text, const QDateTime& timestamp);
+                         const QString& text, const QDateTime& timestamp,
+                         quint32 seq, const QString& idempotencyKey);
+
+    /**
+     * @brief Сигнал отправляется при получении пачки пропущенных сообщений.
+     * @param chatName Имя чата.
+     * @param messages Сообщения по возрастанию номера.
+     * @param hasMore true, если на сервере есть еще пропущенные сообщения.
+     */
+    void syncBatchReceived(const QString& chatName, const QList<MessageRecord>& messages, bool hasMore);
+
+    /**
+     * @brief Сигнал отправляется при получении нескольких сообщений одним кадром.
+     * @param messages Сообщения, возможно из разных чатов.
+     */
+    void messageBatchReceived(const QList<PacketMessage>& messages);
 };
 
 /**
@@ -138,13 +232,25 @@ public:
     void handle(PacketMessage& packet) override;
     void handle(PacketServerResponse& packet) override;
     void handle(PacketChatList& packet) override;
+    void handle(PacketChatListDelta& packet) override;
 
 signals:
     /**
      * @brief Сигнал отправляется при получении списка чатов.
      * @param chatList Список имен чатов.
+     * @param version Версия списка на сервере.
+     */
+    void chatListReceived(const QStringList& chatList, quint32 version);
+
+    /**
+     * @brief Сигнал отправляется при получении изменения списка чатов.
+     * @param kind Вид изменения.
+     * @param version Версия списка после изменения.
+     * @param chatName Имя чата.
+     * @param newName Новое имя чата (при переименовании).
      */
-    void chatListReceived(const QStringList& chatList);
+    void chatListDeltaReceived(PacketChatListDelta::Kind kind, quint32 version,
+                               const QString& chatName, const QString& newName);
 };
 
 #endif // PACKETHANDLER_H
@@ -0,0 +1,91 @@
+#include "BroadcastCoalescer.h"
+#include "logger.h"
+#include "Tracer.h"
+#include <utility>
+
+BroadcastCoalescer::BroadcastCoalescer(ManagerNetwork* managerNetwork, QObject* parent)
+    : QObject(parent), managerNetwork(managerNetwork),
+      queueDepth(Metrics::getInstance().gauge("messenger_queue_depth", "Jobs waiting in a worker queue",
+                                              Metrics::label("queue", "broadcast"))) {
+    lingerTimer.setSingleShot(true);
+    connect(&lingerTimer, &QTimer::timeout, this, &BroadcastCoalescer::flush);
+}
+
+/**
+ * @brief Задает окно ожидания и размер пачки.
+ * @param lingerMs Время, в течение которого сообщения накапливаются, 0 - без ожидания.
+ * @param maxMessages Число сообщений, при котором пачка отправляется не дожидаясь окна.
+ */
+void BroadcastCoalescer::setPolicy(int lingerMs, int maxMessages) {
+    this->lingerMs = qMax(0, lingerMs);
+    this->maxMessages = qBound(1, maxMessages, static_cast<int>(PacketMessageBatch::MaxMessages));
+    Logger::getInstance().log(QtInfoMsg, QString("Объединение рассылки: окно %1 мс, до %2 сообщений")
+                                             .arg(this->lingerMs).arg(this->maxMessages));
+}
+
+/**
+ * @brief Ставит сообщение в очередь рассылки.
+ * Окно отсчитывается от первого сообщения пачки, поэтому задержка
+ * рассылки не превышает lingerMs даже при непрерывном потоке.
+ * @param message Сохраненное сообщение с номером.
+ */
+void BroadcastCoalescer::enqueue(const PacketMessage& message) {
+    pending.addMessage(message);
+    queueDepth.set(pending.size());
+    if (const quint64 trace = Tracer::currentTrace()) {
+        Tracer::getInstance().flowStart(trace);
+        traces.append(trace);
+    }
+    if (lingerMs == 0 || pending.size() >= maxMessages) {
+        flush();
+    } else if (!lingerTimer.isActive()) {
+        lingerTimer.start(lingerMs);
+    }
+}
+
+/**
+ * @brief Рассылает накопленные сообщения всем клиентам.
+ */
+void BroadcastCoalescer::flush() {
+    lingerTimer.stop();
+    if (pending.size() == 0) {
+        return;
+    }
+    queueDepth.set(0);
+
+    /*рассылка трассируется, если в пачке есть сообщение из выбранного пакета*/
+    const QList<quint64> sampled = std::exchange(traces, {});
+    Tracer::Scope trace(sampled.isEmpty() ? 0 : sampled.first());
+    Tracer::Span span("coalescer.flush");
+    for (quint64 id : sampled) {
+        Tracer::getInstance().flowEnd(id);
+    }
+    if (span.isRecording()) {
+        span.setDetail(QString("%1 сообщений").arg(pending.size()));
+    }
+
+    if (pending.size() == 1) {
+        QByteArray frame;
+        {
+            Tracer::Span serialize("serialize");
+            frame = pending.getMessages().first().serialize();
+        }
+        managerNetwork->broadcastMessage(frame);
+        pending.clear();
+        return;
+    }
+
+    /*клиенты без поддержки пачек получают те же сообщения отдельными кадрами*/
+    QList<QByteArray> single;
+    QByteArray batch;
+    {
+        Tracer::Span serialize("serialize");
+        single.reserve(pending.size());
+        for (const PacketMessage& message : pending.getMessages()) {
+            single.append(message.serialize());
+        }
+        batch = pending.serialize();
+    }
+    managerNetwork->broadcastMessage(batch, Capability::MessageBatch, single);
+    pending.clear();
+}
@@ -0,0 +1,46 @@
+#ifndef BROADCASTCOALESCER_H
+#define BROADCASTCOALESCER_H
+
+#include <QObject>
+#include <QTimer>
+#include "protocol.h"
+#include "ManagerNetwork.h"
+#include "Metrics.h"
+
+/**
+ * @brief Класс BroadcastCoalescer - объединение рассылки сообщений.
+ *
+ * Принятые сообщения не рассылаются по одному: они накапливаются в
+ * течение короткого окна ожидания и уходят каждому клиенту одним кадром
+ * PacketMessageBatch, если клиент согласовал Capability::MessageBatch.
+ * Одиночное сообщение отправляется обычным PacketMessage.
+ * Нулевое окно отключает объединение.
+ */
+class BroadcastCoalescer : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Конструктор класса BroadcastCoalescer.
+     * @param managerNetwork Менеджер сети.
+     * @param parent Родительский объект.
+     */
+    explicit BroadcastCoalescer(ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+
+    void setPolicy(int lingerMs, int maxMessages);
+    void enqueue(const PacketMessage& message);
+
+public slots:
+    void flush();
+
+private:
+    ManagerNetwork* managerNetwork;
+    PacketMessageBatch pending;
+    MetricGauge& queueDepth; /* сообщений в pending*/
+    QList<quint64> traces;   /* трассы пакетов, сообщения которых ждут в pending*/
+    QTimer lingerTimer;
+    int lingerMs = 5;
+    int maxMessages = 64;
+};
+
+#endif // BROADCASTCOALESCER_H
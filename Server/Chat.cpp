@@ -1,4 +1,5 @@
 #include "Chat.h"
+#include "UserInterner.h"
 
 /**
  * @brief Конструктор по умолчанию.
@@ -18,25 +19,161 @@ Chat::Chat(const QString& chatName) {
     }
 }
 
+/**
+ * @brief Конструктор с идентификатором и именем чата.
+ * @param chatId Идентификатор чата в базе данных.
+ * @param chatName Имя чата.
+ */
+Chat::Chat(quint32 chatId, const QString& chatName) : Chat(chatName) {
+    id = chatId;
+}
+
 /**
  * @brief Добавляет новое сообщение в чат.
+ * @param seq Номер сообщения в чате, назначенный сервером.
  * @param sender Отправитель сообщения.
  * @param text Текст сообщения.
  * @param timestamp Временная метка сообщения.
  * @param firstName Имя отправителя.
  * @param lastName Фамилия отправителя.
  */
-void Chat::addMessage(const QString& sender, const QString& text, const QDateTime& timestamp,
+void Chat::addMessage(quint32 seq, const QString& sender, const QString& text, const QDateTime& timestamp,
                       const QString& firstName, const QString& lastName) {
-    messages.append(Message(sender, text, timestamp, firstName, lastName));
+    QByteArray utf8 = text.toUtf8();
+
+    CompactMessage message;
+    message.timestampMs = timestamp.toMSecsSinceEpoch();
+    message.seq = seq;
+    lastSeq = qMax(lastSeq, seq);
+    message.userId = UserInterner::getInstance().intern(sender, firstName, lastName);
+    message.textOffset = static_cast<quint32>(textArena.size());
+    message.textLength = static_cast<quint32>(utf8.size());
+
+    textArena.append(utf8);
+
+    if (count < capacity) {
+        /*буфер растет до заданного размера постепенно*/
+        if (ring.size() < capacity) {
+            ring.append(message);
+        } else {
+            ring[(head + count) % ring.size()] = message;
+        }
+        ++count;
+        return;
+    }
+
+    /*буфер заполнен: новое сообщение занимает место самого старого*/
+    deadTextBytes += ring[head].textLength;
+    ring[head] = message;
+    head = (head + 1) % ring.size();
+
+    if (deadTextBytes > textArena.size() / 2) {
+        compactArena();
+    }
+}
+
+/**
+ * @brief Переписывает буфер текстов, оставляя только тексты сообщений из кольца.
+ * Вызывается, когда вытесненные тексты занимают больше половины буфера,
+ * поэтому в пересчете на одно сообщение стоимость остается постоянной.
+ */
+void Chat::compactArena() {
+    QByteArray compacted;
+    compacted.reserve(static_cast<int>(textArena.size() - deadTextBytes));
+    for (int i = 0; i < count; ++i) {
+        CompactMessage& message = ring[(head + i) % ring.size()];
+        quint32 offset = static_cast<quint32>(compacted.size());
+        compacted.append(textArena.constData() + message.textOffset, static_cast<int>(message.textLength));
+        message.textOffset = offset;
+    }
+    textArena = compacted;
+    deadTextBytes = 0;
+}
+
+/**
+ * @brief Задает размер кольцевого буфера.
+ * При уменьшении сохраняются самые новые сообщения.
+ * @param messages Максимальное число сообщений в памяти.
+ */
+void Chat::setCapacity(int messages) {
+    messages = qMax(1, messages);
+    if (messages == capacity) {
+        return;
+    }
+
+    int keep = qMin(count, messages);
+    QVector<CompactMessage> resized;
+    resized.reserve(keep);
+    for (int i = count - keep; i < count; ++i) {
+        resized.append(ring.at((head + i) % ring.size()));
+    }
+    for (int i = 0; i < count - keep; ++i) {
+        deadTextBytes += ring.at((head + i) % ring.size()).textLength;
+    }
+
+    ring = resized;
+    head = 0;
+    count = keep;
+    capacity = messages;
+    compactArena();
+}
+
+/**
+ * @brief Освобождает память, занятую сообщениями.
+ * Используется при вытеснении холодного чата из кэша; номера
+ * следующих сообщений сохраняются.
+ */
+void Chat::releaseMessages() {
+    ring = QVector<CompactMessage>();
+    textArena = QByteArray();
+    head = 0;
+    count = 0;
+    deadTextBytes = 0;
+}
+
+/**
+ * @brief Возвращает текст компактного сообщения.
+ * @param message Запись сообщения этого чата.
+ * @return Текст сообщения.
+ */
+QString Chat::textOf(const CompactMessage& message) const {
+    return QString::fromUtf8(textArena.constData() + message.textOffset,
+                             static_cast<int>(message.textLength));
+}
+
+/**
+ * @brief Восстанавливает сообщение в виде объекта Message для интерфейса.
+ * @param index Номер сообщения в чате, начиная с 0.
+ * @return Сообщение.
+ */
+Message Chat::messageAt(int index) const {
+    const CompactMessage& message = compactAt(index);
+    const UserInterner::UserRecord& user = UserInterner::getInstance().user(message.userId);
+    return Message(user.sender, textOf(message), QDateTime::fromMSecsSinceEpoch(message.timestampMs),
+                   user.firstName, user.lastName);
 }
 
 /**
  * @brief Возвращает список всех сообщений в чате.
+ * Сообщения восстанавливаются из компактного представления при каждом вызове,
+ * поэтому для обхода больших чатов лучше использовать messageAt().
  * @return Список сообщений (QList<Message>).
  */
-const QList<Message>& Chat::getMessages() const {
-    return messages;
+QList<Message> Chat::getMessages() const {
+    QList<Message> result;
+    result.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        result.append(messageAt(i));
+    }
+    return result;
+}
+
+/**
+ * @brief Оценивает объем памяти, занимаемый сообщениями чата.
+ * @return Размер в байтах.
+ */
+qint64 Chat::memoryUsage() const {
+    return static_cast<qint64>(ring.capacity()) * sizeof(CompactMessage) + textArena.capacity();
 }
 
 /**
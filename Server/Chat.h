@@ -3,28 +3,71 @@
 
 #include <QString>
 #include <QList>
+#include <QVector>
+#include <QByteArray>
 #include <QDateTime>
 #include "Message.h"
 
+/**
+ * @brief Компактная запись сообщения в памяти чата.
+ *
+ * Вместо пяти строк с собственными буферами хранит номер автора
+ * (см. UserInterner), номер сообщения в чате, время в миллисекундах
+ * от эпохи и положение текста в общем буфере текстов чата.
+ */
+struct CompactMessage {
+    qint64 timestampMs; /*время отправки, мс от эпохи*/
+    quint32 seq;        /*номер сообщения в чате*/
+    quint32 userId;     /*номер автора в UserInterner*/
+    quint32 textOffset; /*смещение текста в буфере чата*/
+    quint32 textLength; /*длина текста в байтах UTF-8*/
+};
+
 /**
  * @brief Класс Chat представляет собой модель чата.
  *
- * Класс управляет списком сообщений в чате и предоставляет методы для работы с ними.
- * Каждое сообщение представлено объектом класса Message.
+ * Класс хранит кольцевой буфер последних сообщений чата фиксированного размера:
+ * при переполнении самое старое сообщение вытесняется (вся история остается в БД).
+ * Сообщения хранятся в компактном виде, а тексты - подряд в одном буфере UTF-8.
+ * Для интерфейса сообщения восстанавливаются в объекты класса Message.
  */
 
 class Chat {
 private:
+    quint32 id = 0;
     QString name;
-    QList<Message> messages;
+    QVector<CompactMessage> ring; /*кольцевой буфер сообщений*/
+    int head = 0;                 /*позиция самого старого сообщения*/
+    int count = 0;                /*число сообщений в буфере*/
+    int capacity = DefaultCapacity;
+    QByteArray textArena;         /*тексты сообщений чата подряд*/
+    qint64 deadTextBytes = 0;     /*байты текстов вытесненных сообщений*/
+    quint32 lastSeq = 0;          /*номер последнего сообщения чата, в том числе вытесненного*/
+
+    void compactArena();
 
 public:
+    static constexpr int DefaultCapacity = 500;
+
     Chat();
     Chat(const QString& chatName);
-    void addMessage(const QString& sender, const QString& text, const QDateTime& timestamp,
+    Chat(quint32 chatId, const QString& chatName);
+    void addMessage(quint32 seq, const QString& sender, const QString& text, const QDateTime& timestamp,
                     const QString& firstName, const QString& lastName);
-    const QList<Message>& getMessages() const;
+    QList<Message> getMessages() const;
+    Message messageAt(int index) const;
+    const CompactMessage& compactAt(int index) const { return ring.at((head + index) % ring.size()); }
+    QString textOf(const CompactMessage& message) const;
+    int messageCount() const { return count; }
+    void setCapacity(int messages);
+    int getCapacity() const { return capacity; }
+    void releaseMessages();
+    qint64 memoryUsage() const;
     QString getName() const;
+    quint32 getId() const { return id; }
+    quint32 getLastSeq() const { return lastSeq; }
+    void setLastSeq(quint32 seq) { lastSeq = seq; }
+    void setName(const QString& chatName) { name = chatName; }
     ~Chat() = default;
 };
 #endif // CHAT_H
@@ -4,6 +4,16 @@
 #include <QDebug>
 #include <QDateTime>
 #include "logger.h"
+#include "Metrics.h"
+#include "Tracer.h"
+
+namespace {
+/* Время операций с базой в микросекундах, выводится в секундах*/
+MetricHistogram& operationLatency(const char* op) {
+    return Metrics::getInstance().histogram("messenger_db_op_seconds", "Database operation latency",
+                                            Metrics::label("db", "chat") + "," + Metrics::label("op", op), 1e-6);
+}
+}
 
 /**
  * @brief Конструктор класса ChatDatabase.
@@ -22,23 +32,49 @@ ChatDatabase::~ChatDatabase() {
 
 /**
  * @brief Открывает соединение с базой данных сообщений.
- * Создает таблицу messages, если она не существует.
+ * Создает таблицу messages, если она не существует, а в каталоге - еще
+ * список чатов и сроки хранения и переносит в него базу прежнего формата.
  * @param path Путь к файлу базы данных.
+ * @param connectionName Имя соединения QSqlDatabase; у каждого потока и каждой части базы свое.
+ * @param catalog true для части 0, в которой кроме сообщений лежит каталог чатов.
  * @return true, если соединение успешно установлено, иначе false.
  */
-bool ChatDatabase::open(const QString& path) {
+bool ChatDatabase::open(const QString& path, const QString& connectionName, bool catalog) {
     Logger& logger = Logger::getInstance();
     logger.log(QtInfoMsg, QString("Попытка открыть базу данных по пути: %1").arg(path));
 
-    db = QSqlDatabase::addDatabase("QSQLITE", "ChatDatabase");
+    db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
     db.setDatabaseName(path);
+    /*поток поиска пишет в индекс на своем соединении, запись ждет его блокировки*/
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
 
     if (!db.open()) {
         logger.log(QtCriticalMsg, QString("Не удалось открыть базу данных: %1").arg(db.lastError().text()));
         return false;
     }
+    if (!createMessageSchema() || (catalog && !createCatalogSchema())) {
+        return false;
+    }
 
+    /*уникальность номеров проверяется после нумерации сообщений прежнего формата*/
     QSqlQuery query(db);
+    if (!query.exec("CREATE UNIQUE INDEX IF NOT EXISTS idx_messages_seq ON messages (chat_name, seq)")) {
+        logger.log(QtWarningMsg, QString("Ошибка при создании индекса: %1").arg(query.lastError().text()));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Создает таблицу сообщений с индексами; она есть в каждой части.
+ * @return true, если таблица есть или создана.
+ */
+bool ChatDatabase::createMessageSchema() {
+    Logger& logger = Logger::getInstance();
+    QSqlQuery query(db);
+    /*действует только для новой базы: страницы удаленных сообщений
+      возвращает RetentionWorker через PRAGMA incremental_vacuum*/
+    query.exec("PRAGMA auto_vacuum = INCREMENTAL");
     if (!query.exec("CREATE TABLE IF NOT EXISTS messages ("
                     "id INTEGER PRIMARY KEY AUTOINCREMENT, "
                     "chat_name TEXT NOT NULL, "
@@ -46,11 +82,146 @@ bool ChatDatabase::open(const QString& path) {
                     "firstName TEXT NOT NULL, "
                     "lastName TEXT NOT NULL, "
                     "text TEXT NOT NULL, "
-                    "timestamp DATETIME NOT NULL)")) {
+                    "timestamp DATETIME NOT NULL, "
+                    "seq INTEGER)")) {
         logger.log(QtWarningMsg, QString("Ошибка при создании таблицы: %1").arg(query.lastError().text()));
         return false;
     }
     logger.log(QtInfoMsg, "Таблица messages успешно создана или уже существует.");
+
+    /*индекс для выборки последних сообщений чата при загрузке его в кэш*/
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_messages_chat ON messages (chat_name, id)")) {
+        logger.log(QtWarningMsg, QString("Ошибка при создании индекса: %1").arg(query.lastError().text()));
+    }
+
+    /*WAL: поток поиска читает базу, не блокируя запись сообщений*/
+    if (!query.exec("PRAGMA journal_mode=WAL")) {
+        logger.log(QtWarningMsg, QString("Не удалось включить журнал WAL: %1").arg(query.lastError().text()));
+    }
+    createSearchIndex();
+    return true;
+}
+
+/**
+ * @brief Создает таблицы каталога - список чатов и сроки хранения - и
+ * переносит базу прежнего формата. Прежний формат бывает только у части 0:
+ * остальные части появились вместе с разбиением.
+ * @return true, если таблицы есть или созданы.
+ */
+bool ChatDatabase::createCatalogSchema() {
+    Logger& logger = Logger::getInstance();
+    QSqlQuery query(db);
+    if (!query.exec("CREATE TABLE IF NOT EXISTS chats ("
+                    "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                    "name TEXT NOT NULL UNIQUE)")) {
+        logger.log(QtWarningMsg, QString("Ошибка при создании таблицы chats: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    /*чаты из баз прежнего формата, где они существовали только как chat_name в сообщениях*/
+    if (!query.exec("INSERT OR IGNORE INTO chats (name) SELECT DISTINCT chat_name FROM messages")) {
+        logger.log(QtWarningMsg, QString("Ошибка при переносе списка чатов: %1").arg(query.lastError().text()));
+    }
+
+    if (!migrateSequenceNumbers()) {
+        return false;
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS chat_retention ("
+                    "chat_name TEXT PRIMARY KEY, "
+                    "max_age_days INTEGER NOT NULL DEFAULT 0, "
+                    "max_count INTEGER NOT NULL DEFAULT 0)")) {
+        logger.log(QtWarningMsg, QString("Ошибка при создании таблицы сроков хранения: %1")
+                                     .arg(query.lastError().text()));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Создает полнотекстовый индекс сообщений, если его еще нет.
+ * messages_fts - таблица FTS5 с внешним содержимым: в ней хранится только
+ * индекс, а текст берется из messages. Наполняет индекс SearchWorker,
+ * а messages_fts_state хранит id последнего проиндексированного сообщения.
+ * Триггер удаляет из индекса удаленные сообщения, если они уже были
+ * проиндексированы. Без поддержки FTS5 в SQLite поиск просто недоступен.
+ * @return true, если индекс есть или создан.
+ */
+bool ChatDatabase::createSearchIndex() {
+    Logger& logger = Logger::getInstance();
+    QSqlQuery query(db);
+    const char* statements[] = {
+        "CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5("
+        "text, sender, content='messages', content_rowid='id', tokenize='unicode61 remove_diacritics 2')",
+        "CREATE TABLE IF NOT EXISTS messages_fts_state (last_rowid INTEGER NOT NULL)",
+        "INSERT INTO messages_fts_state (last_rowid) SELECT 0 WHERE NOT EXISTS (SELECT 1 FROM messages_fts_state)",
+        "CREATE TRIGGER IF NOT EXISTS messages_fts_delete AFTER DELETE ON messages "
+        "WHEN old.id <= (SELECT last_rowid FROM messages_fts_state) BEGIN "
+        "INSERT INTO messages_fts (messages_fts, rowid, text, sender) VALUES ('delete', old.id, old.text, old.sender); "
+        "END",
+    };
+    for (const char* statement : statements) {
+        if (!query.exec(statement)) {
+            logger.log(QtWarningMsg, QString("Полнотекстовый поиск недоступен: %1").arg(query.lastError().text()));
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Добавляет столбец seq - номер сообщения внутри чата - и нумерует
+ * сообщения баз прежнего формата в порядке их добавления.
+ * Нумерация выполняется одним проходом по сообщениям в одной транзакции.
+ * @return true, если миграция выполнена или не требуется.
+ */
+bool ChatDatabase::migrateSequenceNumbers() {
+    Logger& logger = Logger::getInstance();
+
+    QSqlQuery columns(db);
+    bool hasSeq = false;
+    if (columns.exec("PRAGMA table_info(messages)")) {
+        while (columns.next()) {
+            hasSeq = hasSeq || columns.value(1).toString() == "seq";
+        }
+    }
+
+    QSqlQuery query(db);
+    if (!hasSeq && !query.exec("ALTER TABLE messages ADD COLUMN seq INTEGER")) {
+        logger.log(QtWarningMsg, QString("Ошибка при добавлении столбца seq: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    if (!query.exec("SELECT id, chat_name FROM messages WHERE seq IS NULL ORDER BY chat_name, id")) {
+        logger.log(QtWarningMsg, QString("Ошибка при нумерации сообщений: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    QList<QPair<qint64, QString>> pending;
+    while (query.next()) {
+        pending.append(qMakePair(query.value(0).toLongLong(), query.value(1).toString()));
+    }
+    if (pending.isEmpty()) {
+        return true;
+    }
+
+    QHash<QString, quint32> lastSeqs = getLastSeqs();
+    db.transaction();
+    QSqlQuery update(db);
+    update.prepare("UPDATE messages SET seq = ? WHERE id = ?");
+    for (const auto& row : pending) {
+        quint32& seq = lastSeqs[row.second];
+        update.addBindValue(++seq);
+        update.addBindValue(row.first);
+        if (!update.exec()) {
+            logger.log(QtWarningMsg, QString("Ошибка при нумерации сообщений: %1").arg(update.lastError().text()));
+            db.rollback();
+            return false;
+        }
+    }
+    db.commit();
+
+    logger.log(QtInfoMsg, QString("Пронумеровано %1 сообщений").arg(pending.size()));
     return true;
 }
 
@@ -67,30 +238,37 @@ void ChatDatabase::close() {
 /**
  * @brief Добавляет новое сообщение в базу данных.
  * @param chatName Имя чата.
+ * @param seq Номер сообщения в чате.
  * @param sender Отправитель сообщения.
  * @param text Текст сообщения.
  * @param timestamp Временная метка сообщения.
  * @param firstName Имя отправителя.
  * @param lastName Фамилия отправителя.
+ * @return true, если сообщение сохранено, иначе false.
  */
-void ChatDatabase::addMessage(const QString& chatName, const QString& sender, const QString& text,
+bool ChatDatabase::addMessage(const QString& chatName, quint32 seq, const QString& sender, const QString& text,
                               const QDateTime& timestamp, const QString& firstName, const QString& lastName) {
+    static MetricHistogram& latency = operationLatency("add_message");
+    MetricHistogram::Timer timer(latency);
+    Tracer::Span span("sqlite.add_message");
     QSqlQuery query(db);
-    query.prepare("INSERT INTO messages (chat_name, sender, text, timestamp, firstName, lastName) "
-                  "VALUES (:chat_name, :sender, :text, :timestamp, :firstName, :lastName)");
+    query.prepare("INSERT INTO messages (chat_name, seq, sender, text, timestamp, firstName, lastName) "
+                  "VALUES (:chat_name, :seq, :sender, :text, :timestamp, :firstName, :lastName)");
     query.bindValue(":chat_name", chatName);
+    query.bindValue(":seq", seq);
     query.bindValue(":sender", sender);
     query.bindValue(":text", text);
     query.bindValue(":timestamp", timestamp.toString(Qt::ISODate));
     query.bindValue(":firstName", firstName);
     query.bindValue(":lastName", lastName);
 
-    Logger& logger = Logger::getInstance();
+    /*успешная вставка не журналируется: журнал общий для всех потоков записи,
+      итог пишется один раз на пачку*/
     if (!query.exec()) {
-        logger.log(QtWarningMsg, QString("Ошибка при добавлении сообщения: %1").arg(query.lastError().text()));
-    } else {
-        logger.log(QtInfoMsg, "Сообщение успешно добавлено в базу данных.");
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при добавлении сообщения: %1").arg(query.lastError().text()));
+        return false;
     }
+    return true;
 }
 
 /**
@@ -103,7 +281,7 @@ QList<QMap<QString, QString>> ChatDatabase::getMessages(const QString& chatName)
     QList<QMap<QString, QString>> messages;
 
     QSqlQuery query(db);
-    query.prepare("SELECT sender, text, timestamp FROM messages WHERE chat_name = ? ORDER BY timestamp ASC");
+    query.prepare("SELECT sender, text, timestamp, firstName, lastName FROM messages WHERE chat_name = ? ORDER BY timestamp ASC");
     query.addBindValue(chatName);
 
     Logger& logger = Logger::getInstance();
@@ -118,6 +296,8 @@ QList<QMap<QString, QString>> ChatDatabase::getMessages(const QString& chatName)
         message["sender"] = query.value(0).toString();
         message["text"] = query.value(1).toString();
         message["timestamp"] = query.value(2).toString();
+        message["firstName"] = query.value(3).toString();
+        message["lastName"] = query.value(4).toString();
         messages.append(message);
     }
 
@@ -126,6 +306,87 @@ QList<QMap<QString, QString>> ChatDatabase::getMessages(const QString& chatName)
     return messages;
 }
 
+/**
+ * @brief Получает последние сообщения указанного чата.
+ * @param chatName Имя чата.
+ * @param limit Максимальное число сообщений.
+ * @return Список сообщений в порядке их добавления, каждый QMap содержит
+ * ключи "seq", "sender", "text", "timestamp", "firstName" и "lastName".
+ */
+QList<QMap<QString, QString>> ChatDatabase::getRecentMessages(const QString& chatName, int limit) {
+    static MetricHistogram& latency = operationLatency("recent_messages");
+    MetricHistogram::Timer timer(latency);
+    QList<QMap<QString, QString>> messages;
+
+    QSqlQuery query(db);
+    query.prepare("SELECT sender, text, timestamp, firstName, lastName, seq FROM "
+                  "(SELECT seq, sender, text, timestamp, firstName, lastName FROM messages "
+                  "WHERE chat_name = ? ORDER BY seq DESC LIMIT ?) ORDER BY seq ASC");
+    query.addBindValue(chatName);
+    query.addBindValue(limit);
+
+    Logger& logger = Logger::getInstance();
+    if (!query.exec()) {
+        logger.log(QtWarningMsg, QString("Ошибка при получении сообщений из чата '%1': %2")
+                                     .arg(chatName, query.lastError().text()));
+        return messages;
+    }
+
+    while (query.next()) {
+        QMap<QString, QString> message;
+        message["sender"] = query.value(0).toString();
+        message["text"] = query.value(1).toString();
+        message["timestamp"] = query.value(2).toString();
+        message["firstName"] = query.value(3).toString();
+        message["lastName"] = query.value(4).toString();
+        message["seq"] = query.value(5).toString();
+        messages.append(message);
+    }
+    return messages;
+}
+
+/**
+ * @brief Получает сообщения чата с номерами больше указанного.
+ * Выборка идет по индексу (chat_name, seq), поэтому ее стоимость зависит
+ * от числа возвращаемых сообщений, а не от размера истории.
+ * @param chatName Имя чата.
+ * @param afterSeq Номер последнего известного клиенту сообщения.
+ * @param limit Максимальное число сообщений.
+ * @return Список сообщений по возрастанию номера, каждый QMap содержит
+ * ключи "seq", "sender", "text", "timestamp", "firstName" и "lastName".
+ */
+QList<QMap<QString, QString>> ChatDatabase::getMessagesAfter(const QString& chatName, quint32 afterSeq, int limit) {
+    static MetricHistogram& latency = operationLatency("messages_after");
+    MetricHistogram::Timer timer(latency);
+    QList<QMap<QString, QString>> messages;
+
+    QSqlQuery query(db);
+    query.prepare("SELECT sender, text, timestamp, firstName, lastName, seq FROM messages "
+                  "WHERE chat_name = ? AND seq > ? ORDER BY seq ASC LIMIT ?");
+    query.addBindValue(chatName);
+    query.addBindValue(afterSeq);
+    query.addBindValue(limit);
+
+    Logger& logger = Logger::getInstance();
+    if (!query.exec()) {
+        logger.log(QtWarningMsg, QString("Ошибка при получении сообщений из чата '%1': %2")
+                                     .arg(chatName, query.lastError().text()));
+        return messages;
+    }
+
+    while (query.next()) {
+        QMap<QString, QString> message;
+        message["sender"] = query.value(0).toString();
+        message["text"] = query.value(1).toString();
+        message["timestamp"] = query.value(2).toString();
+        message["firstName"] = query.value(3).toString();
+        message["lastName"] = query.value(4).toString();
+        message["seq"] = query.value(5).toString();
+        messages.append(message);
+    }
+    return messages;
+}
+
 /**
  * @brief Проверяет, открыто ли соединение с базой данных.
  * @return true, если соединение открыто, иначе false.
@@ -148,7 +409,7 @@ QStringList ChatDatabase::getAllChatNames() {
     }
 
     QSqlQuery query(db);
-    if (!query.exec("SELECT DISTINCT chat_name FROM messages")) {
+    if (!query.exec("SELECT name FROM chats ORDER BY id")) {
         logger.log(QtWarningMsg, QString("Ошибка при получении списка чатов: %1").arg(query.lastError().text()));
         return chatNames;
     }
@@ -162,29 +423,85 @@ QStringList ChatDatabase::getAllChatNames() {
 }
 
 /**
- * @brief Добавляет новый чат в базу данных.
- * Если чат уже существует, он не будет добавлен повторно.
+ * @brief Получает номер последнего сообщения каждого чата.
+ * @return Имя чата -> наибольший номер сообщения.
+ */
+QHash<QString, quint32> ChatDatabase::getLastSeqs() {
+    QHash<QString, quint32> lastSeqs;
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT chat_name, MAX(seq) FROM messages WHERE seq IS NOT NULL GROUP BY chat_name")) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при получении номеров сообщений: %1")
+                                                    .arg(query.lastError().text()));
+        return lastSeqs;
+    }
+
+    while (query.next()) {
+        lastSeqs.insert(query.value(0).toString(), query.value(1).toUInt());
+    }
+    return lastSeqs;
+}
+
+/**
+ * @brief Получает номер последнего сообщения чата.
  * @param chatName Имя чата.
+ * @return Наибольший номер сообщения или 0, если сообщений нет.
  */
-void ChatDatabase::addChat(const QString& chatName) {
+quint32 ChatDatabase::getLastSeq(const QString& chatName) {
     QSqlQuery query(db);
-    query.prepare("INSERT OR IGNORE INTO messages (chat_name, sender, text, timestamp, firstName, lastName) "
-                  "VALUES (?, ?, ?, ?, ?, ?)");
+    query.prepare("SELECT MAX(seq) FROM messages WHERE chat_name = ?");
     query.addBindValue(chatName);
-    query.addBindValue("System");
-    query.addBindValue("Chat created");
-    query.addBindValue(QDateTime::currentDateTime());
-    query.addBindValue("");
-    query.addBindValue("");
+    if (!query.exec() || !query.next()) {
+        return 0;
+    }
+    return query.value(0).toUInt();
+}
 
+/**
+ * @brief Получает идентификаторы и имена всех чатов.
+ * @return Список пар (идентификатор, имя) в порядке создания чатов.
+ */
+QList<QPair<quint32, QString>> ChatDatabase::getAllChats() {
+    QList<QPair<quint32, QString>> chats;
     Logger& logger = Logger::getInstance();
 
+    QSqlQuery query(db);
+    if (!query.exec("SELECT id, name FROM chats ORDER BY id")) {
+        logger.log(QtWarningMsg, QString("Ошибка при получении списка чатов: %1").arg(query.lastError().text()));
+        return chats;
+    }
+
+    while (query.next()) {
+        chats.append(qMakePair(query.value(0).toUInt(), query.value(1).toString()));
+    }
+    return chats;
+}
+
+/**
+ * @brief Добавляет новый чат в базу данных.
+ * Если чат уже существует, он не будет добавлен повторно.
+ * Системное сообщение о создании чата записывает ChatManager
+ * в ту часть базы, где хранятся сообщения чата.
+ * @param chatName Имя чата.
+ * @return Идентификатор чата или 0 при ошибке.
+ */
+quint32 ChatDatabase::addChat(const QString& chatName) {
+    Logger& logger = Logger::getInstance();
+    QSqlQuery query(db);
+    query.prepare("INSERT OR IGNORE INTO chats (name) VALUES (?)");
+    query.addBindValue(chatName);
     if (!query.exec()) {
         logger.log(QtWarningMsg, QString("Ошибка при добавлении чата '%1': %2")
                                      .arg(chatName, query.lastError().text()));
-    } else {
+        return 0;
+    }
+    query.prepare("SELECT id FROM chats WHERE name = ?");
+    query.addBindValue(chatName);
+    quint32 chatId = query.exec() && query.next() ? query.value(0).toUInt() : 0;
+    if (chatId != 0) {
         logger.log(QtInfoMsg, QString("Чат '%1' успешно добавлен в базу данных.").arg(chatName));
     }
+    return chatId;
 }
 
 /**
@@ -205,6 +522,178 @@ bool ChatDatabase::deleteChat(const QString& chatName) {
         return false;
     }
 
+    query.prepare("DELETE FROM chats WHERE name = ?");
+    query.addBindValue(chatName);
+    if (!query.exec()) {
+        logger.log(QtWarningMsg, QString("Ошибка при удалении чата '%1': %2")
+                                     .arg(chatName, query.lastError().text()));
+        return false;
+    }
+    setRetentionPolicy(chatName, RetentionPolicy());
+
     logger.log(QtInfoMsg, QString("Чат '%1' и все связанные сообщения успешно удалены.").arg(chatName));
     return true;
 }
+
+/**
+ * @brief Переименовывает чат вместе со всеми его сообщениями.
+ * @param chatName Текущее имя чата.
+ * @param newName Новое имя чата.
+ * @return true, если чат успешно переименован, иначе false.
+ */
+bool ChatDatabase::renameChat(const QString& chatName, const QString& newName) {
+    Logger& logger = Logger::getInstance();
+
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("UPDATE chats SET name = ? WHERE name = ?");
+    query.addBindValue(newName);
+    query.addBindValue(chatName);
+    bool ok = query.exec();
+
+    if (ok) {
+        query.prepare("UPDATE messages SET chat_name = ? WHERE chat_name = ?");
+        query.addBindValue(newName);
+        query.addBindValue(chatName);
+        ok = query.exec();
+    }
+
+    if (ok) {
+        query.prepare("UPDATE chat_retention SET chat_name = ? WHERE chat_name = ?");
+        query.addBindValue(newName);
+        query.addBindValue(chatName);
+        ok = query.exec();
+    }
+
+    if (!ok) {
+        logger.log(QtWarningMsg, QString("Ошибка при переименовании чата '%1': %2")
+                                     .arg(chatName, query.lastError().text()));
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+/**
+ * @brief Удаляет сообщения чата из части, в которой нет каталога.
+ * @param chatName Имя чата.
+ * @return true, если сообщения удалены.
+ */
+bool ChatDatabase::deleteMessages(const QString& chatName) {
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM messages WHERE chat_name = ?");
+    query.addBindValue(chatName);
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при удалении сообщений чата '%1': %2")
+                                                    .arg(chatName, query.lastError().text()));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Переносит сообщения чата под новое имя в части, в которой нет каталога.
+ * @param chatName Текущее имя чата.
+ * @param newName Новое имя чата.
+ * @return true, если сообщения переименованы.
+ */
+bool ChatDatabase::renameMessages(const QString& chatName, const QString& newName) {
+    QSqlQuery query(db);
+    query.prepare("UPDATE messages SET chat_name = ? WHERE chat_name = ?");
+    query.addBindValue(newName);
+    query.addBindValue(chatName);
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при переименовании сообщений чата '%1': %2")
+                                                    .arg(chatName, query.lastError().text()));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Задает срок хранения сообщений чата вместо общего.
+ * @param chatName Имя чата.
+ * @param policy Ограничения чата; пустая политика возвращает чат к общей.
+ * @return true, если политика сохранена.
+ */
+bool ChatDatabase::setRetentionPolicy(const QString& chatName, const RetentionPolicy& policy) {
+    QSqlQuery query(db);
+    if (policy.isEmpty()) {
+        query.prepare("DELETE FROM chat_retention WHERE chat_name = ?");
+        query.addBindValue(chatName);
+    } else {
+        query.prepare("INSERT OR REPLACE INTO chat_retention (chat_name, max_age_days, max_count) VALUES (?, ?, ?)");
+        query.addBindValue(chatName);
+        query.addBindValue(qMax(0, policy.maxAgeDays));
+        query.addBindValue(qMax(0, policy.maxCount));
+    }
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при сохранении срока хранения чата '%1': %2")
+                                                    .arg(chatName, query.lastError().text()));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Возвращает срок хранения, заданный для чата.
+ * @param chatName Имя чата.
+ * @return Политика чата или пустая, если действует общая.
+ */
+RetentionPolicy ChatDatabase::getRetentionPolicy(const QString& chatName) {
+    RetentionPolicy policy;
+    QSqlQuery query(db);
+    query.prepare("SELECT max_age_days, max_count FROM chat_retention WHERE chat_name = ?");
+    query.addBindValue(chatName);
+    if (query.exec() && query.next()) {
+        policy.maxAgeDays = query.value(0).toInt();
+        policy.maxCount = query.value(1).toInt();
+    }
+    return policy;
+}
+
+/**
+ * @brief Читает число частей базы из каталога.
+ * target_count отличается от shard_count, пока messenger-rebalance
+ * переносит сообщения; сервер в это время базу не открывает.
+ * @param shardCount Заполняется числом частей, в которых лежат сообщения.
+ * @param targetCount Заполняется числом частей после перераспределения.
+ * @return true, если число частей записано; false - база создана до разбиения на части.
+ */
+bool ChatDatabase::getShardConfig(int& shardCount, int& targetCount) {
+    QSqlQuery query(db);
+    if (!query.exec("SELECT shard_count, target_count FROM shard_config") || !query.next()) {
+        return false;
+    }
+    shardCount = query.value(0).toInt();
+    targetCount = query.value(1).toInt();
+    return true;
+}
+
+/**
+ * @brief Записывает число частей базы в каталог.
+ * @param shardCount Число частей, в которых лежат сообщения.
+ * @param targetCount Число частей после перераспределения.
+ * @return true, если запись сохранена.
+ */
+bool ChatDatabase::setShardConfig(int shardCount, int targetCount) {
+    QSqlQuery query(db);
+    bool ok = query.exec("CREATE TABLE IF NOT EXISTS shard_config ("
+                         "shard_count INTEGER NOT NULL, "
+                         "target_count INTEGER NOT NULL)");
+    ok = ok && db.transaction();
+    ok = ok && query.exec("DELETE FROM shard_config");
+    if (ok) {
+        query.prepare("INSERT INTO shard_config (shard_count, target_count) VALUES (?, ?)");
+        query.addBindValue(shardCount);
+        query.addBindValue(targetCount);
+        ok = query.exec();
+    }
+    if (!ok || !db.commit()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка при сохранении числа частей базы: %1")
+                                                    .arg(query.lastError().text()));
+        db.rollback();
+        return false;
+    }
+    return true;
+}
@@ -4,6 +4,21 @@
 #include <QObject>
 #include <QSqlDatabase>
 #include <QString>
+#include <QHash>
+#include <QList>
+#include <QPair>
+
+/**
+ * @brief RetentionPolicy - сколько хранить сообщения чата.
+ * Сообщения старше maxAgeDays дней и все, кроме последних maxCount,
+ * архивируются и удаляются RetentionWorker; 0 - без ограничения.
+ */
+struct RetentionPolicy {
+    int maxAgeDays = 0;
+    int maxCount = 0;
+
+    bool isEmpty() const { return maxAgeDays <= 0 && maxCount <= 0; }
+};
 
 /**
  * @brief ChatDatabase - класс для работы с базой данных чатов.
@@ -19,21 +34,41 @@ class ChatDatabase : public QObject {
 private:
     QSqlDatabase db;
 
+    bool createMessageSchema();
+    bool createCatalogSchema();
+    bool migrateSequenceNumbers();
+    bool createSearchIndex();
+
 public:
     ChatDatabase(QObject* parent = nullptr);
     ~ChatDatabase();
 
-    bool open(const QString& path);
+    bool open(const QString& path, const QString& connectionName = "ChatDatabase", bool catalog = true);
     bool isOpen() const;
     void close();
     QStringList getAllChatNames();
+    QList<QPair<quint32, QString>> getAllChats();
 
-    void addChat(const QString& chatName);
+    quint32 addChat(const QString& chatName);
     bool deleteChat(const QString& chatName);
+    bool renameChat(const QString& chatName, const QString& newName);
+    bool deleteMessages(const QString& chatName);
+    bool renameMessages(const QString& chatName, const QString& newName);
+    bool setRetentionPolicy(const QString& chatName, const RetentionPolicy& policy);
+    RetentionPolicy getRetentionPolicy(const QString& chatName);
+    bool getShardConfig(int& shardCount, int& targetCount);
+    bool setShardConfig(int shardCount, int targetCount);
 
-    void addMessage(const QString& chatName, const QString& sender, const QString& text,
+    bool addMessage(const QString& chatName, quint32 seq, const QString& sender, const QString& text,
                     const QDateTime& timestamp, const QString& firstName, const QString& lastName);
     QList<QMap<QString, QString>> getMessages(const QString& chatName);  // Получить все сообщения чата
+    QList<QMap<QString, QString>> getRecentMessages(const QString& chatName, int limit);
+    QList<QMap<QString, QString>> getMessagesAfter(const QString& chatName, quint32 afterSeq, int limit);
+    QHash<QString, quint32> getLastSeqs();
+    quint32 getLastSeq(const QString& chatName);
+    bool transaction() { return db.transaction(); }
+    bool commit() { return db.commit(); }
+    bool rollback() { return db.rollback(); }
 };
 
 #endif
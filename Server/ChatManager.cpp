@@ -1,38 +1,211 @@
 #include "ChatManager.h"
 #include <QSqlQuery>
+#include <QPointer>
+#include <algorithm>
 #include "logger.h"
+#include "Tracer.h"
+
+namespace {
+MessageRecord toRecord(const QMap<QString, QString>& msg) {
+    MessageRecord record;
+    record.seq = msg["seq"].toUInt();
+    record.sender = msg["sender"];
+    record.firstName = msg["firstName"];
+    record.lastName = msg["lastName"];
+    record.text = msg["text"];
+    record.timestamp = QDateTime::fromString(msg["timestamp"], Qt::ISODate);
+    return record;
+}
+}
 
 /**
  * @brief Конструктор класса ChatManager.
- * Инициализирует менеджер чатов и загружает существующие чаты из базы данных.
- * @param dbPath Путь к базе данных.
+ * Инициализирует менеджер чатов и регистрирует существующие чаты из базы данных.
+ * Сообщения чатов загружаются при первом обращении к ним.
+ * @param dbPath Путь к базе данных - части 0.
+ * @param shardCount Число частей; должно совпадать с записанным в базе.
  * @param parent Родительский объект.
  */
-ChatManager::ChatManager(const QString& dbPath, QObject* parent)
-    : QObject(parent), model(this) {
+ChatManager::ChatManager(const QString& dbPath, int shardCount, QObject* parent)
+    : QObject(parent), model(this), databasePath(dbPath) {
+    if (!openShards(qBound(1, shardCount, ChatShards::MaxShards))) {
+        shards.clear();
+        shards.push_back(std::make_unique<ChatDatabase>());
+        return;
+    }
+    QList<QPair<quint32, QString>> storedChats = catalog().getAllChats();
+    QHash<QString, quint32> lastSeqs;
+    for (const auto& shard : shards) {
+        const QHash<QString, quint32> shardSeqs = shard->getLastSeqs();
+        for (auto it = shardSeqs.constBegin(); it != shardSeqs.constEnd(); ++it) {
+            lastSeqs.insert(it.key(), qMax(it.value(), lastSeqs.value(it.key(), 0)));
+        }
+    }
+    for (const auto& chat : storedChats) {
+        loadChat(chat.first, chat.second);
+        chats.find(chat.first)->setLastSeq(lastSeqs.value(chat.second, 0));
+    }
+    opened = true;
+}
+
+/**
+ * @brief Открывает каталог и остальные части базы и запускает потоки записи.
+ * Число частей сверяется с записанным в каталоге: при другом числе
+ * сообщения чатов искались бы не в тех файлах, поэтому база не открывается,
+ * пока ее не перераспределит messenger-rebalance.
+ * @param shardCount Число частей из настроек.
+ * @return true, если все части открыты.
+ */
+bool ChatManager::openShards(int shardCount) {
     Logger& logger = Logger::getInstance();
-    if (!database.open(dbPath)) {
+    shards.push_back(std::make_unique<ChatDatabase>());
+    if (!catalog().open(databasePath, ChatShards::connectionName(0))) {
         logger.log(QtCriticalMsg, "Не удалось открыть базу данных чатов");
-        return;
+        return false;
+    }
+
+    int storedCount = 0;
+    int targetCount = 0;
+    if (!catalog().getShardConfig(storedCount, targetCount)) {
+        /*база до разбиения на части: все сообщения лежат в одном файле,
+          новую базу можно сразу создать с нужным числом частей*/
+        storedCount = catalog().getAllChats().isEmpty() ? shardCount : 1;
+        targetCount = storedCount;
+        if (!catalog().setShardConfig(storedCount, targetCount)) {
+            return false;
+        }
     }
-    QStringList chatNames = database.getAllChatNames();
-    for (const QString& name : chatNames) {
-        loadChat(name);
+    if (storedCount != targetCount) {
+        logger.log(QtCriticalMsg, QString("Перераспределение базы чатов с %1 на %2 частей не завершено, "
+                                          "запустите messenger-rebalance --shards %2")
+                                      .arg(storedCount).arg(targetCount));
+        return false;
+    }
+    if (storedCount != shardCount) {
+        logger.log(QtCriticalMsg, QString("База чатов разбита на %1 частей, а в настройках storage/shards - %2; "
+                                          "перераспределите ее: messenger-rebalance --shards %2")
+                                      .arg(storedCount).arg(shardCount));
+        return false;
+    }
+
+    for (int shard = 1; shard < shardCount; ++shard) {
+        shards.push_back(std::make_unique<ChatDatabase>());
+        if (!shards.back()->open(ChatShards::shardPath(databasePath, shard), ChatShards::connectionName(shard), false)) {
+            logger.log(QtCriticalMsg, QString("Не удалось открыть часть %1 базы чатов").arg(shard));
+            return false;
+        }
+    }
+    for (int shard = 0; shard < shardCount; ++shard) {
+        writers.push_back(std::make_unique<ShardWriter>(shard, ChatShards::shardPath(databasePath, shard)));
+    }
+    logger.log(QtInfoMsg, QString("База чатов: %1 частей").arg(shardCount));
+    return true;
+}
+
+/**
+ * @brief Дожидается записи всех принятых сообщений во всех частях.
+ * Обратные вызовы addMessageToChat остаются в очереди событий.
+ */
+void ChatManager::flush() {
+    for (const auto& writer : writers) {
+        writer->flush();
     }
 }
 
 /**
  * @brief Создает новый чат и добавляет его в базу данных.
+ * Строка каталога добавляется в потоке записи части 0, затем в потоке
+ * части чата читается последний номер; до этого имя занято, а о готовом
+ * чате сообщает chatAdded.
  * @param name Имя нового чата.
  */
 void ChatManager::createChat(const QString& name) {
-    if (!chats.contains(name)) {
-        chats.insert(name, Chat(name));
-        auto* item = new QStandardItem(name);
-        model.appendRow(item);
-        database.addChat(name);
-        emit chatAdded();
+    if (reservedNames.contains(name)) {
+        Logger::getInstance().log(QtWarningMsg, QString("Имя '%1' еще занято, чат не создан").arg(name));
+        return;
     }
+    if (chatIds.contains(name)) {
+        return;
+    }
+
+    reservedNames.insert(name);
+    auto id = std::make_shared<quint32>(0);
+    writers[0]->execute([name, id](ChatDatabase& database) {
+        *id = database.addChat(name);
+        return *id != 0;
+    }, this, [this, name, id](bool ok) {
+        if (!ok) {
+            reservedNames.remove(name);
+            Logger::getInstance().log(QtWarningMsg, QString("Не удалось создать чат '%1'").arg(name));
+            return;
+        }
+        auto lastSeq = std::make_shared<quint32>(0);
+        writers[shardIndex(*id)]->execute([name, lastSeq](ChatDatabase& database) {
+            *lastSeq = database.getLastSeq(name);
+            return true;
+        }, this, [this, name, id, lastSeq](bool) {
+            finishCreateChat(*id, name, *lastSeq);
+        });
+    });
+}
+
+/**
+ * @brief Регистрирует созданный чат и освобождает его имя.
+ * @param id Идентификатор из каталога.
+ * @param name Имя чата.
+ * @param lastSeq Последний номер сообщения в части чата.
+ */
+void ChatManager::finishCreateChat(quint32 id, const QString& name, quint32 lastSeq) {
+    reservedNames.remove(name);
+    loadChat(id, name);
+    chats.find(id)->setLastSeq(lastSeq);
+    ++chatListVersion;
+    emit chatAdded(name);
+    addMessageToChat(id, "System", "Chat created", QDateTime::currentDateTime(), "", "");
+}
+
+/**
+ * @brief Задает политику кэширования сообщений.
+ * @param messagesPerChat Число последних сообщений, хранимых в памяти для каждого чата.
+ * @param memoryBudgetBytes Общий бюджет памяти на сообщения всех чатов.
+ */
+void ChatManager::setCachePolicy(int messagesPerChat, qint64 memoryBudgetBytes) {
+    this->messagesPerChat = qMax(1, messagesPerChat);
+    memoryBudget = qMax<qint64>(0, memoryBudgetBytes);
+
+    residentBytes = 0;
+    for (Chat* chat : chats.all()) {
+        chat->setCapacity(this->messagesPerChat);
+        if (resident.contains(chat->getId())) {
+            residentBytes += chat->memoryUsage();
+        }
+    }
+    enforceBudget();
+
+    Logger::getInstance().log(QtInfoMsg, QString("Кэш сообщений: %1 сообщений на чат, бюджет %2 МБ")
+                                             .arg(this->messagesPerChat).arg(memoryBudget / (1024 * 1024)));
+}
+
+/**
+ * @brief Возвращает указатель на чат по идентификатору.
+ * Для выгруженного чата запускается загрузка из базы данных: пока она идет,
+ * в чате только новые сообщения, по ее завершении отправляется chatLoaded.
+ * Сам чат помечается как недавно использованный.
+ * Указатель остается действительным до удаления чата.
+ * @param id Идентификатор чата.
+ * @return Указатель на чат или nullptr, если чат не найден.
+ */
+Chat* ChatManager::getChat(quint32 id) {
+    Chat* chat = chats.find(id);
+    if (!chat) {
+        return nullptr;
+    }
+    if (!resident.contains(id)) {
+        rehydrate(*chat);
+    }
+    touch(id);
+    enforceBudget();
+    return chat;
 }
 
 /**
@@ -41,75 +214,322 @@ void ChatManager::createChat(const QString& name) {
  * @return Указатель на чат или nullptr, если чат не найден.
  */
 Chat* ChatManager::getChat(const QString& name) {
-    QMap<QString, Chat>::iterator it = chats.find(name);
-    if (it != chats.end()) {
-        return &it.value();
+    return getChat(chatId(name));
+}
+
+/**
+ * @brief Перемещает чат в начало списка недавно использованных.
+ * @param id Идентификатор загруженного чата.
+ */
+void ChatManager::touch(quint32 id) {
+    auto it = resident.find(id);
+    if (it != resident.end()) {
+        recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, it.value());
+    }
+}
+
+/**
+ * @brief Начинает загрузку последних сообщений чата из базы данных.
+ * Чтение встает в очередь записи части за всеми сообщениями, которым номер
+ * уже присвоен, и видит их в базе без ожидания. Чат сразу считается
+ * загруженным: новые сообщения попадают в кэш и после загрузки
+ * оказываются за прочитанными.
+ * @param chat Выгруженный чат.
+ */
+void ChatManager::rehydrate(Chat& chat) {
+    const quint32 id = chat.getId();
+    recentlyUsed.push_front(id);
+    resident.insert(id, recentlyUsed.begin());
+    residentBytes += chat.memoryUsage();
+
+    const quint64 ticket = ++loadTicket;
+    loading.insert(id, ticket);
+    auto messages = std::make_shared<QList<QMap<QString, QString>>>();
+    writers[shardIndex(id)]->execute([name = chat.getName(), limit = messagesPerChat, messages](ChatDatabase& database) {
+        *messages = database.getRecentMessages(name, limit);
+        return true;
+    }, this, [this, id, ticket, messages](bool) {
+        finishRehydrate(id, ticket, *messages);
+    });
+}
+
+/**
+ * @brief Добавляет прочитанную историю перед сообщениями, пришедшими во время загрузки.
+ * Результат устаревшей загрузки (чат успели выгрузить или удалить) отбрасывается.
+ * @param id Идентификатор чата.
+ * @param ticket Номер загрузки из rehydrate.
+ * @param messages Последние сообщения чата по возрастанию номера.
+ */
+void ChatManager::finishRehydrate(quint32 id, quint64 ticket, const QList<QMap<QString, QString>>& messages) {
+    auto it = loading.find(id);
+    if (it == loading.end() || it.value() != ticket) {
+        return;
+    }
+    loading.erase(it);
+    Chat* chat = chats.find(id);
+
+    QList<QPair<quint32, Message>> arrived;
+    for (int i = 0; i < chat->messageCount(); ++i) {
+        arrived.append(qMakePair(chat->compactAt(i).seq, chat->messageAt(i)));
+    }
+    const qint64 before = chat->memoryUsage();
+    chat->releaseMessages();
+    for (const auto& msg : messages) {
+        QDateTime timestamp = QDateTime::fromString(msg["timestamp"], Qt::ISODate);
+        chat->addMessage(msg["seq"].toUInt(), msg["sender"], msg["text"], timestamp, msg["firstName"], msg["lastName"]);
+    }
+    for (const auto& message : arrived) {
+        const Message& msg = message.second;
+        chat->addMessage(message.first, msg.getSender(), msg.getText(), msg.getTimestamp(),
+                         msg.getFirstName(), msg.getLastName());
+    }
+    residentBytes += chat->memoryUsage() - before;
+    enforceBudget();
+    emit chatLoaded(chat->getName());
+}
+
+/**
+ * @brief Выгружает сообщения чата из памяти.
+ * @param id Идентификатор загруженного чата.
+ */
+void ChatManager::evict(quint32 id) {
+    auto it = resident.find(id);
+    if (it == resident.end()) {
+        return;
+    }
+    recentlyUsed.erase(it.value());
+    resident.erase(it);
+    loading.remove(id);
+
+    Chat* chat = chats.find(id);
+    residentBytes -= chat->memoryUsage();
+    chat->releaseMessages();
+}
+
+/**
+ * @brief Выгружает дольше всего не использовавшиеся чаты, пока объем
+ * сообщений в памяти превышает бюджет. Последний использованный чат
+ * остается в памяти всегда.
+ */
+void ChatManager::enforceBudget() {
+    while (residentBytes > memoryBudget && recentlyUsed.size() > 1) {
+        evict(recentlyUsed.back());
     }
-    return nullptr;
 }
 
 /**
  * @brief Добавляет сообщение в указанный чат.
- * @param chatName Имя чата.
+ * Сообщению сразу присваивается следующий номер в чате и оно попадает
+ * в кэш, а запись в базу выполняет поток части. Если записать не удалось,
+ * чат выгружается из кэша, а номер остается пропущенным: клиенты догоняют
+ * историю по номерам и пропуск не мешает синхронизации.
+ * @param chatId Идентификатор чата.
  * @param sender Отправитель сообщения.
  * @param text Текст сообщения.
  * @param timestamp Временная метка.
  * @param firstName Имя отправителя.
  * @param lastName Фамилия отправителя.
+ * @param context Объект, при удалении которого persisted не вызывается; nullptr - вызывается всегда.
+ * @param persisted Вызывается в потоке ChatManager после записи: true - сообщение в базе.
+ * @return Номер сообщения в чате или 0, если чат не найден.
  */
-void ChatManager::addMessageToChat(const QString& chatName, const QString& sender, const QString& text,
-                                   const QDateTime& timestamp, const QString& firstName, const QString& lastName) {
-    Chat* chat = getChat(chatName);
-    if (chat) {
-        chat->addMessage(sender, text, timestamp, firstName, lastName);
-        database.addMessage(chatName, sender, text, timestamp, firstName, lastName);
-        emit chatUpdated(chatName);
+quint32 ChatManager::addMessageToChat(quint32 chatId, const QString& sender, const QString& text,
+                                     const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                                     QObject* context, std::function<void(bool)> persisted) {
+    Tracer::Span span("chat_manager.add_message");
+    Chat* chat = chats.find(chatId);
+    if (!chat) {
+        return 0;
+    }
+
+    quint32 seq = chat->getLastSeq() + 1;
+    chat->setLastSeq(seq);
+
+    /*в выгруженный чат сообщение попадет при следующей загрузке из базы*/
+    if (resident.contains(chatId)) {
+        qint64 before = chat->memoryUsage();
+        chat->addMessage(seq, sender, text, timestamp, firstName, lastName);
+        residentBytes += chat->memoryUsage() - before;
+        touch(chatId);
+        enforceBudget();
     }
+
+    PendingMessage message{chat->getName(), seq, sender, text, timestamp, firstName, lastName, Tracer::currentTrace()};
+    /*запись идет в потоке части: стрелка ведет к фиксации пачки*/
+    if (message.trace != 0) {
+        Tracer::getInstance().flowStart(message.trace);
+    }
+    QPointer<QObject> guard(context);
+    const bool guarded = context != nullptr;
+    writers[shardIndex(chatId)]->submit(message, this, [this, chatId, seq, guard, guarded,
+                                                        persisted = std::move(persisted)](bool ok) {
+        if (!ok) {
+            Logger::getInstance().log(QtWarningMsg, QString("Сообщение %1 чата %2 не записано в базу")
+                                                        .arg(seq).arg(chatId));
+            evict(chatId);
+        } else if (Chat* stored = chats.find(chatId)) {
+            emit chatUpdated(stored->getName());
+        }
+        if (persisted && (!guarded || guard)) {
+            persisted(ok);
+        }
+    });
+    return seq;
 }
 
 /**
- * @brief Загружает чат из базы данных.
- * @param name Имя чата.
+ * @brief Добавляет сообщение в чат, указанный по имени.
+ * @param chatName Имя чата.
+ * @param sender Отправитель сообщения.
+ * @param text Текст сообщения.
+ * @param timestamp Временная метка.
+ * @param firstName Имя отправителя.
+ * @param lastName Фамилия отправителя.
+ * @param context Объект, при удалении которого persisted не вызывается.
+ * @param persisted Вызывается после записи в базу.
+ * @return Номер сообщения в чате или 0, если чат не найден.
+ */
+quint32 ChatManager::addMessageToChat(const QString& chatName, const QString& sender, const QString& text,
+                                     const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                                     QObject* context, std::function<void(bool)> persisted) {
+    return addMessageToChat(chatId(chatName), sender, text, timestamp, firstName, lastName, context,
+                            std::move(persisted));
+}
+
+/**
+ * @brief Читает сообщения чата, пропущенные клиентом.
+ * Если клиенту не известно ни одного сообщения чата, возвращаются
+ * только последние limit сообщений, а не вся история. Чтение встает
+ * в очередь записи части и видит все сообщения, которым уже присвоен номер.
+ * @param chatId Идентификатор чата.
+ * @param afterSeq Номер последнего известного клиенту сообщения.
+ * @param limit Максимальное число сообщений.
+ * @param context Объект, при удалении которого done не вызывается.
+ * @param done Вызывается в потоке ChatManager с сообщениями по возрастанию номера.
  */
-void ChatManager::loadChat(const QString& name) {
-    if (!chats.contains(name)) {
-        Chat chat(name);
-        QList<QMap<QString, QString>> messages = database.getMessages(name);
-        for (const auto& msg : messages) {
-            QDateTime timestamp = QDateTime::fromString(msg["timestamp"], Qt::ISODate);
-            chat.addMessage(msg["sender"], msg["text"], timestamp, msg["firstName"], msg["lastName"]);
+void ChatManager::getMessagesAfter(quint32 chatId, quint32 afterSeq, int limit, QObject* context,
+                                   std::function<void(const QList<MessageRecord>&)> done) {
+    Chat* chat = chats.find(chatId);
+    if (!chat) {
+        done({});
+        return;
+    }
+
+    auto messages = std::make_shared<QList<QMap<QString, QString>>>();
+    writers[shardIndex(chatId)]->execute([name = chat->getName(), afterSeq, limit, messages](ChatDatabase& database) {
+        *messages = afterSeq > 0 ? database.getMessagesAfter(name, afterSeq, limit)
+                                 : database.getRecentMessages(name, limit);
+        return true;
+    }, context, [messages, done = std::move(done)](bool) {
+        QList<MessageRecord> result;
+        result.reserve(messages->size());
+        for (const auto& msg : *messages) {
+            result.append(toRecord(msg));
         }
+        done(result);
+    });
+}
 
-        chats.insert(name, chat);
-        auto* item = new QStandardItem(name);
-        model.appendRow(item);
+/**
+ * @brief Читает одно сообщение чата по номеру.
+ * @param chatId Идентификатор чата.
+ * @param seq Номер сообщения.
+ * @param context Объект, при удалении которого done не вызывается.
+ * @param done Вызывается в потоке ChatManager: найдено ли сообщение и само сообщение.
+ */
+void ChatManager::getMessage(quint32 chatId, quint32 seq, QObject* context,
+                             std::function<void(bool found, const MessageRecord& record)> done) {
+    Chat* chat = chats.find(chatId);
+    if (!chat || seq == 0) {
+        done(false, MessageRecord());
+        return;
     }
+    auto messages = std::make_shared<QList<QMap<QString, QString>>>();
+    writers[shardIndex(chatId)]->execute([name = chat->getName(), seq, messages](ChatDatabase& database) {
+        *messages = database.getMessagesAfter(name, seq - 1, 1);
+        return true;
+    }, context, [seq, messages, done = std::move(done)](bool) {
+        if (messages->isEmpty() || messages->first()["seq"].toUInt() != seq) {
+            done(false, MessageRecord());
+            return;
+        }
+        done(true, toRecord(messages->first()));
+    });
 }
 
+/**
+ * @brief Возвращает текущее имя чата по идентификатору.
+ * @param id Идентификатор чата.
+ * @return Имя чата или пустая строка, если чат не найден.
+ */
+QString ChatManager::chatName(quint32 id) const {
+    Chat* chat = chats.find(id);
+    return chat ? chat->getName() : QString();
+}
 
-QStringList ChatManager::getAllChatNames() const {
-    return chats.keys();
+/**
+ * @brief Регистрирует чат из базы данных без загрузки сообщений.
+ * @param id Идентификатор чата.
+ * @param name Имя чата.
+ */
+void ChatManager::loadChat(quint32 id, const QString& name) {
+    if (!chatIds.contains(name)) {
+        Chat* chat = chats.insert(id, name);
+        chat->setCapacity(messagesPerChat);
+        chatIds.insert(name, id);
+        chatNames.insert(std::lower_bound(chatNames.begin(), chatNames.end(), name), name);
+        auto* item = new QStandardItem(name);
+        model.appendRow(item);
+    }
 }
 
 /**
  * @brief Удаляет чат из системы, включая его из базы данных и внутренних структур данных.
+ * Из памяти чат удаляется сразу, а из базы - в потоке записи части после
+ * сообщений, уже стоящих в очереди; до этого имя чата нельзя занять снова.
  * @param name Имя чата для удаления.
- * @return true, если чат успешно удален, иначе false.
+ * @return true, если чат найден и удаление запущено, иначе false.
  */
 bool ChatManager::deleteChat(const QString& name) {
     Logger& logger = Logger::getInstance();
 
-    if (!chats.contains(name)) {
+    quint32 id = chatId(name);
+    if (id == 0) {
         logger.log(QtWarningMsg, QString("Чат '%1' не найден для удаления.").arg(name));
         return false;
     }
 
-    if (!database.deleteChat(name)) {
-        logger.log(QtWarningMsg, QString("Не удалось удалить чат '%1' из базы данных.").arg(name));
-        return false;
+    /*строку каталога чат освобождает последней: пока она есть, имя занято*/
+    reservedNames.insert(name);
+    auto deleteFromCatalog = [this, name]() {
+        writers[0]->execute([name](ChatDatabase& database) { return database.deleteChat(name); }, this,
+                            [this, name](bool ok) {
+            if (!ok) {
+                Logger::getInstance().log(QtCriticalMsg, QString("Не удалось удалить чат '%1' из каталога.").arg(name));
+                return;
+            }
+            reservedNames.remove(name);
+        });
+    };
+    const int shard = shardIndex(id);
+    if (shard == 0) {
+        deleteFromCatalog();
+    } else {
+        writers[shard]->execute([name](ChatDatabase& database) { return database.deleteMessages(name); }, this,
+                                [name, shard, deleteFromCatalog](bool ok) {
+            if (!ok) {
+                Logger::getInstance().log(QtCriticalMsg, QString("Не удалось удалить сообщения чата '%1' из части %2.")
+                                                             .arg(name).arg(shard));
+                return;
+            }
+            deleteFromCatalog();
+        });
     }
 
-    chats.remove(name);
+    evict(id);
+    chats.remove(id);
+    chatIds.remove(name);
+    chatNames.removeOne(name);
 
     for (int row = 0; row < model.rowCount(); ++row) {
         QStandardItem* item = model.item(row);
@@ -120,6 +540,103 @@ bool ChatManager::deleteChat(const QString& name) {
     }
 
     logger.log(QtInfoMsg, QString("Чат '%1' успешно удален.").arg(name));
-    emit chatDeleted();
+    ++chatListVersion;
+    emit chatDeleted(name);
+    return true;
+}
+
+/**
+ * @brief Переименовывает чат. Идентификатор чата и его сообщения сохраняются.
+ * В памяти имя меняется сразу, а в базе - в потоке записи части: сообщения,
+ * стоящие в очереди до переименования, записываются с прежним именем
+ * и переименовываются вместе с остальными. До завершения прежнее имя занято.
+ * @param name Текущее имя чата.
+ * @param newName Новое имя чата.
+ * @return true, если переименование запущено, иначе false.
+ */
+bool ChatManager::renameChat(const QString& name, const QString& newName) {
+    Logger& logger = Logger::getInstance();
+
+    quint32 id = chatId(name);
+    if (id == 0) {
+        logger.log(QtWarningMsg, QString("Чат '%1' не найден для переименования.").arg(name));
+        return false;
+    }
+    if (newName.isEmpty() || chatIds.contains(newName) || reservedNames.contains(newName)) {
+        logger.log(QtWarningMsg, QString("Имя '%1' недопустимо или уже занято.").arg(newName));
+        return false;
+    }
+
+    reservedNames.insert(name);
+    const int shard = shardIndex(id);
+    auto renameInCatalog = [this, name, newName]() {
+        writers[0]->execute([name, newName](ChatDatabase& database) { return database.renameChat(name, newName); },
+                            this, [this, name](bool ok) {
+            if (!ok) {
+                Logger::getInstance().log(QtCriticalMsg, QString("Не удалось переименовать чат '%1' в каталоге.").arg(name));
+                return;
+            }
+            reservedNames.remove(name);
+        });
+    };
+    if (shard == 0) {
+        renameInCatalog();
+    } else {
+        writers[shard]->execute([name, newName](ChatDatabase& database) { return database.renameMessages(name, newName); },
+                                this, [name, shard, renameInCatalog](bool ok) {
+            if (!ok) {
+                Logger::getInstance().log(QtCriticalMsg, QString("Не удалось переименовать чат '%1' в части %2.")
+                                                             .arg(name).arg(shard));
+                return;
+            }
+            renameInCatalog();
+        });
+    }
+
+    chats.find(id)->setName(newName);
+    chatIds.remove(name);
+    chatIds.insert(newName, id);
+    chatNames.removeOne(name);
+    chatNames.insert(std::lower_bound(chatNames.begin(), chatNames.end(), newName), newName);
+
+    for (int row = 0; row < model.rowCount(); ++row) {
+        QStandardItem* item = model.item(row);
+        if (item && item->text() == name) {
+            item->setText(newName);
+            break;
+        }
+    }
+
+    logger.log(QtInfoMsg, QString("Чат '%1' переименован в '%2'.").arg(name, newName));
+    ++chatListVersion;
+    emit chatRenamed(name, newName);
     return true;
 }
+
+/**
+ * @brief Задает срок хранения сообщений чата.
+ * @param name Имя чата.
+ * @param policy Ограничения чата; пустая политика - действует общая.
+ * @return true, если политика сохранена.
+ */
+bool ChatManager::setRetentionPolicy(const QString& name, const RetentionPolicy& policy) {
+    if (!hasChat(name)) {
+        Logger::getInstance().log(QtWarningMsg, QString("Чат '%1' не найден.").arg(name));
+        return false;
+    }
+    return catalog().setRetentionPolicy(name, policy);
+}
+
+/**
+ * @brief Выгружает чат из памяти, если в нем остались удаленные по сроку хранения сообщения.
+ * При следующем обращении чат загрузится из базы уже без них.
+ * @param name Имя чата.
+ * @param upToSeq Номер последнего удаленного сообщения.
+ */
+void ChatManager::expireMessages(const QString& name, quint32 upToSeq) {
+    quint32 id = chatId(name);
+    Chat* chat = id != 0 && resident.contains(id) ? chats.find(id) : nullptr;
+    if (chat && chat->messageCount() > 0 && chat->compactAt(0).seq <= upToSeq) {
+        evict(id);
+    }
+}
@@ -1,35 +1,115 @@
 #pragma once
 
-#include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QStandardItemModel>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
 #include "Chat.h"
 #include "ChatDatabase.h"
+#include "ChatShards.h"
+#include "ChatStore.h"
+#include "ShardWriter.h"
+#include "protocol.h"
 
-
+/**
+ * @brief Класс ChatManager - управление чатами сервера.
+ *
+ * Чаты адресуются целочисленными идентификаторами из базы данных;
+ * для пакетов, в которых чат указан по имени, ведется индекс имя -> идентификатор.
+ * В памяти держатся только последние сообщения чатов, к которым недавно
+ * обращались. Когда общий объем сообщений в памяти превышает бюджет,
+ * дольше всего не использовавшиеся чаты выгружаются целиком и при
+ * следующем обращении заново загружаются из базы данных.
+ *
+ * Сообщения хранятся в нескольких файлах SQLite - частях, чат
+ * закреплен за частью ChatShards::shardFor по идентификатору. Часть 0
+ * одновременно каталог: список чатов и сроки хранения лежат только в ней.
+ * Номер сообщения присваивается сразу, а запись идет в потоке ShardWriter
+ * своей части; о результате сообщает обратный вызов addMessageToChat.
+ * Создание, загрузка чата в кэш, удаление, переименование и чтение истории
+ * для клиентов тоже встают в очередь ShardWriter и выполняются после уже
+ * принятых сообщений, а результат приходит обратным вызовом, поэтому поток
+ * ChatManager не ждет базу. Соединения чтения в потоке ChatManager остаются
+ * для запуска, настроек хранения и поиска.
+ */
 class ChatManager : public QObject {
     Q_OBJECT
 
 private:
-    QMap<QString, Chat> chats;
+    ChatStore chats;
+    QHash<QString, quint32> chatIds; /*имя чата -> идентификатор*/
+    QStringList chatNames;           /*отсортированные имена для списка чатов*/
     QStandardItemModel model;
-    ChatDatabase database;
+    QString databasePath;
+    std::vector<std::unique_ptr<ChatDatabase>> shards;  /*соединения чтения, shards[0] - каталог*/
+    std::vector<std::unique_ptr<ShardWriter>> writers; /*по одному потоку записи на часть*/
+    bool opened = false;
+
+    std::list<quint32> recentlyUsed; /*загруженные чаты, в начале - самые свежие*/
+    QHash<quint32, std::list<quint32>::iterator> resident;
+    QHash<quint32, quint64> loading; /*чаты, история которых еще читается, -> номер загрузки*/
+    quint64 loadTicket = 0;
+    QSet<QString> reservedNames;     /*имена, строки каталога которых еще меняет поток записи*/
+    qint64 residentBytes = 0;
+    int messagesPerChat = Chat::DefaultCapacity;
+    qint64 memoryBudget = 64LL * 1024 * 1024;
+    quint32 chatListVersion = 0;     /*растет при каждом изменении списка чатов*/
+
+    void touch(quint32 id);
+    void rehydrate(Chat& chat);
+    void finishRehydrate(quint32 id, quint64 ticket, const QList<QMap<QString, QString>>& messages);
+    void finishCreateChat(quint32 id, const QString& name, quint32 lastSeq);
+    void evict(quint32 id);
+    void enforceBudget();
+    bool openShards(int shardCount);
+    int shardIndex(quint32 id) const { return ChatShards::shardFor(id, int(shards.size())); }
+    ChatDatabase& catalog() { return *shards.front(); }
 
 public:
-    ChatManager(const QString& dbPath, QObject* parent = nullptr);
+    ChatManager(const QString& dbPath, int shardCount, QObject* parent = nullptr);
+
+    void setCachePolicy(int messagesPerChat, qint64 memoryBudgetBytes);
+    qint64 cachedBytes() const { return residentBytes; }
+    int cachedChatCount() const { return resident.size(); }
 
     void createChat(const QString& name);
     bool deleteChat(const QString& name);
+    bool renameChat(const QString& name, const QString& newName);
+    bool setRetentionPolicy(const QString& name, const RetentionPolicy& policy);
+    RetentionPolicy retentionPolicy(const QString& name) { return catalog().getRetentionPolicy(name); }
+    void expireMessages(const QString& name, quint32 upToSeq);
+    quint32 chatId(const QString& name) const { return chatIds.value(name, 0); }
+    Chat* getChat(quint32 id);
     Chat* getChat(const QString& name);
-    void addMessageToChat(const QString& chatName, const QString& sender, const QString& text,
-                          const QDateTime& timestamp, const QString& firstName, const QString& lastName);
-    bool isOpen() const { return database.isOpen(); }
-    void loadChat(const QString& name);
+    bool hasChat(const QString& name) const { return chatIds.contains(name); }
+    quint32 addMessageToChat(quint32 chatId, const QString& sender, const QString& text,
+                             const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                             QObject* context = nullptr, std::function<void(bool)> persisted = {});
+    quint32 addMessageToChat(const QString& chatName, const QString& sender, const QString& text,
+                             const QDateTime& timestamp, const QString& firstName, const QString& lastName,
+                             QObject* context = nullptr, std::function<void(bool)> persisted = {});
+    void getMessagesAfter(quint32 chatId, quint32 afterSeq, int limit, QObject* context,
+                          std::function<void(const QList<MessageRecord>&)> done);
+    void getMessage(quint32 chatId, quint32 seq, QObject* context,
+                    std::function<void(bool found, const MessageRecord& record)> done);
+    QString chatName(quint32 id) const;
+    bool isOpen() const { return opened; }
+    int shardCount() const { return int(shards.size()); }
+    QStringList shardPaths() const { return ChatShards::shardPaths(databasePath, int(shards.size())); }
+    void flush(); /* Дожидается записи всех принятых сообщений*/
+    void loadChat(quint32 id, const QString& name);
 
-    QStringList getAllChatNames() const;
+    const QStringList& getAllChatNames() const { return chatNames; }
+    quint32 getChatListVersion() const { return chatListVersion; }
     QStandardItemModel* getModel() { return &model; }
 
 signals:
     void chatUpdated(const QString& chatName);
-    void chatDeleted();
-    void chatAdded();
+    void chatLoaded(const QString& chatName); /* История чата загружена в кэш*/
+    void chatDeleted(const QString& chatName);
+    void chatAdded(const QString& chatName);
+    void chatRenamed(const QString& chatName, const QString& newName);
 };
@@ -0,0 +1,52 @@
+#include "ChatShards.h"
+#include "libs/crc/CRC.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+
+namespace ChatShards {
+
+/**
+ * @brief Возвращает номер части, в которой хранятся сообщения чата.
+ * @param chatId Идентификатор чата из таблицы chats.
+ * @param shardCount Число частей.
+ */
+int shardFor(quint32 chatId, int shardCount) {
+    if (shardCount <= 1) {
+        return 0;
+    }
+    char bytes[4];
+    qToLittleEndian(chatId, bytes);
+    return int(CRC::Calculate(bytes, sizeof(bytes), CRC::CRC_32()) % quint32(shardCount));
+}
+
+/**
+ * @brief Возвращает путь к файлу части.
+ * @param basePath Путь к базе чатов из настроек - часть 0.
+ * @param shard Номер части.
+ */
+QString shardPath(const QString& basePath, int shard) {
+    if (shard == 0) {
+        return basePath;
+    }
+    const QFileInfo info(basePath);
+    const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+    return info.dir().filePath(QString("%1.shard%2%3").arg(info.completeBaseName()).arg(shard).arg(suffix));
+}
+
+QStringList shardPaths(const QString& basePath, int shardCount) {
+    QStringList paths;
+    for (int shard = 0; shard < qMax(1, shardCount); ++shard) {
+        paths.append(shardPath(basePath, shard));
+    }
+    return paths;
+}
+
+/**
+ * @brief Часть 0 использует прежнее имя соединения "ChatDatabase".
+ */
+QString connectionName(int shard) {
+    return shard == 0 ? QString("ChatDatabase") : QString("ChatDatabase.%1").arg(shard);
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef CHATSHARDS_H
+#define CHATSHARDS_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief ChatShards - раскладка сообщений чатов по файлам базы.
+ *
+ * Сообщения чата хранятся в части shardFor(id чата, число частей).
+ * Часть 0 - файл, указанный в настройках, в нем же каталог: таблицы
+ * chats, chat_retention и shard_config. Остальные части лежат рядом:
+ * chats.db -> chats.shard1.db, chats.shard2.db и т. д. Поэтому база
+ * из одной части совпадает с базой, созданной до разбиения.
+ *
+ * Часть выбирается по CRC32 идентификатора, а не по имени: имя чата
+ * меняется при переименовании, а идентификатор - никогда. Функция
+ * не зависит от версии Qt и платформы, поэтому раскладка, записанная
+ * однажды, читается так же сервером и messenger-rebalance.
+ */
+namespace ChatShards {
+    constexpr int MaxShards = 64;
+
+    int shardFor(quint32 chatId, int shardCount);
+    QString shardPath(const QString& basePath, int shard);
+    QStringList shardPaths(const QString& basePath, int shardCount);
+    QString connectionName(int shard); /* имя соединения QSqlDatabase для чтения части*/
+}
+
+#endif // CHATSHARDS_H
@@ -0,0 +1,67 @@
+#include "ChatStore.h"
+
+/**
+ * @brief Создает чат с указанным идентификатором.
+ * Если чат с таким идентификатором уже есть, возвращается он.
+ * @param id Идентификатор чата.
+ * @param name Имя чата.
+ * @return Указатель на чат.
+ */
+Chat* ChatStore::insert(quint32 id, const QString& name) {
+    if (Chat* existing = find(id)) {
+        return existing;
+    }
+
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<int>(slots.size());
+        slots.emplace_back();
+    }
+    slots[slot] = std::make_unique<Chat>(id, name);
+    index.insert(id, slot);
+    return slots[slot].get();
+}
+
+/**
+ * @brief Ищет чат по идентификатору.
+ * @param id Идентификатор чата.
+ * @return Указатель на чат или nullptr, если чат не найден.
+ */
+Chat* ChatStore::find(quint32 id) const {
+    int slot = index.find(id);
+    return slot < 0 ? nullptr : slots[slot].get();
+}
+
+/**
+ * @brief Удаляет чат и освобождает его ячейку.
+ * @param id Идентификатор чата.
+ * @return true, если чат был найден и удален.
+ */
+bool ChatStore::remove(quint32 id) {
+    int slot = index.find(id);
+    if (slot < 0) {
+        return false;
+    }
+    index.remove(id);
+    slots[slot].reset();
+    freeSlots.push_back(slot);
+    return true;
+}
+
+/**
+ * @brief Возвращает все чаты хранилища.
+ * @return Список указателей на чаты в порядке ячеек.
+ */
+QList<Chat*> ChatStore::all() const {
+    QList<Chat*> result;
+    result.reserve(index.size());
+    for (const auto& chat : slots) {
+        if (chat) {
+            result.append(chat.get());
+        }
+    }
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef CHATSTORE_H
+#define CHATSTORE_H
+
+#include <QList>
+#include <memory>
+#include <vector>
+#include "Chat.h"
+#include "FlatIdIndex.h"
+
+/**
+ * @brief Класс ChatStore - хранилище чатов по целочисленному идентификатору.
+ *
+ * Каждый чат размещается в куче один раз и не перемещается, поэтому
+ * указатели Chat* остаются действительными, пока чат не удален.
+ * Освободившиеся ячейки переиспользуются, поиск по идентификатору
+ * выполняется через FlatIdIndex и не зависит от числа чатов.
+ */
+class ChatStore {
+public:
+    Chat* insert(quint32 id, const QString& name);
+    Chat* find(quint32 id) const;
+    bool remove(quint32 id);
+    QList<Chat*> all() const;
+    int size() const { return index.size(); }
+
+private:
+    std::vector<std::unique_ptr<Chat>> slots;
+    std::vector<int> freeSlots;
+    FlatIdIndex index;
+};
+
+#endif // CHATSTORE_H
@@ -0,0 +1,57 @@
+#ifndef CLIENTCONNECTION_H
+#define CLIENTCONNECTION_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+#include <QHostAddress>
+#include "TimerWheel.h"
+
+class QTcpSocket;
+class QLocalSocket;
+class NetworkBackend;
+
+/**
+ * @brief Структура ClientConnection - состояние одного клиентского соединения.
+ *
+ * Все, что сервер знает о соединении, лежит в одной записи: буферы,
+ * пользователь, согласованные параметры и время активности. Записи
+ * хранятся в ConnectionSlab и переиспользуются, поэтому сохранять указатель
+ * дольше обработки одного события нельзя - для отложенных ответов служит id.
+ */
+struct ClientConnection {
+    /* Параметры, согласованные с клиентом пакетами Hello/HelloAck*/
+    struct PeerInfo {
+        quint16 version = 1;      /* клиенты без Hello считаются версией 1*/
+        quint32 capabilities = 0; /* битовая маска Capability*/
+        quint8 codec = 0;         /* кодек сжатия исходящих кадров, 0 - без сжатия*/
+    };
+
+    quint64 id = 0;               /* номер ячейки и поколение, 0 - запись свободна*/
+    QHostAddress address;
+    quint16 port = 0;
+    bool open = false;            /* false после разрыва, пока запись не возвращена в пул*/
+    bool local = false;           /* локальный сокет: address - условный LocalHost, общий для всех*/
+
+    QByteArray readBuffer;        /* накопленные данные неполного кадра*/
+    QString user;                 /* пользователь, прошедший аутентификацию*/
+    PeerInfo peer;
+
+    qint64 lastActivityMs = 0;    /* время последнего входящего кадра*/
+    qint64 roundTripMs = -1;
+    TimerWheel::TimerId idleTimer = 0;
+
+    /* данные транспорта: используется только поле своего бэкенда*/
+    NetworkBackend* transport = nullptr; /* бэкенд, принявший соединение*/
+    QTcpSocket* socket = nullptr;
+    QLocalSocket* localSocket = nullptr;
+    int fd = -1;
+    QByteArray writeBuffer;       /* неотправленный хвост исходящих данных*/
+    qsizetype writeOffset = 0;
+    bool closeWhenFlushed = false;
+
+    QHostAddress peerAddress() const { return address; }
+    quint16 peerPort() const { return port; }
+};
+
+#endif // CLIENTCONNECTION_H
@@ -1,7 +1,18 @@
 #include "ClientDataBase.h"
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QThread>
 #include "logger.h"
+#include "Metrics.h"
+#include "Tracer.h"
+
+namespace {
+/* Время операций с базой в микросекундах, выводится в секундах*/
+MetricHistogram& operationLatency(const char* op) {
+    return Metrics::getInstance().histogram("messenger_db_op_seconds", "Database operation latency",
+                                            Metrics::label("db", "users") + "," + Metrics::label("op", op), 1e-6);
+}
+}
 
 
 /**
@@ -15,6 +26,7 @@ ClientDataBase::ClientDataBase(const QString& path, QObject* parent)
     : QObject(parent), db(QSqlDatabase::addDatabase("QSQLITE", "ClientDataBase" )) {
 
     db.setDatabaseName(path);
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
     Logger& logger = Logger::getInstance();
     if (!db.open()) {
         logger.log(QtCriticalMsg, QString("Ошибка открытия базы данных: %1").arg(db.lastError().text()));
@@ -29,10 +41,22 @@ ClientDataBase::ClientDataBase(const QString& path, QObject* parent)
                               "password_hash TEXT NOT NULL, "
                               "salt TEXT NOT NULL, "
                               "role TEXT DEFAULT 'user', "
-                              "created_time TIMESTAMP DEFAULT CURRENT_TIMESTAMP)");
+                              "created_time TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+                              "token_generation INTEGER NOT NULL DEFAULT 0)");
     if (!success) {
         logger.log(QtCriticalMsg, QString("Ошибка создания таблицы Users: %1").arg(query.lastError().text()));
     }
+
+    /*базы, созданные до отзыва токенов, получают столбец поколения*/
+    bool hasGeneration = false;
+    if (query.exec("PRAGMA table_info(Users)")) {
+        while (query.next()) {
+            hasGeneration = hasGeneration || query.value("name").toString() == "token_generation";
+        }
+    }
+    if (!hasGeneration && !query.exec("ALTER TABLE Users ADD COLUMN token_generation INTEGER NOT NULL DEFAULT 0")) {
+        logger.log(QtCriticalMsg, QString("Ошибка добавления столбца token_generation: %1").arg(query.lastError().text()));
+    }
 }
 
 ClientDataBase::~ClientDataBase() {
@@ -41,21 +65,52 @@ ClientDataBase::~ClientDataBase() {
     }
 }
 
+/**
+ * @brief Возвращает соединение с базой данных для текущего потока.
+ * QSqlDatabase можно использовать только из потока, в котором оно создано,
+ * поэтому рабочие потоки (см. CredentialWorkerPool) получают собственный
+ * клон основного соединения на тот же файл.
+ * @return Соединение, пригодное для использования в текущем потоке.
+ */
+QSqlDatabase ClientDataBase::connection() const {
+    if (QThread::currentThread() == thread()) {
+        return db;
+    }
+
+    const QString name = QString("ClientDataBase_%1")
+                             .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    if (QSqlDatabase::contains(name)) {
+        return QSqlDatabase::database(name);
+    }
+
+    QSqlDatabase clone = QSqlDatabase::cloneDatabase("ClientDataBase", name);
+    if (!clone.open()) {
+        Logger::getInstance().log(QtCriticalMsg, QString("Ошибка открытия соединения рабочего потока: %1")
+                                                     .arg(clone.lastError().text()));
+    }
+    return clone;
+}
+
 /**
  * @brief Создает нового пользователя в базе данных.
- * Добавляет запись о пользователе в таблицу Users.
+ * Добавляет запись о пользователе в таблицу Users одним запросом: занятость
+ * логина проверяет ограничение UNIQUE, поэтому две одновременные регистрации
+ * одного логина не могут пройти обе.
  * @param firstName Имя пользователя.
  * @param lastName Фамилия пользователя.
  * @param username Уникальное имя пользователя.
  * @param password_hash Хеш пароля.
  * @param salt Соль для хеширования.
- * @return true, если пользователь успешно создан, иначе false.
+ * @return Created, UsernameTaken, если логин уже занят, или Error.
  */
-bool ClientDataBase::createUser(const QString& firstName, const QString& lastName, const QString& username,const QString& password_hash ,const QString& salt ) {
-    QSqlQuery query(db);
+ClientDataBase::CreateResult ClientDataBase::createUser(const QString& firstName, const QString& lastName, const QString& username,const QString& password_hash ,const QString& salt ) {
+    static MetricHistogram& latency = operationLatency("create_user");
+    MetricHistogram::Timer timer(latency);
+    QSqlQuery query(connection());
     Logger& logger = Logger::getInstance();
     query.prepare("INSERT INTO Users (first_name, last_name, username,password_hash,  salt) "
-                  "VALUES (:first_name, :last_name, :username, :password_hash, :salt)");
+                  "VALUES (:first_name, :last_name, :username, :password_hash, :salt) "
+                  "ON CONFLICT(username) DO NOTHING");
     query.bindValue(":first_name", firstName);
     query.bindValue(":last_name", lastName);
     query.bindValue(":username", username);
@@ -65,10 +120,11 @@ bool ClientDataBase::createUser(const QString& firstName, const QString& lastNam
     if (!query.exec()) {
         logger.log(QtWarningMsg, QString("Ошибка создания пользователя '%1': %2")
                                      .arg(username).arg(query.lastError().text()));
-        return false;
+        return CreateResult::Error;
     }
 
-    return true;
+    /*строка не вставлена только при конфликте по username*/
+    return query.numRowsAffected() == 1 ? CreateResult::Created : CreateResult::UsernameTaken;
 }
 
 /**
@@ -79,7 +135,7 @@ bool ClientDataBase::createUser(const QString& firstName, const QString& lastNam
  */
 bool ClientDataBase::deleteUser(const QString& username){
     Logger& logger = Logger::getInstance();
-    QSqlQuery query(db);
+    QSqlQuery query(connection());
     query.prepare("DELETE FROM Users WHERE username = :username");
     query.bindValue(":username", username);
     if(!query.exec()){
@@ -99,8 +155,10 @@ bool ClientDataBase::deleteUser(const QString& username){
  * @return true, если пользователь существует, иначе false.
  */
 bool ClientDataBase::existsUser(const QString& username){
+    static MetricHistogram& latency = operationLatency("exists_user");
+    MetricHistogram::Timer timer(latency);
     Logger& logger = Logger::getInstance();
-    QSqlQuery query(db);
+    QSqlQuery query(connection());
     query.prepare("SELECT COUNT(*) FROM Users WHERE username = :username");
     query.bindValue(":username", username);
 
@@ -128,10 +186,14 @@ bool ClientDataBase::existsUser(const QString& username){
  * @return QMa.p
  */
 QMap<QString, QString> ClientDataBase::getUserData(const QString& username) const {
+    static MetricHistogram& latency = operationLatency("get_user");
+    MetricHistogram::Timer timer(latency);
+    Tracer::Span span("sqlite.get_user_data");
     QMap<QString, QString> userData;
     Logger& logger = Logger::getInstance();
-    QSqlQuery query(db);
-    query.prepare("SELECT id, first_name, last_name, username, salt, password_hash, role, created_time FROM Users WHERE username = :username");
+    QSqlQuery query(connection());
+    query.prepare("SELECT id, first_name, last_name, username, salt, password_hash, role, created_time, token_generation "
+                  "FROM Users WHERE username = :username");
     query.bindValue(":username", username);
 
     if (!query.exec()) {
@@ -149,12 +211,70 @@ QMap<QString, QString> ClientDataBase::getUserData(const QString& username) cons
         userData["salt"] = query.value("salt").toString();
         userData["role"] = query.value("role").toString();
         userData["created_time"] = query.value("created_time").toString();
+        userData["token_generation"] = query.value("token_generation").toString();
     }
 
     return userData;
 }
 
 
+/**
+ * @brief Возвращает поколение токенов сессии пользователя.
+ * Действителен только токен, выданный с текущим поколением.
+ * @param username Логин пользователя.
+ * @return Поколение или -1, если пользователь не найден или запрос не выполнен.
+ */
+qint64 ClientDataBase::tokenGeneration(const QString& username) const {
+    QSqlQuery query(connection());
+    query.prepare("SELECT token_generation FROM Users WHERE username = :username");
+    query.bindValue(":username", username);
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка чтения поколения токенов '%1': %2")
+                                                    .arg(username).arg(query.lastError().text()));
+        return -1;
+    }
+    return query.next() ? query.value(0).toLongLong() : -1;
+}
+
+/**
+ * @brief Переводит пользователя на следующее поколение токенов, если текущее
+ * равно expected. Проверка и увеличение - один запрос, поэтому один токен
+ * нельзя обменять на новый дважды, даже присылая его параллельно.
+ * @param username Логин пользователя.
+ * @param expected Поколение предъявленного токена.
+ * @return true, если поколение совпало и увеличено.
+ */
+bool ClientDataBase::advanceTokenGeneration(const QString& username, qint64 expected) {
+    QSqlQuery query(connection());
+    query.prepare("UPDATE Users SET token_generation = token_generation + 1 "
+                  "WHERE username = :username AND token_generation = :expected");
+    query.bindValue(":username", username);
+    query.bindValue(":expected", expected);
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка смены поколения токенов '%1': %2")
+                                                    .arg(username).arg(query.lastError().text()));
+        return false;
+    }
+    return query.numRowsAffected() == 1;
+}
+
+/**
+ * @brief Отзывает все выданные пользователю токены сессии.
+ * @param username Логин пользователя.
+ * @return true, если поколение увеличено.
+ */
+bool ClientDataBase::revokeTokens(const QString& username) {
+    QSqlQuery query(connection());
+    query.prepare("UPDATE Users SET token_generation = token_generation + 1 WHERE username = :username");
+    query.bindValue(":username", username);
+    if (!query.exec()) {
+        Logger::getInstance().log(QtWarningMsg, QString("Ошибка отзыва токенов '%1': %2")
+                                                    .arg(username).arg(query.lastError().text()));
+        return false;
+    }
+    return query.numRowsAffected() == 1;
+}
+
 bool ClientDataBase::isOpen() const {
     return db.isOpen();
 }
@@ -14,17 +14,29 @@ private:
 
 QSqlDatabase db;
 
+    QSqlDatabase connection() const; /*соединение для текущего потока*/
+
 public:
+    enum class CreateResult {
+        Created,       /*пользователь добавлен*/
+        UsernameTaken, /*логин уже занят*/
+        Error          /*ошибка базы данных*/
+    };
+
     ClientDataBase(const QString& path, QObject* parent = nullptr);
     ~ClientDataBase();
 
-    bool createUser(const QString& firstName, const QString& lastName, const QString& username,const QString& password_hash ,const QString& salt );
+    CreateResult createUser(const QString& firstName, const QString& lastName, const QString& username,const QString& password_hash ,const QString& salt );
     bool deleteUser(const QString& username);
     bool existsUser(const QString& username);
     bool isOpen() const;
 
     QMap<QString, QString> getUserData(const QString& username) const; /*получаем данные пользователя*/
 
+    qint64 tokenGeneration(const QString& username) const; /*поколение токенов сессии, -1 - нет пользователя*/
+    bool advanceTokenGeneration(const QString& username, qint64 expected); /*отзывает токены поколения expected*/
+    bool revokeTokens(const QString& username); /*отзывает все выданные токены*/
+
 };
 
 #endif // CLIENTDATABASE_H
@@ -0,0 +1,77 @@
+#include "ConnectionSlab.h"
+
+ConnectionSlab::Slot* ConnectionSlab::slotAt(quint32 index) const {
+    return &chunks[index / ChunkSize][index % ChunkSize];
+}
+
+/**
+ * @brief Находит ячейку записи по номеру, сохраненному в ее id.
+ */
+ConnectionSlab::Slot* ConnectionSlab::slotOf(ClientConnection* connection) const {
+    const quint32 index = static_cast<quint32>(connection->id & 0xffffffffu) - 1;
+    return slotAt(index);
+}
+
+/**
+ * @brief Выделяет запись для нового соединения.
+ * @return Запись с новым id и значениями по умолчанию.
+ */
+ClientConnection* ConnectionSlab::acquire() {
+    if (freeSlots.empty()) {
+        chunks.emplace_back(new Slot[ChunkSize]);
+        for (quint32 i = ChunkSize; i > 0; --i) {
+            freeSlots.push_back(capacity + i - 1);
+        }
+        capacity += ChunkSize;
+    }
+
+    const quint32 index = freeSlots.back();
+    freeSlots.pop_back();
+
+    Slot* slot = slotAt(index);
+    slot->connection = ClientConnection();
+    slot->connection.id = (static_cast<quint64>(slot->generation) << 32) | (index + 1);
+    slot->liveIndex = static_cast<int>(live.size());
+    live.push_back(&slot->connection);
+    return &slot->connection;
+}
+
+/**
+ * @brief Возвращает запись в пул.
+ * Поколение ячейки увеличивается, поэтому старый id перестает находиться.
+ * Буферы освобождаются сразу, чтобы простаивающая ячейка не держала память.
+ */
+void ConnectionSlab::release(ClientConnection* connection) {
+    Slot* slot = slotOf(connection);
+    if (slot->liveIndex < 0) {
+        return;
+    }
+
+    ClientConnection* moved = live.back();
+    live[slot->liveIndex] = moved;
+    slotOf(moved)->liveIndex = slot->liveIndex;
+    live.pop_back();
+
+    slot->liveIndex = -1;
+    ++slot->generation;
+    const quint32 index = static_cast<quint32>(connection->id & 0xffffffffu) - 1;
+    slot->connection = ClientConnection();
+    freeSlots.push_back(index);
+}
+
+/**
+ * @brief Ищет запись по id.
+ * @param id Идентификатор соединения.
+ * @return Запись или nullptr, если соединение уже закрыто и запись возвращена в пул.
+ */
+ClientConnection* ConnectionSlab::find(quint64 id) const {
+    const quint32 index = static_cast<quint32>(id & 0xffffffffu);
+    if (index == 0 || index > capacity) {
+        return nullptr;
+    }
+    Slot* slot = slotAt(index - 1);
+    if (slot->liveIndex < 0 || slot->generation != static_cast<quint32>(id >> 32)) {
+        return nullptr;
+    }
+    return &slot->connection;
+}
@@ -0,0 +1,45 @@
+#ifndef CONNECTIONSLAB_H
+#define CONNECTIONSLAB_H
+
+#include <QtGlobal>
+#include <memory>
+#include <vector>
+#include "ClientConnection.h"
+
+/**
+ * @brief Класс ConnectionSlab - пул записей ClientConnection.
+ *
+ * Записи выделяются блоками по ChunkSize и не перемещаются, освобожденные
+ * записи переиспользуются. Идентификатор записи содержит номер ячейки и
+ * поколение, поэтому поиск по id выполняется за O(1) без хэш-таблицы и не
+ * находит запись, которую успели отдать другому соединению.
+ * Открытые соединения дополнительно собраны в плотный массив для рассылки.
+ */
+class ConnectionSlab {
+public:
+    static constexpr int ChunkSize = 1024;
+
+    ClientConnection* acquire();
+    void release(ClientConnection* connection);
+    ClientConnection* find(quint64 id) const;
+
+    const std::vector<ClientConnection*>& active() const { return live; }
+    int size() const { return static_cast<int>(live.size()); }
+
+private:
+    struct Slot {
+        ClientConnection connection;
+        quint32 generation = 1;
+        int liveIndex = -1;       /* позиция в live, -1 - ячейка свободна*/
+    };
+
+    Slot* slotAt(quint32 index) const;
+    Slot* slotOf(ClientConnection* connection) const;
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<quint32> freeSlots;
+    std::vector<ClientConnection*> live;
+    quint32 capacity = 0;
+};
+
+#endif // CONNECTIONSLAB_H
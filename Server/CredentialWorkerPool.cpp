@@ -0,0 +1,127 @@
+#include "CredentialWorkerPool.h"
+#include "SecurityUtils.h"
+#include "logger.h"
+
+/**
+ * @brief Конструктор класса CredentialWorkerPool.
+ * Потоки пула не завершаются по простою, так как каждый из них держит
+ * собственное соединение с базой пользователей.
+ * @param db Указатель на базу данных клиентов.
+ * @param maxThreads Максимальное число рабочих потоков.
+ * @param maxPending Максимальное число задач в очереди.
+ * @param parent Родительский объект.
+ */
+CredentialWorkerPool::CredentialWorkerPool(ClientDataBase* db, int maxThreads, int maxPending, QObject* parent)
+    : QObject(parent), clientDataBase(db), pending(0), maxPending(maxPending),
+      queueDepth(Metrics::getInstance().gauge("messenger_queue_depth", "Jobs waiting in a worker queue",
+                                              Metrics::label("queue", "credentials"))) {
+    pool.setMaxThreadCount(qMax(1, maxThreads));
+    pool.setExpiryTimeout(-1);
+    Logger::getInstance().log(QtInfoMsg, QString("Пул обработки учетных данных: %1 потоков, очередь до %2 задач")
+                                             .arg(pool.maxThreadCount()).arg(maxPending));
+}
+
+/**
+ * @brief Деструктор класса CredentialWorkerPool.
+ * Отменяет задачи, которые еще не начались, и дожидается выполняющихся.
+ */
+CredentialWorkerPool::~CredentialWorkerPool() {
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief Регистрирует пользователя в рабочем потоке.
+ * Генерирует соль, хэширует пароль и создает запись в базе данных;
+ * занятость логина определяется самой вставкой.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param done Вызывается в потоке пула с итогом регистрации.
+ * @return false, если очередь переполнена.
+ */
+bool CredentialWorkerPool::submitRegister(QObject* context, const QString& firstName, const QString& lastName,
+                                          const QString& username, const QString& password,
+                                          std::function<void(RegisterStatus)> done) {
+    ClientDataBase* db = clientDataBase;
+    return submit<RegisterStatus>(context, [db, firstName, lastName, username, password]() {
+        QString salt = SecurityUtils::generateSalt(16);
+        QString hash = SecurityUtils::hashPassword(password, salt);
+        switch (db->createUser(firstName, lastName, username, hash, salt)) {
+        case ClientDataBase::CreateResult::Created:
+            return RegisterStatus::Created;
+        case ClientDataBase::CreateResult::UsernameTaken:
+            return RegisterStatus::UsernameTaken;
+        case ClientDataBase::CreateResult::Error:
+            break;
+        }
+        return RegisterStatus::DatabaseError;
+    }, std::move(done));
+}
+
+/**
+ * @brief Получает соль пользователя в рабочем потоке.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param username Логин пользователя.
+ * @param done Вызывается с солью или пустой строкой, если пользователь не найден.
+ * @return false, если очередь переполнена.
+ */
+bool CredentialWorkerPool::submitSaltLookup(QObject* context, const QString& username,
+                                            std::function<void(const QString&)> done) {
+    ClientDataBase* db = clientDataBase;
+    return submit<QString>(context, [db, username]() {
+        return db->getUserData(username).value("salt");
+    }, [done = std::move(done)](QString salt) { done(salt); });
+}
+
+/**
+ * @brief Сверяет присланный хэш пароля с хэшем из базы в рабочем потоке.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param username Логин пользователя.
+ * @param passwordHash Хэш пароля, присланный клиентом.
+ * @param done Вызывается с поколением токенов пользователя для выдачи токена
+ * или с -1, если хэш не совпал.
+ * @return false, если очередь переполнена.
+ */
+bool CredentialWorkerPool::submitVerify(QObject* context, const QString& username, const QString& passwordHash,
+                                        std::function<void(qint64)> done) {
+    ClientDataBase* db = clientDataBase;
+    return submit<qint64>(context, [db, username, passwordHash]() -> qint64 {
+        const QMap<QString, QString> user = db->getUserData(username);
+        const QString hash = user.value("password_hash");
+        if (hash.isEmpty() || hash != passwordHash) {
+            return -1;
+        }
+        return user.value("token_generation").toLongLong();
+    }, std::move(done));
+}
+
+/**
+ * @brief Обменивает токен поколения generation на следующее поколение
+ * в рабочем потоке; все токены прежнего поколения перестают действовать.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param username Логин пользователя.
+ * @param generation Поколение предъявленного токена.
+ * @param done Вызывается с true, если токен был действующим.
+ * @return false, если очередь переполнена.
+ */
+bool CredentialWorkerPool::submitTokenRotation(QObject* context, const QString& username, qint64 generation,
+                                               std::function<void(bool)> done) {
+    ClientDataBase* db = clientDataBase;
+    return submit<bool>(context, [db, username, generation]() {
+        return db->advanceTokenGeneration(username, generation);
+    }, std::move(done));
+}
+
+/**
+ * @brief Отзывает все токены сессии пользователя в рабочем потоке.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param username Логин пользователя.
+ * @param done Вызывается с результатом отзыва.
+ * @return false, если очередь переполнена.
+ */
+bool CredentialWorkerPool::submitTokenRevocation(QObject* context, const QString& username,
+                                                 std::function<void(bool)> done) {
+    ClientDataBase* db = clientDataBase;
+    return submit<bool>(context, [db, username]() {
+        return db->revokeTokens(username);
+    }, std::move(done));
+}
@@ -0,0 +1,95 @@
+#ifndef CREDENTIALWORKERPOOL_H
+#define CREDENTIALWORKERPOOL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QPointer>
+#include <QAtomicInt>
+#include <QString>
+#include <functional>
+#include "ClientDataBase.h"
+#include "Metrics.h"
+
+/**
+ * @brief Класс CredentialWorkerPool - пул потоков для работы с учетными данными.
+ *
+ * Генерация соли, хэширование пароля и SQL-запросы к базе пользователей
+ * выполняются вне цикла событий, чтобы всплеск регистраций не останавливал
+ * доставку сообщений остальным клиентам. Результат каждой задачи
+ * возвращается в поток, которому принадлежит пул (поток соединений).
+ * Если объект-контекст (обычно обработчик пакетов) удален до завершения
+ * задачи, результат отбрасывается.
+ */
+class CredentialWorkerPool : public QObject {
+    Q_OBJECT
+
+public:
+    enum class RegisterStatus {
+        Created,       /*пользователь создан*/
+        UsernameTaken, /*логин уже занят*/
+        DatabaseError  /*ошибка при записи в БД*/
+    };
+
+    /**
+     * @brief Конструктор класса CredentialWorkerPool.
+     * @param db Указатель на базу данных клиентов.
+     * @param maxThreads Максимальное число рабочих потоков.
+     * @param maxPending Максимальное число задач в очереди.
+     * @param parent Родительский объект.
+     */
+    CredentialWorkerPool(ClientDataBase* db, int maxThreads, int maxPending, QObject* parent = nullptr);
+    ~CredentialWorkerPool();
+
+    bool submitRegister(QObject* context, const QString& firstName, const QString& lastName,
+                        const QString& username, const QString& password,
+                        std::function<void(RegisterStatus)> done);
+    bool submitSaltLookup(QObject* context, const QString& username,
+                          std::function<void(const QString& salt)> done);
+    bool submitVerify(QObject* context, const QString& username, const QString& passwordHash,
+                      std::function<void(qint64 tokenGeneration)> done);
+    bool submitTokenRotation(QObject* context, const QString& username, qint64 generation,
+                             std::function<void(bool)> done);
+    bool submitTokenRevocation(QObject* context, const QString& username, std::function<void(bool)> done);
+
+    int pendingJobs() const { return pending.loadRelaxed(); }
+
+private:
+    template <typename Result>
+    bool submit(QObject* context, std::function<Result()> job, std::function<void(Result)> done);
+
+    ClientDataBase* clientDataBase;
+    QThreadPool pool;
+    QAtomicInt pending;
+    int maxPending;
+    MetricGauge& queueDepth; /* pending в реестре метрик*/
+};
+
+/**
+ * @brief Ставит задачу в очередь пула.
+ * Задача выполняется в рабочем потоке, а функция done вызывается в потоке пула
+ * только если context к этому моменту еще существует.
+ * @return false, если очередь переполнена и задача отклонена.
+ */
+template <typename Result>
+bool CredentialWorkerPool::submit(QObject* context, std::function<Result()> job, std::function<void(Result)> done) {
+    if (pending.fetchAndAddRelaxed(1) >= maxPending) {
+        pending.fetchAndAddRelaxed(-1);
+        return false;
+    }
+    queueDepth.add(1);
+
+    QPointer<QObject> guard(context);
+    pool.start([this, guard, job = std::move(job), done = std::move(done)]() {
+        Result result = job();
+        pending.fetchAndAddRelaxed(-1);
+        queueDepth.add(-1);
+        QMetaObject::invokeMethod(this, [guard, done, result]() {
+            if (guard) {
+                done(result);
+            }
+        }, Qt::QueuedConnection);
+    });
+    return true;
+}
+
+#endif // CREDENTIALWORKERPOOL_H
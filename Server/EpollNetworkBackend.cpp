@@ -0,0 +1,523 @@
+#include "EpollNetworkBackend.h"
+#include "logger.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <QMutexLocker>
+
+namespace {
+QString systemError() {
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+}
+
+EpollNetworkBackend::EpollNetworkBackend(ConnectionSlab& slab, QObject* parent)
+    : NetworkBackend(slab, parent) {}
+
+EpollNetworkBackend::~EpollNetworkBackend() {
+    for (ClientConnection* connection : slab.active()) {
+        if (connection->fd >= 0) {
+            ::close(connection->fd);
+            connection->fd = -1;
+        }
+    }
+    close();
+    notifier.reset();
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+    }
+    if (epollFd >= 0) {
+        ::close(epollFd);
+    }
+}
+
+/**
+ * @brief Создает слушающий сокет.
+ * QHostAddress::Any слушает IPv6 и IPv4 одним сокетом, как QTcpServer.
+ * @param reusePort Разрешить другим сокетам слушать тот же порт (SO_REUSEPORT).
+ * @param blocking Блокирующий сокет для потока приема.
+ * @return Дескриптор или -1, текст ошибки сохраняется в lastError.
+ */
+int EpollNetworkBackend::openListener(const QHostAddress& address, quint16 port, bool reusePort, bool blocking) {
+    sockaddr_storage storage;
+    std::memset(&storage, 0, sizeof(storage));
+    socklen_t length = 0;
+    bool dualStack = false;
+
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        auto* in = reinterpret_cast<sockaddr_in*>(&storage);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        in->sin_addr.s_addr = htonl(address.toIPv4Address());
+        length = sizeof(sockaddr_in);
+    } else {
+        auto* in6 = reinterpret_cast<sockaddr_in6*>(&storage);
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        dualStack = address == QHostAddress(QHostAddress::Any);
+        if (dualStack) {
+            in6->sin6_addr = in6addr_any;
+        } else {
+            Q_IPV6ADDR raw = address.toIPv6Address();
+            std::memcpy(&in6->sin6_addr, &raw, sizeof(raw));
+        }
+        length = sizeof(sockaddr_in6);
+    }
+
+    int fd = ::socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC | (blocking ? 0 : SOCK_NONBLOCK), 0);
+    if (fd < 0) {
+        lastError = systemError();
+        return -1;
+    }
+    int one = 1;
+    int zero = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (reusePort) {
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+    if (dualStack) {
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0 || ::listen(fd, listenBacklog) < 0) {
+        lastError = systemError();
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Открывает слушающие сокеты и дескриптор epoll.
+ * С одним потоком приема слушающий сокет добавляется в epoll сервера,
+ * иначе запускаются потоки приема, а в epoll добавляется eventfd очереди.
+ * @return false при ошибке, текст ошибки доступен через errorString().
+ */
+bool EpollNetworkBackend::listen(const QHostAddress& address, quint16 port) {
+    if (epollFd < 0) {
+        epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    }
+    if (epollFd < 0) {
+        lastError = systemError();
+        return false;
+    }
+
+    /*data.ptr указывает на поле с дескриптором для служебных событий
+     *и на запись ClientConnection для событий соединений*/
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET;
+
+    if (acceptorCount <= 1) {
+        listenFd = openListener(address, port, false, false);
+        if (listenFd < 0) {
+            return false;
+        }
+        event.data.ptr = &listenFd;
+        if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) < 0) {
+            lastError = systemError();
+            close();
+            return false;
+        }
+    } else {
+        if (wakeFd < 0) {
+            wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            event.data.ptr = &wakeFd;
+            if (wakeFd < 0 || ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) < 0) {
+                lastError = systemError();
+                return false;
+            }
+        }
+        for (int i = 0; i < acceptorCount; ++i) {
+            int fd = openListener(address, port, true, true);
+            if (fd < 0) {
+                close();
+                return false;
+            }
+            acceptorFds.push_back(fd);
+        }
+        for (int fd : acceptorFds) {
+            acceptors.emplace_back(QThread::create([this, fd]() { acceptLoop(fd); }));
+            acceptors.back()->start();
+        }
+        Logger::getInstance().log(QtInfoMsg, QString("Запущено потоков приема подключений: %1").arg(acceptorCount));
+    }
+
+    if (!notifier) {
+        notifier = std::make_unique<QSocketNotifier>(epollFd, QSocketNotifier::Read);
+        connect(notifier.get(), &QSocketNotifier::activated, this, &EpollNetworkBackend::onEpollReady);
+    }
+    return true;
+}
+
+/**
+ * @brief Закрывает слушающие сокеты и останавливает потоки приема.
+ * Принятые соединения остаются открытыми, а еще не переданные
+ * в поток сервера закрываются.
+ */
+void EpollNetworkBackend::close() {
+    if (listenFd >= 0) {
+        if (epollFd >= 0) {
+            ::epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, nullptr);
+        }
+        ::close(listenFd);
+        listenFd = -1;
+    }
+
+    /*shutdown() прерывает блокирующий accept() в потоке приема*/
+    for (int fd : acceptorFds) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+    for (auto& thread : acceptors) {
+        thread->wait();
+    }
+    acceptors.clear();
+    for (int fd : acceptorFds) {
+        ::close(fd);
+    }
+    acceptorFds.clear();
+
+    QMutexLocker locker(&acceptedMutex);
+    for (const AcceptedSocket& accepted : acceptedQueue) {
+        ::close(accepted.fd);
+    }
+    acceptedQueue.clear();
+}
+
+/**
+ * @brief Цикл потока приема: принимает подключения и ставит их в очередь.
+ * Поток сервера будится через eventfd, только когда очередь была пуста.
+ * @param fd Блокирующий слушающий сокет этого потока.
+ */
+void EpollNetworkBackend::acceptLoop(int fd) {
+    while (true) {
+        sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        int client = ::accept4(fd, reinterpret_cast<sockaddr*>(&peer), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                /*исчерпаны дескрипторы или память: подключения ждут в очереди ядра*/
+                QThread::msleep(50);
+                continue;
+            }
+            return; /*сокет закрыт через shutdown()*/
+        }
+
+        AcceptedSocket accepted;
+        accepted.fd = client;
+        accepted.address = QHostAddress(reinterpret_cast<sockaddr*>(&peer));
+        accepted.port = peer.ss_family == AF_INET6
+            ? ntohs(reinterpret_cast<sockaddr_in6*>(&peer)->sin6_port)
+            : ntohs(reinterpret_cast<sockaddr_in*>(&peer)->sin_port);
+
+        bool wasEmpty;
+        {
+            QMutexLocker locker(&acceptedMutex);
+            wasEmpty = acceptedQueue.empty();
+            acceptedQueue.push_back(std::move(accepted));
+        }
+        if (wasEmpty) {
+            quint64 one = 1;
+            ssize_t written = ::write(wakeFd, &one, sizeof(one));
+            Q_UNUSED(written);
+        }
+    }
+}
+
+/**
+ * @brief Разбирает готовые события epoll.
+ * Запись закрытого соединения возвращается в пул только из цикла событий,
+ * после выхода из этой функции, поэтому указатели в уже полученных
+ * событиях не могут указывать на соединение, принятое позже.
+ */
+void EpollNetworkBackend::onEpollReady() {
+    epoll_event events[MaxEvents];
+    while (true) {
+        int count = ::epoll_wait(epollFd, events, MaxEvents, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::getInstance().log(QtCriticalMsg, QString("Ошибка epoll_wait: %1").arg(systemError()));
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.ptr == &listenFd) {
+                acceptPending();
+                continue;
+            }
+            if (events[i].data.ptr == &wakeFd) {
+                quint64 counter;
+                while (::read(wakeFd, &counter, sizeof(counter)) > 0) {}
+                acceptQueued();
+                continue;
+            }
+            auto* connection = static_cast<ClientConnection*>(events[i].data.ptr);
+            const quint32 flags = events[i].events;
+            if (!connection->open) {
+                continue;
+            }
+            if (flags & EPOLLERR) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                ::getsockopt(connection->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                shutdown(connection, QString::fromLocal8Bit(std::strerror(error)));
+                continue;
+            }
+            if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                readAvailable(connection);
+            }
+            if (connection->open && (flags & EPOLLOUT) && !connection->writeBuffer.isEmpty()) {
+                flush(connection);
+            }
+        }
+
+        if (count < MaxEvents) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Принимает ожидающие подключения, не больше acceptBatch за вызов.
+ * Слушающий сокет работает в режиме edge-triggered, поэтому если пачка
+ * кончилась раньше очереди, продолжение планируется в цикле событий.
+ */
+void EpollNetworkBackend::acceptPending() {
+    if (listenFd < 0) {
+        return;
+    }
+    for (int count = 0; count < acceptBatch; ++count) {
+        sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        int fd = ::accept4(listenFd, reinterpret_cast<sockaddr*>(&peer), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                Logger::getInstance().log(QtWarningMsg, QString("Не удалось принять подключение: %1").arg(systemError()));
+            }
+            return;
+        }
+        registerConnection(fd, QHostAddress(reinterpret_cast<sockaddr*>(&peer)),
+                           peer.ss_family == AF_INET6
+                               ? ntohs(reinterpret_cast<sockaddr_in6*>(&peer)->sin6_port)
+                               : ntohs(reinterpret_cast<sockaddr_in*>(&peer)->sin_port));
+    }
+    scheduleAccept();
+}
+
+/**
+ * @brief Регистрирует подключения, принятые потоками приема,
+ * не больше acceptBatch за вызов.
+ */
+void EpollNetworkBackend::acceptQueued() {
+    std::vector<AcceptedSocket> batch;
+    bool more;
+    {
+        QMutexLocker locker(&acceptedMutex);
+        const size_t count = qMin(acceptedQueue.size(), static_cast<size_t>(acceptBatch));
+        batch.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch.push_back(std::move(acceptedQueue.front()));
+            acceptedQueue.pop_front();
+        }
+        more = !acceptedQueue.empty();
+    }
+
+    for (const AcceptedSocket& accepted : batch) {
+        registerConnection(accepted.fd, accepted.address, accepted.port);
+    }
+    if (more) {
+        scheduleAccept();
+    }
+}
+
+/**
+ * @brief Планирует следующую пачку приема после уже готовых событий.
+ */
+void EpollNetworkBackend::scheduleAccept() {
+    if (acceptScheduled) {
+        return;
+    }
+    acceptScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        acceptScheduled = false;
+        acceptPending();
+        acceptQueued();
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Добавляет принятый сокет в epoll и создает запись соединения.
+ */
+void EpollNetworkBackend::registerConnection(int fd, const QHostAddress& address, quint16 port) {
+    /*оборванные соединения клиентов без Ping закрывает TCP keepalive*/
+    const int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+
+    ClientConnection* connection = acquireConnection();
+    connection->fd = fd;
+    connection->address = address;
+    connection->port = port;
+
+    /*EPOLLOUT в режиме edge-triggered срабатывает, только когда
+     *переполненный буфер сокета освобождается, поэтому подписка постоянная*/
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = connection;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        Logger::getInstance().log(QtWarningMsg, QString("Не удалось добавить сокет в epoll: %1").arg(systemError()));
+        ::close(fd);
+        slab.release(connection);
+        return;
+    }
+
+    connection->open = true;
+    emit accepted(connection);
+}
+
+/**
+ * @brief Дочитывает сокет до EAGAIN.
+ * Данные передаются ManagerNetwork после каждого блока, чтобы полные кадры
+ * разбирались сразу и буфер соединения не рос на весь объем сокета.
+ */
+void EpollNetworkBackend::readAvailable(ClientConnection* connection) {
+    char chunk[ReadChunk];
+    while (true) {
+        ssize_t n = ::recv(connection->fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            connection->readBuffer.append(chunk, n);
+            emit readyRead(connection);
+            if (!connection->open) {
+                return;
+            }
+            continue;
+        }
+        if (n == 0) {
+            shutdown(connection, "Клиент закрыл соединение");
+            return;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            shutdown(connection, systemError());
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Отправляет накопленный хвост исходящих данных.
+ * @return false, если соединение закрыто из-за ошибки.
+ */
+bool EpollNetworkBackend::flush(ClientConnection* connection) {
+    while (connection->writeOffset < connection->writeBuffer.size()) {
+        ssize_t n = ::send(connection->fd, connection->writeBuffer.constData() + connection->writeOffset,
+                           connection->writeBuffer.size() - connection->writeOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            connection->writeOffset += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        shutdown(connection, systemError());
+        return false;
+    }
+
+    connection->writeBuffer = QByteArray();
+    connection->writeOffset = 0;
+    if (connection->closeWhenFlushed) {
+        shutdown(connection, QString());
+    }
+    return true;
+}
+
+/**
+ * @brief Отправляет данные клиенту.
+ * Пока буфер сокета свободен, данные уходят сразу без копирования;
+ * остаток копится в writeBuffer до события EPOLLOUT.
+ */
+void EpollNetworkBackend::write(ClientConnection* connection, const QByteArray& data) {
+    if (!connection->open || connection->closeWhenFlushed || data.isEmpty()) {
+        return;
+    }
+
+    if (!connection->writeBuffer.isEmpty()) {
+        if (connection->writeBuffer.size() - connection->writeOffset + data.size() > MaxWriteBuffer) {
+            shutdown(connection, "Клиент не успевает принимать данные");
+            return;
+        }
+        connection->writeBuffer.append(data);
+        return;
+    }
+
+    qsizetype sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(connection->fd, data.constData() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        shutdown(connection, systemError());
+        return;
+    }
+
+    if (sent < data.size()) {
+        connection->writeBuffer = data.mid(sent);
+        connection->writeOffset = 0;
+    }
+}
+
+/**
+ * @brief Закрывает соединение.
+ * При graceful данные из writeBuffer сначала отправляются клиенту.
+ */
+void EpollNetworkBackend::closeConnection(ClientConnection* connection, bool graceful) {
+    if (!connection->open) {
+        return;
+    }
+    if (graceful && !connection->writeBuffer.isEmpty()) {
+        connection->closeWhenFlushed = true;
+        return;
+    }
+    shutdown(connection, QString());
+}
+
+/**
+ * @brief Снимает сокет с epoll, закрывает его и сообщает об этом.
+ */
+void EpollNetworkBackend::shutdown(ClientConnection* connection, const QString& reason) {
+    if (!connection->open) {
+        return;
+    }
+    connection->open = false;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    connection->fd = -1;
+    connection->writeBuffer = QByteArray();
+    connection->writeOffset = 0;
+    emit closed(connection, reason);
+}
@@ -0,0 +1,80 @@
+#ifndef EPOLLNETWORKBACKEND_H
+#define EPOLLNETWORKBACKEND_H
+
+#include "NetworkBackend.h"
+#include <QSocketNotifier>
+#include <QThread>
+#include <QMutex>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Класс EpollNetworkBackend - транспорт на неблокирующих сокетах и epoll.
+ *
+ * Соединение - только дескриптор и запись ClientConnection: без QObject,
+ * соединений сигналов и буферов QTcpSocket. Все сокеты зарегистрированы
+ * в одном epoll в режиме edge-triggered, а в цикл событий Qt встроен
+ * единственный QSocketNotifier на дескриптор epoll. Поэтому каждое событие
+ * дочитывает и дописывает сокет до EAGAIN.
+ *
+ * При acceptorCount > 1 порт слушают несколько сокетов с SO_REUSEPORT,
+ * каждый в своем потоке приема, и ядро распределяет между ними входящие
+ * подключения. Потоки только вызывают accept(): принятые дескрипторы
+ * передаются в поток сервера через очередь и eventfd, так как вся работа
+ * с соединениями однопоточная.
+ * Собирается только под Linux (MESSENGER_HAVE_EPOLL).
+ */
+class EpollNetworkBackend : public NetworkBackend {
+    Q_OBJECT
+
+public:
+    explicit EpollNetworkBackend(ConnectionSlab& slab, QObject* parent = nullptr);
+    ~EpollNetworkBackend();
+
+    bool listen(const QHostAddress& address, quint16 port) override;
+    void close() override;
+    bool isListening() const override { return listenFd >= 0 || !acceptors.empty(); }
+    QString errorString() const override { return lastError; }
+
+    void write(ClientConnection* connection, const QByteArray& data) override;
+    void closeConnection(ClientConnection* connection, bool graceful) override;
+
+    static constexpr int MaxEvents = 256;
+    static constexpr qsizetype ReadChunk = 64 * 1024;
+    static constexpr qsizetype MaxWriteBuffer = 16 * 1024 * 1024; /* медленный клиент отключается*/
+
+private slots:
+    void onEpollReady();
+
+private:
+    /* Подключение, принятое потоком приема*/
+    struct AcceptedSocket {
+        int fd;
+        QHostAddress address;
+        quint16 port;
+    };
+
+    int openListener(const QHostAddress& address, quint16 port, bool reusePort, bool blocking);
+    void acceptLoop(int fd);
+    void acceptPending();
+    void acceptQueued();
+    void scheduleAccept();
+    void registerConnection(int fd, const QHostAddress& address, quint16 port);
+    void readAvailable(ClientConnection* connection);
+    bool flush(ClientConnection* connection);
+    void shutdown(ClientConnection* connection, const QString& reason);
+
+    int epollFd = -1;
+    int listenFd = -1;                  /* слушающий сокет, если поток приема один*/
+    int wakeFd = -1;                    /* eventfd: в очереди есть принятые подключения*/
+    std::vector<int> acceptorFds;
+    std::vector<std::unique_ptr<QThread>> acceptors;
+    QMutex acceptedMutex;
+    std::deque<AcceptedSocket> acceptedQueue; /* защищена acceptedMutex*/
+    bool acceptScheduled = false;
+    std::unique_ptr<QSocketNotifier> notifier;
+    QString lastError;
+};
+
+#endif // EPOLLNETWORKBACKEND_H
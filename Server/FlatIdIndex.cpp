@@ -0,0 +1,128 @@
+#include "FlatIdIndex.h"
+
+/**
+ * @brief Конструктор класса FlatIdIndex.
+ */
+FlatIdIndex::FlatIdIndex() : entries(16) {}
+
+/**
+ * @brief Начальная позиция идентификатора в таблице.
+ * Мультипликативное хэширование (Фибоначчи) разносит по таблице
+ * идущие подряд идентификаторы из базы данных; позицией служат
+ * старшие биты произведения.
+ */
+size_t FlatIdIndex::home(quint32 id) const {
+    return static_cast<size_t>((id * 2654435769u) >> shift);
+}
+
+/**
+ * @brief Добавляет идентификатор или обновляет номер его ячейки.
+ * Таблица увеличивается вдвое при заполнении больше чем на 3/4.
+ * @param id Идентификатор (не 0).
+ * @param slot Номер ячейки в хранилище.
+ */
+void FlatIdIndex::insert(quint32 id, int slot) {
+    if (id == 0) {
+        return;
+    }
+    if ((count + 1) * 4 > static_cast<int>(entries.size()) * 3) {
+        rehash(entries.size() * 2);
+    }
+
+    const size_t mask = entries.size() - 1;
+    for (size_t i = home(id);; i = (i + 1) & mask) {
+        Entry& entry = entries[i];
+        if (entry.id == id) {
+            entry.slot = slot;
+            return;
+        }
+        if (entry.id == 0) {
+            entry.id = id;
+            entry.slot = slot;
+            ++count;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Ищет номер ячейки по идентификатору.
+ * @param id Идентификатор.
+ * @return Номер ячейки или -1, если идентификатор не найден.
+ */
+int FlatIdIndex::find(quint32 id) const {
+    if (id == 0) {
+        return -1;
+    }
+    const size_t mask = entries.size() - 1;
+    for (size_t i = home(id);; i = (i + 1) & mask) {
+        const Entry& entry = entries[i];
+        if (entry.id == id) {
+            return entry.slot;
+        }
+        if (entry.id == 0) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief Удаляет идентификатор из таблицы.
+ * Записи, стоящие за удаленной в той же цепочке, сдвигаются на ее место,
+ * если это не уводит их дальше их начальной позиции.
+ * @param id Идентификатор.
+ * @return true, если идентификатор был в таблице.
+ */
+bool FlatIdIndex::remove(quint32 id) {
+    if (id == 0) {
+        return false;
+    }
+    const size_t mask = entries.size() - 1;
+    size_t hole = home(id);
+    while (entries[hole].id != id) {
+        if (entries[hole].id == 0) {
+            return false;
+        }
+        hole = (hole + 1) & mask;
+    }
+
+    for (size_t i = (hole + 1) & mask; entries[i].id != 0; i = (i + 1) & mask) {
+        size_t desired = home(entries[i].id);
+        /*запись можно перенести в дыру, если дыра лежит между ее начальной позицией и текущей*/
+        if (((i - desired) & mask) >= ((i - hole) & mask)) {
+            entries[hole] = entries[i];
+            hole = i;
+        }
+    }
+    entries[hole] = Entry();
+    --count;
+    return true;
+}
+
+/**
+ * @brief Удаляет все записи.
+ */
+void FlatIdIndex::clear() {
+    entries.assign(16, Entry());
+    count = 0;
+    shift = 28;
+}
+
+/**
+ * @brief Перестраивает таблицу под новый размер.
+ * @param newCapacity Новый размер (степень двойки).
+ */
+void FlatIdIndex::rehash(size_t newCapacity) {
+    std::vector<Entry> old(newCapacity);
+    old.swap(entries);
+    count = 0;
+    shift = 32;
+    for (size_t size = newCapacity; size > 1; size >>= 1) {
+        --shift;
+    }
+    for (const Entry& entry : old) {
+        if (entry.id != 0) {
+            insert(entry.id, entry.slot);
+        }
+    }
+}
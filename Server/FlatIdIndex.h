@@ -0,0 +1,39 @@
+#ifndef FLATIDINDEX_H
+#define FLATIDINDEX_H
+
+#include <QtGlobal>
+#include <vector>
+
+/**
+ * @brief Класс FlatIdIndex - плоская хэш-таблица с открытой адресацией.
+ *
+ * Сопоставляет целочисленному идентификатору номер ячейки в хранилище.
+ * Записи лежат в одном массиве, коллизии разрешаются линейным пробированием,
+ * а при удалении последующие записи цепочки сдвигаются назад, поэтому
+ * надгробия не нужны. Идентификатор 0 зарезервирован под пустую запись.
+ */
+class FlatIdIndex {
+public:
+    FlatIdIndex();
+
+    void insert(quint32 id, int slot);
+    int find(quint32 id) const;
+    bool remove(quint32 id);
+    void clear();
+    int size() const { return count; }
+
+private:
+    struct Entry {
+        quint32 id = 0;  /*0 - пустая запись*/
+        int slot = -1;
+    };
+
+    std::vector<Entry> entries; /*размер - степень двойки*/
+    int count = 0;
+    int shift = 28;             /*32 - log2(размер таблицы)*/
+
+    size_t home(quint32 id) const;
+    void rehash(size_t newCapacity);
+};
+
+#endif // FLATIDINDEX_H
@@ -0,0 +1,23 @@
+#pragma once
+#include <QByteArray>
+
+/**
+ * @brief FrameCompression - сжатие полезных данных кадра.
+ *
+ * Сжатые данные кадра начинаются с байта кодека, за которым идет
+ * результат сжатия. Базовый кодек - zlib (qCompress), доступный всегда;
+ * zstd доступен, если сборка выполнена с MESSENGER_WITH_ZSTD.
+ */
+namespace FrameCompression {
+    enum Codec : quint8 {
+        Zlib = 0x01,
+        Zstd = 0x02
+    };
+
+    constexpr int DefaultThreshold = 512; /*кадры с данными короче порога не сжимаются*/
+
+    quint8 supportedCodecs();
+    quint8 preferredCodec(quint8 codecs);
+    QByteArray compress(const QByteArray& data, quint8 codec);
+    bool decompress(const QByteArray& compressed, qint64 maxSize, QByteArray& data);
+}
@@ -0,0 +1,85 @@
+#include "IdempotencyCache.h"
+
+IdempotencyCache::IdempotencyCache(qint64 windowMs, int capacity)
+    : windowMs(windowMs), capacity(qMax(1, capacity)) {
+    clock.start();
+}
+
+/**
+ * @brief Составляет ключ таблицы. Ключи разных пользователей не пересекаются,
+ * поэтому клиент не может подобрать чужой ключ и подавить чужое сообщение.
+ * Имя пользователя должно браться из аутентификации соединения.
+ */
+QString IdempotencyCache::compose(const QString& username, const QString& key) {
+    return username + QChar(0x1f) + key;
+}
+
+/**
+ * @brief Ищет сообщение, ранее принятое с тем же ключом.
+ * @param username Отправитель.
+ * @param key Ключ отправки.
+ * @param entry Заполняется найденной записью.
+ * @return true, если сообщение с таким ключом уже сохранено.
+ */
+bool IdempotencyCache::find(const QString& username, const QString& key, Entry& entry) {
+    expire(clock.elapsed());
+    auto it = entries.constFind(compose(username, key));
+    if (it == entries.constEnd()) {
+        return false;
+    }
+    entry = it.value().entry;
+    return true;
+}
+
+/**
+ * @brief Запоминает номер сохраненного сообщения для ключа отправки.
+ * @param username Отправитель.
+ * @param key Ключ отправки.
+ * @param entry Чат и номер сообщения.
+ */
+void IdempotencyCache::insert(const QString& username, const QString& key, const Entry& entry) {
+    qint64 nowMs = clock.elapsed();
+    expire(nowMs);
+
+    QString composed = compose(username, key);
+    if (entries.contains(composed)) {
+        return;
+    }
+    while (entries.size() >= capacity && !order.isEmpty()) {
+        dropExpiring(order.dequeue());
+    }
+    entries.insert(composed, {entry, nowMs + windowMs});
+    order.enqueue(qMakePair(nowMs + windowMs, composed));
+}
+
+/**
+ * @brief Забывает ключ сообщения, которое не удалось сохранить,
+ * чтобы повторная отправка с тем же ключом была принята заново.
+ * Элемент очереди остается и при истечении ничего не удаляет.
+ * @param username Отправитель.
+ * @param key Ключ отправки.
+ */
+void IdempotencyCache::remove(const QString& username, const QString& key) {
+    entries.remove(compose(username, key));
+}
+
+/**
+ * @brief Удаляет запись, если она добавлена тем же элементом очереди,
+ * а не заново после remove().
+ */
+void IdempotencyCache::dropExpiring(const QPair<qint64, QString>& item) {
+    auto it = entries.find(item.second);
+    if (it != entries.end() && it.value().expiresMs == item.first) {
+        entries.erase(it);
+    }
+}
+
+/**
+ * @brief Удаляет ключи с истекшим сроком. Очередь упорядочена по времени
+ * добавления, а значит и по сроку, поэтому проверяется только ее начало.
+ */
+void IdempotencyCache::expire(qint64 nowMs) {
+    while (!order.isEmpty() && order.head().first <= nowMs) {
+        dropExpiring(order.dequeue());
+    }
+}
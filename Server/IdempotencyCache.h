@@ -0,0 +1,57 @@
+#ifndef IDEMPOTENCYCACHE_H
+#define IDEMPOTENCYCACHE_H
+
+#include <QHash>
+#include <QQueue>
+#include <QPair>
+#include <QString>
+#include <QElapsedTimer>
+
+/**
+ * @brief Класс IdempotencyCache - ключи недавно принятых сообщений.
+ *
+ * Клиент помечает каждое отправляемое сообщение случайным ключом и
+ * повторяет отправку с тем же ключом, если не дождался подтверждения.
+ * Для каждой пары (пользователь, ключ) кэш помнит, под каким номером
+ * сообщение сохранено, чтобы повтор не создавал второе сообщение.
+ * Ключи хранятся ограниченное время и в ограниченном количестве;
+ * устаревшие удаляются в порядке добавления.
+ */
+class IdempotencyCache {
+public:
+    struct Entry {
+        quint32 chatId = 0;
+        quint32 seq = 0;
+    };
+
+    /**
+     * @brief Конструктор класса IdempotencyCache.
+     * @param windowMs Время, в течение которого повтор распознается.
+     * @param capacity Максимальное число хранимых ключей.
+     */
+    explicit IdempotencyCache(qint64 windowMs = 10 * 60 * 1000, int capacity = 100000);
+
+    bool find(const QString& username, const QString& key, Entry& entry);
+    void insert(const QString& username, const QString& key, const Entry& entry);
+    void remove(const QString& username, const QString& key); /* Сообщение с ключом так и не сохранено*/
+    int size() const { return entries.size(); }
+
+private:
+    static QString compose(const QString& username, const QString& key);
+    void expire(qint64 nowMs);
+
+    struct Slot {
+        Entry entry;
+        qint64 expiresMs = 0; /*отличает запись от удаленной и добавленной заново с тем же ключом*/
+    };
+
+    void dropExpiring(const QPair<qint64, QString>& item);
+
+    QHash<QString, Slot> entries;
+    QQueue<QPair<qint64, QString>> order; /*(время истечения, ключ) в порядке добавления*/
+    qint64 windowMs;
+    int capacity;
+    QElapsedTimer clock;
+};
+
+#endif // IDEMPOTENCYCACHE_H
@@ -0,0 +1,98 @@
+#include "LocalNetworkBackend.h"
+#include "logger.h"
+
+LocalNetworkBackend::LocalNetworkBackend(ConnectionSlab& slab, const QString& serverName, QObject* parent)
+    : NetworkBackend(slab, parent), serverName(serverName) {
+    connect(&server, &QLocalServer::newConnection, this, &LocalNetworkBackend::onNewConnection);
+    /*подключаться может только пользователь, от имени которого запущен сервер*/
+    server.setSocketOptions(QLocalServer::UserAccessOption);
+}
+
+/**
+ * @brief Начинает прием локальных подключений.
+ * Файл сокета, оставшийся после аварийного завершения сервера,
+ * удаляется перед запуском, иначе listen() завершится ошибкой.
+ */
+bool LocalNetworkBackend::listen(const QHostAddress& address, quint16 port) {
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    QLocalServer::removeServer(serverName);
+    server.setMaxPendingConnections(listenBacklog);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    server.setListenBacklogSize(listenBacklog);
+#endif
+    return server.listen(serverName);
+}
+
+void LocalNetworkBackend::close() {
+    server.close();
+}
+
+/**
+ * @brief Принимает подключения и связывает сокеты с записями соединений.
+ * Как и у QtNetworkBackend, за вызов принимается не больше acceptBatch
+ * подключений, а обработчики сокета находят запись по id.
+ */
+void LocalNetworkBackend::onNewConnection() {
+    for (int count = 0; count < acceptBatch; ++count) {
+        QLocalSocket* socket = server.nextPendingConnection();
+        if (!socket) {
+            return;
+        }
+        ClientConnection* connection = acquireConnection();
+        connection->localSocket = socket;
+        connection->address = QHostAddress::LocalHost;
+        connection->port = 0;
+        connection->local = true;
+        connection->open = true;
+        const quint64 id = connection->id;
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket, id]() {
+            ClientConnection* connection = slab.find(id);
+            if (!connection || !connection->open) {
+                socket->readAll();
+                return;
+            }
+            connection->readBuffer.append(socket->readAll());
+            emit readyRead(connection);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket, id]() {
+            ClientConnection* connection = slab.find(id);
+            if (connection && connection->open) {
+                connection->open = false;
+                connection->localSocket = nullptr;
+                emit closed(connection, socket->error() == QLocalSocket::UnknownSocketError
+                                            ? QString() : socket->errorString());
+            }
+            socket->deleteLater();
+        });
+
+        emit accepted(connection);
+    }
+    if (server.hasPendingConnections()) {
+        QMetaObject::invokeMethod(this, &LocalNetworkBackend::onNewConnection, Qt::QueuedConnection);
+    }
+}
+
+void LocalNetworkBackend::write(ClientConnection* connection, const QByteArray& data) {
+    if (connection->localSocket && connection->localSocket->state() == QLocalSocket::ConnectedState) {
+        connection->localSocket->write(data);
+    }
+}
+
+/**
+ * @brief Закрывает соединение. Сигнал closed испускается из обработчика
+ * disconnected сокета, при abort() - синхронно.
+ */
+void LocalNetworkBackend::closeConnection(ClientConnection* connection, bool graceful) {
+    QLocalSocket* socket = connection->localSocket;
+    if (!socket) {
+        return;
+    }
+    if (graceful) {
+        socket->flush();
+        socket->disconnectFromServer();
+    } else {
+        socket->abort();
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef LOCALNETWORKBACKEND_H
+#define LOCALNETWORKBACKEND_H
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "NetworkBackend.h"
+
+/**
+ * @brief Класс LocalNetworkBackend - транспорт на QLocalServer и QLocalSocket.
+ * Для ботов и мостов на одной машине с сервером: сокет AF_UNIX под Unix
+ * и именованный канал под Windows, без стека TCP на loopback. Кадры,
+ * маршрутизация и проверка живости те же, что и у сетевых соединений.
+ * Локальные соединения получают адрес QHostAddress::LocalHost и порт 0;
+ * доступ к ним ограничивается правами на файл сокета.
+ */
+class LocalNetworkBackend : public NetworkBackend {
+    Q_OBJECT
+
+public:
+    LocalNetworkBackend(ConnectionSlab& slab, const QString& serverName, QObject* parent = nullptr);
+
+    /* Адрес и порт не используются: сервер слушает имя, заданное в конструкторе*/
+    bool listen(const QHostAddress& address, quint16 port) override;
+    void close() override;
+    bool isListening() const override { return server.isListening(); }
+    QString errorString() const override { return server.errorString(); }
+    QString fullServerName() const { return server.fullServerName(); }
+
+    void write(ClientConnection* connection, const QByteArray& data) override;
+    void closeConnection(ClientConnection* connection, bool graceful) override;
+
+private slots:
+    void onNewConnection();
+
+private:
+    QLocalServer server;
+    QString serverName;
+};
+
+#endif // LOCALNETWORKBACKEND_H
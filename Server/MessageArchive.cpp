@@ -0,0 +1,215 @@
+#include "MessageArchive.h"
+#include "ByteBuffer.h"
+#include "FrameCompression.h"
+#include "exception/ParsingException.h"
+#include "logger.h"
+#include <QDateTime>
+#include <QDir>
+#include <QtEndian>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const QByteArray Magic = "MSGARC";
+constexpr qint64 HeaderSize = 6 + 2 + 8;
+constexpr qint64 MaxBlockBytes = 256 * 1024 * 1024; /* защита от поврежденной длины*/
+
+void appendInt(QByteArray& out, quint32 value) {
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+void appendLong(QByteArray& out, qint64 value) {
+    char bytes[8];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 8);
+}
+
+void appendString(QByteArray& out, const QString& value) {
+    const QByteArray utf8 = value.toUtf8();
+    appendInt(out, quint32(utf8.size()));
+    out.append(utf8);
+}
+
+QString readString(ByteBuffer& buffer) {
+    const qint32 size = buffer.readIntLE();
+    if (size < 0 || quint32(size) > buffer.getAvailableBytes()) {
+        throw ParsingException("[archive] string out of bound");
+    }
+    return QString::fromUtf8(buffer.read(size));
+}
+
+/* Сбрасывает файл на диск: блок должен пережить сбой до удаления строк из базы*/
+bool syncFile(QFile& file) {
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+}
+
+/**
+ * @brief Открывает каталог архива и начинает новый сегмент.
+ * @param directory Каталог архива, создается при необходимости.
+ * @param maxSegmentBytes Размер, после которого начинается следующий сегмент, 0 - без ограничения.
+ * @return true, если сегмент создан.
+ */
+bool MessageArchive::open(const QString& directory, qint64 maxSegmentBytes) {
+    close();
+    this->directory = directory;
+    this->maxSegmentBytes = maxSegmentBytes;
+    if (!QDir().mkpath(directory)) {
+        error = QString("не удалось создать каталог %1").arg(directory);
+        return false;
+    }
+    return startSegment();
+}
+
+void MessageArchive::close() {
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+bool MessageArchive::startSegment() {
+    close();
+    const QString name = QString("messages-%1.seg")
+                             .arg(QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss-zzz"));
+    file.setFileName(QDir(directory).filePath(name));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        error = QString("%1: %2").arg(file.fileName(), file.errorString());
+        return false;
+    }
+    QByteArray header = Magic;
+    char version[2];
+    qToLittleEndian(FormatVersion, version);
+    header.append(version, 2);
+    appendLong(header, QDateTime::currentMSecsSinceEpoch());
+    written = file.write(header);
+    if (written != header.size()) {
+        error = QString("%1: %2").arg(file.fileName(), file.errorString());
+        file.close();
+        return false;
+    }
+    Logger::getInstance().log(QtInfoMsg, QString("Новый сегмент архива сообщений %1").arg(file.fileName()));
+    return true;
+}
+
+/**
+ * @brief Сжимает записи одним блоком, дописывает его и сбрасывает на диск.
+ * @param records Записи блока.
+ * @return true, если блок записан на диск.
+ */
+bool MessageArchive::append(const QList<Record>& records) {
+    if (!file.isOpen()) {
+        return false;
+    }
+    if (records.isEmpty()) {
+        return true;
+    }
+    if (maxSegmentBytes > 0 && written > HeaderSize && written >= maxSegmentBytes && !startSegment()) {
+        return false;
+    }
+
+    QByteArray raw;
+    for (const Record& record : records) {
+        appendString(raw, record.chatName);
+        appendInt(raw, record.seq);
+        appendString(raw, record.sender);
+        appendString(raw, record.firstName);
+        appendString(raw, record.lastName);
+        appendLong(raw, record.timestampMs);
+        appendString(raw, record.text);
+    }
+    const QByteArray compressed = FrameCompression::compress(
+        raw, FrameCompression::preferredCodec(FrameCompression::supportedCodecs()));
+    if (compressed.isEmpty()) {
+        error = "ошибка сжатия блока";
+        return false;
+    }
+
+    QByteArray block;
+    block.reserve(8 + compressed.size());
+    appendInt(block, quint32(compressed.size()));
+    appendInt(block, quint32(records.size()));
+    block.append(compressed);
+    if (file.write(block) != block.size() || !syncFile(file)) {
+        error = QString("%1: %2").arg(file.fileName(), file.errorString());
+        /*недописанный блок обрезается, чтобы сегмент остался читаемым*/
+        file.resize(written);
+        return false;
+    }
+    written += block.size();
+    return true;
+}
+
+/**
+ * @brief Открывает сегмент архива и проверяет заголовок.
+ */
+bool MessageArchive::Reader::open(const QString& path) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    const QByteArray header = file.read(HeaderSize);
+    if (header.size() != HeaderSize || !header.startsWith(Magic)) {
+        error = "файл не является сегментом архива";
+        return false;
+    }
+    const quint16 version = qFromLittleEndian<quint16>(header.constData() + Magic.size());
+    if (version != FormatVersion) {
+        error = QString("неподдерживаемая версия формата %1").arg(version);
+        return false;
+    }
+    createdMs = qFromLittleEndian<qint64>(header.constData() + Magic.size() + 2);
+    return true;
+}
+
+bool MessageArchive::Reader::next(QList<Record>& records) {
+    records.clear();
+    const QByteArray prefix = file.read(8);
+    if (prefix.isEmpty()) {
+        return false;
+    }
+    const quint32 length = qFromLittleEndian<quint32>(prefix.constData());
+    const quint32 count = qFromLittleEndian<quint32>(prefix.constData() + 4);
+    if (prefix.size() != 8 || length > MaxBlockBytes) {
+        error = "поврежденный блок";
+        return false;
+    }
+    const QByteArray compressed = file.read(length);
+    QByteArray raw;
+    if (compressed.size() != qint64(length) || !FrameCompression::decompress(compressed, MaxBlockBytes, raw)) {
+        error = "блок обрывается или не распаковывается";
+        return false;
+    }
+
+    ByteBuffer buffer(raw);
+    try {
+        for (quint32 i = 0; i < count; ++i) {
+            Record record;
+            record.chatName = readString(buffer);
+            record.seq = quint32(buffer.readIntLE());
+            record.sender = readString(buffer);
+            record.firstName = readString(buffer);
+            record.lastName = readString(buffer);
+            record.timestampMs = buffer.readLongLE();
+            record.text = readString(buffer);
+            records.append(record);
+        }
+    } catch (const ParsingException&) {
+        error = "поврежденная запись";
+        records.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef MESSAGEARCHIVE_H
+#define MESSAGEARCHIVE_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/**
+ * @brief Класс MessageArchive - сегменты архива сообщений, удаленных по сроку хранения.
+ *
+ * Архив - каталог с файлами messages-<время создания>.seg. Сегмент
+ * начинается с заголовка "MSGARC", версии формата (2 байта LE) и времени
+ * создания (8 байт LE, мс от эпохи). Дальше идут блоки:
+ * [длина 4 байта LE][число записей 4 байта LE][данные FrameCompression].
+ * Блок - одна пачка удаляемых сообщений, сжатая целиком (zstd, если сборка
+ * с MESSENGER_WITH_ZSTD, иначе zlib), поэтому сжатие видит много похожих
+ * записей сразу. Запись внутри блока: имя чата, номер, отправитель, имя,
+ * фамилия, время (мс от эпохи) и текст; строки - длина 4 байта LE и UTF-8.
+ * Новый сегмент начинается при каждом открытии и при превышении maxSegmentBytes.
+ *
+ * Блок дописывается и сбрасывается на диск до удаления строк из базы,
+ * поэтому при сбое между этими шагами сообщения могут попасть в архив
+ * дважды; читатель может отбрасывать повторы по (имя чата, номер).
+ */
+class MessageArchive {
+public:
+    struct Record {
+        QString chatName;
+        quint32 seq = 0;
+        QString sender;
+        QString firstName;
+        QString lastName;
+        qint64 timestampMs = 0;
+        QString text;
+    };
+
+    static constexpr quint16 FormatVersion = 1;
+
+    bool open(const QString& directory, qint64 maxSegmentBytes);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    QString errorString() const { return error; }
+    bool append(const QList<Record>& records); /* false - блок не записан, удалять строки нельзя*/
+
+    /* Последовательное чтение одного сегмента*/
+    class Reader {
+    public:
+        bool open(const QString& path);
+        bool next(QList<Record>& records); /* false - конец файла или поврежденный блок*/
+        QString errorString() const { return error; }
+        qint64 createdAtMs() const { return createdMs; }
+
+    private:
+        QFile file;
+        QString error;
+        qint64 createdMs = 0;
+    };
+
+private:
+    bool startSegment();
+
+    QString directory;
+    QFile file;
+    QString error;
+    qint64 written = 0;
+    qint64 maxSegmentBytes = 0;
+};
+
+#endif // MESSAGEARCHIVE_H
@@ -0,0 +1,202 @@
+#include "Metrics.h"
+#include <QTextStream>
+#include <cmath>
+
+namespace {
+int highestBit(quint64 value) {
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+QString formatValue(double value) {
+    return QString::number(value, 'g', 10);
+}
+
+/* Метки серии с добавленной меткой quantile*/
+QString withQuantile(const QString& labels, const char* quantile) {
+    const QString q = QString("quantile=\"%1\"").arg(quantile);
+    return labels.isEmpty() ? q : labels + "," + q;
+}
+}
+
+MetricHistogram::MetricHistogram()
+    : buckets(new std::atomic<quint64>[BucketCount]) {
+    for (int i = 0; i < BucketCount; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int MetricHistogram::indexOf(quint64 value) {
+    if (value < quint64(2 * SubBuckets)) {
+        return int(value);
+    }
+    const int shift = highestBit(value) - SubBucketBits;
+    return 2 * SubBuckets + (shift - 1) * SubBuckets + int((value >> shift) - SubBuckets);
+}
+
+quint64 MetricHistogram::highestValueAt(int index) {
+    if (index < 2 * SubBuckets) {
+        return quint64(index);
+    }
+    const int shift = (index - 2 * SubBuckets) / SubBuckets + 1;
+    const quint64 sub = quint64((index - 2 * SubBuckets) % SubBuckets + SubBuckets);
+    return ((sub + 1) << shift) - 1;
+}
+
+void MetricHistogram::record(quint64 value) {
+    buckets[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    valueSum.fetch_add(value, std::memory_order_relaxed);
+    quint64 seen = maxValue.load(std::memory_order_relaxed);
+    while (value > seen && !maxValue.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Верхняя граница корзины, в которую попадает доля fraction значений.
+ * Запись может идти параллельно, поэтому результат приблизительный.
+ */
+quint64 MetricHistogram::percentile(double fraction) const {
+    const quint64 count = this->count();
+    if (count == 0) {
+        return 0;
+    }
+    const quint64 target = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, fraction, 1.0) * double(count))));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return qMin(max(), highestValueAt(i));
+        }
+    }
+    return max();
+}
+
+Metrics& Metrics::getInstance() {
+    static Metrics instance;
+    return instance;
+}
+
+QString Metrics::label(const QString& key, const QString& value) {
+    QString escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return QString("%1=\"%2\"").arg(key, escaped);
+}
+
+Metrics::Series& Metrics::series(const QString& name, const QString& help, const QString& labels, Kind kind,
+                                 double scale) {
+    QMutexLocker locker(&mutex);
+    Family* family = byName.value(name, nullptr);
+    if (!family) {
+        families.push_back(std::make_unique<Family>());
+        family = families.back().get();
+        family->name = name;
+        family->help = help;
+        family->kind = kind;
+        family->scale = scale;
+        byName.insert(name, family);
+    }
+    Q_ASSERT(family->kind == kind);
+
+    for (const auto& existing : family->series) {
+        if (existing->labels == labels) {
+            return *existing;
+        }
+    }
+    family->series.push_back(std::make_unique<Series>());
+    Series& created = *family->series.back();
+    created.labels = labels;
+    switch (kind) {
+    case Kind::Counter: created.counter = std::make_unique<MetricCounter>(); break;
+    case Kind::Gauge: created.gauge = std::make_unique<MetricGauge>(); break;
+    case Kind::Histogram: created.histogram = std::make_unique<MetricHistogram>(); break;
+    }
+    return created;
+}
+
+MetricCounter& Metrics::counter(const QString& name, const QString& help, const QString& labels) {
+    return *series(name, help, labels, Kind::Counter, 1.0).counter;
+}
+
+MetricGauge& Metrics::gauge(const QString& name, const QString& help, const QString& labels) {
+    return *series(name, help, labels, Kind::Gauge, 1.0).gauge;
+}
+
+MetricHistogram& Metrics::histogram(const QString& name, const QString& help, const QString& labels, double scale) {
+    return *series(name, help, labels, Kind::Histogram, scale).histogram;
+}
+
+/**
+ * @brief Выводит все метрики в текстовом формате Prometheus.
+ * Гистограммы выводятся как summary: квантили, сумма и количество.
+ */
+QString Metrics::renderPrometheus() const {
+    QMutexLocker locker(&mutex);
+    QString result;
+    QTextStream out(&result);
+    for (const auto& family : families) {
+        const char* type = family->kind == Kind::Counter ? "counter"
+                         : family->kind == Kind::Gauge   ? "gauge"
+                                                         : "summary";
+        out << "# HELP " << family->name << ' ' << family->help << '\n';
+        out << "# TYPE " << family->name << ' ' << type << '\n';
+        for (const auto& series : family->series) {
+            const QString labels = series->labels.isEmpty() ? QString() : "{" + series->labels + "}";
+            switch (family->kind) {
+            case Kind::Counter:
+                out << family->name << labels << ' ' << series->counter->get() << '\n';
+                break;
+            case Kind::Gauge:
+                out << family->name << labels << ' ' << series->gauge->get() << '\n';
+                break;
+            case Kind::Histogram: {
+                const MetricHistogram& histogram = *series->histogram;
+                for (const char* quantile : {"0.5", "0.9", "0.99", "0.999"}) {
+                    out << family->name << '{' << withQuantile(series->labels, quantile) << "} "
+                        << formatValue(histogram.percentile(QByteArray(quantile).toDouble()) * family->scale) << '\n';
+                }
+                out << family->name << "_sum" << labels << ' ' << formatValue(histogram.sum() * family->scale) << '\n';
+                out << family->name << "_count" << labels << ' ' << histogram.count() << '\n';
+                break;
+            }
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Сводка для вкладки статистики: одна строка на серию,
+ * у гистограмм - количество, p50, p99 и максимум.
+ */
+QString Metrics::renderText() const {
+    QMutexLocker locker(&mutex);
+    QString result;
+    QTextStream out(&result);
+    for (const auto& family : families) {
+        for (const auto& series : family->series) {
+            const QString name = series->labels.isEmpty() ? family->name
+                                                          : family->name + "{" + series->labels + "}";
+            switch (family->kind) {
+            case Kind::Counter:
+                out << name << "  " << series->counter->get() << '\n';
+                break;
+            case Kind::Gauge:
+                out << name << "  " << series->gauge->get() << '\n';
+                break;
+            case Kind::Histogram: {
+                const MetricHistogram& histogram = *series->histogram;
+                out << name << "  n=" << histogram.count()
+                    << " p50=" << formatValue(histogram.percentile(0.5) * family->scale)
+                    << " p99=" << formatValue(histogram.percentile(0.99) * family->scale)
+                    << " max=" << formatValue(histogram.max() * family->scale) << '\n';
+                break;
+            }
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,131 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Счетчик, который только растет.
+ */
+class MetricCounter {
+public:
+    void increment(quint64 n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> value{0};
+};
+
+/**
+ * @brief Текущее значение: число соединений, длина очереди.
+ */
+class MetricGauge {
+public:
+    void set(qint64 v) { value.store(v, std::memory_order_relaxed); }
+    void add(qint64 n) { value.fetch_add(n, std::memory_order_relaxed); }
+    qint64 get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> value{0};
+};
+
+/**
+ * @brief Гистограмма в духе HDR: до 63 значения хранятся точно, дальше
+ * каждая степень двойки делится на 32 корзины, поэтому погрешность
+ * процентилей не больше 1/32 во всем диапазоне. Запись - несколько
+ * атомарных сложений без блокировок, из любого потока.
+ */
+class MetricHistogram {
+public:
+    MetricHistogram();
+
+    void record(quint64 value);
+    quint64 count() const { return total.load(std::memory_order_relaxed); }
+    quint64 sum() const { return valueSum.load(std::memory_order_relaxed); }
+    quint64 max() const { return maxValue.load(std::memory_order_relaxed); }
+    quint64 percentile(double fraction) const;
+
+    /* Записывает в гистограмму время жизни объекта в микросекундах*/
+    class Timer {
+    public:
+        explicit Timer(MetricHistogram& histogram) : histogram(histogram) { timer.start(); }
+        ~Timer() { histogram.record(quint64(timer.nsecsElapsed() / 1000)); }
+
+    private:
+        MetricHistogram& histogram;
+        QElapsedTimer timer;
+    };
+
+private:
+    static constexpr int SubBucketBits = 5;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int BucketCount = 2 * SubBuckets + (64 - SubBucketBits - 1) * SubBuckets;
+
+    static int indexOf(quint64 value);
+    static quint64 highestValueAt(int index);
+
+    std::unique_ptr<std::atomic<quint64>[]> buckets;
+    std::atomic<quint64> total{0};
+    std::atomic<quint64> valueSum{0};
+    std::atomic<quint64> maxValue{0};
+};
+
+/**
+ * @brief Класс Metrics (синглтон) - реестр метрик сервера.
+ *
+ * Метрика регистрируется один раз по имени и набору меток и дальше живет
+ * до конца работы процесса, поэтому код на горячем пути сохраняет ссылку
+ * (в поле класса или статической переменной) и обновляет ее атомарно,
+ * без обращения к реестру. Блокировка нужна только при регистрации и выводе.
+ * Метки передаются готовой строкой, см. label().
+ */
+class Metrics {
+public:
+    static Metrics& getInstance();
+
+    MetricCounter& counter(const QString& name, const QString& help, const QString& labels = QString());
+    MetricGauge& gauge(const QString& name, const QString& help, const QString& labels = QString());
+    /* scale переводит записанные целые значения в единицы метрики, например 1e-6 для мкс -> с*/
+    MetricHistogram& histogram(const QString& name, const QString& help, const QString& labels = QString(),
+                               double scale = 1.0);
+
+    static QString label(const QString& key, const QString& value);
+
+    QString renderPrometheus() const; /* текстовый формат Prometheus 0.0.4*/
+    QString renderText() const;       /* сводка для окна сервера*/
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+
+    struct Series {
+        QString labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    struct Family {
+        QString name;
+        QString help;
+        Kind kind;
+        double scale = 1.0;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    Metrics() = default;
+    Series& series(const QString& name, const QString& help, const QString& labels, Kind kind, double scale);
+
+    mutable QMutex mutex;
+    std::vector<std::unique_ptr<Family>> families; /* в порядке регистрации*/
+    QHash<QString, Family*> byName;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,72 @@
+#include "MetricsEndpoint.h"
+#include "Metrics.h"
+#include "logger.h"
+#include <QTcpSocket>
+
+MetricsEndpoint::MetricsEndpoint(QObject* parent)
+    : QObject(parent) {
+    connect(&server, &QTcpServer::newConnection, this, &MetricsEndpoint::onNewConnection);
+}
+
+/**
+ * @brief Начинает прием запросов.
+ * @param port Порт HTTP.
+ * @param address Адрес, по умолчанию только loopback.
+ * @return true, если порт открыт.
+ */
+bool MetricsEndpoint::listen(quint16 port, const QHostAddress& address) {
+    Logger& logger = Logger::getInstance();
+    if (!server.listen(address, port)) {
+        logger.log(QtWarningMsg, QString("Не удалось открыть порт метрик %1: %2").arg(port).arg(server.errorString()));
+        return false;
+    }
+    logger.log(QtInfoMsg, QString("Метрики доступны по адресу http://%1:%2/metrics").arg(address.toString()).arg(port));
+    return true;
+}
+
+/**
+ * @brief Читает строку запроса и отвечает одним HTTP/1.0-ответом.
+ * Тело запроса не читается: сборщики метрик отправляют только GET.
+ */
+void MetricsEndpoint::onNewConnection() {
+    while (QTcpSocket* socket = server.nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+            if (socket->property("answered").toBool()) {
+                socket->readAll();
+                return;
+            }
+            if (!socket->canReadLine()) {
+                if (socket->bytesAvailable() > MaxRequestSize) {
+                    socket->abort();
+                }
+                return;
+            }
+
+            const QList<QByteArray> request = socket->readLine().trimmed().split(' ');
+            const QByteArray method = request.value(0);
+            const QByteArray path = request.value(1).split('?').value(0);
+
+            QByteArray status = "200 OK";
+            QByteArray body;
+            if (method != "GET" && method != "HEAD") {
+                status = "405 Method Not Allowed";
+            } else if (path == "/metrics" || path == "/") {
+                body = Metrics::getInstance().renderPrometheus().toUtf8();
+            } else {
+                status = "404 Not Found";
+            }
+
+            QByteArray response = "HTTP/1.0 " + status + "\r\n"
+                                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                                  "Connection: close\r\n\r\n";
+            if (method != "HEAD") {
+                response.append(body);
+            }
+            socket->setProperty("answered", true);
+            socket->write(response);
+            socket->disconnectFromHost();
+        });
+    }
+}
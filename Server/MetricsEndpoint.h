@@ -0,0 +1,34 @@
+#ifndef METRICSENDPOINT_H
+#define METRICSENDPOINT_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QHostAddress>
+
+/**
+ * @brief Класс MetricsEndpoint - HTTP-точка для сбора метрик.
+ *
+ * Отвечает на GET /metrics содержимым реестра Metrics в текстовом формате
+ * Prometheus и закрывает соединение. Слушает только loopback: метрики
+ * раскрывают нагрузку сервера, поэтому наружу их отдает обратный прокси
+ * или агент на той же машине. Клиентские соединения с ним не связаны.
+ */
+class MetricsEndpoint : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MetricsEndpoint(QObject* parent = nullptr);
+
+    bool listen(quint16 port, const QHostAddress& address = QHostAddress::LocalHost);
+    QString errorString() const { return server.errorString(); }
+
+    static constexpr qsizetype MaxRequestSize = 8 * 1024; /* заголовки запроса сборщика*/
+
+private slots:
+    void onNewConnection();
+
+private:
+    QTcpServer server;
+};
+
+#endif // METRICSENDPOINT_H
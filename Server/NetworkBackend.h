@@ -0,0 +1,70 @@
+#ifndef NETWORKBACKEND_H
+#define NETWORKBACKEND_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QString>
+#include "ConnectionSlab.h"
+
+/**
+ * @brief Класс NetworkBackend - транспорт клиентских соединений.
+ *
+ * Бэкенд принимает подключения, дописывает входящие байты в readBuffer
+ * соединения и отправляет исходящие. Разбор кадров, проверка живости и
+ * рассылка остаются в ManagerNetwork и одинаковы для всех бэкендов.
+ * Записи соединений выделяются из общего ConnectionSlab, который
+ * принадлежит ManagerNetwork; возвращает их в пул тоже ManagerNetwork.
+ * Сигналы испускаются синхронно из цикла событий потока сервера.
+ * Одновременно может работать несколько бэкендов, поэтому каждая запись
+ * помнит принявший ее бэкенд в поле transport.
+ */
+class NetworkBackend : public QObject {
+    Q_OBJECT
+
+public:
+    explicit NetworkBackend(ConnectionSlab& slab, QObject* parent = nullptr)
+        : QObject(parent), slab(slab) {}
+
+    /**
+     * @brief Задает параметры приема подключений, действует до listen().
+     * @param acceptors Число потоков приема со своими сокетами SO_REUSEPORT.
+     * @param backlog Длина очереди подключений, ожидающих accept().
+     * @param batch Сколько подключений принимается за одно пробуждение,
+     *              остальные - на следующей итерации цикла событий.
+     */
+    void setAcceptPolicy(int acceptors, int backlog, int batch) {
+        acceptorCount = qMax(1, acceptors);
+        listenBacklog = qMax(1, backlog);
+        acceptBatch = qMax(1, batch);
+    }
+
+    virtual bool listen(const QHostAddress& address, quint16 port) = 0;
+    virtual void close() = 0;
+    virtual bool isListening() const = 0;
+    virtual QString errorString() const = 0;
+
+    virtual void write(ClientConnection* connection, const QByteArray& data) = 0;
+    /* graceful - сначала отправить накопленные данные, иначе разорвать сразу*/
+    virtual void closeConnection(ClientConnection* connection, bool graceful) = 0;
+
+signals:
+    void accepted(ClientConnection* connection);
+    void readyRead(ClientConnection* connection);
+    void closed(ClientConnection* connection, const QString& reason);
+
+protected:
+    /* Выделяет запись соединения, принадлежащую этому бэкенду*/
+    ClientConnection* acquireConnection() {
+        ClientConnection* connection = slab.acquire();
+        connection->transport = this;
+        return connection;
+    }
+
+    ConnectionSlab& slab;
+    int acceptorCount = 1;
+    int listenBacklog = 1024;
+    int acceptBatch = 64;
+};
+
+#endif // NETWORKBACKEND_H
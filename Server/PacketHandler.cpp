@@ -1,13 +1,17 @@
 #include "PacketHandler.h"
 #include "SecurityUtils.h"
 #include "logger.h"
+#include "FrameCompression.h"
+#include "Tracer.h"
+#include <memory>
 
-PacketRegisterHandler::PacketRegisterHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, QObject* parent)
-    : QObject(parent), clientDataBase(db), managerNetwork(managerNetwork) {
+PacketRegisterHandler::PacketRegisterHandler(ClientDataBase* db, ManagerNetwork* managerNetwork,
+                                             CredentialWorkerPool* workerPool, QObject* parent)
+    : QObject(parent), clientDataBase(db), managerNetwork(managerNetwork), workerPool(workerPool) {
 
 }
 
-void PacketRegisterHandler::handle(QTcpSocket* socket, PacketRegister& packet) {
+void PacketRegisterHandler::handle(ClientConnection* connection, PacketRegister& packet) {
     QString username = packet.getUsername();
     QString password = packet.getPassword();
     QString first_name = packet.getFirst_name();
@@ -15,148 +19,542 @@ void PacketRegisterHandler::handle(QTcpSocket* socket, PacketRegister& packet) {
     Logger& logger = Logger::getInstance();
     logger.log(QtDebugMsg, QString("Начинаю обработку запроса "
                                    "регистрации для пользователя %1").arg(username));
-    bool isUsernameTaken = clientDataBase->existsUser(username);
-
-    if (!isUsernameTaken) {
-        salt = SecurityUtils::generateSalt(16);
-        QString hash = SecurityUtils::hashPassword(password, salt);
-
-        if (clientDataBase->createUser(first_name, last_name, username, hash, salt)) {
-            PacketServerResponse response;
-            response.SetResponseType(PacketServerResponse::ServerResponseType::Register);
-            response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Success);
-            QByteArray serialized = response.serialize();
-            managerNetwork->sendMessageToUser(socket, serialized);
-            logger.log(QtInfoMsg, QString("Пользователь %1 успешно зарегистрирован").arg(username));
-        } else {
-            PacketServerResponse response;
-            response.SetResponseType(PacketServerResponse::ServerResponseType::Register);
-            response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
-            response.SetResponseMessage("Ошибка на стороне сервера: не удалось добавить пользователя в БД");
-            QByteArray serialized = response.serialize();
-            managerNetwork->sendMessageToUser(socket, serialized);
-            logger.log(QtWarningMsg, QString("Не удалось зарегистрировать "
-                                             "пользователя %1: ошибка базы данных").arg(username));
+
+    /*Соль, хэш и запись в БД считаются в пуле, ответ придет в этот поток;
+      к этому моменту клиент мог отключиться, поэтому соединение ищется по id*/
+    bool queued = workerPool->submitRegister(this, first_name, last_name, username, password,
+                                             [this, id = connection->id, username](CredentialWorkerPool::RegisterStatus status) {
+        if (ClientConnection* connection = managerNetwork->connection(id)) {
+            sendRegisterResponse(connection, username, status);
         }
-    } else { // Логин занят
-        PacketServerResponse response1;
-        response1.SetResponseType(PacketServerResponse::ServerResponseType::Register);
-        response1.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
-        response1.SetResponseMessage("Данный логин уже занят");
-        QByteArray serialized1 = response1.serialize();
-        managerNetwork->sendMessageToUser(socket, serialized1);
+    });
+
+    if (!queued) {
+        PacketServerResponse response;
+        response.SetResponseType(PacketServerResponse::ServerResponseType::Register);
+        response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+        response.SetResponseMessage("Сервер перегружен, повторите попытку позже");
+        managerNetwork->sendMessageToUser(connection, response.serialize());
+        logger.log(QtWarningMsg, QString("Очередь регистрации переполнена, запрос %1 отклонен").arg(username));
+    }
+}
+
+/**
+ * @brief Отправляет клиенту результат регистрации, полученный из пула.
+ * @param connection Соединение клиента.
+ * @param username Логин пользователя.
+ * @param status Итог регистрации.
+ */
+void PacketRegisterHandler::sendRegisterResponse(ClientConnection* connection, const QString& username,
+                                                 CredentialWorkerPool::RegisterStatus status) {
+    Logger& logger = Logger::getInstance();
+    PacketServerResponse response;
+    response.SetResponseType(PacketServerResponse::ServerResponseType::Register);
+
+    switch (status) {
+    case CredentialWorkerPool::RegisterStatus::Created:
+        response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Success);
+        logger.log(QtInfoMsg, QString("Пользователь %1 успешно зарегистрирован").arg(username));
+        break;
+    case CredentialWorkerPool::RegisterStatus::DatabaseError:
+        response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+        response.SetResponseMessage("Ошибка на стороне сервера: не удалось добавить пользователя в БД");
+        logger.log(QtWarningMsg, QString("Не удалось зарегистрировать "
+                                         "пользователя %1: ошибка базы данных").arg(username));
+        break;
+    case CredentialWorkerPool::RegisterStatus::UsernameTaken: // Логин занят
+        response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+        response.SetResponseMessage("Данный логин уже занят");
         logger.log(QtWarningMsg, QString("Попытка регистрации с занятым логином: %1").arg(username));
+        break;
     }
+
+    QByteArray serialized = response.serialize();
+    managerNetwork->sendMessageToUser(connection, serialized);
 }
 
 
 
 
 
-PacketAuthHandler::PacketAuthHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, QObject* parent)
-    : QObject(parent), clientDataBase(db), managerNetwork(managerNetwork) {}
+PacketAuthHandler::PacketAuthHandler(ClientDataBase* db, ManagerNetwork* managerNetwork,
+                                     CredentialWorkerPool* workerPool, SessionTokenManager* sessionTokens,
+                                     QObject* parent)
+    : QObject(parent), clientDataBase(db), managerNetwork(managerNetwork),
+    workerPool(workerPool), sessionTokens(sessionTokens) {}
 
-void PacketAuthHandler::handle(QTcpSocket* socket, PacketAuth& packet) {
+void PacketAuthHandler::handle(ClientConnection* connection, PacketAuth& packet) {
     QString username = packet.getUsername();
     QString password = packet.getPassword();
 
     Logger& logger = Logger::getInstance();
     logger.log(QtDebugMsg, QString("Начинаю обработку запроса аутентификации "
                                    "для пользователя %1").arg(username));
-    if (!socketStates.contains(socket)) { // Первый этап: клиент отправил только логин
-        if (clientDataBase->existsUser(username)) {
-            QMap<QString, QString> userData = clientDataBase->getUserData(username);
-            QString salt = userData["salt"];
+    bool queued = false;
+    if (!connectionStates.contains(connection)) { // Первый этап: клиент отправил только логин
+        queued = workerPool->submitSaltLookup(this, username, [this, id = connection->id, username](const QString& salt) {
+            ClientConnection* connection = managerNetwork->connection(id);
+            if (!connection) {
+                return;
+            }
+            Logger& logger = Logger::getInstance();
+            if (salt.isEmpty()) {
+                logger.log(QtWarningMsg, QString("Пользователь %1 не найден в базе данных").arg(username));
+                sendAuthFailed(connection, "Вы не зарегестрированы");
+                return;
+            }
             PacketServerResponse responseAuth;
             responseAuth.SetResponseType(PacketServerResponse::ServerResponseType::Auth);
             responseAuth.SetResponseStatus(PacketServerResponse::ServerResponseStatus::SuccessUsername);
             responseAuth.SetSalt(salt);
             QByteArray serializedAuth = responseAuth.serialize();
-            managerNetwork->sendMessageToUser(socket, serializedAuth);
+            managerNetwork->sendMessageToUser(connection, serializedAuth);
 
-            socketStates[socket] = {username, true};
+            connectionStates[connection] = {username, true};
 
             logger.log(QtInfoMsg, QString("Отправляю соль для пользователя %1").arg(username));
-        } else {
-            PacketServerResponse responseAuth;
-            responseAuth.SetResponseType(PacketServerResponse::ServerResponseType::Auth);
-            responseAuth.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
-            responseAuth.SetResponseMessage("Вы не зарегестрированы");
-            QByteArray serializedAuth = responseAuth.serialize();
-            logger.log(QtWarningMsg, QString("Пользователь %1 не найден в базе данных").arg(username));
-            managerNetwork->sendMessageToUser(socket, serializedAuth);
-        }
+        });
     } else { // Второй этап клиент отправил логин и хэш
-        AuthState state = socketStates.value(socket);
-        if (state.hasSentSalt) {
-            QMap<QString, QString> userData = clientDataBase->getUserData(state.username);
-            QString Hash = userData["password_hash"];
-            logger.log(QtDebugMsg, QString("Проверяю хэш пароля для пользователя %1").arg(state.username));
-
-            if (password == Hash) {
-                PacketServerResponse response;
-                response.SetResponseType(PacketServerResponse::ServerResponseType::Auth);
-                response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Success);
-                QByteArray serialized = response.serialize();
-                managerNetwork->sendMessageToUser(socket, serialized);
+        AuthState state = connectionStates.value(connection);
+        if (!state.hasSentSalt) {
+            return;
+        }
+        connectionStates.remove(connection);
+        logger.log(QtDebugMsg, QString("Проверяю хэш пароля для пользователя %1").arg(state.username));
+        queued = workerPool->submitVerify(this, state.username, password, [this, id = connection->id, state](qint64 generation) {
+            ClientConnection* connection = managerNetwork->connection(id);
+            if (!connection) {
+                return;
+            }
+            Logger& logger = Logger::getInstance();
+            if (generation >= 0) {
+                sendAuthSuccess(connection, state.username, generation);
                 logger.log(QtInfoMsg, QString("Аутентификация успешна для пользователя %1").arg(state.username));
-                socketStates.remove(socket);
             } else {
-                qDebug() << "косяк с паролем";
-                PacketServerResponse response;
-                response.SetResponseType(PacketServerResponse::ServerResponseType::Auth);
-                response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
-                response.SetResponseMessage("Неправильный пароль");
                 logger.log(QtWarningMsg, QString("Аутентификация не удалась для пользователя %1: неправильный пароль").arg(state.username));
-                QByteArray serialized = response.serialize();
-                managerNetwork->sendMessageToUser(socket, serialized);
-                socketStates.remove(socket);
+                sendAuthFailed(connection, "Неправильный пароль");
             }
+        });
+    }
+
+    if (!queued) {
+        logger.log(QtWarningMsg, QString("Очередь аутентификации переполнена, запрос %1 отклонен").arg(username));
+        sendAuthFailed(connection, "Сервер перегружен, повторите попытку позже");
+    }
+}
+
+/**
+ * @brief Возобновляет сессию по токену за один пакет.
+ * Подпись и срок токена проверяются сразу, а его поколение сверяется
+ * с базой в пуле учетных данных и тут же увеличивается: новый токен
+ * выдается со следующим поколением, а предъявленный больше не действует.
+ * При неудаче клиент должен пройти обычную аутентификацию с солью.
+ * @param connection Соединение клиента.
+ * @param packet Пакет с логином и токеном.
+ */
+void PacketAuthHandler::handle(ClientConnection* connection, PacketSessionResume& packet) {
+    Logger& logger = Logger::getInstance();
+    connectionStates.remove(connection);
+
+    qint64 generation = 0;
+    QString username = sessionTokens->verify(packet.getToken(), generation);
+    if (username.isEmpty() || username != packet.getUsername()) {
+        logger.log(QtWarningMsg, QString("Недействительный токен сессии для пользователя %1").arg(packet.getUsername()));
+        sendAuthFailed(connection, "Сессия истекла, войдите заново");
+        return;
+    }
+
+    const bool queued = workerPool->submitTokenRotation(this, username, generation,
+                                                        [this, id = connection->id, username, generation](bool ok) {
+        ClientConnection* connection = managerNetwork->connection(id);
+        if (!connection) {
+            return;
+        }
+        Logger& logger = Logger::getInstance();
+        if (!ok) {
+            logger.log(QtWarningMsg, QString("Отозванный токен сессии для пользователя %1").arg(username));
+            sendAuthFailed(connection, "Сессия истекла, войдите заново");
+            return;
         }
+        sendAuthSuccess(connection, username, generation + 1);
+        logger.log(QtInfoMsg, QString("Сессия пользователя %1 возобновлена по токену").arg(username));
+    });
+    if (!queued) {
+        logger.log(QtWarningMsg, QString("Очередь аутентификации переполнена, возобновление %1 отклонено").arg(username));
+        sendAuthFailed(connection, "Сервер перегружен, повторите попытку позже");
+    }
+}
+
+/**
+ * @brief Завершает сессию: все токены пользователя отзываются,
+ * и возобновить сессию с ними больше нельзя.
+ * @param connection Соединение клиента.
+ * @param packet Пакет завершения сессии.
+ */
+void PacketAuthHandler::handle(ClientConnection* connection, PacketLogout& packet) {
+    Q_UNUSED(packet);
+    const QString username = managerNetwork->userForConnection(connection);
+    if (username.isEmpty()) {
+        return;
+    }
+    const bool queued = workerPool->submitTokenRevocation(this, username, [username](bool ok) {
+        Logger::getInstance().log(ok ? QtInfoMsg : QtWarningMsg,
+                                  ok ? QString("Пользователь %1 вышел, токены сессии отозваны").arg(username)
+                                     : QString("Не удалось отозвать токены сессии пользователя %1").arg(username));
+    });
+    if (!queued) {
+        Logger::getInstance().log(QtWarningMsg, QString("Очередь учетных данных переполнена, токены %1 не отозваны")
+                                                    .arg(username));
     }
 }
 
+/**
+ * @brief Сбрасывает состояние аутентификации отключившегося клиента.
+ * @param connection Соединение клиента.
+ */
+void PacketAuthHandler::onClientDisconnected(ClientConnection* connection) {
+    connectionStates.remove(connection);
+}
+
+/**
+ * @brief Отправляет клиенту подтверждение аутентификации с новым токеном сессии.
+ * @param connection Соединение клиента.
+ * @param username Логин пользователя.
+ * @param tokenGeneration Текущее поколение токенов пользователя.
+ */
+void PacketAuthHandler::sendAuthSuccess(ClientConnection* connection, const QString& username, qint64 tokenGeneration) {
+    managerNetwork->associateUserWithConnection(username, connection);
+    PacketServerResponse response;
+    response.SetResponseType(PacketServerResponse::ServerResponseType::Auth);
+    response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Success);
+    response.SetSessionToken(sessionTokens->issue(username, tokenGeneration));
+    QByteArray serialized = response.serialize();
+    managerNetwork->sendMessageToUser(connection, serialized);
+}
+
+/**
+ * @brief Отправляет клиенту отказ в аутентификации.
+ * @param connection Соединение клиента.
+ * @param message Причина отказа.
+ */
+void PacketAuthHandler::sendAuthFailed(ClientConnection* connection, const QString& message) {
+    PacketServerResponse response;
+    response.SetResponseType(PacketServerResponse::ServerResponseType::Auth);
+    response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+    response.SetResponseMessage(message);
+    QByteArray serialized = response.serialize();
+    managerNetwork->sendMessageToUser(connection, serialized);
+}
+
 
 
-PacketMessageHandler::PacketMessageHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, ChatManager* chatManager, QObject* parent)
-    : QObject(parent), clientDataBase(db), managerNetwork(managerNetwork), chatManager(chatManager) {}
+PacketMessageHandler::PacketMessageHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, ChatManager* chatManager,
+                                           BroadcastCoalescer* broadcaster, QObject* parent)
+    : QObject(parent), clientDataBase(db), managerNetwork(managerNetwork), chatManager(chatManager),
+      broadcaster(broadcaster) {}
 
-void PacketMessageHandler::handle(QTcpSocket* socket, PacketMessage& packet) {
+void PacketMessageHandler::handle(ClientConnection* connection, PacketMessage& packet) {
+    /*отправитель берется из аутентификации, а не из поля пакета, которое клиент заполняет сам*/
+    const QString sender = managerNetwork->userForConnection(connection);
+    if (sender.isEmpty()) {
+        Logger::getInstance().log(QtWarningMsg, "Сообщение от неаутентифицированного клиента отклонено");
+        return;
+    }
+    QMap<QString, QString> userData;
+    accept(connection, sender, userData, packet);
+}
+
+/**
+ * @brief Принимает пачку сообщений от клиента.
+ * Сообщения одной части базы попадают в одну очередь записи и фиксируются
+ * общей транзакцией вместе с сообщениями других клиентов,
+ * рассылка идет через общее окно объединения.
+ */
+void PacketMessageHandler::handle(ClientConnection* connection, PacketMessageBatch& packet) {
+    const QString sender = managerNetwork->userForConnection(connection);
+    if (sender.isEmpty()) {
+        Logger::getInstance().log(QtWarningMsg, "Пачка сообщений от неаутентифицированного клиента отклонена");
+        return;
+    }
+    /*данные отправителя запрашиваются из базы один раз на пачку*/
+    QMap<QString, QString> userData;
+    for (const PacketMessage& message : packet.getMessages()) {
+        accept(connection, sender, userData, message);
+    }
+}
+
+/**
+ * @brief Принимает одно сообщение клиента: присваивает номер и ставит в очередь записи.
+ * Сообщение рассылается только после записи в базу, поэтому клиенты
+ * не видят сообщений, которых не окажется в истории.
+ * @param connection Соединение отправителя.
+ * @param sender Аутентифицированный отправитель, он же пространство ключей отправки.
+ * @param userData Данные отправителя из базы; заполняются при первом принятом сообщении.
+ * @param packet Сообщение от клиента.
+ * @return true, если сообщение принято.
+ */
+bool PacketMessageHandler::accept(ClientConnection* connection, const QString& sender, QMap<QString, QString>& userData,
+                                  const PacketMessage& packet) {
     QString chatName = packet.getChatName();
-    QString sender = packet.getFrom();
     QString text = packet.getText();
+    QString key = packet.getIdempotencyKey();
 
-    QMap<QString, QString> userData = clientDataBase->getUserData(sender);
+    /*повтор уже принятого сообщения: отправителю еще раз уходит сохраненная копия,
+      в базу и остальным клиентам ничего не попадает*/
+    IdempotencyCache::Entry accepted;
+    if (!key.isEmpty() && idempotency.find(sender, key, accepted)) {
+        resendAccepted(connection, accepted, key);
+        return false;
+    }
+
+    quint32 chatId = chatManager->chatId(chatName);
+    if (chatId == 0) {
+        return false;
+    }
+
+    if (userData.isEmpty()) {
+        userData = clientDataBase->getUserData(sender);
+    }
     QString firstName = userData.value("firstName", "Unknown");
     QString lastName = userData.value("lastName", "User");
 
-    PacketMessage mes;
-    mes.setFirstName(firstName);
-    mes.setLastName(lastName);
-    mes.setChatName(chatName);
-    mes.setFrom(sender);
-    mes.setTimestamp(QDateTime::currentDateTime());
-    mes.setText(text);
+    auto stored = std::make_shared<PacketMessage>();
+    stored->setFirstName(firstName);
+    stored->setLastName(lastName);
+    stored->setFrom(sender);
+    stored->setTimestamp(QDateTime::currentDateTime());
+    stored->setText(text);
+    stored->setIdempotencyKey(key);
 
-    Chat* chat = chatManager->getChat(chatName);
-
-    if (chat->getName() == nullptr) {
-        return;
+    /*рассылка выполняется уже из обратного вызова записи: трасса пакета продолжается в нем*/
+    const quint64 trace = Tracer::currentTrace();
+    quint32 seq = chatManager->addMessageToChat(chatId, sender, text, stored->getTimestamp(), firstName, lastName, this,
+                                                [this, id = connection->id, sender, chatId, stored, trace](bool ok) {
+        Tracer::Scope scope(trace);
+        if (!ok) {
+            Logger::getInstance().log(QtWarningMsg, QString("Сообщение %1 в чат '%2' не сохранено")
+                                                        .arg(stored->getSeq()).arg(stored->getChatName()));
+            /*номер не занят в базе: повтор с тем же ключом должен пройти заново*/
+            if (!stored->getIdempotencyKey().isEmpty()) {
+                idempotency.remove(sender, stored->getIdempotencyKey());
+            }
+            if (ClientConnection* connection = managerNetwork->connection(id)) {
+                sendRejected(connection, *stored);
+            }
+            return;
+        }
+        /*за время записи чат могли переименовать или удалить*/
+        const QString currentName = chatManager->chatName(chatId);
+        if (!currentName.isEmpty()) {
+            stored->setChatName(currentName);
+            broadcaster->enqueue(*stored);
+        }
+    });
+    if (seq == 0) {
+        Logger::getInstance().log(QtWarningMsg, QString("Сообщение в чат '%1' не сохранено").arg(chatName));
+        return false;
+    }
+    stored->setChatName(chatName);
+    stored->setSeq(seq);
+    if (!key.isEmpty()) {
+        idempotency.insert(sender, key, {chatId, seq});
     }
+    return true;
+}
 
-    chatManager->addMessageToChat(chatName, sender, text, QDateTime::currentDateTime(), firstName, lastName);
+/**
+ * @brief Сообщает отправителю, что сообщение не сохранено. Клиент оставляет
+ * его среди неподтвержденных и отправляет повторно с тем же ключом.
+ * @param connection Соединение отправителя.
+ * @param message Несохраненное сообщение.
+ */
+void PacketMessageHandler::sendRejected(ClientConnection* connection, const PacketMessage& message) {
+    PacketServerResponse response;
+    response.SetResponseType(PacketServerResponse::ServerResponseType::Message);
+    response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+    response.SetResponseMessage(message.getIdempotencyKey());
+    managerNetwork->sendMessageToUser(connection, response.serialize());
+}
+
+/**
+ * @brief Повторно отправляет отправителю уже сохраненное сообщение,
+ * чтобы клиент получил подтверждение с номером и снял его с повторной отправки.
+ * @param connection Соединение отправителя.
+ * @param accepted Чат и номер сохраненного сообщения.
+ * @param key Ключ отправки.
+ */
+void PacketMessageHandler::resendAccepted(ClientConnection* connection, const IdempotencyCache::Entry& accepted, const QString& key) {
+    /*чтение встает в очередь записи за самим сообщением, поэтому не найдено
+      оно только если запись не удалась: тогда клиенту уже ушел отказ*/
+    chatManager->getMessage(accepted.chatId, accepted.seq, this,
+                            [this, id = connection->id, chatId = accepted.chatId, key](bool found, const MessageRecord& record) {
+        ClientConnection* connection = managerNetwork->connection(id);
+        if (!found || !connection) {
+            return;
+        }
+        PacketMessage mes;
+        mes.setFirstName(record.firstName);
+        mes.setLastName(record.lastName);
+        mes.setChatName(chatManager->chatName(chatId));
+        mes.setFrom(record.sender);
+        mes.setTimestamp(record.timestamp);
+        mes.setText(record.text);
+        mes.setSeq(record.seq);
+        mes.setIdempotencyKey(key);
+        managerNetwork->sendMessageToUser(connection, mes.serialize());
 
-    QByteArray serializedMes = mes.serialize();
-    managerNetwork->broadcastMessage(serializedMes);
+        Logger::getInstance().log(QtInfoMsg, QString("Повтор сообщения %1 от %2 отброшен").arg(key, record.sender));
+    });
 }
 
 
 PacketChatListHandler::PacketChatListHandler(ChatManager* manager, ManagerNetwork* managerNetwork, QObject* parent)
     : QObject(parent), chatManager(manager), managerNetwork(managerNetwork) {}
 
-void PacketChatListHandler::handle(QTcpSocket* socket, PacketChatList& packet) {
+void PacketChatListHandler::handle(ClientConnection* connection, PacketChatList& packet) {
     QStringList chatNames = chatManager->getAllChatNames();
     packet.setChatNames(chatNames);
+    packet.setVersion(chatManager->getChatListVersion());
     QByteArray serializedData = packet.serialize();
-    managerNetwork->sendMessageToUser(socket, serializedData);
+    managerNetwork->sendMessageToUser(connection, serializedData);
+}
+
+PacketSyncHandler::PacketSyncHandler(ChatManager* manager, ManagerNetwork* managerNetwork, QObject* parent)
+    : QObject(parent), chatManager(manager), managerNetwork(managerNetwork) {}
+
+/**
+ * @brief Отвечает на запрос синхронизации.
+ * Для каждого чата отправляется одна пачка не больше BatchSize сообщений;
+ * если пропущено больше, клиент запрашивает продолжение сам, поэтому
+ * большой разрыв не выгружается в соединение целиком за один раз.
+ * История читается в потоках записи частей, пачка уходит по готовности.
+ */
+void PacketSyncHandler::handle(ClientConnection* connection, PacketSyncRequest& packet) {
+    Logger& logger = Logger::getInstance();
+    if (managerNetwork->userForConnection(connection).isEmpty()) {
+        logger.log(QtWarningMsg, "Запрос синхронизации от неаутентифицированного клиента отклонен");
+        return;
+    }
+
+    for (const auto& chat : packet.getLastSeen()) {
+        quint32 chatId = chatManager->chatId(chat.first);
+        if (chatId == 0) {
+            continue;
+        }
+
+        chatManager->getMessagesAfter(chatId, chat.second, BatchSize, this,
+                                      [this, id = connection->id, chatName = chat.first, lastSeen = chat.second]
+                                      (const QList<MessageRecord>& messages) {
+            ClientConnection* connection = managerNetwork->connection(id);
+            if (messages.isEmpty() || !connection) {
+                return;
+            }
+            PacketSyncBatch batch;
+            batch.setChatName(chatName);
+            batch.setHasMore(lastSeen > 0 && messages.size() == BatchSize);
+            for (const MessageRecord& message : messages) {
+                batch.addMessage(message);
+            }
+            managerNetwork->sendMessageToUser(connection, batch.serialize());
+        });
+    }
+
+    logger.log(QtInfoMsg, QString("Синхронизация: запрошена история %1 чатов").arg(packet.getLastSeen().size()));
+}
+
+PacketHelloHandler::PacketHelloHandler(ManagerNetwork* managerNetwork, QObject* parent)
+    : QObject(parent), managerNetwork(managerNetwork) {}
+
+/**
+ * @brief Согласует параметры соединения: меньшую из версий протокола,
+ * пересечение возможностей и кодек сжатия. Ответ HelloAck уходит
+ * клиенту, и с этого момента сервер пишет в соединение только то, что клиент
+ * заявил как поддерживаемое.
+ */
+void PacketHelloHandler::handle(ClientConnection* connection, PacketHello& packet) {
+    quint16 version = qMin(packet.getVersion(), Packet::ProtocolVersion);
+    quint32 capabilities = packet.getCapabilities() & Capability::All;
+    if (!managerNetwork->isCompressionEnabled()) {
+        capabilities &= ~Capability::Compression;
+    }
+    quint8 codecs = (capabilities & Capability::Compression)
+        ? packet.getCodecs() & FrameCompression::supportedCodecs()
+        : 0;
+
+    ManagerNetwork::PeerInfo peer;
+    peer.version = version;
+    peer.capabilities = capabilities;
+    peer.codec = FrameCompression::preferredCodec(codecs);
+
+    PacketHelloAck reply;
+    reply.setVersion(version);
+    reply.setCapabilities(capabilities);
+    reply.setCodecs(codecs);
+    managerNetwork->sendMessageToUser(connection, reply.serialize());
+    managerNetwork->setPeerInfo(connection, peer);
+
+    Logger::getInstance().log(QtInfoMsg, QString("Клиент %1:%2: протокол %3, возможности 0x%4, кодек %5")
+                                             .arg(connection->peerAddress().toString())
+                                             .arg(connection->peerPort())
+                                             .arg(version)
+                                             .arg(capabilities, 0, 16)
+                                             .arg(peer.codec));
+}
+
+PacketSearchHandler::PacketSearchHandler(SearchWorker* searchWorker, ManagerNetwork* managerNetwork, QObject* parent)
+    : QObject(parent), searchWorker(searchWorker), managerNetwork(managerNetwork) {}
+
+/**
+ * @brief Выполняет поиск в потоке хранилища.
+ * Ответ уходит, только если клиент к его готовности еще подключен.
+ * @param connection Соединение клиента.
+ * @param packet Запрос поиска.
+ */
+void PacketSearchHandler::handle(ClientConnection* connection, PacketSearchRequest& packet) {
+    Logger& logger = Logger::getInstance();
+    if (managerNetwork->userForConnection(connection).isEmpty()) {
+        logger.log(QtWarningMsg, "Запрос поиска от неаутентифицированного клиента отклонен");
+        return;
+    }
+
+    const quint32 requestId = packet.getRequestId();
+    const quint32 offset = packet.getOffset();
+    /*OFFSET в FTS5 все равно ранжирует пропущенные строки, а при нескольких частях
+      базы каждая отдает offset + limit строк: глубокое листание не принимается*/
+    if (offset > PacketSearchRequest::MaxOffset) {
+        logger.log(QtWarningMsg, QString("Смещение поиска %1 больше допустимого").arg(offset));
+        SearchWorker::Result invalid;
+        invalid.status = PacketSearchResult::Status::InvalidQuery;
+        sendResult(connection, requestId, invalid);
+        return;
+    }
+    const int limit = qBound(1, static_cast<int>(packet.getLimit()), static_cast<int>(PacketSearchRequest::MaxLimit));
+    bool queued = searchWorker->submit(this, packet.getChatName(), packet.getQuery(), offset, limit,
+                                       [this, id = connection->id, requestId, offset, limit](const SearchWorker::Result& result) {
+        if (ClientConnection* connection = managerNetwork->connection(id)) {
+            SearchWorker::Result page = result;
+            /*следующая страница начиналась бы за пределом листания*/
+            if (offset + limit > PacketSearchRequest::MaxOffset) {
+                page.hasMore = false;
+            }
+            sendResult(connection, requestId, page);
+        }
+    });
+    if (!queued) {
+        logger.log(QtWarningMsg, "Очередь поиска переполнена, запрос отклонен");
+        SearchWorker::Result busy;
+        busy.status = PacketSearchResult::Status::Busy;
+        sendResult(connection, requestId, busy);
+    }
+}
+
+void PacketSearchHandler::sendResult(ClientConnection* connection, quint32 requestId, const SearchWorker::Result& result) {
+    PacketSearchResult response;
+    response.setRequestId(requestId);
+    response.setStatus(result.status);
+    response.setHasMore(result.hasMore);
+    for (const SearchHit& hit : result.hits) {
+        response.addHit(hit);
+    }
+    managerNetwork->sendMessageToUser(connection, response.serialize());
 }
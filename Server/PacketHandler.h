@@ -3,12 +3,18 @@
 
 #include <QObject>
 #include <QString>
-#include <QTcpSocket>
+#include "ClientConnection.h"
 #include <QMap>
+#include <QHash>
 #include "protocol.h"
 #include "ClientDataBase.h"
 #include "ManagerNetwork.h"
 #include "ChatManager.h"
+#include "CredentialWorkerPool.h"
+#include "SessionTokenManager.h"
+#include "IdempotencyCache.h"
+#include "BroadcastCoalescer.h"
+#include "SearchWorker.h"
 
 
 /**
@@ -21,38 +27,101 @@ public:
 
     /**
      * @brief Обрабатывает пакет регистрации.
-     * @param socket Сокет клиента.
+     * @param connection Соединение клиента.
      * @param packet Пакет регистрации.
      */
-    virtual void handle(QTcpSocket* socket, PacketRegister& packet) = 0;
+    virtual void handle(ClientConnection* connection, PacketRegister& packet) = 0;
 
     /**
      * @brief Обрабатывает пакет сообщения.
-     * @param socket Сокет клиента.
+     * @param connection Соединение клиента.
      * @param packet Пакет сообщения.
      */
-    virtual void handle(QTcpSocket* socket, PacketMessage& packet) = 0;
+    virtual void handle(ClientConnection* connection, PacketMessage& packet) = 0;
 
     /**
      * @brief Обрабатывает пакет ответа сервера.
-     * @param socket Сокет клиента.
+     * @param connection Соединение клиента.
      * @param packet Пакет ответа сервера.
      */
-    virtual void handle(QTcpSocket* socket, PacketServerResponse& packet) = 0;
+    virtual void handle(ClientConnection* connection, PacketServerResponse& packet) = 0;
 
     /**
      * @brief Обрабатывает пакет списка чатов.
-     * @param socket Сокет клиента.
+     * @param connection Соединение клиента.
      * @param packet Пакет списка чатов.
      */
-    virtual void handle(QTcpSocket* socket, PacketChatList& packet) = 0;
+    virtual void handle(ClientConnection* connection, PacketChatList& packet) = 0;
 
     /**
      * @brief Обрабатывает пакет авторизации.
-     * @param socket Сокет клиента.
+     * @param connection Соединение клиента.
      * @param packet Пакет авторизации.
      */
-    virtual void handle(QTcpSocket* socket, PacketAuth& packet) = 0;
+    virtual void handle(ClientConnection* connection, PacketAuth& packet) = 0;
+
+    /**
+     * @brief Обрабатывает пакет возобновления сессии.
+     * @param connection Соединение клиента.
+     * @param packet Пакет с токеном сессии.
+     */
+    virtual void handle(ClientConnection* connection, PacketSessionResume& packet) {}
+
+    /**
+     * @brief Обрабатывает завершение сессии пользователем.
+     * @param connection Соединение клиента.
+     * @param packet Пакет завершения сессии.
+     */
+    virtual void handle(ClientConnection* connection, PacketLogout& packet) {}
+
+    /**
+     * @brief Обрабатывает пакет изменения списка чатов.
+     * @param connection Соединение клиента.
+     * @param packet Пакет изменения списка чатов.
+     */
+    virtual void handle(ClientConnection* connection, PacketChatListDelta& packet) {}
+
+    /**
+     * @brief Обрабатывает запрос пропущенных сообщений.
+     * @param connection Соединение клиента.
+     * @param packet Пакет с последними известными клиенту номерами сообщений.
+     */
+    virtual void handle(ClientConnection* connection, PacketSyncRequest& packet) {}
+
+    /**
+     * @brief Обрабатывает пачку сообщений синхронизации.
+     * @param connection Соединение клиента.
+     * @param packet Пачка сообщений.
+     */
+    virtual void handle(ClientConnection* connection, PacketSyncBatch& packet) {}
+
+    /**
+     * @brief Обрабатывает пакет с несколькими сообщениями.
+     * @param connection Соединение клиента.
+     * @param packet Пакет сообщений.
+     */
+    virtual void handle(ClientConnection* connection, PacketMessageBatch& packet) {}
+
+    /**
+     * @brief Обрабатывает приветствие клиента с версией протокола и возможностями.
+     * @param connection Соединение клиента.
+     * @param packet Пакет приветствия.
+     */
+    virtual void handle(ClientConnection* connection, PacketHello& packet) {}
+
+    /**
+     * @brief Обрабатывает запрос поиска по истории сообщений.
+     * @param connection Соединение клиента.
+     * @param packet Пакет с текстом запроса и страницей.
+     */
+    virtual void handle(ClientConnection* connection, PacketSearchRequest& packet) {}
+
+    /**
+     * @brief Обрабатывает страницу результатов поиска.
+     * @param connection Соединение клиента.
+     * @param packet Пакет с результатами.
+     */
+    virtual void handle(ClientConnection* connection, PacketSearchResult& packet) {}
 
 protected:
     QString salt; ///< Соль для авторизации.
@@ -68,21 +137,27 @@ class PacketRegisterHandler : public QObject, public PacketHandler {
 private:
     ClientDataBase* clientDataBase;
     ManagerNetwork* managerNetwork;
+    CredentialWorkerPool* workerPool;
+
+    void sendRegisterResponse(ClientConnection* connection, const QString& username,
+                              CredentialWorkerPool::RegisterStatus status);
 
 public:
     /**
      * @brief Конструктор класса PacketRegisterHandler.
      * @param db Указатель на базу данных клиентов.
      * @param managerNetwork Указатель на менеджер сети.
+     * @param workerPool Пул потоков для хэширования паролей и запросов к БД.
      * @param parent Родительский объект.
      */
-    PacketRegisterHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+    PacketRegisterHandler(ClientDataBase* db, ManagerNetwork* managerNetwork,
+                          CredentialWorkerPool* workerPool, QObject* parent = nullptr);
 
-    void handle(QTcpSocket* socket, PacketAuth& packet) override {}
-    void handle(QTcpSocket* socket, PacketRegister& packet) override;
-    void handle(QTcpSocket* socket, PacketMessage& packet) override {}
-    void handle(QTcpSocket* socket, PacketChatList& packet) override {}
-    void handle(QTcpSocket* socket, PacketServerResponse& packet) override {}
+    void handle(ClientConnection* connection, PacketAuth& packet) override {}
+    void handle(ClientConnection* connection, PacketRegister& packet) override;
+    void handle(ClientConnection* connection, PacketMessage& packet) override {}
+    void handle(ClientConnection* connection, PacketChatList& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
 
 signals:
     void registrationSuccess(const QString& username); ///< Сигнал успешной регистрации.
@@ -99,27 +174,41 @@ class PacketAuthHandler : public QObject, public PacketHandler {
 private:
     ClientDataBase* clientDataBase;
     ManagerNetwork* managerNetwork;
+    CredentialWorkerPool* workerPool;
+    SessionTokenManager* sessionTokens;
 
     struct AuthState {
         QString username;
         bool hasSentSalt;
     };
-    QMap<QTcpSocket*, AuthState> socketStates;
+    QHash<ClientConnection*, AuthState> connectionStates;
+
+    void sendAuthFailed(ClientConnection* connection, const QString& message);
+    void sendAuthSuccess(ClientConnection* connection, const QString& username, qint64 tokenGeneration);
 
 public:
     /**
      * @brief Конструктор класса PacketAuthHandler.
      * @param db Указатель на базу данных клиентов.
      * @param managerNetwork Указатель на менеджер сети.
+     * @param workerPool Пул потоков для запросов к базе пользователей.
+     * @param sessionTokens Менеджер токенов сессии.
      * @param parent Родительский объект.
      */
-    PacketAuthHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+    PacketAuthHandler(ClientDataBase* db, ManagerNetwork* managerNetwork,
+                      CredentialWorkerPool* workerPool, SessionTokenManager* sessionTokens,
+                      QObject* parent = nullptr);
+
+    void handle(ClientConnection* connection, PacketAuth& packet) override;
+    void handle(ClientConnection* connection, PacketSessionResume& packet) override;
+    void handle(ClientConnection* connection, PacketLogout& packet) override;
+    void handle(ClientConnection* connection, PacketRegister& packet) override {}
+    void handle(ClientConnection* connection, PacketMessage& packet) override {}
+    void handle(ClientConnection* connection, PacketChatList& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
 
-    void handle(QTcpSocket* socket, PacketAuth& packet) override;
-    void handle(QTcpSocket* socket, PacketRegister& packet) override {}
-    void handle(QTcpSocket* socket, PacketMessage& packet) override {}
-    void handle(QTcpSocket* socket, PacketChatList& packet) override {}
-    void handle(QTcpSocket* socket, PacketServerResponse& packet) override {}
+public slots:
+    void onClientDisconnected(ClientConnection* connection); ///< Сбрасывает незавершенную аутентификацию соединения.
 
 signals:
     void authSuccess();                     ///< Сигнал успешной авторизации.
@@ -137,6 +226,13 @@ private:
     ClientDataBase* clientDataBase;
     ManagerNetwork* managerNetwork;
     ChatManager* chatManager;
+    BroadcastCoalescer* broadcaster;
+    IdempotencyCache idempotency;
+
+    bool accept(ClientConnection* connection, const QString& sender, QMap<QString, QString>& userData,
+                const PacketMessage& packet);
+    void resendAccepted(ClientConnection* connection, const IdempotencyCache::Entry& accepted, const QString& key);
+    void sendRejected(ClientConnection* connection, const PacketMessage& message);
 
 public:
     /**
@@ -144,15 +240,18 @@ public:
      * @param db Указатель на базу данных клиентов.
      * @param managerNetwork Указатель на менеджер сети.
      * @param chatManager Указатель на менеджер чатов.
+     * @param broadcaster Объединитель рассылки сообщений.
      * @param parent Родительский объект.
      */
-    PacketMessageHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, ChatManager* chatManager, QObject* parent = nullptr);
+    PacketMessageHandler(ClientDataBase* db, ManagerNetwork* managerNetwork, ChatManager* chatManager,
+                         BroadcastCoalescer* broadcaster, QObject* parent = nullptr);
 
-    void handle(QTcpSocket* socket, PacketAuth& packet) override {}
-    void handle(QTcpSocket* socket, PacketRegister& packet) override {}
-    void handle(QTcpSocket* socket, PacketMessage& packet) override;
-    void handle(QTcpSocket* socket, PacketChatList& packet) override {}
-    void handle(QTcpSocket* socket, PacketServerResponse& packet) override {}
+    void handle(ClientConnection* connection, PacketAuth& packet) override {}
+    void handle(ClientConnection* connection, PacketRegister& packet) override {}
+    void handle(ClientConnection* connection, PacketMessage& packet) override;
+    void handle(ClientConnection* connection, PacketMessageBatch& packet) override;
+    void handle(ClientConnection* connection, PacketChatList& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
 
 signals:
     void messageReceived(const QString& firstName, const QString& lastName,
@@ -180,13 +279,99 @@ public:
      */
     PacketChatListHandler(ChatManager* manager, ManagerNetwork* managerNetwork, QObject* parent = nullptr);
 
-    void handle(QTcpSocket* socket, PacketAuth& packet) override {}
-    void handle(QTcpSocket* socket, PacketRegister& packet) override {}
-    void handle(QTcpSocket* socket, PacketMessage& packet) override {}
-    void handle(QTcpSocket* socket, PacketServerResponse& packet) override {}
-    void handle(QTcpSocket* socket, PacketChatList& packet) override;
+    void handle(ClientConnection* connection, PacketAuth& packet) override {}
+    void handle(ClientConnection* connection, PacketRegister& packet) override {}
+    void handle(ClientConnection* connection, PacketMessage& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
+    void handle(ClientConnection* connection, PacketChatList& packet) override;
 
 signals:
     void chatListReceived(const QStringList& chatList); ///< Сигнал получения списка чатов.
 };
+
+/**
+ * @brief Класс PacketSyncHandler.
+ * Отправляет клиенту сообщения, пропущенные им во время отключения.
+ */
+class PacketSyncHandler : public QObject, public PacketHandler {
+    Q_OBJECT
+
+private:
+    ChatManager* chatManager;
+    ManagerNetwork* managerNetwork;
+
+public:
+    static constexpr int BatchSize = 200; ///< Максимум сообщений в одной пачке.
+
+    /**
+     * @brief Конструктор класса PacketSyncHandler.
+     * @param manager Указатель на менеджер чатов.
+     * @param managerNetwork Указатель на менеджер сети.
+     * @param parent Родительский объект.
+     */
+    PacketSyncHandler(ChatManager* manager, ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+
+    void handle(ClientConnection* connection, PacketAuth& packet) override {}
+    void handle(ClientConnection* connection, PacketRegister& packet) override {}
+    void handle(ClientConnection* connection, PacketMessage& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
+    void handle(ClientConnection* connection, PacketChatList& packet) override {}
+    void handle(ClientConnection* connection, PacketSyncRequest& packet) override;
+};
+
+/**
+ * @brief Класс PacketHelloHandler.
+ * Согласует с клиентом версию протокола и возможности соединения.
+ */
+class PacketHelloHandler : public QObject, public PacketHandler {
+    Q_OBJECT
+
+private:
+    ManagerNetwork* managerNetwork;
+
+public:
+    /**
+     * @brief Конструктор класса PacketHelloHandler.
+     * @param managerNetwork Указатель на менеджер сети.
+     * @param parent Родительский объект.
+     */
+    PacketHelloHandler(ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+
+    void handle(ClientConnection* connection, PacketAuth& packet) override {}
+    void handle(ClientConnection* connection, PacketRegister& packet) override {}
+    void handle(ClientConnection* connection, PacketMessage& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
+    void handle(ClientConnection* connection, PacketChatList& packet) override {}
+    void handle(ClientConnection* connection, PacketHello& packet) override;
+};
+
+/**
+ * @brief Класс PacketSearchHandler.
+ * Передает запросы поиска в поток хранилища и отправляет клиенту результаты.
+ */
+class PacketSearchHandler : public QObject, public PacketHandler {
+    Q_OBJECT
+
+private:
+    SearchWorker* searchWorker;
+    ManagerNetwork* managerNetwork;
+
+    void sendResult(ClientConnection* connection, quint32 requestId, const SearchWorker::Result& result);
+
+public:
+    /**
+     * @brief Конструктор класса PacketSearchHandler.
+     * @param searchWorker Поток поиска.
+     * @param managerNetwork Указатель на менеджер сети.
+     * @param parent Родительский объект.
+     */
+    PacketSearchHandler(SearchWorker* searchWorker, ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+
+    void handle(ClientConnection* connection, PacketAuth& packet) override {}
+    void handle(ClientConnection* connection, PacketRegister& packet) override {}
+    void handle(ClientConnection* connection, PacketMessage& packet) override {}
+    void handle(ClientConnection* connection, PacketServerResponse& packet) override {}
+    void handle(ClientConnection* connection, PacketChatList& packet) override {}
+    void handle(ClientConnection* connection, PacketSearchRequest& packet) override;
+};
 #endif // PACKETHANDLER_H
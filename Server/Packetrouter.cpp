@@ -1,6 +1,8 @@
 #include "Packetrouter.h"
 #include "packethandler.h"
 #include "logger.h"
+#include "RateLimiter.h"
+#include "Tracer.h"
 PacketRouter::PacketRouter(QObject *parent)
     : QObject(parent)
 {
@@ -16,24 +18,63 @@ void PacketRouter::registerHandler(PacketHandler* handler) {
     }
 }
 
-void PacketRouter::routePacket(QTcpSocket* socket, const QByteArray& data) {
-    std::shared_ptr<Packet> packet = Packet::deserialize(data);
+/**
+ * @brief Устанавливает ограничитель частоты, который проверяет пакеты до разбора.
+ * @param limiter Ограничитель частоты или nullptr, чтобы отключить проверку.
+ */
+void PacketRouter::setRateLimiter(RateLimiter* limiter) {
+    rateLimiter = limiter;
+}
+
+void PacketRouter::routePacket(ClientConnection* connection, const QByteArray& data) {
     Logger& logger = Logger::getInstance();
+    if (rateLimiter && !data.isEmpty()) {
+        /* Тип пакета - первый байт заголовка, разбирать весь пакет не нужно*/
+        PacketType rawType = Packet::frameType(data);
+        Tracer::Span span("rate_limit");
+        RateLimiter::Verdict verdict = rateLimiter->check(connection, rawType);
+        if (!verdict.allowed) {
+            emit packetRejected(connection, rawType, verdict.retryAfterMs, verdict.banned, verdict.notify);
+            return;
+        }
+    }
+
+    std::shared_ptr<Packet> packet;
+    {
+        Tracer::Span span("decode");
+        packet = Packet::deserialize(data);
+    }
     if (!packet) {
         logger.log(QtWarningMsg, "Не удалось десериализовать пакет!");
         return;
     }
 
+    /* Кадр пачки уже оплачен, но каждое сообщение в ней списывается
+       с корзин Message, иначе пачка обходит лимит на сообщения*/
+    if (rateLimiter && packet->getType() == PacketType::MessageBatch) {
+        const int count = static_cast<PacketMessageBatch*>(packet.get())->size();
+        Tracer::Span span("rate_limit");
+        RateLimiter::Verdict verdict = rateLimiter->check(connection, PacketType::Message, count);
+        if (!verdict.allowed) {
+            emit packetRejected(connection, PacketType::Message, verdict.retryAfterMs, verdict.banned, verdict.notify);
+            return;
+        }
+    }
+
 
     PacketType type = packet->getType();
     logger.log(QtInfoMsg, QString("Получен пакет типа: %1").arg(static_cast<int>(type)));
     bool handled = false;
+    Tracer::Span span("handle");
+    if (span.isRecording()) {
+        span.setDetail(Packet::typeName(type));
+    }
     for (PacketHandler* handler : handlers) {
         switch (type) {
         case PacketType::Register: {
             PacketRegister* registerPacket = dynamic_cast<PacketRegister*>(packet.get());
             if (registerPacket != nullptr) {
-                handler->handle(socket, *registerPacket);
+                handler->handle(connection, *registerPacket);
                 handled = true;
             }
             break;
@@ -41,7 +82,7 @@ void PacketRouter::routePacket(QTcpSocket* socket, const QByteArray& data) {
         case PacketType::Auth: {
             PacketAuth* packetAuth = dynamic_cast<PacketAuth*>(packet.get());
             if (packetAuth != nullptr) {
-                handler->handle(socket, *packetAuth);
+                handler->handle(connection, *packetAuth);
                 handled = true;
             }
             break;
@@ -49,7 +90,7 @@ void PacketRouter::routePacket(QTcpSocket* socket, const QByteArray& data) {
         case PacketType::Message: {
             PacketMessage* messagePacket = dynamic_cast<PacketMessage*>(packet.get());
             if (messagePacket) {
-                handler->handle(socket, *messagePacket);
+                handler->handle(connection, *messagePacket);
                 handled = true;
             }
             break;
@@ -57,7 +98,7 @@ void PacketRouter::routePacket(QTcpSocket* socket, const QByteArray& data) {
         case PacketType::ServerResponse: {
             PacketServerResponse* serverResponsePacket = dynamic_cast<PacketServerResponse*>(packet.get());
             if (serverResponsePacket) {
-                handler->handle(socket, *serverResponsePacket);
+                handler->handle(connection, *serverResponsePacket);
                 handled = true;
             }
             break;
@@ -65,7 +106,55 @@ void PacketRouter::routePacket(QTcpSocket* socket, const QByteArray& data) {
         case PacketType::ChatList: {
             PacketChatList* packetChatList = dynamic_cast<PacketChatList*>(packet.get());
             if (packetChatList) {
-                handler->handle(socket, *packetChatList);
+                handler->handle(connection, *packetChatList);
+                handled = true;
+            }
+            break;
+        }
+        case PacketType::SessionResume: {
+            PacketSessionResume* resumePacket = dynamic_cast<PacketSessionResume*>(packet.get());
+            if (resumePacket) {
+                handler->handle(connection, *resumePacket);
+                handled = true;
+            }
+            break;
+        }
+        case PacketType::SyncRequest: {
+            PacketSyncRequest* syncPacket = dynamic_cast<PacketSyncRequest*>(packet.get());
+            if (syncPacket) {
+                handler->handle(connection, *syncPacket);
+                handled = true;
+            }
+            break;
+        }
+        case PacketType::MessageBatch: {
+            PacketMessageBatch* batchPacket = dynamic_cast<PacketMessageBatch*>(packet.get());
+            if (batchPacket) {
+                handler->handle(connection, *batchPacket);
+                handled = true;
+            }
+            break;
+        }
+        case PacketType::Hello: {
+            PacketHello* helloPacket = dynamic_cast<PacketHello*>(packet.get());
+            if (helloPacket) {
+                handler->handle(connection, *helloPacket);
+                handled = true;
+            }
+            break;
+        }
+        case PacketType::Logout: {
+            PacketLogout* logoutPacket = dynamic_cast<PacketLogout*>(packet.get());
+            if (logoutPacket) {
+                handler->handle(connection, *logoutPacket);
+                handled = true;
+            }
+            break;
+        }
+        case PacketType::SearchRequest: {
+            PacketSearchRequest* searchPacket = dynamic_cast<PacketSearchRequest*>(packet.get());
+            if (searchPacket) {
+                handler->handle(connection, *searchPacket);
                 handled = true;
             }
             break;
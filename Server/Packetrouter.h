@@ -3,9 +3,11 @@
 #include <QObject>
 #include "protocol.h"
 #include "packethandler.h"
-#include <QTcpSocket>
+#include "ClientConnection.h"
 #include <QList>
 
+class RateLimiter;
+
 class PacketRouter : public QObject
 {
     Q_OBJECT
@@ -13,9 +15,15 @@ public:
     PacketRouter(QObject *parent = nullptr);
 
     void registerHandler(PacketHandler* handler);
-    void routePacket(QTcpSocket* socket, const QByteArray& data);
+    void setRateLimiter(RateLimiter* limiter);
+    void routePacket(ClientConnection* connection, const QByteArray& data);
+
+signals:
+    /* Пакет отброшен ограничителем частоты до десериализации*/
+    void packetRejected(ClientConnection* connection, PacketType type, qint64 retryAfterMs, bool banned, bool notify);
 
 private:
     QVector<PacketHandler*> handlers;
+    RateLimiter* rateLimiter = nullptr;
 };
 #endif // PACKETROUTER_H
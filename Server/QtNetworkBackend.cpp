@@ -0,0 +1,100 @@
+#include "QtNetworkBackend.h"
+#include "logger.h"
+
+QtNetworkBackend::QtNetworkBackend(ConnectionSlab& slab, QObject* parent)
+    : NetworkBackend(slab, parent) {
+    connect(&server, &QTcpServer::newConnection, this, &QtNetworkBackend::onNewConnection);
+}
+
+/**
+ * @brief Начинает прием подключений.
+ * QTcpServer слушает одним сокетом в потоке сервера, поэтому число потоков
+ * приема не учитывается; длина очереди задается начиная с Qt 6.3.
+ */
+bool QtNetworkBackend::listen(const QHostAddress& address, quint16 port) {
+    if (acceptorCount > 1) {
+        Logger::getInstance().log(QtWarningMsg, "Транспорт Qt принимает подключения в одном потоке, "
+                                                "несколько потоков приема доступны только для epoll");
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    server.setListenBacklogSize(listenBacklog);
+#endif
+    return server.listen(address, port);
+}
+
+void QtNetworkBackend::close() {
+    server.close();
+}
+
+/**
+ * @brief Принимает подключения и связывает сокеты с записями соединений.
+ * За один вызов принимается не больше acceptBatch подключений, остальные -
+ * на следующей итерации цикла событий, чтобы волна переподключений не
+ * задерживала обработку уже подключенных клиентов.
+ * Обработчики сокета находят запись по id, так как к моменту сигнала
+ * запись могла быть уже возвращена в пул.
+ */
+void QtNetworkBackend::onNewConnection() {
+    for (int count = 0; count < acceptBatch; ++count) {
+        QTcpSocket* socket = server.nextPendingConnection();
+        if (!socket) {
+            return;
+        }
+        ClientConnection* connection = acquireConnection();
+        /*оборванные соединения клиентов без Ping закрывает TCP keepalive*/
+        socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+        connection->socket = socket;
+        connection->address = socket->peerAddress();
+        connection->port = socket->peerPort();
+        connection->open = true;
+        const quint64 id = connection->id;
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, id]() {
+            ClientConnection* connection = slab.find(id);
+            if (!connection || !connection->open) {
+                socket->readAll();
+                return;
+            }
+            connection->readBuffer.append(socket->readAll());
+            emit readyRead(connection);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket, id]() {
+            ClientConnection* connection = slab.find(id);
+            if (connection && connection->open) {
+                connection->open = false;
+                connection->socket = nullptr;
+                emit closed(connection, socket->error() == QAbstractSocket::UnknownSocketError
+                                            ? QString() : socket->errorString());
+            }
+            socket->deleteLater();
+        });
+
+        emit accepted(connection);
+    }
+    if (server.hasPendingConnections()) {
+        QMetaObject::invokeMethod(this, &QtNetworkBackend::onNewConnection, Qt::QueuedConnection);
+    }
+}
+
+void QtNetworkBackend::write(ClientConnection* connection, const QByteArray& data) {
+    if (connection->socket && connection->socket->state() == QAbstractSocket::ConnectedState) {
+        connection->socket->write(data);
+    }
+}
+
+/**
+ * @brief Закрывает соединение. Сигнал closed испускается из обработчика
+ * disconnected сокета, при abort() - синхронно.
+ */
+void QtNetworkBackend::closeConnection(ClientConnection* connection, bool graceful) {
+    QTcpSocket* socket = connection->socket;
+    if (!socket) {
+        return;
+    }
+    if (graceful) {
+        socket->flush();
+        socket->disconnectFromHost();
+    } else {
+        socket->abort();
+    }
+}
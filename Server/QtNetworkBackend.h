@@ -0,0 +1,34 @@
+#ifndef QTNETWORKBACKEND_H
+#define QTNETWORKBACKEND_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "NetworkBackend.h"
+
+/**
+ * @brief Класс QtNetworkBackend - транспорт на QTcpServer и QTcpSocket.
+ * Переносим на все платформы, но каждое соединение стоит QObject,
+ * набор соединений сигналов и внутренние буферы сокета.
+ */
+class QtNetworkBackend : public NetworkBackend {
+    Q_OBJECT
+
+public:
+    explicit QtNetworkBackend(ConnectionSlab& slab, QObject* parent = nullptr);
+
+    bool listen(const QHostAddress& address, quint16 port) override;
+    void close() override;
+    bool isListening() const override { return server.isListening(); }
+    QString errorString() const override { return server.errorString(); }
+
+    void write(ClientConnection* connection, const QByteArray& data) override;
+    void closeConnection(ClientConnection* connection, bool graceful) override;
+
+private slots:
+    void onNewConnection();
+
+private:
+    QTcpServer server;
+};
+
+#endif // QTNETWORKBACKEND_H
@@ -0,0 +1,279 @@
+#include "RateLimiter.h"
+#include "logger.h"
+#include <cmath>
+
+/**
+ * @brief Конструктор класса RateLimiter.
+ * Задает лимиты по умолчанию для пакетов, которые обходятся серверу дороже
+ * всего: сообщения (запись в БД и рассылка всем) и аутентификация.
+ * @param managerNetwork Менеджер сети.
+ * @param parent Родительский объект.
+ */
+RateLimiter::RateLimiter(ManagerNetwork* managerNetwork, QObject* parent)
+    : QObject(parent), managerNetwork(managerNetwork) {
+    clock.start();
+
+    setLimit(Scope::Connection, PacketType::Message, {5, 10});
+    setLimit(Scope::User, PacketType::Message, {8, 20});
+    setLimit(Scope::Address, PacketType::Message, {50, 100});
+
+    /*пачка несет до PacketMessageBatch::MaxMessages сообщений; кроме кадра,
+      каждое ее сообщение списывается с корзин Message*/
+    setLimit(Scope::Connection, PacketType::MessageBatch, {1, 3});
+    setLimit(Scope::User, PacketType::MessageBatch, {2, 5});
+    setLimit(Scope::Address, PacketType::MessageBatch, {10, 20});
+
+    setLimit(Scope::Connection, PacketType::Auth, {1, 5});
+    setLimit(Scope::Address, PacketType::Auth, {5, 20});
+
+    setLimit(Scope::Connection, PacketType::SessionResume, {1, 3});
+    setLimit(Scope::Address, PacketType::SessionResume, {10, 30});
+    setLimit(Scope::Connection, PacketType::Logout, {0.2, 3});
+
+    setLimit(Scope::Connection, PacketType::Register, {0.2, 3});
+    setLimit(Scope::Address, PacketType::Register, {0.5, 5});
+
+    setLimit(Scope::Connection, PacketType::ChatList, {2, 5});
+    setLimit(Scope::Connection, PacketType::SyncRequest, {10, 50});
+    setLimit(Scope::Connection, PacketType::Hello, {0.2, 3});
+
+    /*поиск по мере ввода: короткие всплески, но каждый запрос - работа с базой*/
+    setLimit(Scope::Connection, PacketType::SearchRequest, {2, 10});
+    setLimit(Scope::User, PacketType::SearchRequest, {4, 20});
+
+    connect(&sweepTimer, &QTimer::timeout, this, &RateLimiter::sweep);
+    sweepTimer.start(60000);
+}
+
+/**
+ * @brief Устанавливает лимит для типа пакета в указанной области.
+ * @param scope Область действия лимита.
+ * @param type Тип пакета.
+ * @param limit Скорость пополнения и емкость корзины.
+ */
+void RateLimiter::setLimit(Scope scope, PacketType type, const Limit& limit) {
+    limits.insert(qMakePair(static_cast<qint8>(scope), static_cast<qint8>(type)), limit);
+}
+
+/**
+ * @brief Настраивает временную блокировку адресов.
+ * @param violations Число отказов за окно, после которого адрес блокируется.
+ * @param windowMs Длина окна подсчета отказов.
+ * @param banMs Длительность блокировки, 0 отключает блокировки.
+ */
+void RateLimiter::setBanPolicy(int violations, qint64 windowMs, qint64 banMs) {
+    banViolations = violations;
+    banWindowMs = windowMs;
+    banDurationMs = banMs;
+}
+
+/**
+ * @brief Загружает лимиты из настроек.
+ * Ключи имеют вид rate_limit/<Область>/<Тип пакета> = "скорость,емкость",
+ * например rate_limit/Connection/Message = "5,10".
+ * @param settings Настройки сервера.
+ */
+void RateLimiter::loadSettings(QSettings& settings) {
+    settings.beginGroup("rate_limit");
+    const Scope scopes[] = {Scope::Connection, Scope::User, Scope::Address};
+    for (Scope scope : scopes) {
+        for (qint8 t = static_cast<qint8>(PacketType::Register); t <= static_cast<qint8>(LastPacketType); ++t) {
+            PacketType type = static_cast<PacketType>(t);
+            QString key = scopeName(scope) + "/" + Packet::typeName(type);
+            if (!settings.contains(key)) {
+                continue;
+            }
+            QStringList parts = settings.value(key).toString().split(',');
+            if (parts.size() != 2) {
+                Logger::getInstance().log(QtWarningMsg, QString("Некорректный лимит %1 в настройках").arg(key));
+                continue;
+            }
+            setLimit(scope, type, {parts[0].trimmed().toDouble(), parts[1].trimmed().toDouble()});
+        }
+    }
+    setBanPolicy(settings.value("ban_violations", banViolations).toInt(),
+                 settings.value("ban_window_sec", banWindowMs / 1000).toLongLong() * 1000,
+                 settings.value("ban_duration_sec", banDurationMs / 1000).toLongLong() * 1000);
+    settings.endGroup();
+}
+
+/**
+ * @brief Пополняет корзину по прошедшему времени и возвращает ее.
+ * Новая корзина создается заполненной.
+ */
+template <typename Map, typename Key>
+RateLimiter::Bucket& RateLimiter::refill(Map& buckets, const Key& key, const Limit& limit, qint64 nowMs) {
+    auto it = buckets.find(key);
+    if (it == buckets.end()) {
+        it = buckets.insert(key, Bucket{limit.burst, nowMs});
+        return it.value();
+    }
+    Bucket& bucket = it.value();
+    double elapsed = (nowMs - bucket.updatedMs) / 1000.0;
+    bucket.tokens = qMin(limit.burst, bucket.tokens + elapsed * limit.ratePerSecond);
+    bucket.updatedMs = nowMs;
+    return bucket;
+}
+
+/**
+ * @brief Время до появления в корзине нужного числа токенов.
+ * Списание больше емкости корзины допускается из полной корзины: токены
+ * уходят в минус, и следующий запрос ждет, пока долг не восполнится.
+ * Иначе пачка больше burst не прошла бы никогда.
+ */
+qint64 RateLimiter::waitMs(const Bucket& bucket, const Limit& limit, double cost) {
+    const double needed = qMin(cost, limit.burst);
+    if (bucket.tokens >= needed || limit.ratePerSecond <= 0) {
+        return 0;
+    }
+    return static_cast<qint64>(std::ceil((needed - bucket.tokens) / limit.ratePerSecond * 1000.0));
+}
+
+QString RateLimiter::scopeName(Scope scope) {
+    switch (scope) {
+    case Scope::Connection: return "Connection";
+    case Scope::User:       return "User";
+    case Scope::Address:    return "Address";
+    }
+    return "Unknown";
+}
+
+/**
+ * @brief Проверяет, можно ли обработать пакет.
+ * Токены списываются сразу из всех корзин и только если во всех их хватает,
+ * чтобы отклоненный пакет не расходовал лимиты других областей.
+ * У соединений локального сокета нет своего адреса, поэтому для них
+ * не ведутся корзина Address и блокировка адреса: иначе все локальные
+ * клиенты делили бы одну корзину и одну блокировку.
+ * @param connection Соединение клиента.
+ * @param type Тип пакета.
+ * @param cost Число токенов: для пачки сообщений - число сообщений в ней.
+ * @return Решение ограничителя.
+ */
+RateLimiter::Verdict RateLimiter::check(ClientConnection* connection, PacketType type, double cost) {
+    qint64 nowMs = clock.elapsed();
+    QHostAddress address = connection->peerAddress();
+
+    if (!connection->local && isBanned(address)) {
+        Verdict verdict;
+        verdict.allowed = false;
+        verdict.banned = true;
+        verdict.retryAfterMs = offenders.value(address).bannedUntilMs - nowMs;
+        return verdict;
+    }
+
+    const qint8 t = static_cast<qint8>(type);
+    const Limit connectionLimit = limits.value(qMakePair(static_cast<qint8>(Scope::Connection), t));
+    const Limit userLimit = limits.value(qMakePair(static_cast<qint8>(Scope::User), t));
+    const Limit addressLimit = limits.value(qMakePair(static_cast<qint8>(Scope::Address), t));
+    const QString username = managerNetwork->userForConnection(connection);
+
+    Bucket* buckets[3] = {nullptr, nullptr, nullptr};
+    qint64 retryAfterMs = 0;
+
+    if (connectionLimit.ratePerSecond > 0) {
+        buckets[0] = &refill(connectionBuckets[connection], t, connectionLimit, nowMs);
+        retryAfterMs = qMax(retryAfterMs, waitMs(*buckets[0], connectionLimit, cost));
+    }
+    if (userLimit.ratePerSecond > 0 && !username.isEmpty()) {
+        buckets[1] = &refill(userBuckets, qMakePair(username, t), userLimit, nowMs);
+        retryAfterMs = qMax(retryAfterMs, waitMs(*buckets[1], userLimit, cost));
+    }
+    if (addressLimit.ratePerSecond > 0 && !connection->local) {
+        buckets[2] = &refill(addressBuckets, qMakePair(address, t), addressLimit, nowMs);
+        retryAfterMs = qMax(retryAfterMs, waitMs(*buckets[2], addressLimit, cost));
+    }
+
+    if (retryAfterMs > 0) {
+        return registerViolation(connection, address, retryAfterMs, nowMs);
+    }
+
+    for (Bucket* bucket : buckets) {
+        if (bucket) {
+            bucket->tokens -= cost;
+        }
+    }
+    return Verdict();
+}
+
+/**
+ * @brief Учитывает отказ и при необходимости блокирует адрес.
+ * Ответ об отказе отправляется клиенту не чаще раза в секунду,
+ * чтобы флуд не превращался в такой же поток исходящих ответов.
+ */
+RateLimiter::Verdict RateLimiter::registerViolation(ClientConnection* connection, const QHostAddress& address,
+                                                    qint64 retryAfterMs, qint64 nowMs) {
+    Verdict verdict;
+    verdict.allowed = false;
+    verdict.retryAfterMs = retryAfterMs;
+
+    if (banDurationMs > 0 && !connection->local) {
+        Offender& offender = offenders[address];
+        if (nowMs - offender.windowStartMs > banWindowMs) {
+            offender.windowStartMs = nowMs;
+            offender.violations = 0;
+        }
+        if (++offender.violations >= banViolations) {
+            offender.bannedUntilMs = nowMs + banDurationMs;
+            verdict.banned = true;
+            verdict.retryAfterMs = banDurationMs;
+            Logger::getInstance().log(QtWarningMsg, QString("Адрес %1 временно заблокирован на %2 с за превышение лимитов")
+                                                        .arg(address.toString()).arg(banDurationMs / 1000));
+        }
+    }
+
+    auto last = lastNotifyMs.find(connection);
+    if (verdict.banned || last == lastNotifyMs.end() || nowMs - last.value() >= 1000) {
+        lastNotifyMs.insert(connection, nowMs);
+        verdict.notify = true;
+    }
+    return verdict;
+}
+
+/**
+ * @brief Проверяет, заблокирован ли адрес.
+ * @param address IP-адрес клиента.
+ * @return true, если срок блокировки еще не истек.
+ */
+bool RateLimiter::isBanned(const QHostAddress& address) {
+    auto it = offenders.constFind(address);
+    return it != offenders.constEnd() && it.value().bannedUntilMs > clock.elapsed();
+}
+
+/**
+ * @brief Удаляет корзины отключившегося соединения.
+ * @param connection Соединение клиента.
+ */
+void RateLimiter::onClientDisconnected(ClientConnection* connection) {
+    connectionBuckets.remove(connection);
+    lastNotifyMs.remove(connection);
+}
+
+/**
+ * @brief Периодически удаляет простаивающие корзины и истекшие блокировки,
+ * чтобы таблицы не росли с числом когда-либо подключавшихся адресов.
+ */
+void RateLimiter::sweep() {
+    const qint64 nowMs = clock.elapsed();
+    const qint64 idleMs = 60000;
+
+    auto sweepBuckets = [nowMs, idleMs](auto& buckets) {
+        for (auto it = buckets.begin(); it != buckets.end();) {
+            if (nowMs - it.value().updatedMs > idleMs) {
+                it = buckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    };
+    sweepBuckets(userBuckets);
+    sweepBuckets(addressBuckets);
+
+    for (auto it = offenders.begin(); it != offenders.end();) {
+        if (it.value().bannedUntilMs <= nowMs && nowMs - it.value().windowStartMs > banWindowMs) {
+            it = offenders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
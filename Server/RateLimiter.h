@@ -0,0 +1,106 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPair>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QSettings>
+#include "ClientConnection.h"
+#include "protocol.h"
+#include "ManagerNetwork.h"
+
+/**
+ * @brief Класс RateLimiter - ограничение частоты входящих пакетов.
+ *
+ * Для каждого типа пакета ведутся три корзины токенов: на соединение,
+ * на аутентифицированного пользователя и на IP-адрес. Пакет пропускается,
+ * только если во всех корзинах есть токен. Адрес, который слишком часто
+ * упирается в лимит, может быть временно заблокирован.
+ */
+class RateLimiter : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Scope : qint8 {
+        Connection, /*на одно соединение*/
+        User,       /*на пользователя, прошедшего аутентификацию*/
+        Address     /*на IP-адрес клиента*/
+    };
+
+    struct Limit {
+        double ratePerSecond = 0; /*0 - без ограничения*/
+        double burst = 0;         /*емкость корзины*/
+    };
+
+    struct Verdict {
+        bool allowed = true;
+        bool banned = false;
+        bool notify = false;    /*стоит ли отправлять клиенту ответ об отказе*/
+        qint64 retryAfterMs = 0;
+    };
+
+    /**
+     * @brief Конструктор класса RateLimiter.
+     * @param managerNetwork Менеджер сети (для определения пользователя по соединению).
+     * @param parent Родительский объект.
+     */
+    explicit RateLimiter(ManagerNetwork* managerNetwork, QObject* parent = nullptr);
+
+    void setLimit(Scope scope, PacketType type, const Limit& limit);
+    void setBanPolicy(int violations, qint64 windowMs, qint64 banMs);
+    void loadSettings(QSettings& settings);
+
+    Verdict check(ClientConnection* connection, PacketType type, double cost = 1.0);
+    bool isBanned(const QHostAddress& address);
+
+public slots:
+    void onClientDisconnected(ClientConnection* connection);
+
+private slots:
+    void sweep();
+
+private:
+    struct Bucket {
+        double tokens = 0;
+        qint64 updatedMs = 0;
+    };
+
+    struct Offender {
+        int violations = 0;
+        qint64 windowStartMs = 0;
+        qint64 bannedUntilMs = 0;
+    };
+
+    template <typename Key>
+    using BucketMap = QHash<QPair<Key, qint8>, Bucket>;
+
+    template <typename Map, typename Key>
+    static Bucket& refill(Map& buckets, const Key& key, const Limit& limit, qint64 nowMs);
+    static qint64 waitMs(const Bucket& bucket, const Limit& limit, double cost);
+    static QString scopeName(Scope scope);
+
+    Verdict registerViolation(ClientConnection* connection, const QHostAddress& address, qint64 retryAfterMs, qint64 nowMs);
+
+    ManagerNetwork* managerNetwork;
+    QHash<QPair<qint8, qint8>, Limit> limits; /*(область, тип пакета) -> лимит*/
+
+    /*корзины соединения лежат вместе, чтобы при отключении удалять их одной операцией*/
+    QHash<ClientConnection*, QHash<qint8, Bucket>> connectionBuckets;
+    BucketMap<QString> userBuckets;
+    BucketMap<QHostAddress> addressBuckets;
+
+    QHash<QHostAddress, Offender> offenders;
+    QHash<ClientConnection*, qint64> lastNotifyMs;
+
+    int banViolations = 50;
+    qint64 banWindowMs = 10000;
+    qint64 banDurationMs = 60000; /*0 - блокировки отключены*/
+
+    QElapsedTimer clock;
+    QTimer sweepTimer;
+};
+
+#endif // RATELIMITER_H
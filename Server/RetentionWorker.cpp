@@ -0,0 +1,359 @@
+#include "RetentionWorker.h"
+#include "ChatShards.h"
+#include "MessageArchive.h"
+#include "Metrics.h"
+#include "logger.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDateTime>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
+
+namespace {
+constexpr qint64 MsPerDay = 24LL * 3600 * 1000;
+
+MetricHistogram& operationLatency(const char* op) {
+    return Metrics::getInstance().histogram("messenger_db_op_seconds", "Database operation latency",
+                                            Metrics::label("db", "chat") + "," + Metrics::label("op", op), 1e-6);
+}
+
+QString connectionName(int shard) {
+    return shard == 0 ? QString("ChatRetention") : QString("ChatRetention.%1").arg(shard);
+}
+}
+
+/**
+ * @brief RetentionStorage - соединения с частями базы чатов в потоке сроков хранения.
+ * Политики и список чатов читаются из каталога - части 0.
+ * Все методы вызываются только из этого потока.
+ */
+class RetentionStorage : public QObject {
+public:
+    RetentionStorage(const QStringList& paths, const QString& archiveDirectory, qint64 segmentBytes,
+                     RetentionWorker* owner)
+        : archiveDirectory(archiveDirectory), segmentBytes(segmentBytes), owner(owner),
+          expiredMessages(Metrics::getInstance().counter("messenger_retention_messages_total",
+                                                         "Messages archived and deleted by retention policies")),
+          vacuumedPages(Metrics::getInstance().counter("messenger_vacuum_pages_total",
+                                                       "Pages returned to the file system by incremental vacuum")) {
+        for (int i = 0; i < paths.size(); ++i) {
+            Shard shard;
+            shard.path = paths[i];
+            shard.connectionName = connectionName(i);
+            shards.append(shard);
+        }
+    }
+
+    ~RetentionStorage() {
+        archive.close();
+        for (Shard& shard : shards) {
+            if (shard.db.isValid()) {
+                shard.db.close();
+                shard.db = QSqlDatabase();
+                QSqlDatabase::removeDatabase(shard.connectionName);
+            }
+        }
+    }
+
+    void open() {
+        Logger& logger = Logger::getInstance();
+        for (Shard& shard : shards) {
+            shard.db = QSqlDatabase::addDatabase("QSQLITE", shard.connectionName);
+            shard.db.setDatabaseName(shard.path);
+            shard.db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+            if (!shard.db.open()) {
+                logger.log(QtCriticalMsg, QString("Поток сроков хранения не открыл %1: %2")
+                                              .arg(shard.path, shard.db.lastError().text()));
+                continue;
+            }
+            QSqlQuery query(shard.db);
+            shard.incrementalVacuum = query.exec("PRAGMA auto_vacuum") && query.next() && query.value(0).toInt() == 2;
+            if (!shard.incrementalVacuum) {
+                logger.log(QtWarningMsg, QString("В %1 выключен auto_vacuum = INCREMENTAL: место удаленных сообщений "
+                                                 "используется повторно, но файл не уменьшается. Чтобы включить, один "
+                                                 "раз выполните messenger-rebalance --vacuum при остановленном сервере")
+                                             .arg(shard.path));
+            }
+        }
+
+        passTimer.setSingleShot(true);
+        QObject::connect(&passTimer, &QTimer::timeout, this, [this]() { runPass(); });
+        vacuumTimer.setSingleShot(true);
+        QObject::connect(&vacuumTimer, &QTimer::timeout, this, [this]() { vacuumStep(); });
+        passTimer.start(RetentionWorker::StartDelayMs);
+    }
+
+    void setGlobalPolicy(const RetentionPolicy& policy) {
+        globalPolicy = policy;
+    }
+
+    void setSchedule(int intervalMinutes, int batch, int pages) {
+        intervalMs = qMax(1, intervalMinutes) * 60 * 1000;
+        batchSize = qMax(1, batch);
+        vacuumPages = qMax(1, pages);
+    }
+
+    /**
+     * @brief Применяет политики ко всем чатам и запускает возврат освободившихся страниц.
+     */
+    void runPass() {
+        passTimer.start(intervalMs);
+        QSqlDatabase& db = shards.front().db;
+        if (!db.isOpen()) {
+            return;
+        }
+        static MetricHistogram& latency = operationLatency("retention_pass");
+        MetricHistogram::Timer timer(latency);
+
+        QHash<QString, RetentionPolicy> policies;
+        QSqlQuery query(db);
+        if (query.exec("SELECT chat_name, max_age_days, max_count FROM chat_retention")) {
+            while (query.next()) {
+                RetentionPolicy policy;
+                policy.maxAgeDays = query.value(1).toInt();
+                policy.maxCount = query.value(2).toInt();
+                policies.insert(query.value(0).toString(), policy);
+            }
+        }
+        QList<QPair<quint32, QString>> chats;
+        if (query.exec("SELECT id, name FROM chats")) {
+            while (query.next()) {
+                chats.append(qMakePair(query.value(0).toUInt(), query.value(1).toString()));
+            }
+        }
+        query.finish();
+
+        qint64 removed = 0;
+        for (const auto& chat : chats) {
+            const RetentionPolicy policy = policies.value(chat.second, globalPolicy);
+            Shard& shard = shards[ChatShards::shardFor(chat.first, int(shards.size()))];
+            if (policy.isEmpty() || !shard.db.isOpen()) {
+                continue;
+            }
+            const qint64 count = expireChat(shard.db, chat.second, policy);
+            if (count < 0 || QThread::currentThread()->isInterruptionRequested()) {
+                break;
+            }
+            removed += count;
+        }
+        /*каждый проход пишет свой сегмент*/
+        archive.close();
+
+        if (removed > 0) {
+            Logger::getInstance().log(QtInfoMsg, QString("Сроки хранения: %1 сообщений перенесено в архив %2")
+                                                     .arg(removed).arg(archiveDirectory));
+        }
+        for (Shard& shard : shards) {
+            QSqlQuery(shard.db).exec("PRAGMA optimize");
+        }
+        vacuumShard = 0;
+        vacuumTimer.start(0);
+    }
+
+private:
+    /**
+     * @brief Архивирует и удаляет просроченные сообщения чата пачками с начала истории.
+     * Последнее сообщение чата не удаляется никогда: по нему после
+     * перезапуска восстанавливается нумерация сообщений чата.
+     * @return Число удаленных сообщений, -1 - архив недоступен.
+     */
+    qint64 expireChat(QSqlDatabase& db, const QString& chatName, const RetentionPolicy& policy) {
+        Logger& logger = Logger::getInstance();
+        QSqlQuery query(db);
+        query.prepare("SELECT MAX(seq) FROM messages WHERE chat_name = ?");
+        query.addBindValue(chatName);
+        if (!query.exec() || !query.next()) {
+            return 0;
+        }
+        const quint32 lastSeq = query.value(0).toUInt();
+        const quint32 countLimit = policy.maxCount > 0 && lastSeq > quint32(policy.maxCount)
+                                       ? lastSeq - quint32(policy.maxCount) : 0;
+        const qint64 ageLimitMs = policy.maxAgeDays > 0
+                                      ? QDateTime::currentMSecsSinceEpoch() - policy.maxAgeDays * MsPerDay : 0;
+
+        static MetricHistogram& latency = operationLatency("retention_batch");
+        qint64 removed = 0;
+        quint32 removedUpTo = 0;
+        while (!QThread::currentThread()->isInterruptionRequested()) {
+            MetricHistogram::Timer timer(latency);
+            query.prepare("SELECT seq, sender, firstName, lastName, timestamp, text FROM messages "
+                          "WHERE chat_name = ? AND seq < ? ORDER BY seq LIMIT ?");
+            query.addBindValue(chatName);
+            query.addBindValue(lastSeq);
+            query.addBindValue(batchSize);
+            if (!query.exec()) {
+                logger.log(QtWarningMsg, QString("Сроки хранения: ошибка чтения чата '%1': %2")
+                                             .arg(chatName, query.lastError().text()));
+                break;
+            }
+            QList<MessageArchive::Record> expired;
+            bool reachedLive = false;
+            while (query.next()) {
+                MessageArchive::Record record;
+                record.chatName = chatName;
+                record.seq = query.value(0).toUInt();
+                const QDateTime timestamp = QDateTime::fromString(query.value(4).toString(), Qt::ISODate);
+                record.timestampMs = timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : 0;
+                const bool tooOld = ageLimitMs > 0 && timestamp.isValid() && record.timestampMs < ageLimitMs;
+                if (record.seq > countLimit && !tooOld) {
+                    reachedLive = true;
+                    break;
+                }
+                record.sender = query.value(1).toString();
+                record.firstName = query.value(2).toString();
+                record.lastName = query.value(3).toString();
+                record.text = query.value(5).toString();
+                expired.append(record);
+            }
+            query.finish();
+            if (expired.isEmpty()) {
+                break;
+            }
+
+            if ((!archive.isOpen() && !archive.open(archiveDirectory, segmentBytes)) || !archive.append(expired)) {
+                logger.log(QtCriticalMsg, QString("Сроки хранения: архив недоступен (%1), сообщения не удаляются")
+                                              .arg(archive.errorString()));
+                removed = -1;
+                break;
+            }
+            db.transaction();
+            query.prepare("DELETE FROM messages WHERE chat_name = ? AND seq <= ?");
+            query.addBindValue(chatName);
+            query.addBindValue(expired.last().seq);
+            if (!query.exec() || !db.commit()) {
+                logger.log(QtWarningMsg, QString("Сроки хранения: ошибка удаления из чата '%1': %2")
+                                             .arg(chatName, query.lastError().text()));
+                db.rollback();
+                break;
+            }
+            removed += expired.size();
+            removedUpTo = expired.last().seq;
+            expiredMessages.increment(expired.size());
+            if (reachedLive || expired.size() < batchSize) {
+                break;
+            }
+        }
+
+        if (removedUpTo > 0) {
+            RetentionWorker* worker = owner;
+            QMetaObject::invokeMethod(worker, [worker, chatName, removedUpTo]() {
+                emit worker->messagesExpired(chatName, removedUpTo);
+            }, Qt::QueuedConnection);
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Возвращает файловой системе не больше vacuumPages свободных страниц
+     * текущей части и планирует следующую порцию этой или следующей части.
+     */
+    void vacuumStep() {
+        while (vacuumShard < shards.size() && !shards[vacuumShard].incrementalVacuum) {
+            ++vacuumShard;
+        }
+        if (vacuumShard >= shards.size()) {
+            return;
+        }
+        QSqlDatabase& db = shards[vacuumShard].db;
+        QSqlQuery query(db);
+        if (!query.exec("PRAGMA freelist_count") || !query.next()) {
+            ++vacuumShard;
+            vacuumTimer.start(0);
+            return;
+        }
+        const qint64 freePages = query.value(0).toLongLong();
+        query.finish();
+        if (freePages > 0) {
+            static MetricHistogram& latency = operationLatency("incremental_vacuum");
+            MetricHistogram::Timer timer(latency);
+            /*одна строка результата - одна освобожденная страница, выполнение идет по мере чтения*/
+            if (query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(vacuumPages))) {
+                quint64 pages = 0;
+                while (query.next()) {
+                    ++pages;
+                }
+                vacuumedPages.increment(pages);
+            }
+            query.finish();
+        }
+        if (freePages > vacuumPages) {
+            vacuumTimer.start(RetentionWorker::VacuumPauseMs);
+            return;
+        }
+        if (freePages > 0) {
+            /*в режиме WAL файл базы уменьшается при контрольной точке*/
+            QSqlQuery(db).exec("PRAGMA wal_checkpoint(PASSIVE)");
+        }
+        ++vacuumShard;
+        vacuumTimer.start(0);
+    }
+
+    struct Shard {
+        QString path;
+        QString connectionName;
+        QSqlDatabase db;
+        bool incrementalVacuum = false;
+    };
+
+    QVector<Shard> shards;
+    int vacuumShard = 0;
+    QString archiveDirectory;
+    qint64 segmentBytes;
+    RetentionWorker* owner;
+    MessageArchive archive;
+    RetentionPolicy globalPolicy;
+    QTimer passTimer{this};
+    QTimer vacuumTimer{this};
+    int intervalMs = 60 * 60 * 1000;
+    int batchSize = 1000;
+    int vacuumPages = 256;
+    MetricCounter& expiredMessages;
+    MetricCounter& vacuumedPages;
+};
+
+RetentionWorker::RetentionWorker(const QStringList& databasePaths, const QString& archiveDirectory,
+                                 qint64 segmentBytes, QObject* parent)
+    : QObject(parent), storage(new RetentionStorage(databasePaths, archiveDirectory, segmentBytes, this)) {
+    thread.setObjectName("retention");
+    storage->moveToThread(&thread);
+    connect(&thread, &QThread::finished, storage, &QObject::deleteLater);
+    /*проход не должен отнимать процессор у потока сервера*/
+    thread.start(QThread::LowestPriority);
+    QMetaObject::invokeMethod(storage, [storage = storage]() { storage->open(); }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Деструктор класса RetentionWorker.
+ * Прерывает проход после текущей пачки и закрывает соединение.
+ */
+RetentionWorker::~RetentionWorker() {
+    thread.requestInterruption();
+    thread.quit();
+    thread.wait();
+}
+
+/**
+ * @brief Задает политику для чатов, у которых нет собственной.
+ */
+void RetentionWorker::setGlobalPolicy(const RetentionPolicy& policy) {
+    QMetaObject::invokeMethod(storage, [storage = storage, policy]() {
+        storage->setGlobalPolicy(policy);
+    }, Qt::QueuedConnection);
+    Logger::getInstance().log(QtInfoMsg, QString("Общий срок хранения: %1 дней, %2 сообщений (0 - без ограничения)")
+                                             .arg(policy.maxAgeDays).arg(policy.maxCount));
+}
+
+/**
+ * @brief Задает интервал проходов, размер пачки удаления и порцию incremental_vacuum.
+ */
+void RetentionWorker::setSchedule(int intervalMinutes, int batchSize, int vacuumPages) {
+    QMetaObject::invokeMethod(storage, [storage = storage, intervalMinutes, batchSize, vacuumPages]() {
+        storage->setSchedule(intervalMinutes, batchSize, vacuumPages);
+    }, Qt::QueuedConnection);
+}
+
+void RetentionWorker::runNow() {
+    QMetaObject::invokeMethod(storage, [storage = storage]() { storage->runPass(); }, Qt::QueuedConnection);
+}
@@ -0,0 +1,65 @@
+#ifndef RETENTIONWORKER_H
+#define RETENTIONWORKER_H
+
+#include <QObject>
+#include <QThread>
+#include <QString>
+#include <QStringList>
+#include "ChatDataBase.h"
+
+class RetentionStorage;
+
+/**
+ * @brief Класс RetentionWorker - фоновое применение сроков хранения сообщений.
+ *
+ * Раз в интервал поток с низким приоритетом проходит по чатам и для
+ * каждого определяет политику: заданную для чата в chat_retention или
+ * общую. Просроченные сообщения - всегда самые старые по номеру, поэтому
+ * они выбираются с начала чата пачками: пачка сначала записывается
+ * в сегмент MessageArchive и сбрасывается на диск, и только затем
+ * удаляется из базы короткой транзакцией. Если архив записать не удалось,
+ * проход прерывается и ничего не удаляется.
+ *
+ * После прохода освободившиеся страницы возвращаются файловой системе
+ * порциями PRAGMA incremental_vacuum с паузами, чтобы запись сообщений
+ * не ждала блокировки. Это работает только в базе с auto_vacuum =
+ * INCREMENTAL: новые базы создаются так, а существующую нужно один раз
+ * перевести командой VACUUM при остановленном сервере. Каждая часть
+ * базы чатов чистится на своем соединении, по очереди.
+ */
+class RetentionWorker : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Конструктор класса RetentionWorker.
+     * @param databasePaths Пути к частям базы чатов, первая - каталог.
+     * @param archiveDirectory Каталог сегментов архива.
+     * @param segmentBytes Размер сегмента архива.
+     * @param parent Родительский объект.
+     */
+    RetentionWorker(const QStringList& databasePaths, const QString& archiveDirectory, qint64 segmentBytes,
+                    QObject* parent = nullptr);
+    ~RetentionWorker();
+
+    void setGlobalPolicy(const RetentionPolicy& policy); /* Политика чатов без собственной*/
+    void setSchedule(int intervalMinutes, int batchSize, int vacuumPages);
+    void runNow(); /* Внеочередной проход, например после изменения политики*/
+
+    static constexpr int StartDelayMs = 60 * 1000; /* первый проход - после загрузки сервера*/
+    static constexpr int VacuumPauseMs = 50;       /* пауза между порциями incremental_vacuum*/
+
+signals:
+    /**
+     * @brief Сигнал отправляется в потоке объекта, когда из чата удалены просроченные сообщения.
+     * @param chatName Имя чата.
+     * @param upToSeq Номер последнего удаленного сообщения.
+     */
+    void messagesExpired(const QString& chatName, quint32 upToSeq);
+
+private:
+    QThread thread;
+    RetentionStorage* storage; /* живет в thread, удаляется при его завершении*/
+};
+
+#endif // RETENTIONWORKER_H
@@ -0,0 +1,317 @@
+#include "SearchWorker.h"
+#include "logger.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QTimer>
+#include <QRegularExpression>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+MetricHistogram& operationLatency(const char* op) {
+    return Metrics::getInstance().histogram("messenger_db_op_seconds", "Database operation latency",
+                                            Metrics::label("db", "chat") + "," + Metrics::label("op", op), 1e-6);
+}
+
+QString connectionName(int shard) {
+    return shard == 0 ? QString("ChatSearch") : QString("ChatSearch.%1").arg(shard);
+}
+}
+
+/**
+ * @brief SearchStorage - соединения с частями базы чатов в потоке поиска.
+ * Все методы вызываются только из этого потока.
+ */
+class SearchStorage : public QObject {
+public:
+    explicit SearchStorage(const QStringList& paths) {
+        for (int i = 0; i < paths.size(); ++i) {
+            Shard shard;
+            shard.path = paths[i];
+            shard.connectionName = connectionName(i);
+            shards.append(shard);
+        }
+    }
+
+    ~SearchStorage() {
+        for (Shard& shard : shards) {
+            if (shard.db.isValid()) {
+                shard.db.close();
+                shard.db = QSqlDatabase();
+                QSqlDatabase::removeDatabase(shard.connectionName);
+            }
+        }
+    }
+
+    void open() {
+        Logger& logger = Logger::getInstance();
+        for (Shard& shard : shards) {
+            shard.db = QSqlDatabase::addDatabase("QSQLITE", shard.connectionName);
+            shard.db.setDatabaseName(shard.path);
+            shard.db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+            if (!shard.db.open()) {
+                logger.log(QtCriticalMsg, QString("Поток поиска не открыл %1: %2")
+                                              .arg(shard.path, shard.db.lastError().text()));
+                continue;
+            }
+            QSqlQuery query(shard.db);
+            shard.available = query.exec("SELECT last_rowid FROM messages_fts_state") && query.next();
+            if (!shard.available) {
+                logger.log(QtWarningMsg, QString("Полнотекстовый индекс в %1 отсутствует, поиск по нему недоступен")
+                                             .arg(shard.path));
+                continue;
+            }
+            shard.lastIndexed = query.value(0).toLongLong();
+            available = true;
+        }
+        if (!available) {
+            return;
+        }
+
+        indexTimer.setSingleShot(true);
+        QObject::connect(&indexTimer, &QTimer::timeout, this, [this]() { indexStep(); });
+        indexTimer.start(0);
+    }
+
+    void setPolicy(int batch, int interval) {
+        batchSize = qMax(1, batch);
+        intervalMs = qMax(0, interval);
+    }
+
+    /**
+     * @brief Ищет сообщения по выражению MATCH во всех частях, лучшие совпадения первыми.
+     * Перед поиском индексируется очередная пачка, чтобы только что
+     * отправленные сообщения находились без ожидания таймера. Из каждой
+     * части берутся первые offset + limit + 1 совпадений, затем они
+     * сливаются по rank; bm25 считается по статистике своей части,
+     * поэтому порядок между частями приблизительный.
+     */
+    SearchWorker::Result search(const QString& chatName, const QString& match, quint32 offset, int limit) {
+        SearchWorker::Result result;
+        if (!available) {
+            result.status = PacketSearchResult::Status::Unavailable;
+            return result;
+        }
+        for (Shard& shard : shards) {
+            indexPending(shard);
+        }
+
+        static MetricHistogram& latency = operationLatency("search");
+        MetricHistogram::Timer timer(latency);
+        /*одна часть отдает страницу сама, без слияния*/
+        const bool merge = shards.size() > 1;
+        QList<QPair<double, SearchHit>> ranked;
+        for (Shard& shard : shards) {
+            if (!shard.available) {
+                continue;
+            }
+            QSqlQuery query(shard.db);
+            query.prepare(QString("SELECT m.chat_name, m.seq, m.sender, m.firstName, m.lastName, m.timestamp, "
+                                  "snippet(messages_fts, 0, char(2), char(3), '…', 16), rank "
+                                  "FROM messages_fts JOIN messages m ON m.id = messages_fts.rowid "
+                                  "WHERE messages_fts MATCH ? %1"
+                                  "ORDER BY rank LIMIT ? OFFSET ?")
+                              .arg(chatName.isEmpty() ? QString() : QString("AND m.chat_name = ? ")));
+            query.addBindValue(match);
+            if (!chatName.isEmpty()) {
+                query.addBindValue(chatName);
+            }
+            query.addBindValue(merge ? qint64(offset) + limit + 1 : qint64(limit) + 1);
+            query.addBindValue(merge ? 0 : offset);
+            if (!query.exec()) {
+                Logger::getInstance().log(QtWarningMsg, QString("Ошибка поиска: %1").arg(query.lastError().text()));
+                result.status = PacketSearchResult::Status::InvalidQuery;
+                return result;
+            }
+            while (query.next()) {
+                SearchHit hit;
+                hit.chatName = query.value(0).toString();
+                hit.seq = query.value(1).toUInt();
+                hit.sender = query.value(2).toString();
+                hit.firstName = query.value(3).toString();
+                hit.lastName = query.value(4).toString();
+                hit.timestamp = QDateTime::fromString(query.value(5).toString(), Qt::ISODate);
+                hit.snippet = query.value(6).toString();
+                ranked.append(qMakePair(query.value(7).toDouble(), hit));
+            }
+        }
+
+        if (merge) {
+            std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            ranked = ranked.mid(int(qMin<qint64>(offset, ranked.size())));
+        }
+        for (const auto& entry : ranked) {
+            if (result.hits.size() == limit) {
+                result.hasMore = true;
+                break;
+            }
+            result.hits.append(entry.second);
+        }
+        return result;
+    }
+
+private:
+    struct Shard {
+        QString path;
+        QString connectionName;
+        QSqlDatabase db;
+        bool available = false;
+        qint64 lastIndexed = 0;
+    };
+
+    /**
+     * @brief Индексирует до batchSize новых сообщений части одной транзакцией.
+     * BEGIN IMMEDIATE сразу берет блокировку записи: пока она удерживается,
+     * поток записи части не может зафиксировать новые сообщения, поэтому
+     * все строки с id не больше найденной границы уже видны этому соединению.
+     * @return Число проиндексированных строк, -1 при ошибке.
+     */
+    int indexPending(Shard& shard) {
+        if (!shard.available) {
+            return 0;
+        }
+        static MetricHistogram& latency = operationLatency("fts_index");
+        MetricHistogram::Timer timer(latency);
+
+        QSqlQuery query(shard.db);
+        if (!query.exec("BEGIN IMMEDIATE")) {
+            return -1;
+        }
+        query.prepare("SELECT count(*), max(id) FROM (SELECT id FROM messages WHERE id > ? ORDER BY id LIMIT ?)");
+        query.addBindValue(shard.lastIndexed);
+        query.addBindValue(batchSize);
+        if (!query.exec() || !query.next() || query.value(0).toInt() == 0) {
+            query.finish();
+            QSqlQuery(shard.db).exec("ROLLBACK");
+            return 0;
+        }
+        const int rows = query.value(0).toInt();
+        const qint64 upper = query.value(1).toLongLong();
+        query.finish();
+
+        QSqlQuery insert(shard.db);
+        insert.prepare("INSERT INTO messages_fts (rowid, text, sender) "
+                       "SELECT id, text, sender FROM messages WHERE id > ? AND id <= ?");
+        insert.addBindValue(shard.lastIndexed);
+        insert.addBindValue(upper);
+        QSqlQuery state(shard.db);
+        state.prepare("UPDATE messages_fts_state SET last_rowid = ?");
+        state.addBindValue(upper);
+        if (!insert.exec() || !state.exec() || !QSqlQuery(shard.db).exec("COMMIT")) {
+            Logger::getInstance().log(QtWarningMsg, QString("Ошибка индексации сообщений: %1")
+                                                        .arg(insert.lastError().text()));
+            QSqlQuery(shard.db).exec("ROLLBACK");
+            return -1;
+        }
+        shard.lastIndexed = upper;
+        return rows;
+    }
+
+    /* Индексирует пачку в каждой части; если строки еще остались, продолжает сразу, иначе - через интервал*/
+    void indexStep() {
+        bool backlog = false;
+        for (Shard& shard : shards) {
+            backlog = indexPending(shard) == batchSize || backlog;
+        }
+        indexTimer.start(backlog ? 0 : intervalMs);
+    }
+
+    QVector<Shard> shards;
+    QTimer indexTimer{this};
+    bool available = false; /* индекс есть хотя бы в одной части*/
+    int batchSize = 500;
+    int intervalMs = 250;
+};
+
+SearchWorker::SearchWorker(const QStringList& databasePaths, int maxPending, QObject* parent)
+    : QObject(parent), storage(new SearchStorage(databasePaths)), pending(0), maxPending(maxPending),
+      queueDepth(Metrics::getInstance().gauge("messenger_queue_depth", "Jobs waiting in a worker queue",
+                                              Metrics::label("queue", "search"))) {
+    thread.setObjectName("storage");
+    storage->moveToThread(&thread);
+    connect(&thread, &QThread::finished, storage, &QObject::deleteLater);
+    thread.start();
+    QMetaObject::invokeMethod(storage, [storage = storage]() { storage->open(); }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Деструктор класса SearchWorker.
+ * Дожидается текущего запроса или прохода индексации и закрывает соединение.
+ */
+SearchWorker::~SearchWorker() {
+    thread.quit();
+    thread.wait();
+}
+
+/**
+ * @brief Задает размер пачки индексации и паузу между проходами.
+ */
+void SearchWorker::setIndexPolicy(int batchSize, int intervalMs) {
+    QMetaObject::invokeMethod(storage, [storage = storage, batchSize, intervalMs]() {
+        storage->setPolicy(batchSize, intervalMs);
+    }, Qt::QueuedConnection);
+    Logger::getInstance().log(QtInfoMsg, QString("Индексация поиска: по %1 сообщений, пауза %2 мс")
+                                             .arg(batchSize).arg(intervalMs));
+}
+
+/**
+ * @brief Ставит запрос поиска в очередь потока хранилища.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param chatName Чат для поиска, пустая строка - все чаты.
+ * @param query Текст запроса пользователя.
+ * @param offset Смещение страницы.
+ * @param limit Размер страницы.
+ * @param done Вызывается в потоке SearchWorker с результатом.
+ * @return false, если очередь переполнена.
+ */
+bool SearchWorker::submit(QObject* context, const QString& chatName, const QString& query, quint32 offset, int limit,
+                          std::function<void(const Result&)> done) {
+    const QString match = toMatchExpression(query);
+    if (match.isEmpty()) {
+        Result result;
+        result.status = PacketSearchResult::Status::InvalidQuery;
+        done(result);
+        return true;
+    }
+    if (pending.fetchAndAddRelaxed(1) >= maxPending) {
+        pending.fetchAndAddRelaxed(-1);
+        return false;
+    }
+    queueDepth.add(1);
+
+    QPointer<QObject> guard(context);
+    QMetaObject::invokeMethod(storage, [this, guard, chatName, match, offset, limit, done = std::move(done)]() {
+        Result result = storage->search(chatName, match, offset, limit);
+        pending.fetchAndAddRelaxed(-1);
+        queueDepth.add(-1);
+        QMetaObject::invokeMethod(this, [guard, done, result]() {
+            if (guard) {
+                done(result);
+            }
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+/**
+ * @brief Превращает запрос пользователя в выражение MATCH.
+ * Синтаксис FTS5 пользователю не доступен: каждое слово берется в кавычки,
+ * слова объединяются через AND, последнее ищется как префикс.
+ * @return Выражение или пустая строка, если слов нет.
+ */
+QString SearchWorker::toMatchExpression(const QString& query) {
+    static const QRegularExpression separators("[\\s\"]+");
+    QStringList terms = query.split(separators, Qt::SkipEmptyParts);
+    if (terms.size() > MaxTerms) {
+        terms = terms.mid(0, MaxTerms);
+    }
+    QStringList quoted;
+    for (const QString& term : terms) {
+        quoted.append("\"" + term + "\"");
+    }
+    if (!quoted.isEmpty()) {
+        quoted.last().append('*');
+    }
+    return quoted.join(' ');
+}
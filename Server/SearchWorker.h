@@ -0,0 +1,68 @@
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include <QObject>
+#include <QThread>
+#include <QPointer>
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "protocol.h"
+#include "Metrics.h"
+
+class SearchStorage;
+
+/**
+ * @brief Класс SearchWorker - поток хранилища для полнотекстового поиска.
+ *
+ * Таблицу messages_fts (FTS5, внешнее содержимое - messages) создает
+ * ChatDatabase, а наполняет этот поток: раз в интервал он дописывает
+ * в индекс сообщения с id больше последнего проиндексированного
+ * (messages_fts_state.last_rowid) пачками по batchSize строк. Поэтому
+ * запись сообщения в потоке ShardWriter не платит за индекс, а база,
+ * созданная до появления поиска, индексируется постепенно в фоне.
+ * Удаление сообщений отражается в индексе триггером в ChatDatabase.
+ *
+ * Запросы поиска выполняются здесь же, на отдельных соединениях с каждой
+ * частью базы (режим WAL позволяет читать одновременно с записью);
+ * индекс у каждой части свой, совпадения из частей сливаются по rank. Результат
+ * возвращается в поток, которому принадлежит SearchWorker, если объект-
+ * контекст к этому моменту еще существует - как в CredentialWorkerPool.
+ */
+class SearchWorker : public QObject {
+    Q_OBJECT
+
+public:
+    struct Result {
+        PacketSearchResult::Status status = PacketSearchResult::Status::Ok;
+        QList<SearchHit> hits;
+        bool hasMore = false;
+    };
+
+    /**
+     * @brief Конструктор класса SearchWorker.
+     * @param databasePaths Пути к частям базы чатов.
+     * @param maxPending Максимальное число запросов в очереди.
+     * @param parent Родительский объект.
+     */
+    SearchWorker(const QStringList& databasePaths, int maxPending, QObject* parent = nullptr);
+    ~SearchWorker();
+
+    void setIndexPolicy(int batchSize, int intervalMs); /* Строк за проход индексации и пауза между проходами*/
+    bool submit(QObject* context, const QString& chatName, const QString& query, quint32 offset, int limit,
+                std::function<void(const Result&)> done);
+    int pendingJobs() const { return pending.loadRelaxed(); }
+
+    static QString toMatchExpression(const QString& query); /* Запрос пользователя -> выражение MATCH FTS5*/
+    static constexpr int MaxTerms = 16;
+
+private:
+    QThread thread;
+    SearchStorage* storage;  /* живет в thread, удаляется при его завершении*/
+    QAtomicInt pending;
+    int maxPending;
+    MetricGauge& queueDepth;
+};
+
+#endif // SEARCHWORKER_H
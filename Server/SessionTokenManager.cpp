@@ -0,0 +1,109 @@
+#include "SessionTokenManager.h"
+#include <QMessageAuthenticationCode>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <QDateTime>
+
+namespace {
+const QByteArray::Base64Options tokenEncoding =
+    QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals;
+}
+
+SessionTokenManager::SessionTokenManager(const QByteArray& secret, qint64 ttlSeconds)
+    : secret(secret), ttlSeconds(ttlSeconds) {}
+
+/**
+ * @brief Вычисляет подпись данных токена.
+ * @param payload Данные токена.
+ * @return HMAC-SHA256 от данных.
+ */
+QByteArray SessionTokenManager::sign(const QByteArray& payload) const {
+    return QMessageAuthenticationCode::hash(payload, secret, QCryptographicHash::Sha256);
+}
+
+/**
+ * @brief Выдает новый токен сессии для пользователя.
+ * @param username Логин пользователя.
+ * @param generation Текущее поколение токенов пользователя из базы.
+ * @return Подписанный токен.
+ */
+QString SessionTokenManager::issue(const QString& username, qint64 generation) const {
+    qint64 expiresAt = QDateTime::currentSecsSinceEpoch() + ttlSeconds;
+    quint64 nonce = QRandomGenerator::system()->generate64();
+
+    QByteArray payload = username.toUtf8();
+    payload.append('\n');
+    payload.append(QByteArray::number(expiresAt));
+    payload.append('\n');
+    payload.append(QByteArray::number(generation));
+    payload.append('\n');
+    payload.append(QByteArray::number(nonce, 16));
+
+    return QString::fromLatin1(payload.toBase64(tokenEncoding) + '.' + sign(payload).toBase64(tokenEncoding));
+}
+
+/**
+ * @brief Проверяет подпись и срок действия токена.
+ * Поколение токена вызывающий сверяет с базой сам.
+ * @param token Токен, присланный клиентом.
+ * @param generation Заполняется поколением, с которым выдан токен.
+ * @return Логин владельца токена или пустая строка, если токен недействителен.
+ */
+QString SessionTokenManager::verify(const QString& token, qint64& generation) const {
+    QByteArray raw = token.toLatin1();
+    int dot = raw.indexOf('.');
+    if (dot <= 0) {
+        return QString();
+    }
+
+    QByteArray payload = QByteArray::fromBase64(raw.left(dot), tokenEncoding);
+    QByteArray signature = QByteArray::fromBase64(raw.mid(dot + 1), tokenEncoding);
+    QByteArray expected = sign(payload);
+    if (signature.size() != expected.size()) {
+        return QString();
+    }
+
+    /*сравнение за постоянное время, чтобы не подсказывать подпись по таймингу*/
+    char diff = 0;
+    for (int i = 0; i < expected.size(); ++i) {
+        diff |= signature[i] ^ expected[i];
+    }
+    if (diff != 0) {
+        return QString();
+    }
+
+    int nonceSep = payload.lastIndexOf('\n');
+    if (nonceSep <= 0) {
+        return QString();
+    }
+    int generationSep = payload.lastIndexOf('\n', nonceSep - 1);
+    if (generationSep <= 0) {
+        return QString();
+    }
+    int expirySep = payload.lastIndexOf('\n', generationSep - 1);
+    if (expirySep <= 0) {
+        return QString();
+    }
+
+    bool ok = false;
+    qint64 expiresAt = payload.mid(expirySep + 1, generationSep - expirySep - 1).toLongLong(&ok);
+    if (!ok || expiresAt < QDateTime::currentSecsSinceEpoch()) {
+        return QString();
+    }
+    generation = payload.mid(generationSep + 1, nonceSep - generationSep - 1).toLongLong(&ok);
+    if (!ok) {
+        return QString();
+    }
+
+    return QString::fromUtf8(payload.left(expirySep));
+}
+
+/**
+ * @brief Генерирует случайный секретный ключ для подписи токенов.
+ * @return 32 случайных байта.
+ */
+QByteArray SessionTokenManager::generateSecret() {
+    QByteArray key(32, Qt::Uninitialized);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32*>(key.data()), key.size() / 4);
+    return key;
+}
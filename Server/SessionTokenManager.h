@@ -0,0 +1,37 @@
+#ifndef SESSIONTOKENMANAGER_H
+#define SESSIONTOKENMANAGER_H
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief Класс SessionTokenManager - выдача и проверка токенов сессии.
+ *
+ * Токен имеет вид base64url(данные).base64url(HMAC-SHA256(данные)),
+ * где данные - логин, время истечения, поколение токенов пользователя
+ * и случайный nonce. Подпись и срок проверяются без базы данных, а поколение
+ * сверяется с хранимым в ClientDataBase: его увеличение при ротации
+ * и выходе отзывает все ранее выданные токены пользователя.
+ */
+class SessionTokenManager {
+private:
+    QByteArray secret;
+    qint64 ttlSeconds;
+
+    QByteArray sign(const QByteArray& payload) const;
+
+public:
+    /**
+     * @brief Конструктор класса SessionTokenManager.
+     * @param secret Секретный ключ для подписи токенов.
+     * @param ttlSeconds Время жизни токена в секундах.
+     */
+    SessionTokenManager(const QByteArray& secret, qint64 ttlSeconds);
+
+    QString issue(const QString& username, qint64 generation) const;
+    QString verify(const QString& token, qint64& generation) const;
+
+    static QByteArray generateSecret();
+};
+
+#endif // SESSIONTOKENMANAGER_H
@@ -0,0 +1,236 @@
+#include "ShardWriter.h"
+#include "ChatDataBase.h"
+#include "ChatShards.h"
+#include "logger.h"
+#include "Tracer.h"
+#include <QSqlDatabase>
+
+namespace {
+MetricHistogram& operationLatency(const char* op) {
+    return Metrics::getInstance().histogram("messenger_db_op_seconds", "Database operation latency",
+                                            Metrics::label("db", "chat") + "," + Metrics::label("op", op), 1e-6);
+}
+}
+
+/**
+ * @brief ShardWriterStorage - соединение записи с файлом части в потоке ShardWriter.
+ * Все методы вызываются только из этого потока.
+ */
+class ShardWriterStorage : public QObject {
+public:
+    ShardWriterStorage(const QString& path, const QString& connectionName, bool catalog)
+        : path(path), connectionName(connectionName), catalog(catalog) {}
+
+    ~ShardWriterStorage() {
+        delete database;
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+
+    void open() {
+        database = new ChatDatabase();
+        if (!database->open(path, connectionName, catalog)) {
+            Logger::getInstance().log(QtCriticalMsg, QString("Поток записи не открыл часть базы %1").arg(path));
+        }
+    }
+
+    /**
+     * @brief Записывает пачку сообщений одной транзакцией.
+     * Сообщение, которое не удалось вставить, отмечается отдельно и не
+     * мешает остальным; при ошибке фиксации не записано ни одно.
+     * @return Для каждого сообщения - записано ли оно.
+     */
+    QVector<bool> write(const QVector<PendingMessage>& messages) {
+        QVector<bool> results(messages.size(), false);
+        if (!database || !database->isOpen() || !database->transaction()) {
+            return results;
+        }
+        for (int i = 0; i < messages.size(); ++i) {
+            const PendingMessage& message = messages[i];
+            Tracer::Scope trace(message.trace);
+            results[i] = database->addMessage(message.chatName, message.seq, message.sender, message.text,
+                                              message.timestamp, message.firstName, message.lastName);
+        }
+        bool committed = false;
+        {
+            Tracer::Span span("sqlite.commit");
+            committed = database->commit();
+        }
+        if (!committed) {
+            Logger::getInstance().log(QtCriticalMsg, QString("Не удалось зафиксировать пачку сообщений в %1").arg(path));
+            database->rollback();
+            results.fill(false);
+            return results;
+        }
+        Logger::getInstance().log(QtDebugMsg, QString("В %1 записано сообщений: %2 из %3")
+                                                  .arg(path).arg(results.count(true)).arg(messages.size()));
+        return results;
+    }
+
+    /**
+     * @brief Выполняет операцию над частью на соединении записи.
+     * @return Результат операции; false, если часть не открыта.
+     */
+    bool run(const std::function<bool(ChatDatabase&)>& operation) {
+        return database && database->isOpen() && operation(*database);
+    }
+
+private:
+    QString path;
+    QString connectionName;
+    bool catalog;
+    ChatDatabase* database = nullptr;
+};
+
+ShardWriter::ShardWriter(int shard, const QString& databasePath, QObject* parent)
+    : QObject(parent), storage(new ShardWriterStorage(databasePath, ChatShards::connectionName(shard) + ".writer", shard == 0)),
+      pending(0),
+      queueDepth(Metrics::getInstance().gauge("messenger_queue_depth", "Jobs waiting in a worker queue",
+                                              Metrics::label("queue", "chat_writer") + "," +
+                                                  Metrics::label("shard", QString::number(shard)))),
+      writes(Metrics::getInstance().counter("messenger_shard_writes_total", "Messages committed to a chat shard",
+                                            Metrics::label("shard", QString::number(shard)))),
+      batchSize(Metrics::getInstance().histogram("messenger_shard_commit_messages",
+                                                 "Messages committed by one shard transaction",
+                                                 Metrics::label("shard", QString::number(shard)))) {
+    thread.setObjectName(QString("shard-writer-%1").arg(shard));
+    storage->moveToThread(&thread);
+    connect(&thread, &QThread::finished, storage, &QObject::deleteLater);
+    thread.start();
+    QMetaObject::invokeMethod(storage, [storage = storage]() { storage->open(); }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Деструктор класса ShardWriter.
+ * Записывает оставшиеся в очереди сообщения и закрывает соединение.
+ */
+ShardWriter::~ShardWriter() {
+    flush();
+    thread.quit();
+    thread.wait();
+}
+
+/**
+ * @brief Ставит сообщение в очередь записи.
+ * @param message Сообщение с присвоенным номером.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param done Вызывается в потоке ShardWriter: true - сообщение зафиксировано в базе.
+ */
+void ShardWriter::submit(const PendingMessage& message, QObject* context, std::function<void(bool)> done) {
+    Job job{message, QPointer<QObject>(context), std::move(done), {}};
+    enqueue(std::move(job));
+}
+
+/**
+ * @brief Ставит в очередь операцию над частью, например удаление чата.
+ * Операция выполняется в потоке записи после всех сообщений, поставленных
+ * в очередь до нее, и до всех последующих.
+ * @param operation Вызывается в потоке ShardWriter с соединением записи части.
+ * @param context Объект, при удалении которого результат отбрасывается.
+ * @param done Вызывается в потоке ShardWriter с результатом операции.
+ */
+void ShardWriter::execute(std::function<bool(ChatDatabase&)> operation, QObject* context,
+                          std::function<void(bool)> done) {
+    Job job{PendingMessage(), QPointer<QObject>(context), std::move(done), std::move(operation)};
+    enqueue(std::move(job));
+}
+
+void ShardWriter::enqueue(Job job) {
+    bool schedule = false;
+    {
+        QMutexLocker locker(&mutex);
+        queue.append(std::move(job));
+        schedule = !drainScheduled;
+        drainScheduled = true;
+    }
+    pending.fetchAndAddRelaxed(1);
+    queueDepth.add(1);
+
+    /*пока поток занят пачкой, новые сообщения только дописываются в очередь*/
+    if (schedule) {
+        QMetaObject::invokeMethod(storage, [this]() {
+            while (drain()) {
+            }
+        }, Qt::QueuedConnection);
+    }
+}
+
+/**
+ * @brief Дожидается, пока поток запишет все сообщения, принятые до вызова.
+ * Результаты записи при этом остаются в очереди событий вызывающего потока.
+ */
+void ShardWriter::flush() {
+    if (pending.loadRelaxed() == 0) {
+        return;
+    }
+    QMetaObject::invokeMethod(storage, [this]() {
+        while (drain()) {
+        }
+    }, Qt::BlockingQueuedConnection);
+}
+
+/**
+ * @brief Записывает очередную пачку сообщений из начала очереди
+ * или выполняет стоящую в начале операцию.
+ * @return false, если очередь пуста.
+ */
+bool ShardWriter::drain() {
+    QVector<Job> batch;
+    {
+        QMutexLocker locker(&mutex);
+        if (queue.isEmpty()) {
+            drainScheduled = false;
+            return false;
+        }
+        /*пачка сообщений заканчивается перед первой операцией*/
+        int count = 1;
+        if (!queue.first().operation) {
+            while (count < queue.size() && count < MaxBatch && !queue[count].operation) {
+                ++count;
+            }
+        }
+        batch = queue.mid(0, count);
+        queue.remove(0, count);
+    }
+
+    QVector<bool> results;
+    if (batch.first().operation) {
+        results.append(storage->run(batch.first().operation));
+    } else {
+        QVector<PendingMessage> messages;
+        QList<quint64> sampled;
+        messages.reserve(batch.size());
+        for (const Job& job : batch) {
+            messages.append(job.message);
+            if (job.message.trace != 0) {
+                sampled.append(job.message.trace);
+            }
+        }
+        /*фиксация трассируется, если в пачке есть сообщение из выбранного пакета*/
+        Tracer::Scope trace(sampled.isEmpty() ? 0 : sampled.first());
+        Tracer::Span span("shard_writer.commit");
+        for (quint64 id : sampled) {
+            Tracer::getInstance().flowEnd(id);
+        }
+        if (span.isRecording()) {
+            span.setDetail(QString("%1 сообщений").arg(batch.size()));
+        }
+        {
+            static MetricHistogram& latency = operationLatency("shard_commit");
+            MetricHistogram::Timer timer(latency);
+            results = storage->write(messages);
+        }
+        writes.increment(quint64(results.count(true)));
+        batchSize.record(quint64(batch.size()));
+    }
+    pending.fetchAndAddRelaxed(-int(batch.size()));
+    queueDepth.add(-batch.size());
+
+    QMetaObject::invokeMethod(this, [batch = std::move(batch), results]() {
+        for (int i = 0; i < batch.size(); ++i) {
+            if (batch[i].context && batch[i].done) {
+                batch[i].done(results[i]);
+            }
+        }
+    }, Qt::QueuedConnection);
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef SHARDWRITER_H
+#define SHARDWRITER_H
+
+#include <QObject>
+#include <QThread>
+#include <QPointer>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QVector>
+#include <functional>
+#include "Metrics.h"
+
+class ShardWriterStorage;
+class ChatDatabase;
+
+/**
+ * @brief PendingMessage - сообщение с уже присвоенным номером, ожидающее записи.
+ */
+struct PendingMessage {
+    QString chatName;
+    quint32 seq = 0;
+    QString sender;
+    QString text;
+    QDateTime timestamp;
+    QString firstName;
+    QString lastName;
+    quint64 trace = 0; /*трасса пакета с сообщением, 0 - не выбран*/
+};
+
+/**
+ * @brief Класс ShardWriter - поток записи сообщений в одну часть базы чатов.
+ *
+ * У каждой части свой файл SQLite и своя блокировка записи, а у каждой
+ * блокировки - свой поток, поэтому сообщения разных частей фиксируются
+ * параллельно. Очередь потока разбирается пачками до MaxBatch сообщений
+ * в одной транзакции: пока идет фиксация, новые сообщения копятся
+ * и следующей транзакцией уходят вместе, так что под нагрузкой стоимость
+ * fsync делится на всю пачку.
+ *
+ * Кроме сообщений, в ту же очередь ставятся операции над частью
+ * (удаление и переименование чата): операция выполняется после всех
+ * сообщений, принятых до нее, поэтому ее не нужно ждать через flush.
+ *
+ * Результат записи каждого сообщения возвращается в поток, которому
+ * принадлежит ShardWriter, если объект-контекст еще существует - как
+ * в SearchWorker. Порядок результатов совпадает с порядком постановки в очередь.
+ *
+ * Трасса пакета продолжается в потоке записи: запись сообщения из выбранного
+ * пакета отмечается в его трассе, а фиксация пачки связывается с ней стрелкой.
+ */
+class ShardWriter : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Конструктор класса ShardWriter.
+     * @param shard Номер части.
+     * @param databasePath Путь к файлу части.
+     * @param parent Родительский объект.
+     */
+    ShardWriter(int shard, const QString& databasePath, QObject* parent = nullptr);
+    ~ShardWriter();
+
+    void submit(const PendingMessage& message, QObject* context, std::function<void(bool)> done);
+    void execute(std::function<bool(ChatDatabase&)> operation, QObject* context, std::function<void(bool)> done);
+    void flush(); /* Дожидается записи всех принятых сообщений*/
+    int pendingMessages() const { return pending.loadRelaxed(); } /* Вместе с операциями*/
+
+    static constexpr int MaxBatch = 512;
+
+private:
+    struct Job {
+        PendingMessage message;
+        QPointer<QObject> context;
+        std::function<void(bool)> done;
+        std::function<bool(ChatDatabase&)> operation; /* Пустая - запись message*/
+    };
+
+    void enqueue(Job job);
+    bool drain(); /* Вызывается в thread, возвращает false, если очередь пуста*/
+
+    QThread thread;
+    ShardWriterStorage* storage; /* живет в thread, удаляется при его завершении*/
+    QMutex mutex;
+    QVector<Job> queue;          /* под mutex*/
+    bool drainScheduled = false; /* под mutex*/
+    QAtomicInt pending;
+    MetricGauge& queueDepth;
+    MetricCounter& writes;
+    MetricHistogram& batchSize;
+};
+
+#endif // SHARDWRITER_H
@@ -0,0 +1,167 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(qint64 tickMs, qint64 nowMs)
+    : tick(qMax<qint64>(1, tickMs)), originMs(nowMs), buckets(Levels * Slots, -1) {}
+
+/**
+ * @brief Номер такта, не раньше которого наступает момент ms.
+ * Округление вверх гарантирует, что таймер не сработает раньше срока.
+ */
+quint64 TimerWheel::tickAt(qint64 ms) const {
+    if (ms <= originMs) {
+        return 0;
+    }
+    return static_cast<quint64>((ms - originMs + tick - 1) / tick);
+}
+
+/**
+ * @brief Ставит таймер.
+ * Срок в прошлом округляется до следующего такта.
+ * @param key Значение, которое вернет advance() при срабатывании.
+ * @param deadlineMs Момент срабатывания по тем же часам, что и nowMs.
+ * @return Идентификатор для отмены таймера.
+ */
+TimerWheel::TimerId TimerWheel::schedule(quint64 key, qint64 deadlineMs) {
+    int index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node& node = nodes[index];
+    node.key = key;
+    node.deadline = qMax(tickAt(deadlineMs), current + 1);
+    place(index);
+    ++count;
+    return (static_cast<quint64>(node.generation) << 32) | static_cast<quint64>(index + 1);
+}
+
+/**
+ * @brief Отменяет таймер.
+ * Поколение узла в идентификаторе защищает от отмены чужого таймера,
+ * занявшего узел после срабатывания или отмены прежнего.
+ * @param id Идентификатор, полученный от schedule().
+ * @return false, если таймер уже сработал или отменен.
+ */
+bool TimerWheel::cancel(TimerId id) {
+    const quint64 slot = id & 0xffffffffu;
+    if (slot == 0 || slot > nodes.size()) {
+        return false;
+    }
+    const int index = static_cast<int>(slot - 1);
+    Node& node = nodes[index];
+    if (node.bucket < 0 || node.generation != static_cast<quint32>(id >> 32)) {
+        return false;
+    }
+    unlink(index);
+    ++node.generation;
+    freeNodes.push_back(index);
+    --count;
+    return true;
+}
+
+/**
+ * @brief Продвигает колесо до момента nowMs.
+ * @param nowMs Текущее время.
+ * @return Ключи сработавших таймеров.
+ */
+QList<quint64> TimerWheel::advance(qint64 nowMs) {
+    QList<quint64> expired;
+    const quint64 target = nowMs > originMs ? static_cast<quint64>((nowMs - originMs) / tick) : 0;
+
+    while (current < target) {
+        if (count == 0) {
+            current = target;
+            break;
+        }
+        ++current;
+
+        /*старшие уровни раскладываются первыми: их таймеры могут попасть
+         *в ячейку младшего уровня, которая раскладывается на этом же такте*/
+        for (int level = Levels - 1; level > 0; --level) {
+            if ((current & ((quint64(1) << (SlotBits * level)) - 1)) == 0) {
+                cascade(level);
+            }
+        }
+
+        const int bucket = static_cast<int>(current & (Slots - 1));
+        int index = buckets[bucket];
+        buckets[bucket] = -1;
+        while (index >= 0) {
+            Node& node = nodes[index];
+            const int next = node.next;
+            expired.append(node.key);
+            node.bucket = -1;
+            ++node.generation;
+            freeNodes.push_back(index);
+            --count;
+            index = next;
+        }
+    }
+    return expired;
+}
+
+/**
+ * @brief Помещает узел в ячейку самого младшего уровня, покрывающего его срок.
+ * Сроки дальше диапазона колеса откладываются в последнюю ячейку старшего
+ * уровня и уточняются при раскладке.
+ */
+void TimerWheel::place(int index) {
+    Node& node = nodes[index];
+    const quint64 range = quint64(1) << (SlotBits * Levels);
+    quint64 deadline = qMax(node.deadline, current);
+    if (deadline - current >= range) {
+        deadline = current + range - 1;
+    }
+
+    const quint64 delta = deadline - current;
+    int level = 0;
+    while (level < Levels - 1 && delta >= (quint64(1) << (SlotBits * (level + 1)))) {
+        ++level;
+    }
+    const int slot = static_cast<int>((deadline >> (SlotBits * level)) & (Slots - 1));
+    link(index, level * Slots + slot);
+}
+
+void TimerWheel::link(int index, int bucket) {
+    Node& node = nodes[index];
+    node.bucket = bucket;
+    node.prev = -1;
+    node.next = buckets[bucket];
+    if (node.next >= 0) {
+        nodes[node.next].prev = index;
+    }
+    buckets[bucket] = index;
+}
+
+void TimerWheel::unlink(int index) {
+    Node& node = nodes[index];
+    if (node.prev >= 0) {
+        nodes[node.prev].next = node.next;
+    } else {
+        buckets[node.bucket] = node.next;
+    }
+    if (node.next >= 0) {
+        nodes[node.next].prev = node.prev;
+    }
+    node.prev = node.next = -1;
+    node.bucket = -1;
+}
+
+/**
+ * @brief Раскладывает текущую ячейку уровня level по младшим уровням.
+ */
+void TimerWheel::cascade(int level) {
+    const int bucket = level * Slots + static_cast<int>((current >> (SlotBits * level)) & (Slots - 1));
+    int index = buckets[bucket];
+    buckets[bucket] = -1;
+    while (index >= 0) {
+        const int next = nodes[index].next;
+        nodes[index].bucket = -1;
+        place(index);
+        index = next;
+    }
+}
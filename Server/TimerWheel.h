@@ -0,0 +1,69 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QtGlobal>
+#include <QList>
+#include <vector>
+
+/**
+ * @brief Класс TimerWheel - иерархическое колесо таймеров.
+ *
+ * Время делится на такты длиной tickMs. Колесо состоит из Levels уровней
+ * по Slots ячеек: ячейка нулевого уровня покрывает один такт, ячейка
+ * следующего уровня - в Slots раз больше. Таймер попадает в ячейку
+ * самого младшего уровня, диапазон которого покрывает его срок, а при
+ * обороте младшего уровня таймеры старшей ячейки раскладываются вниз.
+ *
+ * Ячейки - двусвязные списки узлов из общего массива, поэтому постановка
+ * и отмена таймера выполняются за O(1) без выделения памяти на каждый таймер.
+ * Колесо не владеет таймером Qt: его продвигает владелец вызовом advance().
+ */
+class TimerWheel {
+public:
+    using TimerId = quint64; /*0 - нет таймера*/
+
+    static constexpr int SlotBits = 6;
+    static constexpr int Slots = 1 << SlotBits;
+    static constexpr int Levels = 4; /*при такте 250 мс колесо покрывает около 194 суток*/
+
+    /**
+     * @brief Конструктор класса TimerWheel.
+     * @param tickMs Длина такта в миллисекундах.
+     * @param nowMs Текущее время по монотонным часам владельца.
+     */
+    TimerWheel(qint64 tickMs, qint64 nowMs);
+
+    TimerId schedule(quint64 key, qint64 deadlineMs);
+    bool cancel(TimerId id);
+    QList<quint64> advance(qint64 nowMs);
+
+    qint64 tickMs() const { return tick; }
+    int size() const { return count; }
+
+private:
+    struct Node {
+        quint64 key = 0;
+        quint64 deadline = 0;  /*номер такта срабатывания*/
+        int prev = -1;
+        int next = -1;
+        int bucket = -1;       /*-1 - узел свободен*/
+        quint32 generation = 0;
+    };
+
+    qint64 tick;
+    qint64 originMs;           /*время, соответствующее такту 0*/
+    quint64 current = 0;       /*последний обработанный такт*/
+    int count = 0;
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    std::vector<int> buckets;  /*голова списка каждой ячейки, Levels * Slots*/
+
+    quint64 tickAt(qint64 ms) const;
+    void place(int index);
+    void link(int index, int bucket);
+    void unlink(int index);
+    void cascade(int level);
+};
+
+#endif // TIMERWHEEL_H
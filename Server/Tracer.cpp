@@ -0,0 +1,174 @@
+#include "Tracer.h"
+#include "logger.h"
+#include <QThread>
+
+thread_local quint64 Tracer::activeTrace = 0;
+
+namespace {
+/* Номер потока в файле трассы и номер файла, в котором поток описан*/
+thread_local int traceThread = 0;
+thread_local int traceFile = 0;
+
+QByteArray jsonString(const QString& text) {
+    QByteArray result = "\"";
+    for (const QChar c : text) {
+        if (c == '"' || c == '\\') {
+            result.append('\\').append(char(c.unicode()));
+        } else if (c.unicode() < 0x20) {
+            result.append(QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0')).toLatin1());
+        } else {
+            result.append(QString(c).toUtf8());
+        }
+    }
+    return result.append('"');
+}
+
+QByteArray micros(qint64 ns) {
+    return QByteArray::number(double(ns) / 1000.0, 'f', 3);
+}
+}
+
+Tracer::Tracer() {
+    clock.start();
+}
+
+Tracer& Tracer::getInstance() {
+    static Tracer instance;
+    return instance;
+}
+
+/**
+ * @brief Открывает файл трассы и включает выборку.
+ * @param path Путь к файлу JSON.
+ * @param sampleEvery Трассируется каждый N-й входящий кадр.
+ * @param maxBytes Размер файла, после которого запись прекращается.
+ * @return true, если файл открыт.
+ */
+bool Tracer::start(const QString& path, int sampleEvery, qint64 maxBytes) {
+    stop();
+    QMutexLocker locker(&mutex);
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        Logger::getInstance().log(QtWarningMsg, QString("Не удалось открыть файл трассировки %1: %2")
+                                                    .arg(path, file.errorString()));
+        return false;
+    }
+    this->sampleEvery = qMax(1, sampleEvery);
+    this->maxBytes = maxBytes;
+    written = 0;
+    firstEvent = true;
+    threadCount = 0;
+    ++fileNumber;
+    buffer = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    enabled.store(true, std::memory_order_relaxed);
+    Logger::getInstance().log(QtInfoMsg, QString("Трассировка каждого %1-го пакета в %2").arg(this->sampleEvery).arg(path));
+    return true;
+}
+
+/**
+ * @brief Дописывает накопленные события, закрывает массив и файл.
+ */
+void Tracer::stop() {
+    QMutexLocker locker(&mutex);
+    if (!file.isOpen()) {
+        return;
+    }
+    enabled.store(false, std::memory_order_relaxed);
+    buffer.append("\n]}\n");
+    flushLocked();
+    file.close();
+}
+
+/**
+ * @brief Решает, трассировать ли очередной кадр.
+ * @return Номер новой трассы или 0.
+ */
+quint64 Tracer::sample() {
+    if (!isEnabled() || frames.fetch_add(1, std::memory_order_relaxed) % quint64(sampleEvery) != 0) {
+        return 0;
+    }
+    return nextTrace.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Номер потока для событий; при первом событии потока записывает его имя.
+ * Вызывается под mutex.
+ */
+int Tracer::threadIndex() {
+    if (traceFile != fileNumber) {
+        traceFile = fileNumber;
+        traceThread = ++threadCount;
+        QString name = QThread::currentThread()->objectName();
+        if (name.isEmpty()) {
+            name = QString("thread %1").arg(traceThread);
+        }
+        append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(traceThread) +
+               ",\"args\":{\"name\":" + jsonString(name) + "}}");
+    }
+    return traceThread;
+}
+
+void Tracer::complete(const char* name, qint64 startNs, qint64 endNs, quint64 trace, const QString& detail) {
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    const int tid = threadIndex();
+    QByteArray event = "{\"name\":\"" + QByteArray(name) + "\",\"cat\":\"packet\",\"ph\":\"X\",\"ts\":" + micros(startNs) +
+                       ",\"dur\":" + micros(endNs - startNs) + ",\"pid\":1,\"tid\":" + QByteArray::number(tid) +
+                       ",\"args\":{\"trace\":" + QByteArray::number(trace);
+    if (!detail.isEmpty()) {
+        event += ",\"detail\":" + jsonString(detail);
+    }
+    append(event + "}}");
+}
+
+void Tracer::flowStart(quint64 trace) {
+    if (!isEnabled() || trace == 0) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    const int tid = threadIndex();
+    append("{\"name\":\"broadcast\",\"cat\":\"flow\",\"ph\":\"s\",\"id\":" + QByteArray::number(trace) +
+           ",\"ts\":" + micros(nowNs()) + ",\"pid\":1,\"tid\":" + QByteArray::number(tid) + "}");
+}
+
+void Tracer::flowEnd(quint64 trace) {
+    if (!isEnabled() || trace == 0) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    const int tid = threadIndex();
+    append("{\"name\":\"broadcast\",\"cat\":\"flow\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" + QByteArray::number(trace) +
+           ",\"ts\":" + micros(nowNs()) + ",\"pid\":1,\"tid\":" + QByteArray::number(tid) + "}");
+}
+
+/**
+ * @brief Добавляет событие в буфер; вызывается под mutex.
+ * При превышении maxBytes трассировка выключается, файл остается корректным.
+ */
+void Tracer::append(const QByteArray& event) {
+    if (!firstEvent) {
+        buffer.append(",\n");
+    }
+    firstEvent = false;
+    buffer.append(event);
+    if (buffer.size() >= FlushThreshold) {
+        flushLocked();
+    }
+    if (maxBytes > 0 && written + buffer.size() >= maxBytes && enabled.load(std::memory_order_relaxed)) {
+        enabled.store(false, std::memory_order_relaxed);
+        buffer.append("\n]}\n");
+        flushLocked();
+        file.close();
+        Logger::getInstance().log(QtWarningMsg, "Трассировка остановлена: достигнут предельный размер файла");
+    }
+}
+
+void Tracer::flushLocked() {
+    if (file.isOpen() && !buffer.isEmpty()) {
+        written += file.write(buffer);
+        file.flush();
+    }
+    buffer.clear();
+}
@@ -0,0 +1,104 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+
+/**
+ * @brief Класс Tracer (синглтон) - выборочная трассировка обработки пакетов.
+ *
+ * Каждый N-й входящий кадр получает номер трассы, и пока он обрабатывается,
+ * участки кода, отмеченные Tracer::Span, записываются в файл как события
+ * формата Chrome trace (ph "X"). Файл открывается в chrome://tracing и
+ * Perfetto. Номер трассы хранится в thread_local переменной, поэтому
+ * в не выбранных пакетах и в других потоках Span сводится к одной проверке.
+ *
+ * Рассылка идет позже обработки пакета (окно BroadcastCoalescer), поэтому
+ * она связывается с трассой пакета стрелкой (события flow "s"/"f"), как и
+ * фиксация сообщения в потоке ShardWriter.
+ */
+class Tracer {
+public:
+    static Tracer& getInstance();
+
+    bool start(const QString& path, int sampleEvery, qint64 maxBytes);
+    void stop();
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    quint64 sample();                                  /* номер трассы для очередного кадра или 0*/
+    static quint64 currentTrace() { return activeTrace; }
+
+    void complete(const char* name, qint64 startNs, qint64 endNs, quint64 trace, const QString& detail);
+    void flowStart(quint64 trace);                     /* начало стрелки внутри текущего участка*/
+    void flowEnd(quint64 trace);                       /* конец стрелки внутри текущего участка*/
+    qint64 nowNs() const { return clock.nsecsElapsed(); }
+
+    /* Делает трассу текущей для потока до конца области видимости*/
+    class Scope {
+    public:
+        explicit Scope(quint64 trace) : previous(activeTrace) { activeTrace = trace; }
+        ~Scope() { activeTrace = previous; }
+
+    private:
+        quint64 previous;
+    };
+
+    /* Участок кода; записывается, только если у потока есть текущая трасса*/
+    class Span {
+    public:
+        explicit Span(const char* name, const QString& detail = QString())
+            : name(name), trace(activeTrace) {
+            if (trace != 0) {
+                this->detail = detail;
+                startNs = Tracer::getInstance().nowNs();
+            }
+        }
+        ~Span() {
+            if (trace != 0) {
+                Tracer& tracer = Tracer::getInstance();
+                tracer.complete(name, startNs, tracer.nowNs(), trace, detail);
+            }
+        }
+        bool isRecording() const { return trace != 0; }
+        void setDetail(const QString& text) { detail = text; }
+
+    private:
+        const char* name;
+        quint64 trace;
+        qint64 startNs = 0;
+        QString detail;
+    };
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static constexpr qsizetype FlushThreshold = 256 * 1024;
+
+private:
+    Tracer();
+    void append(const QByteArray& event);
+    void flushLocked();
+    int threadIndex();
+
+    static thread_local quint64 activeTrace;
+
+    QElapsedTimer clock;
+    std::atomic<bool> enabled{false};
+    std::atomic<quint64> frames{0};
+    std::atomic<quint64> nextTrace{1};
+    int sampleEvery = 100;
+
+    QMutex mutex;                 /* защищает все поля ниже*/
+    QFile file;
+    QByteArray buffer;
+    qint64 written = 0;
+    qint64 maxBytes = 0;
+    bool firstEvent = true;
+    int threadCount = 0;
+    int fileNumber = 0;           /* потоки описываются заново в каждом файле*/
+};
+
+#endif // TRACER_H
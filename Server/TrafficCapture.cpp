@@ -0,0 +1,172 @@
+#include "TrafficCapture.h"
+#include "ByteBuffer.h"
+#include "logger.h"
+#include "protocol.h"
+#include <QDateTime>
+
+namespace {
+const QByteArray Magic = "MSGCAP";
+constexpr quint64 MaxRecordFrame = 64 * 1024 * 1024; /* защита от поврежденной длины*/
+}
+
+/**
+ * @brief Создает файл записи и пишет заголовок.
+ * @param path Путь к файлу.
+ * @param maxBytes Размер, после которого запись прекращается, 0 - без ограничения.
+ * @param includeCredentials Записывать ли кадры Register, Auth и SessionResume.
+ * @return true, если файл открыт.
+ */
+bool TrafficCapture::open(const QString& path, qint64 maxBytes, bool includeCredentials) {
+    close();
+    file.setFileName(path);
+    /*запись читает только владелец: в ней переписка и, возможно, учетные данные*/
+    const QFileDevice::Permissions ownerOnly = QFileDevice::ReadOwner | QFileDevice::WriteOwner;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    const bool opened = file.open(QIODevice::WriteOnly | QIODevice::Truncate, ownerOnly);
+#else
+    const bool opened = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+#endif
+    /*права уже существующего файла open не меняет*/
+    if (!opened || !file.setPermissions(ownerOnly)) {
+        Logger::getInstance().log(QtWarningMsg, QString("Не удалось открыть файл записи трафика %1: %2")
+                                                    .arg(path, file.errorString()));
+        file.close();
+        return false;
+    }
+    ByteBuffer header;
+    header.write(Magic);
+    header.writeShortLE(FormatVersion);
+    header.writeLongLE(QDateTime::currentMSecsSinceEpoch());
+    written = file.write(header);
+    this->maxBytes = maxBytes;
+    this->includeCredentials = includeCredentials;
+    lastUs = 0;
+    clock.start();
+    Logger::getInstance().log(QtInfoMsg, QString("Запись входящего трафика в %1").arg(path));
+    return true;
+}
+
+void TrafficCapture::close() {
+    if (file.isOpen()) {
+        file.close();
+        Logger::getInstance().log(QtInfoMsg, QString("Запись трафика завершена, %1 байт").arg(written));
+    }
+}
+
+void TrafficCapture::appendVarint(QByteArray& out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+/**
+ * @brief Дописывает входящий кадр. Кадры с учетными данными
+ * пропускаются, если запись открыта без includeCredentials.
+ */
+void TrafficCapture::recordFrame(quint64 connection, const QByteArray& frame) {
+    if (!includeCredentials && !frame.isEmpty()) {
+        const PacketType type = Packet::frameType(frame);
+        if (type == PacketType::Register || type == PacketType::Auth || type == PacketType::SessionResume) {
+            return;
+        }
+    }
+    record(Kind::Frame, connection, frame);
+}
+
+/**
+ * @brief Дописывает запись; при достижении maxBytes файл закрывается.
+ */
+void TrafficCapture::record(Kind kind, quint64 connection, const QByteArray& frame) {
+    if (!file.isOpen()) {
+        return;
+    }
+    const qint64 nowUs = clock.nsecsElapsed() / 1000;
+    QByteArray out;
+    out.reserve(16 + frame.size());
+    out.append(char(kind));
+    appendVarint(out, connection);
+    appendVarint(out, quint64(nowUs - lastUs));
+    if (kind == Kind::Frame) {
+        appendVarint(out, quint64(frame.size()));
+        out.append(frame);
+    }
+    lastUs = nowUs;
+
+    if (maxBytes > 0 && written + out.size() > maxBytes) {
+        Logger::getInstance().log(QtWarningMsg, "Запись трафика остановлена: достигнут предельный размер файла");
+        close();
+        return;
+    }
+    written += file.write(out);
+}
+
+/**
+ * @brief Открывает файл записи и проверяет заголовок.
+ */
+bool TrafficCapture::Reader::open(const QString& path) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    const QByteArray header = file.read(Magic.size() + 2 + 8);
+    if (header.size() != Magic.size() + 2 + 8 || !header.startsWith(Magic)) {
+        error = "файл не является записью трафика";
+        return false;
+    }
+    ByteBuffer buffer(header.mid(Magic.size()));
+    const quint16 version = quint16(buffer.readShortLE());
+    if (version != FormatVersion) {
+        error = QString("неподдерживаемая версия формата %1").arg(version);
+        return false;
+    }
+    startedMs = buffer.readLongLE();
+    timeUs = 0;
+    return true;
+}
+
+bool TrafficCapture::Reader::readVarint(quint64& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        char byte;
+        if (!file.getChar(&byte)) {
+            return false;
+        }
+        value |= quint64(quint8(byte) & 0x7F) << shift;
+        if (!(quint8(byte) & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TrafficCapture::Reader::next(Record& record) {
+    char kind;
+    if (!file.getChar(&kind)) {
+        return false;
+    }
+    quint64 delta = 0;
+    if (quint8(kind) > quint8(Kind::Close) || !readVarint(record.connection) || !readVarint(delta)) {
+        error = "поврежденная запись";
+        return false;
+    }
+    record.kind = Kind(quint8(kind));
+    timeUs += qint64(delta);
+    record.timeUs = timeUs;
+    record.frame.clear();
+    if (record.kind == Kind::Frame) {
+        quint64 length = 0;
+        if (!readVarint(length) || length > MaxRecordFrame) {
+            error = "поврежденная запись";
+            return false;
+        }
+        record.frame = file.read(qint64(length));
+        if (record.frame.size() != qint64(length)) {
+            error = "запись обрывается";
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef TRAFFICCAPTURE_H
+#define TRAFFICCAPTURE_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+/**
+ * @brief Класс TrafficCapture - запись входящего трафика сервера в файл.
+ *
+ * Файл начинается с заголовка "MSGCAP", версии формата (2 байта LE) и времени
+ * начала записи (8 байт LE, мс от эпохи). Дальше идут записи:
+ * [вид 1 байт][id соединения varint][мкс от предыдущей записи varint]
+ * и для кадров еще [длина varint][кадр как он пришел от клиента].
+ * Числа varint - LEB128, поэтому запись короткого кадра занимает
+ * 4-6 байт сверх самого кадра. Ping и Pong не записываются: они зависят
+ * от таймеров сервера и при воспроизведении только мешают.
+ *
+ * Кадры Register, Auth и SessionResume несут хэши паролей и токены сессий,
+ * поэтому по умолчанию не записываются; файл создается с правами 0600.
+ *
+ * Чтение - TrafficCapture::Reader, им пользуется messenger-replay.
+ */
+class TrafficCapture {
+public:
+    enum class Kind : quint8 {
+        Open = 0,  /*клиент подключился*/
+        Frame = 1, /*полный входящий кадр*/
+        Close = 2  /*соединение закрыто*/
+    };
+
+    struct Record {
+        Kind kind = Kind::Frame;
+        quint64 connection = 0;
+        qint64 timeUs = 0; /*от начала записи*/
+        QByteArray frame;
+    };
+
+    static constexpr quint16 FormatVersion = 1;
+
+    bool open(const QString& path, qint64 maxBytes, bool includeCredentials = false);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    QString errorString() const { return file.errorString(); }
+
+    void recordOpen(quint64 connection) { record(Kind::Open, connection, QByteArray()); }
+    void recordFrame(quint64 connection, const QByteArray& frame);
+    void recordClose(quint64 connection) { record(Kind::Close, connection, QByteArray()); }
+
+    /* Последовательное чтение файла записи*/
+    class Reader {
+    public:
+        bool open(const QString& path);
+        bool next(Record& record); /* false - конец файла или поврежденная запись*/
+        QString errorString() const { return error; }
+        qint64 startedAtMs() const { return startedMs; }
+
+    private:
+        bool readVarint(quint64& value);
+
+        QFile file;
+        QString error;
+        qint64 startedMs = 0;
+        qint64 timeUs = 0;
+    };
+
+private:
+    void record(Kind kind, quint64 connection, const QByteArray& frame);
+    static void appendVarint(QByteArray& out, quint64 value);
+
+    QFile file;
+    QElapsedTimer clock;
+    qint64 lastUs = 0;
+    qint64 written = 0;
+    qint64 maxBytes = 0;
+    bool includeCredentials = false;
+};
+
+#endif // TRAFFICCAPTURE_H
@@ -0,0 +1,43 @@
+#include "UserInterner.h"
+
+/**
+ * @brief Возвращает единственный экземпляр таблицы авторов.
+ * @return Ссылка на экземпляр UserInterner.
+ */
+UserInterner& UserInterner::getInstance() {
+    static UserInterner instance;
+    return instance;
+}
+
+/**
+ * @brief Возвращает номер автора, добавляя его в таблицу при первом обращении.
+ * Имя и фамилия входят в ключ, чтобы смена имени пользователя не меняла
+ * подпись его старых сообщений.
+ * @param sender Логин отправителя.
+ * @param firstName Имя отправителя.
+ * @param lastName Фамилия отправителя.
+ * @return Номер автора.
+ */
+quint32 UserInterner::intern(const QString& sender, const QString& firstName, const QString& lastName) {
+    const QChar separator(0x1F);
+    const QString key = sender + separator + firstName + separator + lastName;
+
+    auto it = index.constFind(key);
+    if (it != index.constEnd()) {
+        return it.value();
+    }
+
+    quint32 id = static_cast<quint32>(users.size());
+    users.append({sender, firstName, lastName});
+    index.insert(key, id);
+    return id;
+}
+
+/**
+ * @brief Возвращает данные автора по номеру.
+ * @param id Номер, полученный из intern().
+ * @return Логин, имя и фамилия автора.
+ */
+const UserInterner::UserRecord& UserInterner::user(quint32 id) const {
+    return users.at(static_cast<int>(id));
+}
@@ -0,0 +1,38 @@
+#ifndef USERINTERNER_H
+#define USERINTERNER_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+/**
+ * @brief Класс UserInterner - таблица интернированных авторов сообщений (синглтон).
+ *
+ * Логин, имя и фамилия отправителя одинаковы во всех его сообщениях,
+ * поэтому хранятся один раз, а сообщения ссылаются на них по номеру.
+ */
+class UserInterner {
+public:
+    struct UserRecord {
+        QString sender;    /*логин отправителя*/
+        QString firstName; /*имя отправителя*/
+        QString lastName;  /*фамилия отправителя*/
+    };
+
+    static UserInterner& getInstance();
+
+    quint32 intern(const QString& sender, const QString& firstName, const QString& lastName);
+    const UserRecord& user(quint32 id) const;
+    int size() const { return users.size(); }
+
+    UserInterner(const UserInterner&) = delete;
+    UserInterner& operator=(const UserInterner&) = delete;
+
+private:
+    UserInterner() = default;
+
+    QVector<UserRecord> users;
+    QHash<QString, quint32> index; /*ключ: логин, имя и фамилия через разделитель*/
+};
+
+#endif // USERINTERNER_H
@@ -0,0 +1,372 @@
+#include <QtTest>
+#include "protocol.h"
+#include "ByteBuffer.h"
+
+/**
+ * @brief Микробенчмарки кодека пакетов: Packet::serialize/deserialize,
+ * примитивы ByteBuffer, serializeString/deserializeString и CRC::Calculate.
+ *
+ * Результаты в машиночитаемом виде для сравнения до и после изменения кодека:
+ *   codec-benchmark -csv > after.csv
+ *   codec-benchmark -o after.xml,xml
+ * Отдельный тест выбирается по имени и строке данных: codec-benchmark deserialize:Message/4096
+ */
+class CodecBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void serialize_data();
+    void serialize();
+    void deserialize_data();
+    void deserialize();
+
+    void byteBufferWrite_data();
+    void byteBufferWrite();
+    void byteBufferRead_data();
+    void byteBufferRead();
+
+    void serializeString_data();
+    void serializeString();
+    void deserializeString_data();
+    void deserializeString();
+
+    void crc_data();
+    void crc();
+};
+
+namespace {
+
+/* Доступ к защищенной сериализации строк без создания пакета*/
+struct StringCodec : Packet {
+    using Packet::serializeString;
+    using Packet::deserializeString;
+};
+
+enum class Primitive { Byte, ShortLE, IntLE, LongLE, ShortBE, IntBE, LongBE };
+
+constexpr int PrimitiveCount = 1024; /* значений за одну итерацию*/
+
+QString sampleText(int length, bool cyrillic) {
+    const QString alphabet = cyrillic ? QString::fromUtf8("абвгдеёжзийклмнопрстуфхцчшщъыьэюя ")
+                                      : QString("abcdefghijklmnopqrstuvwxyz ");
+    QString text;
+    text.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        text.append(alphabet.at(i % alphabet.size()));
+    }
+    return text;
+}
+
+PacketMessage sampleMessage(int textLength, quint32 seq) {
+    PacketMessage message;
+    message.setFirstName(QString::fromUtf8("Иван"));
+    message.setLastName(QString::fromUtf8("Петров"));
+    message.setFrom("ivan.petrov");
+    message.setChatName("general");
+    message.setText(sampleText(textLength, true));
+    message.setTimestamp(QDateTime(QDate(2024, 1, 1), QTime(12, 0)));
+    message.setSeq(seq);
+    message.setIdempotencyKey(QString("key-%1").arg(seq));
+    return message;
+}
+
+/**
+ * @brief Пакет заданного типа. size - длина текста для пакетов со строками
+ * и число элементов для пакетов-списков; у пакетов фиксированного размера не учитывается.
+ */
+std::shared_ptr<Packet> samplePacket(PacketType type, int size) {
+    switch (type) {
+    case PacketType::Register: {
+        auto packet = std::make_shared<PacketRegister>();
+        packet->setUsername("ivan.petrov");
+        packet->setPassword(sampleText(size, false));
+        packet->setFirst_name(QString::fromUtf8("Иван"));
+        packet->setLast_name(QString::fromUtf8("Петров"));
+        return packet;
+    }
+    case PacketType::Auth: {
+        auto packet = std::make_shared<PacketAuth>();
+        packet->setUsername("ivan.petrov");
+        packet->setPassword(sampleText(size, false));
+        return packet;
+    }
+    case PacketType::ServerResponse: {
+        auto packet = std::make_shared<PacketServerResponse>();
+        packet->SetResponseType(PacketServerResponse::ServerResponseType::Auth);
+        packet->SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+        packet->SetResponseMessage(sampleText(size, true));
+        return packet;
+    }
+    case PacketType::ChatList: {
+        auto packet = std::make_shared<PacketChatList>();
+        QStringList names;
+        for (int i = 0; i < size; ++i) {
+            names.append(QString::fromUtf8("чат %1").arg(i));
+        }
+        packet->setChatNames(names);
+        packet->setVersion(size);
+        return packet;
+    }
+    case PacketType::Message: {
+        return std::make_shared<PacketMessage>(sampleMessage(size, 1));
+    }
+    case PacketType::SessionResume: {
+        auto packet = std::make_shared<PacketSessionResume>();
+        packet->setUsername("ivan.petrov");
+        packet->setToken(sampleText(size, false));
+        return packet;
+    }
+    case PacketType::ChatListDelta: {
+        auto packet = std::make_shared<PacketChatListDelta>();
+        packet->setKind(PacketChatListDelta::Kind::Renamed);
+        packet->setVersion(7);
+        packet->setChatName(sampleText(size, true));
+        packet->setNewName(sampleText(size, true));
+        return packet;
+    }
+    case PacketType::SyncRequest: {
+        auto packet = std::make_shared<PacketSyncRequest>();
+        for (int i = 0; i < size; ++i) {
+            packet->addChat(QString::fromUtf8("чат %1").arg(i), quint32(i * 100));
+        }
+        return packet;
+    }
+    case PacketType::SyncBatch: {
+        auto packet = std::make_shared<PacketSyncBatch>();
+        packet->setChatName("general");
+        for (int i = 0; i < size; ++i) {
+            MessageRecord record;
+            record.seq = quint32(i + 1);
+            record.sender = "ivan.petrov";
+            record.firstName = QString::fromUtf8("Иван");
+            record.lastName = QString::fromUtf8("Петров");
+            record.text = sampleText(64, true);
+            record.timestamp = QDateTime(QDate(2024, 1, 1), QTime(12, 0));
+            packet->addMessage(record);
+        }
+        return packet;
+    }
+    case PacketType::MessageBatch: {
+        auto packet = std::make_shared<PacketMessageBatch>();
+        for (int i = 0; i < size; ++i) {
+            packet->addMessage(sampleMessage(64, quint32(i + 1)));
+        }
+        return packet;
+    }
+    case PacketType::Hello:
+    case PacketType::HelloAck: {
+        auto packet = type == PacketType::Hello ? std::make_shared<PacketHello>() : std::make_shared<PacketHelloAck>();
+        packet->setCapabilities(Capability::All);
+        packet->setCodecs(0x03);
+        return packet;
+    }
+    case PacketType::Ping:
+    case PacketType::Pong: {
+        auto packet = type == PacketType::Ping ? std::make_shared<PacketPing>() : std::make_shared<PacketPong>();
+        packet->setTimestamp(1700000000000);
+        return packet;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+/* Строки данных: тип пакета и размеры, CreateChat не передается по сети*/
+void addPacketRows() {
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("size");
+
+    const PacketType scalable[] = {PacketType::Register, PacketType::Auth, PacketType::ServerResponse,
+                                   PacketType::Message, PacketType::SessionResume, PacketType::ChatListDelta};
+    for (PacketType type : scalable) {
+        for (int size : {16, 256, 4096}) {
+            QTest::addRow("%s/%d", qPrintable(Packet::typeName(type)), size) << int(type) << size;
+        }
+    }
+    const PacketType lists[] = {PacketType::ChatList, PacketType::SyncRequest, PacketType::SyncBatch,
+                                PacketType::MessageBatch};
+    for (PacketType type : lists) {
+        for (int size : {1, 16, 256}) {
+            QTest::addRow("%s/%d", qPrintable(Packet::typeName(type)), size) << int(type) << size;
+        }
+    }
+    const PacketType fixed[] = {PacketType::Hello, PacketType::HelloAck, PacketType::Ping, PacketType::Pong};
+    for (PacketType type : fixed) {
+        QTest::addRow("%s", qPrintable(Packet::typeName(type))) << int(type) << 0;
+    }
+}
+
+void addPrimitiveRows() {
+    QTest::addColumn<int>("primitive");
+    QTest::newRow("byte") << int(Primitive::Byte);
+    QTest::newRow("shortLE") << int(Primitive::ShortLE);
+    QTest::newRow("intLE") << int(Primitive::IntLE);
+    QTest::newRow("longLE") << int(Primitive::LongLE);
+    QTest::newRow("shortBE") << int(Primitive::ShortBE);
+    QTest::newRow("intBE") << int(Primitive::IntBE);
+    QTest::newRow("longBE") << int(Primitive::LongBE);
+}
+
+void fillPrimitives(ByteBuffer& buffer, Primitive primitive) {
+    for (int i = 0; i < PrimitiveCount; ++i) {
+        switch (primitive) {
+        case Primitive::Byte: buffer.writeByte(qint8(i)); break;
+        case Primitive::ShortLE: buffer.writeShortLE(qint16(i)); break;
+        case Primitive::IntLE: buffer.writeIntLE(i); break;
+        case Primitive::LongLE: buffer.writeLongLE(i); break;
+        case Primitive::ShortBE: buffer.writeShortBE(qint16(i)); break;
+        case Primitive::IntBE: buffer.writeIntBE(i); break;
+        case Primitive::LongBE: buffer.writeLongBE(i); break;
+        }
+    }
+}
+
+void addStringRows() {
+    QTest::addColumn<QString>("text");
+    for (int length : {16, 256, 4096}) {
+        QTest::addRow("ascii/%d", length) << sampleText(length, false);
+        QTest::addRow("cyrillic/%d", length) << sampleText(length, true);
+    }
+}
+
+}
+
+void CodecBenchmark::serialize_data() {
+    addPacketRows();
+}
+
+void CodecBenchmark::serialize() {
+    QFETCH(int, type);
+    QFETCH(int, size);
+    std::shared_ptr<Packet> packet = samplePacket(PacketType(type), size);
+    QVERIFY(packet);
+
+    QByteArray frame;
+    QBENCHMARK {
+        frame = packet->serialize();
+    }
+    QVERIFY(frame.size() >= Packet::HeaderSize);
+}
+
+void CodecBenchmark::deserialize_data() {
+    addPacketRows();
+}
+
+void CodecBenchmark::deserialize() {
+    QFETCH(int, type);
+    QFETCH(int, size);
+    const QByteArray frame = samplePacket(PacketType(type), size)->serialize();
+
+    std::shared_ptr<Packet> packet;
+    QBENCHMARK {
+        packet = Packet::deserialize(frame);
+    }
+    QVERIFY(packet);
+    QCOMPARE(int(packet->getType()), type);
+}
+
+void CodecBenchmark::byteBufferWrite_data() {
+    addPrimitiveRows();
+}
+
+void CodecBenchmark::byteBufferWrite() {
+    QFETCH(int, primitive);
+    QBENCHMARK {
+        ByteBuffer buffer;
+        fillPrimitives(buffer, Primitive(primitive));
+    }
+}
+
+void CodecBenchmark::byteBufferRead_data() {
+    addPrimitiveRows();
+}
+
+void CodecBenchmark::byteBufferRead() {
+    QFETCH(int, primitive);
+    ByteBuffer buffer;
+    fillPrimitives(buffer, Primitive(primitive));
+
+    qint64 sum = 0;
+    QBENCHMARK {
+        buffer.flushIndex();
+        for (int i = 0; i < PrimitiveCount; ++i) {
+            switch (Primitive(primitive)) {
+            case Primitive::Byte: sum += buffer.readByte(); break;
+            case Primitive::ShortLE: sum += buffer.readShortLE(); break;
+            case Primitive::IntLE: sum += buffer.readIntLE(); break;
+            case Primitive::LongLE: sum += buffer.readLongLE(); break;
+            case Primitive::ShortBE: sum += buffer.readShortBE(); break;
+            case Primitive::IntBE: sum += buffer.readIntBE(); break;
+            case Primitive::LongBE: sum += buffer.readLongBE(); break;
+            }
+        }
+    }
+    QVERIFY(sum != 0);
+}
+
+void CodecBenchmark::serializeString_data() {
+    addStringRows();
+}
+
+void CodecBenchmark::serializeString() {
+    QFETCH(QString, text);
+    QBENCHMARK {
+        ByteBuffer buffer;
+        StringCodec::serializeString(buffer, text);
+    }
+}
+
+void CodecBenchmark::deserializeString_data() {
+    addStringRows();
+}
+
+void CodecBenchmark::deserializeString() {
+    QFETCH(QString, text);
+    ByteBuffer buffer;
+    StringCodec::serializeString(buffer, text);
+
+    QString decoded;
+    QBENCHMARK {
+        buffer.flushIndex();
+        decoded = StringCodec::deserializeString(buffer);
+    }
+    QCOMPARE(decoded, text);
+}
+
+/**
+ * Кодек считает CRC побитово (CRC::CRC_32() без таблицы); строки table -
+ * тот же CRC по заранее построенной таблице для сравнения.
+ */
+void CodecBenchmark::crc_data() {
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("table");
+    for (int size : {64, 1024, 16 * 1024, 1024 * 1024}) {
+        QTest::addRow("bitwise/%d", size) << size << false;
+        QTest::addRow("table/%d", size) << size << true;
+    }
+}
+
+void CodecBenchmark::crc() {
+    QFETCH(int, size);
+    QFETCH(bool, table);
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = char(i * 31);
+    }
+    const CRC::Table<std::uint32_t, 32> crcTable(CRC::CRC_32());
+
+    std::uint32_t crc = 0;
+    if (table) {
+        QBENCHMARK {
+            crc = CRC::Calculate(data.constData(), data.size(), crcTable);
+        }
+    } else {
+        QBENCHMARK {
+            crc = CRC::Calculate(data.constData(), data.size(), CRC::CRC_32());
+        }
+    }
+    QCOMPARE(crc, CRC::Calculate(data.constData(), data.size(), crcTable));
+}
+
+QTEST_GUILESS_MAIN(CodecBenchmark)
+#include "CodecBenchmark.moc"
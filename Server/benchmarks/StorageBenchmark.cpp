@@ -0,0 +1,374 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <vector>
+#include "ChatDataBase.h"
+#include "ClientDataBase.h"
+#include "ChatManager.h"
+#include "ChatShards.h"
+#include "logger.h"
+
+/**
+ * @brief storage-benchmark - нагрузочная проверка хранилища сервера.
+ *
+ * Синтезирует базы чатов и пользователей заданного размера и измеряет:
+ * скорость вставки сообщений ChatDatabase::addMessage по одному и пачками
+ * в транзакции, задержки getAllChatNames, getRecentMessages, getMessagesAfter,
+ * getMessages и ClientDataBase::getUserData, время загрузки конструктором
+ * ChatManager и первой загрузки чата в кэш, прирост памяти процесса,
+ * скорость записи ChatManager::addMessageToChat в базу из --shards частей.
+ * Журнал сервера пишется в рабочий каталог, как и при обычной работе,
+ * поэтому его стоимость входит в измерения.
+ */
+
+namespace {
+
+struct Options {
+    int chats = 100;
+    int messagesPerChat = 1000;
+    int users = 1000;
+    int batch = 500;          /* сообщений в одной транзакции*/
+    int singleInserts = 2000; /* сколько сообщений вставить по одному*/
+    int samples = 200;        /* замеров на каждую операцию чтения*/
+    int textSize = 64;
+    int shards = 1;           /* частей базы для замера записи через ChatManager*/
+    int shardedMessages = 20000;
+    bool csv = false;
+};
+
+/* Результаты в виде "метрика значение единица"*/
+class Report {
+public:
+    explicit Report(bool csv) : csv(csv), out(stdout) {
+        if (csv) {
+            out << "metric,value,unit" << Qt::endl;
+        }
+    }
+
+    void add(const QString& metric, double value, const QString& unit) {
+        if (csv) {
+            out << metric << ',' << QString::number(value, 'f', 3) << ',' << unit << Qt::endl;
+        } else {
+            out << QString("%1 %2 %3").arg(metric, -40).arg(value, 14, 'f', 3).arg(unit) << Qt::endl;
+        }
+    }
+
+    /* min, p50, p99, max и среднее по замерам в наносекундах, выводятся в микросекундах*/
+    void addLatency(const QString& metric, std::vector<qint64> samples) {
+        if (samples.empty()) {
+            return;
+        }
+        std::sort(samples.begin(), samples.end());
+        auto at = [&samples](double fraction) {
+            size_t index = size_t(fraction * double(samples.size() - 1) + 0.5);
+            return samples[index] / 1000.0;
+        };
+        double sum = 0;
+        for (qint64 sample : samples) {
+            sum += double(sample);
+        }
+        add(metric + ".p50", at(0.50), "us");
+        add(metric + ".p99", at(0.99), "us");
+        add(metric + ".max", samples.back() / 1000.0, "us");
+        add(metric + ".mean", sum / double(samples.size()) / 1000.0, "us");
+    }
+
+private:
+    bool csv;
+    QTextStream out;
+};
+
+/* Резидентная память процесса в байтах, -1 - недоступно на этой платформе*/
+qint64 residentBytes() {
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields[1].toLongLong() * 4096;
+        }
+    }
+#endif
+    return -1;
+}
+
+QString chatName(int index) {
+    return QString("chat_%1").arg(index);
+}
+
+QString userName(int index) {
+    return QString("user_%1").arg(index);
+}
+
+/* Журнал пишется в файл, а его копии в консоль не мешают отчету*/
+void quietMessageHandler(QtMsgType type, const QMessageLogContext&, const QString& message) {
+    if (type == QtWarningMsg || type == QtCriticalMsg || type == QtFatalMsg) {
+        QTextStream(stderr) << message << Qt::endl;
+    }
+}
+
+void populateUsers(const Options& options, const QString& path, Report& report) {
+    ClientDataBase users(path);
+    QSqlDatabase db = QSqlDatabase::database("ClientDataBase");
+    QElapsedTimer timer;
+    timer.start();
+    db.transaction();
+    for (int i = 0; i < options.users; ++i) {
+        users.createUser("Имя", "Фамилия", userName(i), "hash", "salt");
+    }
+    db.commit();
+    report.add("users.insert.rate", options.users / qMax(1e-9, timer.nsecsElapsed() / 1e9), "users/s");
+}
+
+void populateChats(const Options& options, const QString& path, Report& report) {
+    ChatDatabase database;
+    database.open(path);
+    for (int i = 0; i < options.chats; ++i) {
+        database.addChat(chatName(i));
+    }
+
+    QRandomGenerator random(42);
+    const QString text(options.textSize, QChar('x'));
+    const QDateTime timestamp = QDateTime::currentDateTime();
+    std::vector<quint32> seqs(options.chats, 0);
+    const qint64 total = qint64(options.chats) * options.messagesPerChat;
+    const qint64 single = qMin<qint64>(total, options.singleInserts);
+    auto insert = [&](qint64 i) {
+        const int chat = int(i % options.chats);
+        const QString sender = userName(int(random.bounded(qMax(1, options.users))));
+        database.addMessage(chatName(chat), ++seqs[chat], sender, text, timestamp, "Имя", "Фамилия");
+    };
+
+    /*по одному: каждая вставка - своя транзакция, как у одиночного PacketMessage*/
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 i = 0; i < single; ++i) {
+        insert(i);
+    }
+    if (single > 0) {
+        report.add("messages.insert.single.rate", single / qMax(1e-9, timer.nsecsElapsed() / 1e9), "msg/s");
+    }
+
+    /*пачками: batch сообщений в одной транзакции, как у PacketMessageBatch*/
+    timer.restart();
+    for (qint64 i = single; i < total; i += options.batch) {
+        database.transaction();
+        for (qint64 j = i; j < qMin(total, i + options.batch); ++j) {
+            insert(j);
+        }
+        database.commit();
+    }
+    if (total > single) {
+        report.add("messages.insert.batched.rate", (total - single) / qMax(1e-9, timer.nsecsElapsed() / 1e9),
+                   "msg/s");
+    }
+}
+
+/* Задержки запросов ChatDatabase к заполненной базе*/
+void measureChatQueries(const Options& options, const QString& path, Report& report) {
+    ChatDatabase database;
+    database.open(path);
+    QRandomGenerator random(7);
+    QElapsedTimer timer;
+
+    std::vector<qint64> names;
+    for (int i = 0; i < qMin(options.samples, 50); ++i) {
+        timer.start();
+        database.getAllChatNames();
+        names.push_back(timer.nsecsElapsed());
+    }
+    report.addLatency("chats.getAllChatNames", names);
+
+    std::vector<qint64> recent;
+    std::vector<qint64> after;
+    for (int i = 0; i < options.samples; ++i) {
+        const QString chat = chatName(int(random.bounded(options.chats)));
+        timer.start();
+        database.getRecentMessages(chat, Chat::DefaultCapacity);
+        recent.push_back(timer.nsecsElapsed());
+
+        const quint32 from = random.bounded(quint32(qMax(1, options.messagesPerChat)));
+        timer.start();
+        database.getMessagesAfter(chat, from, 100);
+        after.push_back(timer.nsecsElapsed());
+    }
+    report.addLatency("messages.getRecentMessages", recent);
+    report.addLatency("messages.getMessagesAfter100", after);
+
+    /*полная история дорогая, поэтому замеров меньше*/
+    std::vector<qint64> full;
+    for (int i = 0; i < qMin(options.samples, 20); ++i) {
+        timer.start();
+        database.getMessages(chatName(int(random.bounded(options.chats))));
+        full.push_back(timer.nsecsElapsed());
+    }
+    report.addLatency("messages.getMessages", full);
+}
+
+void measureUserQueries(const Options& options, const QString& path, Report& report) {
+    ClientDataBase users(path);
+    QRandomGenerator random(11);
+    QElapsedTimer timer;
+    std::vector<qint64> samples;
+    for (int i = 0; i < options.samples; ++i) {
+        const QString name = userName(int(random.bounded(qMax(1, options.users))));
+        timer.start();
+        users.getUserData(name);
+        samples.push_back(timer.nsecsElapsed());
+    }
+    report.addLatency("users.getUserData", samples);
+}
+
+/* Загрузка ChatManager при старте сервера и первое обращение к чатам*/
+void measureStartup(const Options& options, const QString& path, Report& report) {
+    const qint64 before = residentBytes();
+    QElapsedTimer timer;
+    timer.start();
+    ChatManager manager(path, 1);
+    report.add("startup.chatManager", timer.nsecsElapsed() / 1e6, "ms");
+    const qint64 loaded = residentBytes();
+
+    QRandomGenerator random(13);
+    std::vector<qint64> cold;
+    for (int i = 0; i < qMin(options.samples, options.chats); ++i) {
+        const quint32 id = manager.chatId(chatName(int(random.bounded(options.chats))));
+        timer.start();
+        manager.getChat(id);
+        /*история читается в потоке записи части, чат готов после ее обратного вызова*/
+        manager.flush();
+        QCoreApplication::sendPostedEvents();
+        cold.push_back(timer.nsecsElapsed());
+    }
+    report.addLatency("startup.firstGetChat", cold);
+
+    if (before >= 0) {
+        report.add("memory.chatManager", (loaded - before) / 1024.0, "KiB");
+        report.add("memory.afterGetChat", (residentBytes() - before) / 1024.0, "KiB");
+        report.add("memory.cachedMessages", manager.cachedBytes() / 1024.0, "KiB");
+    }
+}
+
+/* Запись через ChatManager: потоки ShardWriter, по одному на часть базы, с групповой фиксацией*/
+void measureShardedWrites(const Options& options, const QString& path, Report& report) {
+    ChatManager manager(path, options.shards);
+    if (!manager.isOpen()) {
+        return;
+    }
+    for (int i = 0; i < options.chats; ++i) {
+        manager.createChat(chatName(i));
+    }
+    /*создание идет в два шага: строка каталога, затем номер в части чата*/
+    for (int step = 0; step < 2; ++step) {
+        manager.flush();
+        QCoreApplication::sendPostedEvents();
+    }
+
+    std::vector<quint32> ids;
+    for (int i = 0; i < options.chats; ++i) {
+        ids.push_back(manager.chatId(chatName(i)));
+    }
+    QRandomGenerator random(17);
+    const QString text(options.textSize, QChar('x'));
+    const QDateTime timestamp = QDateTime::currentDateTime();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < options.shardedMessages; ++i) {
+        const QString sender = userName(int(random.bounded(qMax(1, options.users))));
+        manager.addMessageToChat(ids[size_t(i % options.chats)], sender, text, timestamp, "Имя", "Фамилия");
+    }
+    manager.flush();
+    QCoreApplication::sendPostedEvents();
+    if (options.shardedMessages > 0) {
+        report.add("messages.insert.sharded.rate", options.shardedMessages / qMax(1e-9, timer.nsecsElapsed() / 1e9),
+                   "msg/s");
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("storage-benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Нагрузочная проверка ChatDatabase, ClientDataBase и загрузки ChatManager");
+    parser.addHelpOption();
+    Options options;
+    QCommandLineOption chats("chats", "Число чатов.", "n", QString::number(options.chats));
+    QCommandLineOption messages("messages", "Сообщений в каждом чате.", "n", QString::number(options.messagesPerChat));
+    QCommandLineOption users("users", "Число пользователей.", "n", QString::number(options.users));
+    QCommandLineOption batch("batch", "Сообщений в одной транзакции.", "n", QString::number(options.batch));
+    QCommandLineOption single("single", "Сколько сообщений вставить по одному.", "n",
+                              QString::number(options.singleInserts));
+    QCommandLineOption samples("samples", "Замеров на каждую операцию чтения.", "n", QString::number(options.samples));
+    QCommandLineOption textSize("text-size", "Длина текста сообщения.", "chars", QString::number(options.textSize));
+    QCommandLineOption shards("shards", "Частей базы для замера записи через ChatManager.", "n",
+                              QString::number(options.shards));
+    QCommandLineOption shardedMessages("sharded-messages", "Сколько сообщений записать через ChatManager.", "n",
+                                       QString::number(options.shardedMessages));
+    QCommandLineOption dir("dir", "Каталог для баз; по умолчанию временный, удаляется после прогона.", "path");
+    QCommandLineOption csv("csv", "Вывод в формате CSV.");
+    parser.addOptions({chats, messages, users, batch, single, samples, textSize, shards, shardedMessages, dir, csv});
+    parser.process(app);
+
+    options.chats = qMax(1, parser.value(chats).toInt());
+    options.messagesPerChat = qMax(0, parser.value(messages).toInt());
+    options.users = qMax(0, parser.value(users).toInt());
+    options.batch = qMax(1, parser.value(batch).toInt());
+    options.singleInserts = qMax(0, parser.value(single).toInt());
+    options.samples = qMax(1, parser.value(samples).toInt());
+    options.textSize = qMax(1, parser.value(textSize).toInt());
+    options.shards = qBound(1, parser.value(shards).toInt(), ChatShards::MaxShards);
+    options.shardedMessages = qMax(0, parser.value(shardedMessages).toInt());
+    options.csv = parser.isSet(csv);
+
+    QTemporaryDir temporary;
+    const QString workDir = parser.isSet(dir) ? parser.value(dir) : temporary.path();
+    const QString chatsPath = workDir + "/chats.db";
+    const QString usersPath = workDir + "/users.db";
+    const QString shardedPath = workDir + "/sharded.db";
+    QFile::remove(chatsPath);
+    QFile::remove(usersPath);
+    for (const QString& path : ChatShards::shardPaths(shardedPath, options.shards)) {
+        QFile::remove(path);
+    }
+
+    qInstallMessageHandler(quietMessageHandler);
+    Logger& logger = Logger::getInstance();
+    logger.setLogFile(workDir + "/storage-benchmark.log");
+    logger.open();
+
+    Report report(options.csv);
+    report.add("config.chats", options.chats, "");
+    report.add("config.messagesPerChat", options.messagesPerChat, "");
+    report.add("config.users", options.users, "");
+    report.add("config.shards", options.shards, "");
+
+    populateUsers(options, usersPath, report);
+    QSqlDatabase::removeDatabase("ClientDataBase");
+    populateChats(options, chatsPath, report);
+    QSqlDatabase::removeDatabase("ChatDatabase");
+    report.add("files.chats", QFileInfo(chatsPath).size() / 1024.0, "KiB");
+    report.add("files.users", QFileInfo(usersPath).size() / 1024.0, "KiB");
+
+    measureChatQueries(options, chatsPath, report);
+    QSqlDatabase::removeDatabase("ChatDatabase");
+    measureUserQueries(options, usersPath, report);
+    QSqlDatabase::removeDatabase("ClientDataBase");
+    measureStartup(options, chatsPath, report);
+    QSqlDatabase::removeDatabase("ChatDatabase");
+    measureShardedWrites(options, shardedPath, report);
+    for (int shard = 0; shard < options.shards; ++shard) {
+        QSqlDatabase::removeDatabase(ChatShards::connectionName(shard));
+    }
+
+    logger.close();
+    return 0;
+}
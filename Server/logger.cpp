@@ -73,6 +73,7 @@ void Logger::close() {
  * @param message Сообщение для записи.
  */
 void Logger::log(QtMsgType level, const QString& message) {
+    QMutexLocker locker(&mutex);
     if (!is_open) {
         qCritical() << "Файл журнала закрыт:" << currentFile;
         return;
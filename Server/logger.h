@@ -7,6 +7,7 @@
 #include <QDebug>
 #include <QDateTime>
 #include <QDir>
+#include <QMutex>
 
 /**
  * @brief Класс Logger (синглтону).
@@ -25,6 +26,7 @@ private:
     QTextStream logStream;
     QString currentFile;
     bool is_open;
+    QMutex mutex; /*запись в журнал возможна из рабочих потоков*/
 
     Logger();
 
@@ -5,7 +5,13 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QSettings>
+#include <QScrollBar>
+#include <QThread>
+#include <limits>
 #include "logger.h"
+#include "FrameCompression.h"
+#include "Metrics.h"
+#include "Tracer.h"
 
 
 MainWindow::MainWindow(QWidget *parent)
@@ -22,10 +28,26 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->CreateChatpushButton, &QPushButton::clicked, this, &MainWindow::onCreateChatButtonClicked);
 
     connect(ui->DeleteChatpushButton, &QPushButton::clicked, this, &MainWindow::onDeleteChatButtonClicked);
+    connect(ui->RenameChatpushButton, &QPushButton::clicked, this, &MainWindow::onRenameChatButtonClicked);
+    connect(ui->RetentionChatlineEdit, &QLineEdit::editingFinished, this, &MainWindow::onRetentionChatChanged);
+    connect(ui->RetentionpushButton, &QPushButton::clicked, this, &MainWindow::onRetentionButtonClicked);
+
+    /*вкладка статистики обновляется, только пока она открыта*/
+    connect(&statsTimer, &QTimer::timeout, this, &MainWindow::refreshStats);
+    connect(ui->tabWidget, &QTabWidget::currentChanged, this, [this](int) {
+        if (ui->tabWidget->currentWidget() == ui->tab_3) {
+            refreshStats();
+            statsTimer.start(1000);
+        } else {
+            statsTimer.stop();
+        }
+    });
 }
 
 MainWindow::~MainWindow()
 {
+    delete credentialPool; // дожидаемся задач пула, пока база пользователей еще существует
+    Tracer::getInstance().stop(); // закрываем JSON, иначе файл трассы не откроется
     delete ui;
     Logger::getInstance().close();
 
@@ -88,9 +110,12 @@ void MainWindow::on_StartServer_clicked()
         return;
     }
 
-    chatManager = new ChatManager(chatDbPath, this);  // предполагается, что конструктор принимает путь
+    QSettings settings("Grachev", "ChatServer");
+    /*число частей базы чатов меняется только вместе с messenger-rebalance*/
+    chatManager = new ChatManager(chatDbPath, settings.value("storage/shards", 1).toInt(), this);
     if (!chatManager->isOpen()) {
-        QMessageBox::critical(this, "Ошибка", "Не удалось открыть базу данных чатов");
+        QMessageBox::critical(this, "Ошибка", "Не удалось открыть базу данных чатов. Если менялось число частей "
+                                              "storage/shards, перераспределите базу утилитой messenger-rebalance");
         delete chatManager;
         chatManager = nullptr;
         delete clientDataBase;
@@ -106,40 +131,170 @@ void MainWindow::on_StartServer_clicked()
 
     packetRouter = new PacketRouter(this);
 
-    PacketRegisterHandler* packetRegisterHandler = new PacketRegisterHandler(clientDataBase, managerNetwork, this);
-    PacketAuthHandler* packetAuthHandler = new PacketAuthHandler(clientDataBase, managerNetwork, this);
-    PacketMessageHandler* packetMessageHandler = new PacketMessageHandler(clientDataBase, managerNetwork, chatManager,  this);
+    int authThreads = settings.value("auth_worker_threads", qMax(2, QThread::idealThreadCount() / 2)).toInt();
+    int authQueue = settings.value("auth_queue_limit", 1024).toInt();
+    credentialPool = new CredentialWorkerPool(clientDataBase, authThreads, authQueue, this);
+    chatManager->setCachePolicy(settings.value("cache/messages_per_chat", Chat::DefaultCapacity).toInt(),
+                                settings.value("cache/memory_budget_mb", 64).toLongLong() * 1024 * 1024);
+
+    PacketRegisterHandler* packetRegisterHandler = new PacketRegisterHandler(clientDataBase, managerNetwork, credentialPool, this);
+    QByteArray sessionSecret = QByteArray::fromHex(settings.value("session_secret").toByteArray());
+    if (sessionSecret.isEmpty()) {
+        sessionSecret = SessionTokenManager::generateSecret();
+        settings.setValue("session_secret", sessionSecret.toHex());
+    }
+    qint64 sessionTtl = settings.value("session_ttl_hours", 12).toLongLong() * 3600;
+    sessionTokens = std::make_unique<SessionTokenManager>(sessionSecret, sessionTtl);
+
+    PacketAuthHandler* packetAuthHandler = new PacketAuthHandler(clientDataBase, managerNetwork, credentialPool,
+                                                                 sessionTokens.get(), this);
+    BroadcastCoalescer* broadcaster = new BroadcastCoalescer(managerNetwork, this);
+    broadcaster->setPolicy(settings.value("broadcast/linger_ms", 5).toInt(),
+                           settings.value("broadcast/max_messages", 64).toInt());
+    PacketMessageHandler* packetMessageHandler = new PacketMessageHandler(clientDataBase, managerNetwork, chatManager,
+                                                                          broadcaster, this);
     PacketChatListHandler* chatListHandler = new PacketChatListHandler(chatManager, managerNetwork, this);
+    PacketSyncHandler* syncHandler = new PacketSyncHandler(chatManager, managerNetwork, this);
+    PacketHelloHandler* helloHandler = new PacketHelloHandler(managerNetwork, this);
+    /*полнотекстовый поиск: индекс догоняет новые сообщения в потоке хранилища*/
+    SearchWorker* searchWorker = new SearchWorker(chatManager->shardPaths(),
+                                                  settings.value("search/queue_limit", 256).toInt(), this);
+    searchWorker->setIndexPolicy(settings.value("search/index_batch", 500).toInt(),
+                                 settings.value("search/index_interval_ms", 250).toInt());
+    PacketSearchHandler* searchHandler = new PacketSearchHandler(searchWorker, managerNetwork, this);
+    /*сроки хранения: просроченные сообщения уходят в архив и удаляются в фоновом потоке*/
+    retentionWorker = new RetentionWorker(chatManager->shardPaths(),
+                                          settings.value("retention/archive_dir", chatDbPath + ".archive").toString(),
+                                          settings.value("retention/segment_mb", 64).toLongLong() * 1024 * 1024, this);
+    RetentionPolicy retention;
+    retention.maxAgeDays = settings.value("retention/max_age_days", 0).toInt();
+    retention.maxCount = settings.value("retention/max_count", 0).toInt();
+    retentionWorker->setGlobalPolicy(retention);
+    retentionWorker->setSchedule(settings.value("retention/interval_min", 60).toInt(),
+                                 settings.value("retention/batch", 1000).toInt(),
+                                 settings.value("retention/vacuum_pages", 256).toInt());
+    connect(retentionWorker, &RetentionWorker::messagesExpired, chatManager, &ChatManager::expireMessages);
+    onRetentionChatChanged();
+    managerNetwork->setCompression(settings.value("compression/enabled", true).toBool(),
+                                   settings.value("compression/threshold", FrameCompression::DefaultThreshold).toInt());
+    managerNetwork->setBackend(settings.value("network/backend", "qt").toString() == "epoll"
+                                   ? ManagerNetwork::Backend::Epoll : ManagerNetwork::Backend::Qt);
+    managerNetwork->setAcceptPolicy(settings.value("network/acceptors", 1).toInt(),
+                                    settings.value("network/listen_backlog", 1024).toInt(),
+                                    settings.value("network/accept_batch", 64).toInt());
+    managerNetwork->setHeartbeat(settings.value("heartbeat/ping_interval_sec", 30).toInt() * 1000,
+                                 settings.value("heartbeat/timeout_sec", 90).toInt() * 1000);
     packetRouter->registerHandler(packetRegisterHandler);
     packetRouter->registerHandler(packetAuthHandler);
     packetRouter->registerHandler(packetMessageHandler);
     packetRouter->registerHandler(chatListHandler);
+    packetRouter->registerHandler(syncHandler);
+    packetRouter->registerHandler(helloHandler);
+    packetRouter->registerHandler(searchHandler);
+
+    rateLimiter = new RateLimiter(managerNetwork, this);
+    rateLimiter->loadSettings(settings);
+    packetRouter->setRateLimiter(rateLimiter);
+    connect(packetRouter, &PacketRouter::packetRejected, this, &MainWindow::onPacketRejected);
+    connect(managerNetwork, &ManagerNetwork::clientDisconnected, rateLimiter, &RateLimiter::onClientDisconnected);
     connect(managerNetwork, &ManagerNetwork::dataReceived, this, &MainWindow::onDataReceived);
     connect(managerNetwork, &ManagerNetwork::errorOccurred, this, &MainWindow::handleServerError);
     connect(managerNetwork, &ManagerNetwork::newConnection, this, &MainWindow::handleNewConnection);
     connect(managerNetwork, &ManagerNetwork::clientDisconnected, this, &MainWindow::handleClientDisconnected);
-    connect(chatManager, &ChatManager::chatDeleted, this, &MainWindow::sendUpdatedChatList);
-    connect(chatManager, &ChatManager::chatAdded, this, &MainWindow::sendUpdatedChatList);
+    connect(managerNetwork, &ManagerNetwork::clientDisconnected, packetAuthHandler, &PacketAuthHandler::onClientDisconnected);
+    connect(chatManager, &ChatManager::chatAdded, this, [this](const QString& name) {
+        ui->LisyOfChatListWidget->addItem(name);
+        ui->ChatSelectionComboBox->addItem(name);
+        sendChatListDelta(PacketChatListDelta::Kind::Added, name);
+    });
+    connect(chatManager, &ChatManager::chatDeleted, this, [this](const QString& name) {
+        sendChatListDelta(PacketChatListDelta::Kind::Removed, name);
+    });
+    connect(chatManager, &ChatManager::chatRenamed, this, [this](const QString& name, const QString& newName) {
+        sendChatListDelta(PacketChatListDelta::Kind::Renamed, name, newName);
+    });
+    /*история открытого чата догружается из базы после его выбора*/
+    connect(chatManager, &ChatManager::chatLoaded, this, [this](const QString& name) {
+        if (ui->ChatSelectionComboBox->currentText() == name) {
+            on_ChatSelectionComboBox_currentTextChanged(name);
+        }
+    });
     saveSettings();
     managerNetwork->startServer(port, address);
     logger.log(QtInfoMsg, QString("Сервер успешно запустился на порту %1 и слушает %2").arg(port).arg(address.toString()));
+    /*локальный сокет для ботов и мостов на этой же машине, пустое имя - выключен*/
+    const QString localSocket = settings.value("network/local_socket").toString();
+    if (!localSocket.isEmpty()) {
+        managerNetwork->startLocalServer(localSocket);
+    }
+    /*метрики в формате Prometheus на loopback, порт 0 - выключены*/
+    const quint16 metricsPort = quint16(settings.value("metrics/port", 0).toUInt());
+    if (metricsPort != 0) {
+        metricsEndpoint = new MetricsEndpoint(this);
+        metricsEndpoint->listen(metricsPort);
+    }
+    /*запись входящего трафика для messenger-replay, пустой путь - выключена.
+      Файл содержит переписку и доступен только владельцу. Кадры Register, Auth
+      и SessionResume (хэши паролей и токены сессий) пишутся лишь при
+      capture/include_credentials = true - без них воспроизведенные соединения
+      не проходят аутентификацию; такой файл равносилен выдаче паролей*/
+    const QString captureFile = settings.value("capture/file").toString();
+    if (!captureFile.isEmpty()) {
+        managerNetwork->startCapture(captureFile, settings.value("capture/max_mb", 1024).toLongLong() * 1024 * 1024,
+                                     settings.value("capture/include_credentials", false).toBool());
+    }
+    /*выборочная трассировка пакетов в формате Chrome trace, пустой путь - выключена*/
+    const QString traceFile = settings.value("trace/file").toString();
+    if (!traceFile.isEmpty()) {
+        QThread::currentThread()->setObjectName("server");
+        Tracer::getInstance().start(traceFile, settings.value("trace/sample_every", 100).toInt(),
+                                    settings.value("trace/max_mb", 256).toLongLong() * 1024 * 1024);
+    }
 
 }
 
 void MainWindow::handleServerError(const QString& errorMessage) {
 }
 
-void MainWindow::handleNewConnection(QTcpSocket* socket) {
+void MainWindow::handleNewConnection(ClientConnection* connection) {
+    if (rateLimiter && !connection->local && rateLimiter->isBanned(connection->peerAddress())) {
+        Logger::getInstance().log(QtWarningMsg, QString("Отклонено подключение с заблокированного адреса %1")
+                                                    .arg(connection->peerAddress().toString()));
+        managerNetwork->disconnectClient(connection);
+    }
+}
+
+/**
+ * @brief Сообщает клиенту, что его пакет отброшен ограничителем частоты.
+ * Заблокированный клиент отключается.
+ */
+void MainWindow::onPacketRejected(ClientConnection* connection, PacketType type, qint64 retryAfterMs, bool banned, bool notify) {
+    if (notify) {
+        PacketServerResponse response;
+        response.SetResponseType(PacketServerResponse::ServerResponseType::RateLimit);
+        response.SetResponseStatus(PacketServerResponse::ServerResponseStatus::Failed);
+        response.SetResponseMessage(banned
+                                        ? QString("Превышен лимит запросов, доступ временно заблокирован на %1 с")
+                                              .arg((retryAfterMs + 999) / 1000)
+                                        : QString("Слишком много запросов, повторите через %1 мс").arg(retryAfterMs));
+        response.SetRetryAfterMs(static_cast<qint32>(qMin<qint64>(retryAfterMs, std::numeric_limits<qint32>::max())));
+        managerNetwork->sendMessageToUser(connection, response.serialize());
+        Logger::getInstance().log(QtWarningMsg, QString("Пакет %1 от %2 отклонен ограничителем частоты")
+                                                    .arg(Packet::typeName(type), connection->peerAddress().toString()));
+    }
+    if (banned) {
+        managerNetwork->disconnectClient(connection, true);
+    }
 }
 
 
 
-void MainWindow::handleClientDisconnected(QTcpSocket* socket) {
-    qDebug() << "Клиент отключился:" << socket->peerAddress().toString();
+void MainWindow::handleClientDisconnected(ClientConnection* connection) {
+    qDebug() << "Клиент отключился:" << connection->peerAddress().toString();
 }
 
-void MainWindow::onDataReceived(QTcpSocket* socket, const QByteArray& data) {
-    packetRouter->routePacket(socket, data);
+void MainWindow::onDataReceived(ClientConnection* connection, const QByteArray& data) {
+    packetRouter->routePacket(connection, data);
 }
 
 void MainWindow::on_Port_valueChanged(int arg1)
@@ -204,7 +359,7 @@ void MainWindow::on_ChatSelectionComboBox_currentTextChanged(const QString &chat
     }
 
     Chat* chat = chatManager->getChat(chatName);
-    if (chat->getName() == nullptr) {
+    if (!chat) {
         ui->chatHistory->setText("Чат не найден.");
         return;
     }
@@ -218,15 +373,23 @@ void MainWindow::on_ChatSelectionComboBox_currentTextChanged(const QString &chat
     }
 }
 
-void MainWindow::sendUpdatedChatList() {
+/**
+ * @brief Рассылает клиентам одно изменение списка чатов вместо всего списка.
+ * @param kind Вид изменения.
+ * @param chatName Имя чата.
+ * @param newName Новое имя чата (при переименовании).
+ */
+void MainWindow::sendChatListDelta(PacketChatListDelta::Kind kind, const QString& chatName, const QString& newName) {
     Logger& logger = Logger::getInstance();
-    PacketChatList packet;
-    QStringList chatNames = chatManager->getAllChatNames();
-    packet.setChatNames(chatNames);
+    PacketChatListDelta packet;
+    packet.setKind(kind);
+    packet.setVersion(chatManager->getChatListVersion());
+    packet.setChatName(chatName);
+    packet.setNewName(newName);
 
     QByteArray serializedData = packet.serialize();
     managerNetwork->broadcastMessage(serializedData);
-    logger.log(QtInfoMsg, "Обновленный список чатов отправлен.");
+    logger.log(QtInfoMsg, QString("Изменение списка чатов (версия %1) отправлено.").arg(packet.getVersion()));
 }
 
 void MainWindow::updateChatListUI() {
@@ -247,7 +410,7 @@ void MainWindow::onDeleteChatButtonClicked() {
         QMessageBox::warning(this, "Ошибка", "Введите название чата для удаления");
         return;
     }
-    if (!chatManager->getAllChatNames().contains(name)) {
+    if (!chatManager->hasChat(name)) {
         QMessageBox::warning(this, "Ошибка", QString("Чат '%1' не найден.").arg(name));
         return;
     }
@@ -261,6 +424,76 @@ void MainWindow::onDeleteChatButtonClicked() {
     }
 }
 
+void MainWindow::onRenameChatButtonClicked() {
+    QString name = ui->RenameChatlineEdit->text().trimmed();
+    QString newName = ui->RenameChatNewNamelineEdit->text().trimmed();
+    if (name.isEmpty() || newName.isEmpty()) {
+        QMessageBox::warning(this, "Ошибка", "Введите текущее и новое название чата");
+        return;
+    }
+    if (!chatManager->hasChat(name)) {
+        QMessageBox::warning(this, "Ошибка", QString("Чат '%1' не найден.").arg(name));
+        return;
+    }
+    if (chatManager->hasChat(newName)) {
+        QMessageBox::warning(this, "Ошибка", QString("Чат '%1' уже существует.").arg(newName));
+        return;
+    }
+
+    if (chatManager->renameChat(name, newName)) {
+        updateChatListUI();
+        ui->RenameChatlineEdit->clear();
+        ui->RenameChatNewNamelineEdit->clear();
+    }
+}
+
+/**
+ * @brief Показывает срок хранения выбранного чата или общий, если чат не указан.
+ */
+void MainWindow::onRetentionChatChanged() {
+    const QString name = ui->RetentionChatlineEdit->text().trimmed();
+    RetentionPolicy policy;
+    if (name.isEmpty()) {
+        QSettings settings("Grachev", "ChatServer");
+        policy.maxAgeDays = settings.value("retention/max_age_days", 0).toInt();
+        policy.maxCount = settings.value("retention/max_count", 0).toInt();
+    } else if (chatManager && chatManager->hasChat(name)) {
+        policy = chatManager->retentionPolicy(name);
+    }
+    ui->RetentionDaysspinBox->setValue(policy.maxAgeDays);
+    ui->RetentionCountspinBox->setValue(policy.maxCount);
+}
+
+/**
+ * @brief Сохраняет срок хранения и запускает внеочередной проход.
+ * Без имени чата задается общий срок, для чата 0 в обоих полях
+ * возвращает его к общему.
+ */
+void MainWindow::onRetentionButtonClicked() {
+    if (!chatManager || !retentionWorker) {
+        QMessageBox::warning(this, "Ошибка", "Сначала запустите сервер");
+        return;
+    }
+    const QString name = ui->RetentionChatlineEdit->text().trimmed();
+    RetentionPolicy policy;
+    policy.maxAgeDays = ui->RetentionDaysspinBox->value();
+    policy.maxCount = ui->RetentionCountspinBox->value();
+
+    if (name.isEmpty()) {
+        QSettings settings("Grachev", "ChatServer");
+        settings.setValue("retention/max_age_days", policy.maxAgeDays);
+        settings.setValue("retention/max_count", policy.maxCount);
+        retentionWorker->setGlobalPolicy(policy);
+    } else if (!chatManager->hasChat(name)) {
+        QMessageBox::warning(this, "Ошибка", QString("Чат '%1' не найден.").arg(name));
+        return;
+    } else if (!chatManager->setRetentionPolicy(name, policy)) {
+        QMessageBox::warning(this, "Ошибка", QString("Не удалось сохранить срок хранения чата '%1'.").arg(name));
+        return;
+    }
+    retentionWorker->runNow();
+}
+
 void MainWindow::onUserDbButtonClicked() {
     QString path = QFileDialog::getOpenFileName(
         this,
@@ -304,11 +537,20 @@ void MainWindow::onCreateChatButtonClicked() {
         return;
     }
 
+    /*чат появится в списках по сигналу chatAdded, когда его запишет поток каталога*/
     chatManager->createChat(name);
-    ui->LisyOfChatListWidget->addItem(name);
-    ui->ChatSelectionComboBox->addItem(name);
     ui->CreateChatlineEdit->clear();
 }
 void MainWindow::appendLogToInterface(const QString& logMessage) {
     ui->LogsTextEdit->append(logMessage);
 }
+
+/**
+ * @brief Выводит текущие значения метрик, сохраняя положение прокрутки.
+ */
+void MainWindow::refreshStats() {
+    QScrollBar* scrollBar = ui->StatsTextEdit->verticalScrollBar();
+    const int position = scrollBar->value();
+    ui->StatsTextEdit->setPlainText(Metrics::getInstance().renderText());
+    scrollBar->setValue(position);
+}
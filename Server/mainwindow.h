@@ -2,9 +2,13 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTcpSocket>
+#include <QTimer>
+#include "ClientConnection.h"
 #include "ManagerNetwork.h"
 #include "Packetrouter.h"
+#include "RateLimiter.h"
+#include "MetricsEndpoint.h"
+#include "RetentionWorker.h"
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
@@ -22,9 +26,10 @@ public:
 private slots:
     void on_StartServer_clicked();
     void handleServerError(const QString& errorMessage); // Обработка ошибок сервера
-    void handleNewConnection(QTcpSocket* socket);        // Обработка новых подключений
-    void onDataReceived(QTcpSocket* socket, const QByteArray& data); // Обработка данных
-    void handleClientDisconnected(QTcpSocket* socket);
+    void handleNewConnection(ClientConnection* connection);        // Обработка новых подключений
+    void onPacketRejected(ClientConnection* connection, PacketType type, qint64 retryAfterMs, bool banned, bool notify);
+    void onDataReceived(ClientConnection* connection, const QByteArray& data); // Обработка данных
+    void handleClientDisconnected(ClientConnection* connection);
     void on_Port_valueChanged(int arg1);
 
     void on_ip_adres_lissen_textChanged(const QString &arg1);
@@ -38,8 +43,9 @@ private slots:
 
     void on_Log_bd_textEdited(const QString &arg1);
 
-    void sendUpdatedChatList();
+    void sendChatListDelta(PacketChatListDelta::Kind kind, const QString& chatName, const QString& newName = QString());
     void appendLogToInterface(const QString& logMessage);
+    void refreshStats(); // Обновление вкладки статистики
 
 
     //void on_pushButton_3_clicked();
@@ -50,10 +56,19 @@ private:
     PacketRouter* packetRouter;
     ClientDataBase *clientDataBase;
     ChatManager *chatManager;
+    CredentialWorkerPool *credentialPool = nullptr;
+    RateLimiter *rateLimiter = nullptr;
+    std::unique_ptr<SessionTokenManager> sessionTokens;
+    MetricsEndpoint *metricsEndpoint = nullptr;
+    RetentionWorker *retentionWorker = nullptr;
+    QTimer statsTimer;
 
     void loadSettings();
     void saveSettings();
     void onDeleteChatButtonClicked();
+    void onRenameChatButtonClicked();
+    void onRetentionChatChanged();
+    void onRetentionButtonClicked();
     void updateChatListUI();
     void onUserDbButtonClicked();
     void onChatDbButtonClicked();
@@ -1,16 +1,96 @@
 #include "ManagerNetwork.h"
 #include "logger.h"
+#include "protocol.h"
+#include "Tracer.h"
+#include "QtNetworkBackend.h"
+#ifdef MESSENGER_HAVE_EPOLL
+#include "EpollNetworkBackend.h"
+#endif
 #include <QDebug>
 
 ManagerNetwork::ManagerNetwork(QObject* parent)
-    : QObject(parent) {
-    connect(&server, &QTcpServer::newConnection, this, &ManagerNetwork::onNewConnection);
+    : QObject(parent), idleTimers(HeartbeatTickMs, 0),
+      openConnections(Metrics::getInstance().gauge("messenger_connections", "Open client connections")),
+      acceptedConnections(Metrics::getInstance().counter("messenger_connections_accepted_total",
+                                                         "Accepted client connections")),
+      bytesReceived(Metrics::getInstance().counter("messenger_bytes_received_total",
+                                                   "Bytes of complete frames received from clients")),
+      bytesSent(Metrics::getInstance().counter("messenger_bytes_sent_total",
+                                               "Bytes written to client transports")),
+      broadcastFanout(Metrics::getInstance().histogram("messenger_broadcast_fanout",
+                                                       "Recipients of one broadcast")) {
+    Metrics& metrics = Metrics::getInstance();
+    for (int i = 0; i <= PacketTypeSlots; ++i) {
+        const QString type = Metrics::label("type", i < PacketTypeSlots ? Packet::typeName(static_cast<PacketType>(i))
+                                                                        : QString("Unknown"));
+        packetsReceived[i] = &metrics.counter("messenger_packets_received_total", "Frames received by packet type", type);
+        packetsSent[i] = &metrics.counter("messenger_packets_sent_total", "Frames sent by packet type", type);
+    }
+    clock.start();
+    connect(&heartbeatTimer, &QTimer::timeout, this, &ManagerNetwork::onHeartbeatTick);
+    heartbeatTimer.start(HeartbeatTickMs);
 }
 
 ManagerNetwork::~ManagerNetwork() {
-    if (server.isListening()) {
-        server.close();
+    if (backend && backend->isListening()) {
+        backend->close();
+    }
+    if (localBackend && localBackend->isListening()) {
+        localBackend->close();
+    }
+    /* бэкенд закрывает сокеты, не испуская сигналов в полуразрушенный объект*/
+    if (backend) {
+        backend->disconnect(this);
+    }
+    if (localBackend) {
+        localBackend->disconnect(this);
+    }
+}
+
+/**
+ * @brief Проверяет, собран ли транспорт в эту версию сервера.
+ */
+bool ManagerNetwork::isBackendAvailable(Backend backend) {
+    switch (backend) {
+    case Backend::Qt:
+        return true;
+    case Backend::Epoll:
+#ifdef MESSENGER_HAVE_EPOLL
+        return true;
+#else
+        return false;
+#endif
     }
+    return false;
+}
+
+/**
+ * @brief Выбирает транспорт клиентских соединений.
+ * Недоступный в этой сборке транспорт заменяется на Qt.
+ * @param backend Транспорт.
+ */
+void ManagerNetwork::setBackend(Backend backend) {
+    if (this->backend) {
+        Logger::getInstance().log(QtWarningMsg, "Транспорт нельзя сменить после запуска сервера");
+        return;
+    }
+    if (!isBackendAvailable(backend)) {
+        Logger::getInstance().log(QtWarningMsg, "Транспорт epoll недоступен в этой сборке, используется Qt");
+        backend = Backend::Qt;
+    }
+    backendType = backend;
+}
+
+/**
+ * @brief Задает параметры приема подключений, действует при следующем запуске.
+ * @param acceptors Число потоков приема с SO_REUSEPORT (только epoll).
+ * @param backlog Длина очереди подключений ядра.
+ * @param batch Число подключений, принимаемых за одно пробуждение.
+ */
+void ManagerNetwork::setAcceptPolicy(int acceptors, int backlog, int batch) {
+    acceptorCount = qMax(1, acceptors);
+    listenBacklog = qMax(1, backlog);
+    acceptBatch = qMax(1, batch);
 }
 
 /**
@@ -20,27 +100,76 @@ ManagerNetwork::~ManagerNetwork() {
 void ManagerNetwork::startServer(quint16 port, const QHostAddress& address)
 {
     Logger& logger = Logger::getInstance();
-    if (server.isListening()) {
+    if (backend && backend->isListening()) {
         logger.log(QtWarningMsg, "Сервер уже запущен");
         return;
     }
 
-    if (!server.listen(address, port)) {
-        logger.log(QtCriticalMsg, QString("Не удалось запустить сервер: %1").arg(server.errorString()));
-        emit errorOccurred("Не удалось запустить сервер: " + server.errorString());
+    if (!backend) {
+#ifdef MESSENGER_HAVE_EPOLL
+        if (backendType == Backend::Epoll) {
+            backend = std::make_unique<EpollNetworkBackend>(connections);
+        }
+#endif
+        if (!backend) {
+            backend = std::make_unique<QtNetworkBackend>(connections);
+        }
+        connect(backend.get(), &NetworkBackend::accepted, this, &ManagerNetwork::onAccepted);
+        connect(backend.get(), &NetworkBackend::readyRead, this, &ManagerNetwork::onReadyRead);
+        connect(backend.get(), &NetworkBackend::closed, this, &ManagerNetwork::onClosed);
+        logger.log(QtInfoMsg, QString("Транспорт соединений: %1").arg(backendType == Backend::Epoll ? "epoll" : "Qt"));
+    }
+
+    backend->setAcceptPolicy(acceptorCount, listenBacklog, acceptBatch);
+    if (!backend->listen(address, port)) {
+        logger.log(QtCriticalMsg, QString("Не удалось запустить сервер: %1").arg(backend->errorString()));
+        emit errorOccurred("Не удалось запустить сервер: " + backend->errorString());
         return;
     }
 }
 
+/**
+ * @brief Запускает прием локальных подключений (сокет AF_UNIX или именованный канал).
+ * Работает вместе с сетевым транспортом: соединения попадают в тот же пул,
+ * разбор кадров и маршрутизацию.
+ * @param name Имя сервера или путь к файлу сокета.
+ */
+void ManagerNetwork::startLocalServer(const QString& name) {
+    Logger& logger = Logger::getInstance();
+    if (localBackend && localBackend->isListening()) {
+        logger.log(QtWarningMsg, "Локальный сервер уже запущен");
+        return;
+    }
+
+    if (!localBackend) {
+        localBackend = std::make_unique<LocalNetworkBackend>(connections, name);
+        connect(localBackend.get(), &NetworkBackend::accepted, this, &ManagerNetwork::onAccepted);
+        connect(localBackend.get(), &NetworkBackend::readyRead, this, &ManagerNetwork::onReadyRead);
+        connect(localBackend.get(), &NetworkBackend::closed, this, &ManagerNetwork::onClosed);
+    }
+
+    localBackend->setAcceptPolicy(1, listenBacklog, acceptBatch);
+    if (!localBackend->listen(QHostAddress(), 0)) {
+        logger.log(QtCriticalMsg, QString("Не удалось запустить локальный сервер: %1").arg(localBackend->errorString()));
+        emit errorOccurred("Не удалось запустить локальный сервер: " + localBackend->errorString());
+        return;
+    }
+    logger.log(QtInfoMsg, QString("Локальный сервер слушает %1")
+                              .arg(localBackend->fullServerName()));
+}
+
 /**
  * @brief Отправляет сообщение конкретному пользователю.
- * @param username Имя пользователя.
+ * @param connection Соединение клиента.
  * @param data Данные для отправки.
  */
-void ManagerNetwork::sendMessageToUser(QTcpSocket* socket, const QByteArray& data) {
+void ManagerNetwork::sendMessageToUser(ClientConnection* connection, const QByteArray& data) {
     Logger& logger = Logger::getInstance();
-    if (socket->state() == QAbstractSocket::ConnectedState) {
-        socket->write(data);
+    if (connection->open) {
+        const QByteArray frame = Packet::compressFrame(data, connection->peer.codec, compressionThreshold);
+        connection->transport->write(connection, frame);
+        countSent(data, 1);
+        bytesSent.increment(frame.size());
         logger.log(QtInfoMsg, "Сообщение отправлено пользователю");
     } else {
         logger.log(QtWarningMsg, "Ошибка: соединение с пользователем не установлено.");
@@ -48,114 +177,379 @@ void ManagerNetwork::sendMessageToUser(QTcpSocket* socket, const QByteArray& dat
 }
 
 
+/**
+ * @brief Связывает имя пользователя с соединением после успешной аутентификации.
+ * @param username Имя пользователя.
+ * @param connection Соединение клиента.
+ */
+void ManagerNetwork::associateUserWithConnection(const QString& username, ClientConnection* connection) {
+    connection->user = username;
+}
+
+/**
+ * @brief Возвращает открытое соединение по идентификатору.
+ * Используется для ответов, которые готовятся асинхронно: к их готовности
+ * клиент может отключиться, а запись соединения - достаться другому клиенту.
+ * @param id Идентификатор соединения.
+ * @return Соединение или nullptr, если оно уже закрыто.
+ */
+ClientConnection* ManagerNetwork::connection(quint64 id) const {
+    ClientConnection* connection = connections.find(id);
+    return connection && connection->open ? connection : nullptr;
+}
+
+/**
+ * @brief Разрывает соединение с клиентом.
+ * @param connection Соединение клиента.
+ * @param graceful Сначала отправить накопленные данные.
+ */
+void ManagerNetwork::disconnectClient(ClientConnection* connection, bool graceful) {
+    if (connection->open) {
+        connection->transport->closeConnection(connection, graceful);
+    }
+}
+
 /**
  * @brief Рассылает сообщение всем подключенным клиентам.
  * @param data Данные для рассылки.
  */
 void ManagerNetwork::broadcastMessage(const QByteArray& data) {
+    broadcastMessage(data, 0, {});
+}
+
+/**
+ * @brief Рассылает данные всем клиентам с учетом их возможностей.
+ * Клиенты, не согласовавшие capability, получают кадры fallback.
+ * Каждый кадр сжимается один раз для каждого кодека, а не для каждого клиента.
+ * @param data Кадр для клиентов с возможностью capability.
+ * @param capability Требуемая возможность, 0 - кадр подходит всем.
+ * @param fallback Кадры для остальных клиентов.
+ */
+void ManagerNetwork::broadcastMessage(const QByteArray& data, quint32 capability, const QList<QByteArray>& fallback) {
     Logger& logger = Logger::getInstance();
-    for (auto* socket : server.findChildren<QTcpSocket*>()) {
-        if (socket->state() == QAbstractSocket::ConnectedState) {
-            socket->write(data);
-            logger.log(QtInfoMsg, QString("Сообщение отправлено клиенту: %1:%2")
-                                      .arg(socket->peerAddress().toString())
-                                      .arg(socket->peerPort()));
+    QHash<quint8, QByteArray> encoded;
+    QHash<quint8, QByteArray> encodedFallback;
+    /* запись закрывшегося при отправке соединения остается в массиве до
+     * возврата в пул, поэтому перебор по индексу безопасен*/
+    Tracer::Span span("broadcast");
+    const std::vector<ClientConnection*>& active = connections.active();
+    int primary = 0;
+    int secondary = 0;
+    for (size_t i = 0; i < active.size(); ++i) {
+        ClientConnection* connection = active[i];
+        if (!connection->open) {
+            continue;
         }
+        const PeerInfo& peer = connection->peer;
+        if ((peer.capabilities & capability) == capability) {
+            auto it = encoded.find(peer.codec);
+            if (it == encoded.end()) {
+                it = encoded.insert(peer.codec, Packet::compressFrame(data, peer.codec, compressionThreshold));
+            }
+            connection->transport->write(connection, it.value());
+            bytesSent.increment(it.value().size());
+            ++primary;
+        } else {
+            auto it = encodedFallback.find(peer.codec);
+            if (it == encodedFallback.end()) {
+                QByteArray frames;
+                for (const QByteArray& frame : fallback) {
+                    frames.append(Packet::compressFrame(frame, peer.codec, compressionThreshold));
+                }
+                it = encodedFallback.insert(peer.codec, frames);
+            }
+            connection->transport->write(connection, it.value());
+            bytesSent.increment(it.value().size());
+            ++secondary;
+        }
+    }
+    countSent(data, primary);
+    for (const QByteArray& frame : fallback) {
+        countSent(frame, secondary);
     }
+    broadcastFanout.record(quint64(primary + secondary));
+    if (span.isRecording()) {
+        span.setDetail(QString("%1 получателей").arg(primary + secondary));
+    }
+    logger.log(QtInfoMsg, QString("Сообщение разослано %1 клиентам").arg(active.size()));
 }
 
 
 
 
 /**
- * @brief Обрабатывает новое подключение клиента.
+ * @brief Задает политику сжатия исходящих кадров.
+ * @param enabled Разрешено ли сжатие на новых соединениях.
+ * @param threshold Кадры с полезными данными короче порога отправляются без сжатия.
+ */
+void ManagerNetwork::setCompression(bool enabled, int threshold) {
+    compressionEnabled = enabled;
+    compressionThreshold = qMax(0, threshold);
+    Logger::getInstance().log(QtInfoMsg, QString("Сжатие кадров: %1, порог %2 байт")
+                                             .arg(enabled ? "включено" : "выключено").arg(compressionThreshold));
+}
+
+/**
+ * @brief Запоминает параметры, согласованные с клиентом.
+ * @param connection Соединение клиента.
+ * @param info Версия протокола, возможности и кодек сжатия.
+ */
+void ManagerNetwork::setPeerInfo(ClientConnection* connection, const PeerInfo& info) {
+    connection->peer = info;
+}
+
+/**
+ * @brief Задает проверку живости соединений.
+ * Клиенту, от которого pingIntervalMs не было данных, отправляется Ping;
+ * соединение, не ответившее на него за idleTimeoutMs простоя, разрывается.
+ * Клиентов без Capability::Heartbeat нечем проверить, их молчание не повод
+ * для разрыва: оборванные соединения закрывает TCP keepalive. Таймер одного соединения
+ * переставляется только при срабатывании, а входящий кадр лишь обновляет
+ * время активности, поэтому поток данных не нагружает колесо таймеров.
+ * @param pingIntervalMs Простой до отправки Ping, 0 - не отправлять Ping.
+ * @param idleTimeoutMs Простой до разрыва соединения, 0 - не разрывать.
  */
-void ManagerNetwork::onNewConnection() {
+void ManagerNetwork::setHeartbeat(int pingIntervalMs, int idleTimeoutMs) {
+    this->idleTimeoutMs = qMax(0, idleTimeoutMs);
+    this->pingIntervalMs = qBound<qint64>(0, pingIntervalMs, this->idleTimeoutMs);
+
+    const qint64 nowMs = clock.elapsed();
+    for (ClientConnection* connection : connections.active()) {
+        idleTimers.cancel(connection->idleTimer);
+        connection->idleTimer = 0;
+        if (connection->open) {
+            armHeartbeat(connection, nowMs);
+        }
+    }
+
+    if (this->idleTimeoutMs > 0) {
+        heartbeatTimer.start(HeartbeatTickMs);
+    } else {
+        heartbeatTimer.stop();
+    }
+    Logger::getInstance().log(QtInfoMsg, QString("Проверка соединений: Ping после %1 мс простоя, разрыв после %2 мс")
+                                             .arg(this->pingIntervalMs).arg(this->idleTimeoutMs));
+}
+
+/**
+ * @brief Ставит таймер простоя соединения на ближайший из сроков:
+ * отправка Ping или разрыв.
+ * @param nowMs Текущее время; срок считается от последней активности.
+ */
+void ManagerNetwork::armHeartbeat(ClientConnection* connection, qint64 nowMs) {
+    if (idleTimeoutMs <= 0) {
+        return;
+    }
+    qint64 deadlineMs = connection->lastActivityMs + idleTimeoutMs;
+    if (pingIntervalMs > 0 && nowMs < connection->lastActivityMs + pingIntervalMs) {
+        deadlineMs = connection->lastActivityMs + pingIntervalMs;
+    }
+    connection->idleTimer = idleTimers.schedule(connection->id, deadlineMs);
+}
+
+/**
+ * @brief Продвигает колесо таймеров и обрабатывает истекшие соединения.
+ * Соединение, от которого с момента постановки таймера пришли данные,
+ * просто получает новый таймер от времени своей активности.
+ */
+void ManagerNetwork::onHeartbeatTick() {
     Logger& logger = Logger::getInstance();
-    QTcpSocket* socket = server.nextPendingConnection();
+    const qint64 nowMs = clock.elapsed();
 
-    connect(socket, &QTcpSocket::readyRead, this, &ManagerNetwork::onReadyRead);
-    connect(socket, &QTcpSocket::disconnected, this, &ManagerNetwork::onClientDisconnected);
-    connect(socket, &QTcpSocket::errorOccurred, this, &ManagerNetwork::onError);
+    for (quint64 id : idleTimers.advance(nowMs)) {
+        ClientConnection* connection = this->connection(id);
+        if (!connection) {
+            continue;
+        }
+        connection->idleTimer = 0;
+        const qint64 idleMs = nowMs - connection->lastActivityMs;
+
+        /*клиент, не умеющий отвечать на Ping, проверяется позже снова:
+          после Hello он может стать проверяемым*/
+        if (pingIntervalMs <= 0 || !(connection->peer.capabilities & Capability::Heartbeat)) {
+            connection->idleTimer = idleTimers.schedule(connection->id, nowMs + idleTimeoutMs);
+            continue;
+        }
+
+        if (idleMs >= idleTimeoutMs) {
+            logger.log(QtWarningMsg, QString("Клиент %1:%2 не отвечает %3 с, соединение разорвано")
+                                         .arg(connection->peerAddress().toString())
+                                         .arg(connection->peerPort())
+                                         .arg(idleMs / 1000));
+            connection->transport->closeConnection(connection, false);
+            continue;
+        }
+
+        if (idleMs >= pingIntervalMs) {
+            PacketPing ping;
+            ping.setTimestamp(nowMs);
+            sendMessageToUser(connection, ping.serialize());
+        }
+        armHeartbeat(connection, nowMs);
+    }
+}
+
+/**
+ * @brief Обрабатывает новое подключение клиента.
+ */
+void ManagerNetwork::onAccepted(ClientConnection* connection) {
+    Logger& logger = Logger::getInstance();
 
-    buffers[socket] = QByteArray();
+    connection->lastActivityMs = clock.elapsed();
+    armHeartbeat(connection, connection->lastActivityMs);
+    openConnections.add(1);
+    acceptedConnections.increment();
+    capture.recordOpen(connection->id);
 
-    emit newConnection(socket);
+    emit newConnection(connection);
 
-    logger.log(QtInfoMsg, QString("Новое подключение: %1:%2") .arg(socket->peerAddress().toString())
-                              .arg(socket->peerPort()));}
+    logger.log(QtInfoMsg, QString("Новое подключение: %1:%2") .arg(connection->peerAddress().toString())
+                              .arg(connection->peerPort()));}
 
 /**
  * @brief Обрабатывает входящие данные от клиентов.
  */
-void ManagerNetwork::onReadyRead() {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+void ManagerNetwork::onReadyRead(ClientConnection* connection) {
     Logger& logger = Logger::getInstance();
-    if (!socket) {
-        logger.log(QtWarningMsg, "Ошибка: не удалось определить сокет.");
-        return;
-    }
 
-    QByteArray data = socket->readAll();
+    /* TCP не сохраняет границы пакетов: бэкенд накапливает данные,
+     * а дальше отдается каждый полностью полученный пакет отдельно*/
+    QByteArray& buffer = connection->readBuffer;
+    const qint64 nowMs = clock.elapsed();
+    connection->lastActivityMs = nowMs;
 
-    if (!data.isEmpty()) {
+    while (true) {
+        qint64 size = Packet::frameSize(buffer);
+        if (size < 0) {
+            break;
+        }
+        if (size < Packet::HeaderSize || size > MaxFrameSize) {
+            logger.log(QtWarningMsg, QString("Некорректный размер пакета от %1:%2 (%3 байт), соединение разорвано")
+                                         .arg(connection->peerAddress().toString())
+                                         .arg(connection->peerPort())
+                                         .arg(size));
+            buffer.clear();
+            connection->transport->closeConnection(connection, false);
+            return;
+        }
+        if (buffer.size() < size) {
+            break;
+        }
+
+        QByteArray data = buffer.left(size);
+        buffer.remove(0, size);
+
+        /* сжатый кадр принимается только в кодеке, выбранном при Hello:
+           иначе клиент мог бы навязать распаковку, о которой не договаривались*/
+        if ((static_cast<quint8>(data.at(0)) & Packet::CompressedFlag)
+            && (connection->peer.codec == 0 || size <= Packet::HeaderSize
+                || static_cast<quint8>(data.at(Packet::HeaderSize)) != connection->peer.codec)) {
+            logger.log(QtWarningMsg, QString("Сжатый кадр без согласованного кодека от %1:%2, соединение разорвано")
+                                         .arg(connection->peerAddress().toString())
+                                         .arg(connection->peerPort()));
+            buffer.clear();
+            connection->transport->closeConnection(connection, false);
+            return;
+        }
+        packetCounter(packetsReceived, data).increment();
+        bytesReceived.increment(data.size());
         logger.log(QtInfoMsg, QString("Получен пакет от %1:%2, размер: %3 байт")
-                                  .arg(socket->peerAddress().toString())
-                                  .arg(socket->peerPort())
+                                  .arg(connection->peerAddress().toString())
+                                  .arg(connection->peerPort())
                                   .arg(data.size()));
-        emit dataReceived(socket, data);
+
+        /* Ping и Pong только подтверждают, что клиент жив*/
+        const PacketType type = Packet::frameType(data);
+        if (type == PacketType::Pong) {
+            auto pong = std::dynamic_pointer_cast<PacketPong>(Packet::deserialize(data));
+            if (pong) {
+                connection->roundTripMs = nowMs - pong->getTimestamp();
+            }
+            continue;
+        }
+        if (type == PacketType::Ping) {
+            continue;
+        }
+
+        capture.recordFrame(connection->id, data);
+
+        /* выбранный для трассировки кадр прослеживается до записи в сокеты*/
+        Tracer::Scope trace(Tracer::getInstance().sample());
+        Tracer::Span span("packet");
+        if (span.isRecording()) {
+            span.setDetail(Packet::typeName(type));
+        }
+        emit dataReceived(connection, data);
+
+        /* обработчик мог разорвать соединение (например, при бане)*/
+        if (!connection->open) {
+            return;
+        }
+    }
+
+    /* у простаивающего соединения не остается выделенного буфера*/
+    if (buffer.isEmpty()) {
+        buffer.clear();
     }
 }
 
 /**
  * @brief Обрабатывает отключение клиента.
+ * Запись соединения возвращается в пул из цикла событий: до этого момента
+ * ее еще могут держать вызывающие функции выше по стеку.
  */
-void ManagerNetwork::onClientDisconnected() {
+void ManagerNetwork::onClosed(ClientConnection* connection, const QString& reason) {
     Logger& logger = Logger::getInstance();
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) {
-        logger.log(QtWarningMsg, "Ошибка: не удалось определить "
-                                 "сокет отсоединяющегося клиента.");
-        return;
-    }
 
-    buffers.remove(socket);
+    idleTimers.cancel(connection->idleTimer);
+    connection->idleTimer = 0;
+    openConnections.add(-1);
+    capture.recordClose(connection->id);
+
+    emit clientDisconnected(connection);
 
-    emit clientDisconnected(socket);
+    logger.log(QtInfoMsg, QString("Клиент отключился: %1:%2%3")
+                              .arg(connection->peerAddress().toString())
+                              .arg(connection->peerPort())
+                              .arg(reason.isEmpty() ? QString() : " (" + reason + ")"));
 
-    logger.log(QtInfoMsg, QString("Клиент отключился: %1:%2")
-                              .arg(socket->peerAddress().toString())
-                              .arg(socket->peerPort()));
+    const quint64 id = connection->id;
+    QMetaObject::invokeMethod(this, [this, id]() {
+        if (ClientConnection* closed = connections.find(id)) {
+            connections.release(closed);
+        }
+    }, Qt::QueuedConnection);
 }
+
 /**
- * @brief Обрабатывает ошибки соединения.
- * @param socketError Тип ошибки.
+ * @brief Начинает запись входящего трафика.
+ * Подключения, открытые до начала записи, попадут в файл без записи Open;
+ * messenger-replay открывает для них соединение при первом кадре.
+ * @param path Путь к файлу записи.
+ * @param maxBytes Предельный размер файла, 0 - без ограничения.
+ * @return true, если файл открыт.
  */
-void ManagerNetwork::onError(QAbstractSocket::SocketError socketError) {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    Logger& logger = Logger::getInstance();
-    if (!socket) {
-        logger.log(QtWarningMsg, "Ошибка: не удалось определить сокет.");
-        return;
-    }
+bool ManagerNetwork::startCapture(const QString& path, qint64 maxBytes, bool includeCredentials) {
+    return capture.open(path, maxBytes, includeCredentials);
+}
 
-    QString errorMessage;
+void ManagerNetwork::stopCapture() {
+    capture.close();
+}
 
-    switch (socketError) {
-    case QAbstractSocket::RemoteHostClosedError:
-        errorMessage = "Клиент закрыл соединение.";
-        break;
-    case QAbstractSocket::ConnectionRefusedError:
-        errorMessage = "Соединение отклонено клиентом.";
-        break;
-    case QAbstractSocket::HostNotFoundError:
-        errorMessage = "Клиент не найден.";
-        break;
-    default:
-        errorMessage = "Ошибка: " + socket->errorString();
-        break;
-    }
+/**
+ * @brief Возвращает счетчик для типа кадра; тип берется из заголовка без флага сжатия.
+ */
+MetricCounter& ManagerNetwork::packetCounter(PacketCounters& counters, const QByteArray& frame) {
+    const int type = frame.isEmpty() ? PacketTypeSlots : static_cast<int>(Packet::frameType(frame));
+    return *counters[type >= 0 && type < PacketTypeSlots ? type : PacketTypeSlots];
+}
 
-    qWarning() << errorMessage;
-    emit errorOccurred(errorMessage);
+/**
+ * @brief Учитывает кадр, отправленный recipients клиентам.
+ */
+void ManagerNetwork::countSent(const QByteArray& frame, int recipients) {
+    if (recipients > 0) {
+        packetCounter(packetsSent, frame).increment(quint64(recipients));
+    }
 }
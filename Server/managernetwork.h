@@ -2,38 +2,108 @@
 #define MANAGERNETWORK_H
 
 #include <QObject>
-#include <QTcpServer>
-#include <QTcpSocket>
-#include <QMap>
+#include <QHostAddress>
 #include <QByteArray>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <array>
+#include <memory>
+#include "ClientConnection.h"
+#include "ConnectionSlab.h"
+#include "NetworkBackend.h"
+#include "LocalNetworkBackend.h"
+#include "TimerWheel.h"
+#include "Metrics.h"
+#include "TrafficCapture.h"
+#include "protocol.h"
 
 class ManagerNetwork : public QObject {
     Q_OBJECT
 
 public:
+    using PeerInfo = ClientConnection::PeerInfo;
+
+    /* Транспорт клиентских соединений*/
+    enum class Backend {
+        Qt,   /* QTcpServer и QTcpSocket, все платформы*/
+        Epoll /* неблокирующие сокеты и epoll, только Linux*/
+    };
+
     explicit ManagerNetwork(QObject* parent = nullptr);
     ~ManagerNetwork();
 
+    static bool isBackendAvailable(Backend backend);
+    void setBackend(Backend backend); /* Выбор транспорта, действует до запуска сервера*/
+    void setAcceptPolicy(int acceptors, int backlog, int batch); /* Потоки приема, длина очереди ядра и пачка приема*/
     void startServer(quint16 port, const QHostAddress& address = QHostAddress::Any); /* Запуск сервера на указанном порту*/
-    void sendMessageToUser(QTcpSocket* socket, const QByteArray& data); /* Отправка сообщения конкретному пользователю*/
+    void startLocalServer(const QString& name); /* Прием локальных подключений по имени сокета*/
+    void sendMessageToUser(ClientConnection* connection, const QByteArray& data); /* Отправка сообщения конкретному пользователю*/
     void broadcastMessage(const QByteArray& data); /* Рассылка данных всем клиентам*/
-    void associateUserWithSocket(const QString& username, QTcpSocket* socket); /* Связывание имени пользователя с сокетом*/
+    void broadcastMessage(const QByteArray& data, quint32 capability, const QList<QByteArray>& fallback); /* Рассылка с запасным вариантом для клиентов без возможности*/
+    void disconnectClient(ClientConnection* connection, bool graceful = false); /* Разрыв соединения, graceful - после отправки накопленного*/
+    ClientConnection* connection(quint64 id) const; /* Открытое соединение по id или nullptr*/
+    int connectionCount() const { return connections.size(); }
+    void associateUserWithConnection(const QString& username, ClientConnection* connection); /* Связывание имени пользователя с соединением*/
+    QString userForConnection(ClientConnection* connection) const { return connection->user; } /* Имя пользователя, прошедшего аутентификацию*/
+    void setCompression(bool enabled, int threshold); /* Политика сжатия исходящих кадров*/
+    bool isCompressionEnabled() const { return compressionEnabled; }
+    void setPeerInfo(ClientConnection* connection, const PeerInfo& info); /* Запоминает согласованные с клиентом параметры*/
+    PeerInfo peerInfo(ClientConnection* connection) const { return connection->peer; }
+    void setHeartbeat(int pingIntervalMs, int idleTimeoutMs); /* Интервал Ping и срок простоя до разрыва, 0 - без проверки*/
+    qint64 roundTripMs(ClientConnection* connection) const { return connection->roundTripMs; } /* Последнее измеренное время Ping-Pong, -1 - неизвестно*/
+    bool startCapture(const QString& path, qint64 maxBytes, bool includeCredentials); /* Запись входящих кадров для messenger-replay*/
+    void stopCapture();
+
+    static constexpr qint64 MaxFrameSize = 8 * 1024 * 1024; /* Пакеты большего размера считаются мусором*/
+    static constexpr int HeartbeatTickMs = 250; /* Такт колеса таймеров простоя*/
 
 signals:
-    void newConnection(QTcpSocket* socket); /* Сигнал о новом подключении*/
-    void dataReceived(QTcpSocket* socket, const QByteArray& data); /* Сигнал о получении данных*/
-    void clientDisconnected(QTcpSocket* socket); /* Сигнал об отключении клиента*/
+    void newConnection(ClientConnection* connection); /* Сигнал о новом подключении*/
+    void dataReceived(ClientConnection* connection, const QByteArray& data); /* Сигнал о получении данных*/
+    void clientDisconnected(ClientConnection* connection); /* Сигнал об отключении клиента*/
     void errorOccurred(const QString& message); /* Сигнал об ошибке*/
 
 private slots:
-    void onNewConnection(); /* Обработка нового подключения*/
-    void onReadyRead(); /* Обработка входящих данных*/
-    void onClientDisconnected(); /* Обработка отключения клиента*/
-    void onError(QAbstractSocket::SocketError socketError); /* Обработка ошибок*/
+    void onAccepted(ClientConnection* connection); /* Обработка нового подключения*/
+    void onReadyRead(ClientConnection* connection); /* Обработка входящих данных*/
+    void onClosed(ClientConnection* connection, const QString& reason); /* Обработка отключения клиента*/
+    void onHeartbeatTick(); /* Проверка соединений, у которых истек срок простоя*/
 
 private:
-    QTcpServer server; /* Сервер*/
-    QMap<QTcpSocket*, QByteArray> buffers; /* Буферы для хранения данных от клиентов*/
+    void armHeartbeat(ClientConnection* connection, qint64 nowMs);
+    void countSent(const QByteArray& frame, int recipients); /* Учет исходящих пакетов по типам*/
+
+    /* Счетчики пакетов по типу; последний элемент - неизвестные типы*/
+    static constexpr int PacketTypeSlots = static_cast<int>(LastPacketType) + 1;
+    using PacketCounters = std::array<MetricCounter*, PacketTypeSlots + 1>;
+    static MetricCounter& packetCounter(PacketCounters& counters, const QByteArray& frame);
+
+    ConnectionSlab connections;              /* Записи соединений; объявлены до бэкенда, который на них ссылается*/
+    std::unique_ptr<NetworkBackend> backend;
+    std::unique_ptr<LocalNetworkBackend> localBackend; /* сокет AF_UNIX для процессов на той же машине*/
+    Backend backendType = Backend::Qt;
+    int acceptorCount = 1;
+    int listenBacklog = 1024;
+    int acceptBatch = 64;
+    bool compressionEnabled = true;
+    int compressionThreshold = 512;
+
+    QElapsedTimer clock;
+    TimerWheel idleTimers;                   /* Один таймер простоя на соединение*/
+    QTimer heartbeatTimer;                   /* Продвигает колесо раз в такт*/
+    qint64 pingIntervalMs = 30000;
+    qint64 idleTimeoutMs = 90000;
+    TrafficCapture capture;                  /* Запись входящего трафика, если открыта*/
+
+    /* Метрики; записи реестра живут до конца процесса*/
+    MetricGauge& openConnections;
+    MetricCounter& acceptedConnections;
+    MetricCounter& bytesReceived;
+    MetricCounter& bytesSent;
+    MetricHistogram& broadcastFanout;
+    PacketCounters packetsReceived;
+    PacketCounters packetsSent;
 };
 
 #endif // MANAGERNETWORK_H
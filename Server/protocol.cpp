@@ -1,6 +1,9 @@
 #include "protocol.h"
 #include "packethandler.h"
 #include "ByteBuffer.h"
+#include "FrameCompression.h"
+#include "exception/ParsingException.h"
+#include "Metrics.h"
 
 /*подсчет контрольной суммы.*/
 QByteArray Packet::crcToByteArray(const ByteBuffer& buffer) const {
@@ -47,6 +50,57 @@ QByteArray Packet::serialize() const {
     return finalPacket;
 }
 
+/**
+ * @brief Packet::frameSize определяет полный размер пакета по его заголовку.
+ * @param data Начало потока данных от клиента.
+ * @return Размер пакета вместе с заголовком или -1, если заголовок еще не получен.
+ */
+qint64 Packet::frameSize(const QByteArray& data) {
+    if (data.size() < HeaderSize) {
+        return -1;
+    }
+    ByteBuffer header(data.left(HeaderSize));
+    header.readByte();
+    return HeaderSize + static_cast<qint64>(header.readIntLE());
+}
+
+/**
+ * @brief Packet::frameType определяет тип пакета по заголовку без учета флага сжатия.
+ * @param data Кадр, начинающийся с заголовка.
+ * @return Тип пакета.
+ */
+PacketType Packet::frameType(const QByteArray& data) {
+    return static_cast<PacketType>(static_cast<quint8>(data.at(0)) & ~CompressedFlag);
+}
+
+/**
+ * @brief Packet::compressFrame сжимает полезные данные готового кадра.
+ * Кадр остается без изменений, если данные короче порога, кодек не задан
+ * или сжатие не уменьшило размер.
+ * @param frame Кадр, полученный из serialize().
+ * @param codec Кодек из FrameCompression::Codec или 0.
+ * @param threshold Минимальный размер полезных данных для сжатия.
+ * @return Сжатый или исходный кадр.
+ */
+QByteArray Packet::compressFrame(const QByteArray& frame, quint8 codec, int threshold) {
+    qint64 payloadSize = frame.size() - HeaderSize;
+    if (codec == 0 || payloadSize < threshold || (static_cast<quint8>(frame.at(0)) & CompressedFlag)) {
+        return frame;
+    }
+
+    QByteArray compressed = FrameCompression::compress(frame.mid(HeaderSize), codec);
+    if (compressed.isEmpty() || compressed.size() >= payloadSize) {
+        return frame;
+    }
+
+    ByteBuffer result;
+    result.writeByte(static_cast<qint8>(static_cast<quint8>(frame.at(0)) | CompressedFlag));
+    result.writeIntLE(compressed.size());
+    result.writeIntLE(crcToInt32(compressed));
+    result.write(compressed);
+    return result;
+}
+
 void Packet::serializeString(ByteBuffer& buffer, const QString& str) {
     QByteArray utf8 = str.toUtf8();
     qint16 size = utf8.size();
@@ -60,7 +114,22 @@ QString Packet::deserializeString(ByteBuffer& buffer) {
     return QString::fromUtf8(data);
 }
 
+namespace {
+/* Счетчик отброшенных кадров по причине: length, crc, decompress, type, parse*/
+MetricCounter& decodeFailures(const char* reason) {
+    return Metrics::getInstance().counter("messenger_decode_failures_total",
+                                          "Frames dropped by Packet::deserialize",
+                                          Metrics::label("reason", reason));
+}
+}
+
 std::shared_ptr<Packet> Packet::deserialize(const QByteArray& data) {
+    static MetricCounter& lengthFailures = decodeFailures("length");
+    static MetricCounter& crcFailures = decodeFailures("crc");
+    static MetricCounter& decompressFailures = decodeFailures("decompress");
+    static MetricCounter& typeFailures = decodeFailures("type");
+    static MetricCounter& parseFailures = decodeFailures("parse");
+
     ByteBuffer buffer(data);
     /*Читаем тип пакета*/
     qint8 typeValue = buffer.readByte();
@@ -74,15 +143,26 @@ std::shared_ptr<Packet> Packet::deserialize(const QByteArray& data) {
     if(usefulData.size() !=usefulDataLength )
     {
         qDebug() <<"Ошибка при чтении данных";
+        lengthFailures.increment();
         return nullptr;
     }
 
     qint32 calcCRC = crcToInt32(usefulData);
     if (calcCRC != CRC){
         qDebug() << "Не совпало CRC";
+        crcFailures.increment();
         return nullptr;
     }
-    PacketType type = static_cast<PacketType>(typeValue);
+    if (static_cast<quint8>(typeValue) & CompressedFlag) {
+        QByteArray unpacked;
+        if (!FrameCompression::decompress(usefulData, MaxPayloadSize, unpacked)) {
+            qDebug() << "Не удалось распаковать данные пакета";
+            decompressFailures.increment();
+            return nullptr;
+        }
+        usefulData = unpacked;
+    }
+    PacketType type = frameType(data);
     std::shared_ptr<Packet> packet;
     switch (type) {
     case PacketType::Register:
@@ -103,12 +183,55 @@ std::shared_ptr<Packet> Packet::deserialize(const QByteArray& data) {
     case PacketType::ChatList :
         packet = std::make_shared<PacketChatList>();
         break;
+    case PacketType::SessionResume:
+        packet = std::make_shared<PacketSessionResume>();
+        break;
+    case PacketType::ChatListDelta:
+        packet = std::make_shared<PacketChatListDelta>();
+        break;
+    case PacketType::SyncRequest:
+        packet = std::make_shared<PacketSyncRequest>();
+        break;
+    case PacketType::SyncBatch:
+        packet = std::make_shared<PacketSyncBatch>();
+        break;
+    case PacketType::MessageBatch:
+        packet = std::make_shared<PacketMessageBatch>();
+        break;
+    case PacketType::Hello:
+        packet = std::make_shared<PacketHello>();
+        break;
+    case PacketType::HelloAck:
+        packet = std::make_shared<PacketHelloAck>();
+        break;
+    case PacketType::Ping:
+        packet = std::make_shared<PacketPing>();
+        break;
+    case PacketType::Pong:
+        packet = std::make_shared<PacketPong>();
+        break;
+    case PacketType::SearchRequest:
+        packet = std::make_shared<PacketSearchRequest>();
+        break;
+    case PacketType::SearchResult:
+        packet = std::make_shared<PacketSearchResult>();
+        break;
+    case PacketType::Logout:
+        packet = std::make_shared<PacketLogout>();
+        break;
     default:
+        typeFailures.increment();
         return nullptr;
     }
     ByteBuffer usefulBuf(usefulData); /*содержит полезные данные*/
     if (packet) {
-        packet->deserializeData(usefulBuf);
+        try {
+            packet->deserializeData(usefulBuf);
+        } catch (const ParsingException& e) {
+            qDebug() << "Ошибка разбора пакета:" << e.what();
+            parseFailures.increment();
+            return nullptr;
+        }
     }
 
     return packet;
@@ -167,9 +290,9 @@ void PacketRegister::setLast_name(const QString &text) {
 }
 
 
-void PacketRegister::handle(QTcpSocket* socket, PacketHandler* handler) {
+void PacketRegister::handle(ClientConnection* connection, PacketHandler* handler) {
     if (handler) {
-        handler->handle(socket, *this);
+        handler->handle(connection, *this);
     }
 }
 
@@ -189,9 +312,9 @@ PacketType PacketAuth::getType() const {
     return PacketType::Auth;
 }
 
-void PacketAuth::handle(QTcpSocket* socket, PacketHandler* handler) {
+void PacketAuth::handle(ClientConnection* connection, PacketHandler* handler) {
     if (handler) {
-        handler->handle(socket, *this);
+        handler->handle(connection, *this);
     }
 }
 
@@ -213,6 +336,30 @@ void PacketAuth::setPassword(const QString &text) {
 
 
 
+// --- Реализация класса PacketSessionResume ---
+
+void PacketSessionResume::serializeData(ByteBuffer& buffer) const {
+    Packet::serializeString(buffer, username);
+    Packet::serializeString(buffer, token);
+}
+
+void PacketSessionResume::deserializeData(ByteBuffer& buffer) {
+    username = Packet::deserializeString(buffer);
+    token = Packet::deserializeString(buffer);
+}
+
+void PacketSessionResume::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+void PacketLogout::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
 // --- Реализация класса PacketMessage ---
 
 void PacketMessage::serializeData(ByteBuffer& buffer) const {
@@ -222,6 +369,8 @@ void PacketMessage::serializeData(ByteBuffer& buffer) const {
     Packet::serializeString(buffer, text);
     Packet::serializeString(buffer, ChatName);
     Packet::serializeString(buffer, timestamp.toString(Qt::ISODate));
+    buffer.writeIntLE(seq);
+    Packet::serializeString(buffer, idempotencyKey);
 }
 
 void PacketMessage::deserializeData(ByteBuffer& buffer) {
@@ -232,6 +381,9 @@ void PacketMessage::deserializeData(ByteBuffer& buffer) {
     ChatName = Packet::deserializeString(buffer);
     QString tsStr = Packet::deserializeString(buffer);
     timestamp = QDateTime::fromString(tsStr, Qt::ISODate);
+    /*номер и ключ отправки идут последними полями, от старых клиентов их нет*/
+    seq = buffer.getAvailableBytes() >= 4 ? buffer.readIntLE() : 0;
+    idempotencyKey = buffer.getAvailableBytes() > 0 ? Packet::deserializeString(buffer) : QString();
 }
 
 PacketType PacketMessage::getType() const {
@@ -287,9 +439,9 @@ void PacketMessage::setLastName(const QString &lastName) {
 }
 
 
-void PacketMessage::handle(QTcpSocket* socket, PacketHandler* handler) {
+void PacketMessage::handle(ClientConnection* connection, PacketHandler* handler) {
     if (handler) {
-        handler->handle(socket, *this);
+        handler->handle(connection, *this);
     }
 }
 
@@ -311,6 +463,12 @@ void PacketServerResponse::serializeData(ByteBuffer& buffer) const  {
         Packet::serializeString(buffer, message);
 
     }
+    if (ResponseType == ServerResponseType::Auth && Status == ServerResponseStatus::Success){
+        Packet::serializeString(buffer, sessionToken);
+    }
+    if (ResponseType == ServerResponseType::RateLimit){
+        buffer.writeIntLE(retryAfterMs);
+    }
 }
 
 void PacketServerResponse::deserializeData(ByteBuffer& buffer) {
@@ -330,6 +488,15 @@ void PacketServerResponse::deserializeData(ByteBuffer& buffer) {
     else {
         message = Packet::deserializeString(buffer);
     }
+
+    /*токен сессии идет последним полем, старые серверы его не присылают*/
+    if (ResponseType == ServerResponseType::Auth && Status == ServerResponseStatus::Success && buffer.getAvailableBytes() > 0){
+        sessionToken = Packet::deserializeString(buffer);
+    }
+    /*срок повтора после отказа ограничителя, старые серверы его не присылают*/
+    if (ResponseType == ServerResponseType::RateLimit && buffer.getAvailableBytes() >= 4){
+        retryAfterMs = buffer.readIntLE();
+    }
 }
 
 void PacketServerResponse::SetResponseType(const ServerResponseType& type) {
@@ -361,9 +528,9 @@ void PacketServerResponse::SetResponseMessage(const QString &text) {
     message = text;
 }
 
-void PacketServerResponse::handle(QTcpSocket* socket, PacketHandler* handler) {
+void PacketServerResponse::handle(ClientConnection* connection, PacketHandler* handler) {
     if (handler) {
-        handler->handle(socket, *this);
+        handler->handle(connection, *this);
     }
 }
 
@@ -391,6 +558,7 @@ void PacketChatList::serializeData(ByteBuffer& buffer) const
     for (const QString& name : chatNames) {
         Packet::serializeString(buffer, name);
     }
+    buffer.writeIntLE(static_cast<qint32>(version));
 }
 
 void PacketChatList::deserializeData(ByteBuffer& buffer)
@@ -400,10 +568,270 @@ void PacketChatList::deserializeData(ByteBuffer& buffer)
     for (int i = 0; i < count; ++i) {
         chatNames.append(Packet::deserializeString(buffer));
     }
+    /*версия идет последним полем, в запросе клиента ее может не быть*/
+    version = buffer.getAvailableBytes() >= 4 ? static_cast<quint32>(buffer.readIntLE()) : 0;
+}
+
+void PacketChatList::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketChatListDelta ---
+
+void PacketChatListDelta::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeByte(static_cast<qint8>(kind));
+    buffer.writeIntLE(static_cast<qint32>(version));
+    Packet::serializeString(buffer, chatName);
+    if (kind == Kind::Renamed) {
+        Packet::serializeString(buffer, newName);
+    }
+}
+
+void PacketChatListDelta::deserializeData(ByteBuffer& buffer)
+{
+    kind = static_cast<Kind>(buffer.readByte());
+    version = static_cast<quint32>(buffer.readIntLE());
+    chatName = Packet::deserializeString(buffer);
+    if (kind == Kind::Renamed) {
+        newName = Packet::deserializeString(buffer);
+    }
+}
+
+void PacketChatListDelta::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketSyncRequest ---
+
+void PacketSyncRequest::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeShortLE(lastSeen.size());
+    for (const auto& chat : lastSeen) {
+        Packet::serializeString(buffer, chat.first);
+        buffer.writeIntLE(chat.second);
+    }
+}
+
+void PacketSyncRequest::deserializeData(ByteBuffer& buffer)
+{
+    qint16 count = buffer.readShortLE();
+    lastSeen.clear();
+    for (int i = 0; i < count; ++i) {
+        QString chatName = Packet::deserializeString(buffer);
+        quint32 lastSeq = buffer.readIntLE();
+        lastSeen.append(qMakePair(chatName, lastSeq));
+    }
+}
+
+void PacketSyncRequest::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketSyncBatch ---
+
+void PacketSyncBatch::serializeData(ByteBuffer& buffer) const
+{
+    Packet::serializeString(buffer, chatName);
+    buffer.writeByte(hasMore ? 1 : 0);
+    buffer.writeShortLE(messages.size());
+    for (const MessageRecord& message : messages) {
+        buffer.writeIntLE(message.seq);
+        Packet::serializeString(buffer, message.sender);
+        Packet::serializeString(buffer, message.firstName);
+        Packet::serializeString(buffer, message.lastName);
+        Packet::serializeString(buffer, message.text);
+        Packet::serializeString(buffer, message.timestamp.toString(Qt::ISODate));
+    }
+}
+
+void PacketSyncBatch::deserializeData(ByteBuffer& buffer)
+{
+    chatName = Packet::deserializeString(buffer);
+    hasMore = buffer.readByte() != 0;
+    qint16 count = buffer.readShortLE();
+    messages.clear();
+    for (int i = 0; i < count; ++i) {
+        MessageRecord message;
+        message.seq = buffer.readIntLE();
+        message.sender = Packet::deserializeString(buffer);
+        message.firstName = Packet::deserializeString(buffer);
+        message.lastName = Packet::deserializeString(buffer);
+        message.text = Packet::deserializeString(buffer);
+        message.timestamp = QDateTime::fromString(Packet::deserializeString(buffer), Qt::ISODate);
+        messages.append(message);
+    }
+}
+
+void PacketSyncBatch::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketMessageBatch ---
+
+void PacketMessageBatch::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeShortLE(messages.size());
+    for (const PacketMessage& message : messages) {
+        Packet::serializeString(buffer, message.getFirstName());
+        Packet::serializeString(buffer, message.getLastName());
+        Packet::serializeString(buffer, message.getFrom());
+        Packet::serializeString(buffer, message.getText());
+        Packet::serializeString(buffer, message.getChatName());
+        Packet::serializeString(buffer, message.getTimestamp().toString(Qt::ISODate));
+        buffer.writeIntLE(message.getSeq());
+        Packet::serializeString(buffer, message.getIdempotencyKey());
+    }
+}
+
+void PacketMessageBatch::deserializeData(ByteBuffer& buffer)
+{
+    qint16 count = buffer.readShortLE();
+    if (count < 0 || count > MaxMessages) {
+        throw ParsingException(QString("[PacketMessageBatch] Invalid message count %1").arg(count));
+    }
+    messages.clear();
+    for (int i = 0; i < count; ++i) {
+        PacketMessage message;
+        message.setFirstName(Packet::deserializeString(buffer));
+        message.setLastName(Packet::deserializeString(buffer));
+        message.setFrom(Packet::deserializeString(buffer));
+        message.setText(Packet::deserializeString(buffer));
+        message.setChatName(Packet::deserializeString(buffer));
+        message.setTimestamp(QDateTime::fromString(Packet::deserializeString(buffer), Qt::ISODate));
+        message.setSeq(buffer.readIntLE());
+        message.setIdempotencyKey(Packet::deserializeString(buffer));
+        messages.append(message);
+    }
+}
+
+void PacketMessageBatch::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketHello ---
+
+void PacketHello::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeShortLE(static_cast<qint16>(version));
+    buffer.writeIntLE(static_cast<qint32>(capabilities));
+    buffer.writeByte(static_cast<qint8>(codecs));
+}
+
+void PacketHello::deserializeData(ByteBuffer& buffer)
+{
+    version = static_cast<quint16>(buffer.readShortLE());
+    capabilities = static_cast<quint32>(buffer.readIntLE());
+    codecs = static_cast<quint8>(buffer.readByte());
+}
+
+void PacketHello::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketHelloAck ---
+
+void PacketHelloAck::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketPing ---
+
+void PacketPing::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeLongLE(timestamp);
+}
+
+void PacketPing::deserializeData(ByteBuffer& buffer)
+{
+    timestamp = buffer.readLongLE();
+}
+
+void PacketPing::handle(ClientConnection* connection, PacketHandler* handler) {
+    /*Ping и Pong обрабатывает ManagerNetwork*/
+}
+
+// --- PacketSearchRequest ---
+
+void PacketSearchRequest::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeIntLE(requestId);
+    Packet::serializeString(buffer, chatName);
+    Packet::serializeString(buffer, query);
+    buffer.writeIntLE(offset);
+    buffer.writeShortLE(limit);
+}
+
+void PacketSearchRequest::deserializeData(ByteBuffer& buffer)
+{
+    requestId = buffer.readIntLE();
+    chatName = Packet::deserializeString(buffer);
+    query = Packet::deserializeString(buffer);
+    offset = buffer.readIntLE();
+    limit = quint16(buffer.readShortLE());
+}
+
+void PacketSearchRequest::handle(ClientConnection* connection, PacketHandler* handler) {
+    if (handler) {
+        handler->handle(connection, *this);
+    }
+}
+
+// --- PacketSearchResult ---
+
+void PacketSearchResult::serializeData(ByteBuffer& buffer) const
+{
+    buffer.writeIntLE(requestId);
+    buffer.writeByte(static_cast<qint8>(status));
+    buffer.writeByte(hasMore ? 1 : 0);
+    buffer.writeShortLE(hits.size());
+    for (const SearchHit& hit : hits) {
+        Packet::serializeString(buffer, hit.chatName);
+        buffer.writeIntLE(hit.seq);
+        Packet::serializeString(buffer, hit.sender);
+        Packet::serializeString(buffer, hit.firstName);
+        Packet::serializeString(buffer, hit.lastName);
+        Packet::serializeString(buffer, hit.timestamp.toString(Qt::ISODate));
+        Packet::serializeString(buffer, hit.snippet);
+    }
+}
+
+void PacketSearchResult::deserializeData(ByteBuffer& buffer)
+{
+    requestId = buffer.readIntLE();
+    status = static_cast<Status>(buffer.readByte());
+    hasMore = buffer.readByte() != 0;
+    qint16 count = buffer.readShortLE();
+    hits.clear();
+    for (int i = 0; i < count; ++i) {
+        SearchHit hit;
+        hit.chatName = Packet::deserializeString(buffer);
+        hit.seq = buffer.readIntLE();
+        hit.sender = Packet::deserializeString(buffer);
+        hit.firstName = Packet::deserializeString(buffer);
+        hit.lastName = Packet::deserializeString(buffer);
+        hit.timestamp = QDateTime::fromString(Packet::deserializeString(buffer), Qt::ISODate);
+        hit.snippet = Packet::deserializeString(buffer);
+        hits.append(hit);
+    }
 }
 
-void PacketChatList::handle(QTcpSocket* socket, PacketHandler* handler) {
+void PacketSearchResult::handle(ClientConnection* connection, PacketHandler* handler) {
     if (handler) {
-        handler->handle(socket, *this);
+        handler->handle(connection, *this);
     }
 }
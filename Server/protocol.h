@@ -9,11 +9,12 @@
 #include "ByteBuffer.h"
 #include <QStringList>
 #include <QDateTime>
-#include <QTcpSocket>
+#include <QPair>
 
 
 
 class PacketHandler;
+class ClientConnection;
 
 enum class PacketType : qint8 {
     /*Аутентификация и идентификация*/
@@ -30,8 +31,33 @@ enum class PacketType : qint8 {
     ChatList, /*получить список чатов*/
     Message, /*сообщение в чат*/
     /**********************************/
+
+    SessionResume, /*возобновление сессии по токену*/
+    ChatListDelta, /*изменение списка чатов*/
+    SyncRequest, /*запрос пропущенных сообщений*/
+    SyncBatch, /*пачка пропущенных сообщений*/
+    MessageBatch, /*несколько сообщений в одном кадре*/
+    Hello, /*версия протокола и возможности клиента*/
+    HelloAck, /*согласованные версия и возможности*/
+    Ping, /*проверка живости соединения*/
+    Pong, /*ответ на Ping*/
+    SearchRequest, /*поиск по истории сообщений*/
+    SearchResult, /*страница результатов поиска*/
+    Logout, /*завершение сессии: выданные токены отзываются*/
 };
 
+/*последний тип пакета: по нему считаются таблицы, индексируемые типом*/
+constexpr PacketType LastPacketType = PacketType::Logout;
+
+/*Возможности, согласуемые при подключении пакетами Hello/HelloAck*/
+namespace Capability {
+    constexpr quint32 MessageBatch = 1u << 0; /*пачки сообщений PacketMessageBatch*/
+    constexpr quint32 Compression  = 1u << 1; /*сжатие кадров, кодеки согласуются отдельно*/
+    constexpr quint32 Heartbeat    = 1u << 2; /*ответы Pong на Ping сервера*/
+    constexpr quint32 Search       = 1u << 3; /*полнотекстовый поиск PacketSearchRequest*/
+    constexpr quint32 All = MessageBatch | Compression | Heartbeat | Search;
+}
+
 class Packet {
 protected:
     virtual void serializeData(ByteBuffer& buffer) const = 0;
@@ -47,19 +73,47 @@ public:
     virtual PacketType getType() const = 0;
     virtual ~Packet() = default;
 
-    virtual void handle(QTcpSocket* socket, PacketHandler* handler) = 0;
+    virtual void handle(ClientConnection* connection, PacketHandler* handler) = 0;
 
     QString getTypeName() const {
-        switch (getType()) {
+        return typeName(getType());
+    }
+
+    static QString typeName(PacketType type) {
+        switch (type) {
         case PacketType::Register:       return "Register";
         case PacketType::Message:        return "Message";
         case PacketType::ServerResponse: return "ServerResponse";
         case PacketType::Auth:          return "Auth";
         case PacketType::ChatList:       return "ChatList";
+        case PacketType::SessionResume:  return "SessionResume";
+        case PacketType::ChatListDelta:  return "ChatListDelta";
+        case PacketType::SyncRequest:    return "SyncRequest";
+        case PacketType::SyncBatch:      return "SyncBatch";
+        case PacketType::MessageBatch:   return "MessageBatch";
+        case PacketType::Hello:          return "Hello";
+        case PacketType::HelloAck:       return "HelloAck";
+        case PacketType::Ping:           return "Ping";
+        case PacketType::Pong:           return "Pong";
+        case PacketType::SearchRequest:  return "SearchRequest";
+        case PacketType::SearchResult:   return "SearchResult";
+        case PacketType::Logout:         return "Logout";
         default:                         return "Unknown";
         }
     }
 
+    /*[ТИП 1 байт][РАЗМЕР 4 байта][CRC 4 байта]*/
+    static constexpr int HeaderSize = 9;
+    /*версия 1 - протокол без Hello; сторона, не приславшая Hello, считается версией 1*/
+    static constexpr quint16 ProtocolVersion = 2;
+    static qint64 frameSize(const QByteArray& data);
+
+    /*старший бит типа в заголовке - полезные данные сжаты*/
+    static constexpr quint8 CompressedFlag = 0x80;
+    static constexpr qint64 MaxPayloadSize = 8 * 1024 * 1024; /*предел размера распакованных данных*/
+    static PacketType frameType(const QByteArray& data);
+    static QByteArray compressFrame(const QByteArray& frame, quint8 codec, int threshold);
+
 private:
     QByteArray  crcToByteArray(const ByteBuffer& buffer) const;
     static uint32_t crcToInt32(const QByteArray& data);
@@ -77,7 +131,7 @@ protected:
     void deserializeData(ByteBuffer& buffer) override;
 
 public:
-    void handle(QTcpSocket* socket, PacketHandler* handler) override;
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
     PacketType getType() const override;
 
     QString getUsername() const;
@@ -105,7 +159,7 @@ protected:
     void deserializeData(ByteBuffer& buffer) override;
 
 public:
-    void handle(QTcpSocket* socket, PacketHandler* handler) override;
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
     PacketType getType() const override;
     QString getUsername() const;
     void setUsername(const QString &text);
@@ -117,6 +171,45 @@ public:
 
 
 
+/**
+ * @brief Пакет возобновления сессии.
+ * Клиент, уже прошедший аутентификацию, после переподключения
+ * предъявляет выданный сервером токен вместо повторного обмена солью.
+ */
+class PacketSessionResume : public Packet {
+private:
+    QString username;
+    QString token;
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::SessionResume; }
+
+    QString getUsername() const { return username; }
+    void setUsername(const QString& text) { username = text; }
+
+    QString getToken() const { return token; }
+    void setToken(const QString& text) { token = text; }
+};
+
+/**
+ * @brief Пакет PacketLogout - пользователь завершил сессию.
+ * Данных нет: сессия определяется соединением.
+ */
+class PacketLogout : public Packet {
+protected:
+    void serializeData(ByteBuffer& buffer) const override { Q_UNUSED(buffer); }
+    void deserializeData(ByteBuffer& buffer) override { Q_UNUSED(buffer); }
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::Logout; }
+};
+
 class PacketMessage : public Packet {
 private:
     QString firstName;
@@ -125,6 +218,8 @@ private:
     QString text;
     QDateTime timestamp;
     QString ChatName;
+    quint32 seq = 0;        /*номер сообщения в чате, 0 - еще не сохранено*/
+    QString idempotencyKey; /*ключ отправки, по которому сервер отбрасывает повторы*/
 
 
 protected:
@@ -132,7 +227,7 @@ protected:
     void deserializeData(ByteBuffer& buffer) override;
 
 public:
-    void handle(QTcpSocket* socket, PacketHandler* handler) override;
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
     PacketType getType() const override;
 
     QString getFirstName() const;
@@ -153,6 +248,12 @@ public:
     QString getChatName() const;
     void setChatName(const QString &name);
 
+    quint32 getSeq() const { return seq; }
+    void setSeq(quint32 value) { seq = value; }
+
+    QString getIdempotencyKey() const { return idempotencyKey; }
+    void setIdempotencyKey(const QString& key) { idempotencyKey = key; }
+
 };
 
 class PacketCreateChat : public Packet {
@@ -160,7 +261,7 @@ private:
     QString nameChat;
 
 public:
-    void handle(QTcpSocket* socket, PacketHandler* handler) override;
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
     void serializeData(ByteBuffer& buffer) const override;
     void deserializeData(ByteBuffer& buffer) const;
 
@@ -182,9 +283,10 @@ public:
 class PacketChatList : public Packet {
 private:
     QStringList chatNames;
+    quint32 version = 0; /*версия списка на сервере*/
 
 public:
-    void handle(QTcpSocket* socket, PacketHandler* handler) override;
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
     void serializeData(ByteBuffer& buffer) const override;
     void deserializeData(ByteBuffer& buffer) override;
     PacketType getType() const override { return PacketType::ChatList; }
@@ -192,6 +294,51 @@ public:
     const QStringList& getChatNames() const { return chatNames; }
     void setChatNames(const QStringList& names) { chatNames.append(names); }
 
+    quint32 getVersion() const { return version; }
+    void setVersion(quint32 value) { version = value; }
+
+};
+
+/**
+ * @brief Пакет PacketChatListDelta - одно изменение списка чатов.
+ *
+ * Каждое изменение увеличивает версию списка на единицу. Клиент применяет
+ * изменение, только если его версия следует сразу за известной ему;
+ * при пропуске он запрашивает полный список (PacketChatList).
+ */
+class PacketChatListDelta : public Packet {
+public:
+    enum class Kind : qint8 {
+        Added,
+        Removed,
+        Renamed
+    };
+
+private:
+    Kind kind = Kind::Added;
+    quint32 version = 0;
+    QString chatName;
+    QString newName; /*только для Renamed*/
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::ChatListDelta; }
+
+    Kind getKind() const { return kind; }
+    void setKind(Kind value) { kind = value; }
+
+    quint32 getVersion() const { return version; }
+    void setVersion(quint32 value) { version = value; }
+
+    QString getChatName() const { return chatName; }
+    void setChatName(const QString& name) { chatName = name; }
+
+    QString getNewName() const { return newName; }
+    void setNewName(const QString& name) { newName = name; }
 };
 
 
@@ -209,10 +356,12 @@ protected:
 
 public:
 
-    void handle(QTcpSocket* socket, PacketHandler* handler) override;
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
     enum class ServerResponseType : qint8{
         Auth,
-        Register
+        Register,
+        RateLimit, /*пакет отброшен ограничителем частоты запросов*/
+        Message    /*сообщение не сохранено, в тексте ответа - его ключ отправки*/
     };
 
     enum class ServerResponseStatus : qint8{
@@ -234,13 +383,277 @@ public:
     void SetSalt(const QString& solt){salt = solt;}
     QString const GetSalt(){return salt;}
 
+    void SetSessionToken(const QString& token){sessionToken = token;}
+    QString GetSessionToken() const {return sessionToken;}
+
+    void SetRetryAfterMs(qint32 ms){retryAfterMs = ms;}
+    qint32 GetRetryAfterMs() const {return retryAfterMs;}
+
     bool  getRegisterStatus() const;
 
 private:
     QString message;
     QString salt;
+    QString sessionToken; /*выдается при успешной аутентификации*/
+    qint32 retryAfterMs = 0; /*для RateLimit: через сколько мс можно повторить запрос*/
     bool RegisterStatus = false;
     ServerResponseStatus Status;
     ServerResponseType ResponseType;
 };
 
+/**
+ * @brief Сообщение в составе пачки синхронизации.
+ */
+struct MessageRecord {
+    quint32 seq = 0;     /*номер сообщения в чате*/
+    QString sender;
+    QString firstName;
+    QString lastName;
+    QString text;
+    QDateTime timestamp;
+};
+
+/**
+ * @brief Пакет PacketSyncRequest - запрос сообщений, пропущенных клиентом.
+ *
+ * Для каждого чата клиент передает номер последнего известного ему
+ * сообщения (0 - сообщений нет), сервер отвечает пачками PacketSyncBatch
+ * только с более новыми сообщениями.
+ */
+class PacketSyncRequest : public Packet {
+private:
+    QList<QPair<QString, quint32>> lastSeen; /*(имя чата, номер последнего сообщения)*/
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::SyncRequest; }
+
+    const QList<QPair<QString, quint32>>& getLastSeen() const { return lastSeen; }
+    void addChat(const QString& chatName, quint32 lastSeq) { lastSeen.append(qMakePair(chatName, lastSeq)); }
+};
+
+/**
+ * @brief Пакет PacketSyncBatch - пачка сообщений одного чата по запросу синхронизации.
+ * Если hasMore установлен, клиент запрашивает продолжение от последнего
+ * полученного номера.
+ */
+class PacketSyncBatch : public Packet {
+private:
+    QString chatName;
+    bool hasMore = false;
+    QList<MessageRecord> messages;
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::SyncBatch; }
+
+    QString getChatName() const { return chatName; }
+    void setChatName(const QString& name) { chatName = name; }
+
+    bool getHasMore() const { return hasMore; }
+    void setHasMore(bool value) { hasMore = value; }
+
+    const QList<MessageRecord>& getMessages() const { return messages; }
+    void addMessage(const MessageRecord& message) { messages.append(message); }
+};
+
+/**
+ * @brief Пакет PacketMessageBatch - несколько сообщений в одном кадре.
+ *
+ * Сообщения могут относиться к разным чатам. Клиент отправляет так
+ * накопившиеся исходящие сообщения, сервер - рассылку сообщений,
+ * принятых за короткое окно ожидания. Каждое сообщение сериализуется
+ * со всеми полями PacketMessage, включая номер и ключ отправки.
+ */
+class PacketMessageBatch : public Packet {
+private:
+    QList<PacketMessage> messages;
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    static const int MaxMessages = 256; /*больше сообщений в одном кадре не принимается*/
+
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::MessageBatch; }
+
+    const QList<PacketMessage>& getMessages() const { return messages; }
+    void addMessage(const PacketMessage& message) { messages.append(message); }
+    int size() const { return messages.size(); }
+    void clear() { messages.clear(); }
+};
+
+/**
+ * @brief Пакет PacketHello - версия протокола и возможности клиента.
+ *
+ * Клиент отправляет его первым пакетом после подключения. Сервер отвечает
+ * PacketHelloAck с меньшей из двух версий и пересечением возможностей;
+ * дальше каждая сторона использует на соединении только согласованное.
+ * До ответа, а также с серверами без поддержки Hello, действует версия 1.
+ */
+class PacketHello : public Packet {
+private:
+    quint16 version = ProtocolVersion;
+    quint32 capabilities = 0; /*битовая маска Capability*/
+    quint8 codecs = 0;        /*битовая маска FrameCompression::Codec*/
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::Hello; }
+
+    quint16 getVersion() const { return version; }
+    void setVersion(quint16 value) { version = value; }
+
+    quint32 getCapabilities() const { return capabilities; }
+    void setCapabilities(quint32 value) { capabilities = value; }
+
+    quint8 getCodecs() const { return codecs; }
+    void setCodecs(quint8 value) { codecs = value; }
+};
+
+/**
+ * @brief Пакет PacketHelloAck - ответ сервера на PacketHello.
+ * Содержит согласованные версию, возможности и кодеки сжатия.
+ */
+class PacketHelloAck : public PacketHello {
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::HelloAck; }
+};
+
+
+/**
+ * @brief Пакет PacketPing - проверка живости соединения.
+ *
+ * Сервер отправляет его клиенту, от которого давно не было данных.
+ * Ping и Pong обрабатываются в ManagerNetwork и не доходят до обработчиков:
+ * это служебные кадры транспорта, а не запросы к серверу.
+ */
+class PacketPing : public Packet {
+private:
+    qint64 timestamp = 0; /*время отправки Ping по часам отправителя, возвращается в Pong*/
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::Ping; }
+
+    qint64 getTimestamp() const { return timestamp; }
+    void setTimestamp(qint64 value) { timestamp = value; }
+};
+
+/**
+ * @brief Пакет PacketPong - ответ на PacketPing с тем же временем отправки.
+ */
+class PacketPong : public PacketPing {
+public:
+    PacketType getType() const override { return PacketType::Pong; }
+};
+
+/**
+ * @brief Пакет PacketSearchRequest - полнотекстовый поиск по истории сообщений.
+ *
+ * Пустое имя чата - поиск по всем чатам. Слова запроса ищутся все сразу,
+ * последнее - как префикс, поэтому результаты появляются по мере ввода.
+ * Страницы запрашиваются смещением offset; requestId возвращается
+ * в ответе, чтобы клиент отбросил ответы на устаревшие запросы.
+ */
+class PacketSearchRequest : public Packet {
+private:
+    quint32 requestId = 0;
+    QString chatName;
+    QString query;
+    quint32 offset = 0;
+    quint16 limit = 20;
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    static const int MaxLimit = 100; /*больше результатов на странице не отдается*/
+    static const quint32 MaxOffset = 10 * MaxLimit; /*дальше первой тысячи результатов поиск не листается*/
+
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::SearchRequest; }
+
+    quint32 getRequestId() const { return requestId; }
+    void setRequestId(quint32 value) { requestId = value; }
+    QString getChatName() const { return chatName; }
+    void setChatName(const QString& name) { chatName = name; }
+    QString getQuery() const { return query; }
+    void setQuery(const QString& text) { query = text; }
+    quint32 getOffset() const { return offset; }
+    void setOffset(quint32 value) { offset = value; }
+    quint16 getLimit() const { return limit; }
+    void setLimit(quint16 value) { limit = value; }
+};
+
+/*Найденное сообщение; в snippet найденные слова обрамлены SearchHit::MarkBegin и MarkEnd*/
+struct SearchHit {
+    static constexpr QChar MarkBegin = QChar(0x02);
+    static constexpr QChar MarkEnd = QChar(0x03);
+
+    QString chatName;
+    quint32 seq = 0;
+    QString sender;
+    QString firstName;
+    QString lastName;
+    QDateTime timestamp;
+    QString snippet; /*фрагмент текста вокруг совпадения*/
+};
+
+/**
+ * @brief Пакет PacketSearchResult - страница результатов поиска.
+ * Результаты упорядочены по релевантности; hasMore означает, что
+ * следующая страница начинается со смещения offset + число результатов.
+ */
+class PacketSearchResult : public Packet {
+public:
+    enum class Status : quint8 {
+        Ok,           /*поиск выполнен*/
+        Unavailable,  /*поиск не поддерживается базой сервера*/
+        InvalidQuery, /*в запросе нет слов для поиска или смещение больше MaxOffset*/
+        Busy          /*очередь поиска переполнена*/
+    };
+
+private:
+    quint32 requestId = 0;
+    Status status = Status::Ok;
+    bool hasMore = false;
+    QList<SearchHit> hits;
+
+protected:
+    void serializeData(ByteBuffer& buffer) const override;
+    void deserializeData(ByteBuffer& buffer) override;
+
+public:
+    void handle(ClientConnection* connection, PacketHandler* handler) override;
+    PacketType getType() const override { return PacketType::SearchResult; }
+
+    quint32 getRequestId() const { return requestId; }
+    void setRequestId(quint32 value) { requestId = value; }
+    Status getStatus() const { return status; }
+    void setStatus(Status value) { status = value; }
+    bool getHasMore() const { return hasMore; }
+    void setHasMore(bool value) { hasMore = value; }
+    const QList<SearchHit>& getHits() const { return hits; }
+    void addHit(const SearchHit& hit) { hits.append(hit); }
+};
@@ -0,0 +1,262 @@
+#include "Rebalancer.h"
+#include "ChatShards.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFileInfo>
+#include <QHash>
+#include <algorithm>
+
+namespace {
+QString connectionName(int file) {
+    return QString("Rebalance.%1").arg(file);
+}
+}
+
+Rebalancer::Rebalancer(const RebalanceConfig& config)
+    : config(config), out(stdout) {}
+
+Rebalancer::~Rebalancer() {
+    const int count = int(files.size());
+    files.clear();
+    for (int file = 0; file < count; ++file) {
+        QSqlDatabase::removeDatabase(connectionName(file));
+    }
+}
+
+QSqlDatabase Rebalancer::connection(int file) const {
+    return QSqlDatabase::database(connectionName(file), false);
+}
+
+/**
+ * @brief Открывает еще не открытые файлы частей. Файлы частей, которые нужны
+ * после перераспределения, создаются; лишние открываются, только если существуют.
+ * @param fileCount Число файлов, в которых могут лежать сообщения.
+ * @return false, если не открылся нужный файл.
+ */
+bool Rebalancer::openFiles(int fileCount) {
+    for (int file = int(files.size()); file < fileCount; ++file) {
+        const QString path = ChatShards::shardPath(config.databasePath, file);
+        const bool needed = file < config.shards && !config.dryRun;
+        if (file > 0 && !needed && !QFileInfo::exists(path)) {
+            files.push_back(nullptr);
+            continue;
+        }
+        auto database = std::make_unique<ChatDatabase>();
+        if (!database->open(path, connectionName(file), file == 0)) {
+            out << "Не удалось открыть " << path << Qt::endl;
+            return false;
+        }
+        files.push_back(std::move(database));
+    }
+    return true;
+}
+
+/**
+ * @brief Находит чаты, сообщения которых лежат не в своей части.
+ * @param chats Чаты каталога.
+ * @return Переносы в порядке (источник, получатель), чтобы каждую пару
+ * файлов присоединять один раз.
+ */
+QList<Rebalancer::Move> Rebalancer::planMoves(const QList<QPair<quint32, QString>>& chats) {
+    std::vector<QHash<QString, qint64>> counts(files.size());
+    for (size_t file = 0; file < files.size(); ++file) {
+        if (!files[file]) {
+            continue;
+        }
+        QSqlQuery query(connection(int(file)));
+        if (query.exec("SELECT chat_name, COUNT(*) FROM messages GROUP BY chat_name")) {
+            while (query.next()) {
+                counts[file].insert(query.value(0).toString(), query.value(1).toLongLong());
+            }
+        }
+    }
+
+    QList<Move> moves;
+    for (const auto& chat : chats) {
+        const int target = ChatShards::shardFor(chat.first, config.shards);
+        for (size_t file = 0; file < files.size(); ++file) {
+            const qint64 messages = counts[file].value(chat.second, 0);
+            if (int(file) != target && messages > 0) {
+                moves.append({chat.first, chat.second, int(file), target, messages});
+            }
+        }
+    }
+    std::stable_sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) {
+        return qMakePair(a.from, a.to) < qMakePair(b.from, b.to);
+    });
+    return moves;
+}
+
+/**
+ * @brief Переносит сообщения одного чата в его часть.
+ * Копия фиксируется в получателе до удаления из источника: у частей
+ * отдельные журналы WAL, и общая транзакция не была бы атомарной.
+ * Если в получателе под тем же номером лежит другое сообщение,
+ * источник не трогается.
+ * Файл-источник к этому моменту присоединен к получателю как src.
+ * @return true, если сообщения перенесены.
+ */
+bool Rebalancer::moveChat(const Move& move) {
+    QSqlDatabase target = connection(move.to);
+    QSqlQuery query(target);
+    target.transaction();
+    query.prepare("INSERT OR IGNORE INTO messages (chat_name, seq, sender, firstName, lastName, text, timestamp) "
+                  "SELECT chat_name, seq, sender, firstName, lastName, text, timestamp FROM src.messages "
+                  "WHERE chat_name = ? ORDER BY seq");
+    query.addBindValue(move.chatName);
+    if (!query.exec() || !target.commit()) {
+        out << QString("Чат '%1': ошибка копирования: %2").arg(move.chatName, query.lastError().text()) << Qt::endl;
+        target.rollback();
+        return false;
+    }
+
+    query.prepare("SELECT COUNT(*) FROM src.messages s WHERE s.chat_name = ? AND NOT EXISTS ("
+                  "SELECT 1 FROM main.messages m WHERE m.chat_name = s.chat_name AND m.seq = s.seq "
+                  "AND m.sender = s.sender AND m.text = s.text)");
+    query.addBindValue(move.chatName);
+    if (!query.exec() || !query.next() || query.value(0).toLongLong() != 0) {
+        out << QString("Чат '%1': в части %2 уже есть другие сообщения с теми же номерами, "
+                       "сообщения в части %3 оставлены")
+                   .arg(move.chatName).arg(move.to).arg(move.from)
+            << Qt::endl;
+        return false;
+    }
+    query.finish();
+
+    QSqlDatabase source = connection(move.from);
+    QSqlQuery remove(source);
+    source.transaction();
+    remove.prepare("DELETE FROM messages WHERE chat_name = ?");
+    remove.addBindValue(move.chatName);
+    if (!remove.exec() || !source.commit()) {
+        out << QString("Чат '%1': ошибка удаления из части %2: %3")
+                   .arg(move.chatName).arg(move.from).arg(remove.lastError().text())
+            << Qt::endl;
+        source.rollback();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Перестраивает файлы частей, чтобы вернуть место перенесенных
+ * сообщений и включить auto_vacuum = INCREMENTAL для RetentionWorker.
+ */
+void Rebalancer::vacuumFiles() {
+    for (int file = 0; file < config.shards; ++file) {
+        const QString path = ChatShards::shardPath(config.databasePath, file);
+        const qint64 before = QFileInfo(path).size();
+        QSqlQuery query(connection(file));
+        if (!query.exec("PRAGMA auto_vacuum = INCREMENTAL") || !query.exec("VACUUM")) {
+            out << QString("%1: VACUUM не выполнен: %2").arg(path, query.lastError().text()) << Qt::endl;
+            continue;
+        }
+        query.exec("PRAGMA wal_checkpoint(TRUNCATE)");
+        out << QString("%1: %2 -> %3 КиБ").arg(path).arg(before / 1024).arg(QFileInfo(path).size() / 1024)
+            << Qt::endl;
+    }
+}
+
+/**
+ * @brief Выполняет перераспределение.
+ * @return true, если все сообщения лежат в своих частях и каталог обновлен.
+ */
+bool Rebalancer::run() {
+    if (!openFiles(1)) {
+        return false;
+    }
+    int storedCount = 1;
+    int targetCount = 1;
+    if (!files[0]->getShardConfig(storedCount, targetCount)) {
+        /*база до разбиения на части*/
+        storedCount = targetCount = 1;
+    }
+    if (storedCount != targetCount) {
+        out << QString("Предыдущее перераспределение с %1 на %2 частей не завершено, продолжаем")
+                   .arg(storedCount).arg(targetCount)
+            << Qt::endl;
+    }
+
+    /*сообщения могут лежать в любом файле прежней, прерванной и новой раскладки*/
+    const int fileCount = std::max({storedCount, targetCount, config.shards});
+    if (!openFiles(fileCount)) {
+        return false;
+    }
+
+    const QList<QPair<quint32, QString>> chats = files[0]->getAllChats();
+    const QList<Move> moves = planMoves(chats);
+    qint64 totalMessages = 0;
+    for (const Move& move : moves) {
+        totalMessages += move.messages;
+        out << QString("Чат '%1' (id %2): часть %3 -> %4, %5 сообщений")
+                   .arg(move.chatName).arg(move.chatId).arg(move.from).arg(move.to).arg(move.messages)
+            << Qt::endl;
+    }
+    out << QString("Чатов: %1, переносов: %2, сообщений: %3, частей: %4 -> %5")
+               .arg(chats.size()).arg(moves.size()).arg(totalMessages).arg(storedCount).arg(config.shards)
+        << Qt::endl;
+    if (config.dryRun) {
+        return true;
+    }
+
+    if (!files[0]->setShardConfig(storedCount, config.shards)) {
+        return false;
+    }
+
+    bool ok = true;
+    int attachedFrom = -1;
+    int attachedTo = -1;
+    for (const Move& move : moves) {
+        if (move.from != attachedFrom || move.to != attachedTo) {
+            if (attachedTo >= 0) {
+                QSqlQuery(connection(attachedTo)).exec("DETACH DATABASE src");
+            }
+            QSqlQuery attach(connection(move.to));
+            attach.prepare("ATTACH DATABASE ? AS src");
+            attach.addBindValue(ChatShards::shardPath(config.databasePath, move.from));
+            if (!attach.exec()) {
+                out << QString("Не удалось присоединить часть %1: %2").arg(move.from).arg(attach.lastError().text())
+                    << Qt::endl;
+                attachedTo = -1;
+                ok = false;
+                break;
+            }
+            attachedFrom = move.from;
+            attachedTo = move.to;
+        }
+        ok = moveChat(move) && ok;
+    }
+    if (attachedTo >= 0) {
+        QSqlQuery(connection(attachedTo)).exec("DETACH DATABASE src");
+    }
+    if (!ok) {
+        out << "Перераспределение не завершено, сервер не откроет базу до успешного повторного запуска" << Qt::endl;
+        return false;
+    }
+    if (!files[0]->setShardConfig(config.shards, config.shards)) {
+        return false;
+    }
+
+    for (int file = config.shards; file < int(files.size()); ++file) {
+        if (!files[file]) {
+            continue;
+        }
+        const QString path = ChatShards::shardPath(config.databasePath, file);
+        QSqlQuery query(connection(file));
+        const qint64 left = query.exec("SELECT COUNT(*) FROM messages") && query.next() ? query.value(0).toLongLong() : -1;
+        if (left == 0) {
+            out << QString("Файл %1 больше не используется, его можно удалить вместе с -wal и -shm").arg(path)
+                << Qt::endl;
+        } else {
+            out << QString("В файле %1 осталось %2 сообщений чатов, которых нет в каталоге").arg(path).arg(left)
+                << Qt::endl;
+        }
+    }
+
+    if (config.vacuum) {
+        vacuumFiles();
+    }
+    out << QString("Готово: база чатов разбита на %1 частей, задайте storage/shards = %1").arg(config.shards)
+        << Qt::endl;
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef REBALANCER_H
+#define REBALANCER_H
+
+#include <QString>
+#include <QTextStream>
+#include <QSqlDatabase>
+#include <QList>
+#include <QPair>
+#include <memory>
+#include <vector>
+#include "ChatDataBase.h"
+
+/**
+ * @brief Параметры перераспределения базы чатов.
+ */
+struct RebalanceConfig {
+    QString databasePath;  /* часть 0 - каталог, как chat_db_path сервера*/
+    int shards = 1;
+    bool dryRun = false;
+    bool vacuum = false;   /* после переноса перестроить файлы с auto_vacuum = INCREMENTAL*/
+};
+
+/**
+ * @brief Класс Rebalancer - перенос сообщений чатов при смене числа частей базы.
+ *
+ * Сервер при этом должен быть остановлен. Сначала в каталоге
+ * записывается целевое число частей: пока оно отличается от текущего,
+ * сервер базу не откроет. Затем сообщения каждого чата, лежащие не
+ * в своей части, копируются в нее (ATTACH файла-источника к соединению
+ * части-получателя, INSERT OR IGNORE одной транзакцией) и только после
+ * фиксации копии удаляются из источника. Поэтому прерванный перенос
+ * безопасно запустить повторно - с тем же или другим числом частей:
+ * источниками считаются все существующие файлы частей. В конце
+ * каталог получает новое число частей, а опустевшие лишние файлы
+ * перечисляются для удаления.
+ */
+class Rebalancer {
+public:
+    explicit Rebalancer(const RebalanceConfig& config);
+    ~Rebalancer();
+
+    bool run();
+
+private:
+    struct Move {
+        quint32 chatId = 0;
+        QString chatName;
+        int from = 0;
+        int to = 0;
+        qint64 messages = 0;
+    };
+
+    bool openFiles(int fileCount);
+    QList<Move> planMoves(const QList<QPair<quint32, QString>>& chats);
+    bool moveChat(const Move& move);
+    void vacuumFiles();
+    QSqlDatabase connection(int file) const;
+
+    RebalanceConfig config;
+    std::vector<std::unique_ptr<ChatDatabase>> files;
+    QTextStream out;
+};
+
+#endif // REBALANCER_H
@@ -0,0 +1,50 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include "Rebalancer.h"
+#include "ChatShards.h"
+#include "logger.h"
+
+/**
+ * @brief messenger-rebalance - смена числа частей базы чатов.
+ * Запускается при остановленном сервере с тем же путем к базе чатов,
+ * что и в настройках сервера; после успешного прогона в настройке
+ * storage/shards задается новое число частей. Прерванный прогон
+ * достаточно повторить.
+ */
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("messenger-rebalance");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Перераспределение сообщений чатов по частям базы");
+    parser.addHelpOption();
+
+    RebalanceConfig config;
+    QCommandLineOption db("db", "Путь к базе чатов (часть 0).", "path");
+    QCommandLineOption shards("shards", "Новое число частей.", "n", QString::number(config.shards));
+    QCommandLineOption dryRun("dry-run", "Только показать, какие чаты будут перенесены.");
+    QCommandLineOption vacuum("vacuum", "После переноса перестроить файлы частей (VACUUM, auto_vacuum = INCREMENTAL).");
+    parser.addOptions({db, shards, dryRun, vacuum});
+    parser.process(app);
+
+    if (!parser.isSet(db)) {
+        parser.showHelp(1);
+    }
+    config.databasePath = parser.value(db);
+    config.shards = parser.value(shards).toInt();
+    config.dryRun = parser.isSet(dryRun);
+    config.vacuum = parser.isSet(vacuum);
+    if (config.shards < 1 || config.shards > ChatShards::MaxShards) {
+        qCritical().noquote() << QString("Число частей должно быть от 1 до %1").arg(ChatShards::MaxShards);
+        return 1;
+    }
+
+    Logger& logger = Logger::getInstance();
+    logger.setLogFile(config.databasePath + ".rebalance.log");
+    logger.open();
+
+    Rebalancer rebalancer(config);
+    const bool ok = rebalancer.run();
+    logger.close();
+    return ok ? 0 : 1;
+}
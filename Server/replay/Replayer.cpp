@@ -0,0 +1,275 @@
+#include "Replayer.h"
+#include "protocol.h"
+#include <QTextStream>
+
+Replayer::Replayer(const ReplayConfig& config, QObject* parent)
+    : QObject(parent), config(config) {
+    stepTimer.setSingleShot(true);
+    stepTimer.setTimerType(Qt::PreciseTimer);
+    connect(&stepTimer, &QTimer::timeout, this, &Replayer::onStep);
+}
+
+/**
+ * @brief Читает запись целиком в память, чтобы чтение файла не влияло на темп.
+ * @return false, если файл не открылся или поврежден.
+ */
+bool Replayer::load() {
+    QTextStream err(stderr);
+    TrafficCapture::Reader reader;
+    if (!reader.open(config.file)) {
+        err << "Не удалось открыть " << config.file << ": " << reader.errorString() << Qt::endl;
+        return false;
+    }
+    TrafficCapture::Record record;
+    while (reader.next(record)) {
+        records.push_back(record);
+    }
+    if (!reader.errorString().isEmpty()) {
+        err << "Запись прочитана до " << records.size() << "-й: " << reader.errorString() << Qt::endl;
+    }
+    return !records.empty();
+}
+
+void Replayer::start() {
+    clock.start();
+    onStep();
+}
+
+/**
+ * @brief Отправляет записи, срок которых наступил, и планирует следующий проход.
+ */
+void Replayer::onStep() {
+    const qint64 nowUs = clock.nsecsElapsed() / 1000;
+    int processed = 0;
+    while (nextRecord < records.size()) {
+        const TrafficCapture::Record& record = records[nextRecord];
+        const qint64 dueUs = config.speed > 0 ? qint64(double(record.timeUs) / config.speed) : 0;
+        if (dueUs > nowUs) {
+            stepTimer.start(int(qMax<qint64>(0, (dueUs - nowUs) / 1000)));
+            return;
+        }
+        if (config.speed > 0) {
+            maxLagUs = qMax(maxLagUs, nowUs - dueUs);
+        }
+        dispatch(record);
+        ++nextRecord;
+        /* ответы сервера читаются между проходами*/
+        if (++processed >= StepBatch) {
+            stepTimer.start(0);
+            return;
+        }
+    }
+    finishedSendingNs = clock.nsecsElapsed();
+    QTimer::singleShot(config.drainSec * 1000, this, &Replayer::report);
+}
+
+void Replayer::dispatch(const TrafficCapture::Record& record) {
+    switch (record.kind) {
+    case TrafficCapture::Kind::Open:
+        openConnection(record.connection);
+        break;
+    case TrafficCapture::Kind::Frame:
+        sendFrame(record.connection, record.frame);
+        break;
+    case TrafficCapture::Kind::Close:
+        closeConnection(record.connection);
+        break;
+    }
+}
+
+/**
+ * @brief Открывает соединение для записанного id.
+ * Соединения, открытые до начала записи, создаются при первом кадре.
+ */
+Replayer::ConnectionPtr Replayer::openConnection(quint64 id) {
+    ConnectionPtr& slot = connections[id];
+    if (slot) {
+        return slot;
+    }
+    slot = std::make_shared<Connection>();
+    ConnectionPtr connection = slot;
+    QTcpSocket* socket = new QTcpSocket(this);
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connection->socket = socket;
+    ++connectionsOpened;
+
+    connect(socket, &QTcpSocket::connected, this, [connection]() {
+        if (!connection->pending.isEmpty()) {
+            connection->socket->write(connection->pending);
+            connection->pending.clear();
+        }
+        if (connection->closing) {
+            connection->socket->disconnectFromHost();
+        }
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [this, connection]() { onReadyRead(*connection); });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket](QAbstractSocket::SocketError error) {
+        if (socket->state() != QAbstractSocket::ConnectedState && error != QAbstractSocket::RemoteHostClosedError) {
+            ++connectErrors;
+        }
+    });
+    /* соединение, закрытое сервером, при следующем кадре с тем же id открывается заново*/
+    connect(socket, &QTcpSocket::disconnected, this, [this, id, connection]() {
+        connection->socket->deleteLater();
+        connection->socket = nullptr;
+        auto it = connections.find(id);
+        if (it != connections.end() && it.value() == connection) {
+            connections.erase(it);
+        }
+    });
+    socket->connectToHost(config.host, config.port);
+    return connection;
+}
+
+void Replayer::sendFrame(quint64 id, const QByteArray& frame) {
+    ConnectionPtr connection = openConnection(id);
+    noteSent(frame);
+    ++framesSent;
+    bytesSent += quint64(frame.size());
+    if (connection->socket->state() == QAbstractSocket::ConnectedState) {
+        connection->socket->write(frame);
+    } else {
+        connection->pending.append(frame);
+    }
+}
+
+/**
+ * @brief Закрывает соединение после отправки накопленных кадров.
+ * Запись о нем удаляется сразу: id может снова появиться в записи.
+ */
+void Replayer::closeConnection(quint64 id) {
+    ConnectionPtr connection = connections.take(id);
+    if (!connection) {
+        return;
+    }
+    if (connection->socket->state() == QAbstractSocket::ConnectedState) {
+        connection->socket->disconnectFromHost();
+    } else {
+        connection->closing = true;
+    }
+}
+
+/**
+ * @brief Разбирает ответы сервера: отвечает на Ping и сопоставляет рассылку.
+ */
+void Replayer::onReadyRead(Connection& connection) {
+    QTcpSocket* socket = connection.socket;
+    QByteArray& buffer = connection.readBuffer;
+    buffer.append(socket->readAll());
+    while (true) {
+        const qint64 size = Packet::frameSize(buffer);
+        if (size < Packet::HeaderSize || buffer.size() < size) {
+            break;
+        }
+        const QByteArray frame = buffer.left(size);
+        buffer.remove(0, size);
+        ++framesReceived;
+        bytesReceived += quint64(size);
+
+        if (Packet::frameType(frame) == PacketType::Ping) {
+            auto ping = std::dynamic_pointer_cast<PacketPing>(Packet::deserialize(frame));
+            if (ping) {
+                PacketPong pong;
+                pong.setTimestamp(ping->getTimestamp());
+                socket->write(pong.serialize());
+            }
+            continue;
+        }
+        noteReceived(frame);
+    }
+}
+
+/**
+ * @brief Запоминает момент отправки сообщений с ключом отправки.
+ * Повторная отправка того же ключа (клиент повторял запрос) не сдвигает отсчет.
+ */
+void Replayer::noteSent(const QByteArray& frame) {
+    const PacketType type = Packet::frameType(frame);
+    if (type != PacketType::Message && type != PacketType::MessageBatch) {
+        return;
+    }
+    const qint64 nowNs = clock.nsecsElapsed();
+    std::shared_ptr<Packet> packet = Packet::deserialize(frame);
+    QList<PacketMessage> messages;
+    if (auto message = std::dynamic_pointer_cast<PacketMessage>(packet)) {
+        messages.append(*message);
+    } else if (auto batch = std::dynamic_pointer_cast<PacketMessageBatch>(packet)) {
+        messages = batch->getMessages();
+    }
+    for (const PacketMessage& message : messages) {
+        ++messagesSent;
+        const QString key = message.getIdempotencyKey();
+        if (!key.isEmpty() && !inFlight.contains(key)) {
+            inFlight.insert(key, nowNs);
+        }
+    }
+}
+
+void Replayer::noteReceived(const QByteArray& frame) {
+    const PacketType type = Packet::frameType(frame);
+    if (inFlight.isEmpty() || (type != PacketType::Message && type != PacketType::MessageBatch)) {
+        return;
+    }
+    const qint64 nowNs = clock.nsecsElapsed();
+    std::shared_ptr<Packet> packet = Packet::deserialize(frame);
+    QList<PacketMessage> messages;
+    if (auto message = std::dynamic_pointer_cast<PacketMessage>(packet)) {
+        messages.append(*message);
+    } else if (auto batch = std::dynamic_pointer_cast<PacketMessageBatch>(packet)) {
+        messages = batch->getMessages();
+    }
+    for (const PacketMessage& message : messages) {
+        auto it = inFlight.find(message.getIdempotencyKey());
+        if (it != inFlight.end()) {
+            latency.record(quint64((nowNs - it.value()) / 1000));
+            inFlight.erase(it);
+        }
+    }
+}
+
+/**
+ * @brief Выводит итог прогона и завершает работу.
+ */
+void Replayer::report() {
+    QTextStream out(stdout);
+    const double sendSec = qMax(1e-9, double(finishedSendingNs) / 1e9);
+    const double captureSec = double(records.back().timeUs) / 1e6;
+    auto line = [&](const QString& metric, double value, const QString& unit) {
+        if (config.csv) {
+            out << metric << ',' << QString::number(value, 'f', 3) << ',' << unit << Qt::endl;
+        } else {
+            out << QString("%1 %2 %3").arg(metric, -28).arg(value, 14, 'f', 3).arg(unit) << Qt::endl;
+        }
+    };
+
+    if (config.csv) {
+        out << "metric,value,unit" << Qt::endl;
+    }
+    line("capture_span", captureSec, "s");
+    line("replay_span", sendSec, "s");
+    line("schedule_lag_max", double(maxLagUs) / 1000.0, "ms");
+    line("connections", double(connectionsOpened), "count");
+    line("connect_errors", double(connectErrors), "count");
+    line("frames_sent", double(framesSent), "count");
+    line("frames_sent_rate", double(framesSent) / sendSec, "1/s");
+    line("bytes_sent", double(bytesSent), "bytes");
+    line("frames_received", double(framesReceived), "count");
+    line("bytes_received", double(bytesReceived), "bytes");
+    line("messages_sent", double(messagesSent), "count");
+    line("messages_delivered", double(latency.count()), "count");
+    line("messages_lost", double(inFlight.size()), "count");
+    for (const auto& [name, fraction] : {std::pair<const char*, double>{"latency_p50", 0.5},
+                                        {"latency_p90", 0.9}, {"latency_p99", 0.99}, {"latency_p999", 0.999}}) {
+        line(name, double(latency.percentile(fraction)) / 1000.0, "ms");
+    }
+    line("latency_max", double(latency.max()) / 1000.0, "ms");
+
+    /* abort() синхронно испускает disconnected, а обработчик меняет connections*/
+    const QList<ConnectionPtr> open = connections.values();
+    for (const ConnectionPtr& connection : open) {
+        if (connection->socket) {
+            connection->socket->abort();
+        }
+    }
+    emit finished(0);
+}
@@ -0,0 +1,99 @@
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHash>
+#include <memory>
+#include <vector>
+#include "TrafficCapture.h"
+#include "Metrics.h"
+
+/**
+ * @brief Параметры воспроизведения записи трафика.
+ */
+struct ReplayConfig {
+    QString file;
+    QString host = "127.0.0.1";
+    quint16 port = 3333;
+    double speed = 1.0;   /* 1 - исходный темп, 2 - вдвое быстрее, 0 - без пауз*/
+    int drainSec = 3;     /* ожидание рассылки после последней записи*/
+    bool csv = false;
+};
+
+/**
+ * @brief Класс Replayer - воспроизводит запись TrafficCapture на сервере.
+ *
+ * Каждое записанное соединение становится отдельным TCP-соединением,
+ * кадры уходят без изменений в моменты записи, деленные на speed.
+ * Записи обрабатываются по порядку, поэтому порядок кадров внутри
+ * соединения и между соединениями сохраняется, а всплески и волны
+ * переподключений повторяются в исходной форме.
+ *
+ * Сервер должен начинать с копий баз, снятых в момент начала записи:
+ * кадры Auth содержат хэш с солью из базы пользователей, а номера
+ * сообщений зависят от истории чатов. Кадры аутентификации есть в записи,
+ * только если она снята с capture/include_credentials = true.
+ *
+ * Задержка считается для сообщений с ключом отправки: от записи кадра
+ * в сокет до первого получения этого сообщения любым соединением.
+ */
+class Replayer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit Replayer(const ReplayConfig& config, QObject* parent = nullptr);
+
+    bool load();
+    void start();
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void onStep();
+    void report();
+
+private:
+    /* Состояние соединения; обработчики сигналов сокета держат его до удаления сокета*/
+    struct Connection {
+        QTcpSocket* socket = nullptr;
+        QByteArray pending;    /* кадры до установления соединения*/
+        QByteArray readBuffer;
+        bool closing = false;  /* закрыть после отправки pending*/
+    };
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    static constexpr int StepBatch = 256; /* записей за один проход без возврата в цикл событий*/
+
+    void dispatch(const TrafficCapture::Record& record);
+    ConnectionPtr openConnection(quint64 id);
+    void sendFrame(quint64 id, const QByteArray& frame);
+    void closeConnection(quint64 id);
+    void onReadyRead(Connection& connection);
+    void noteSent(const QByteArray& frame);
+    void noteReceived(const QByteArray& frame);
+
+    ReplayConfig config;
+    std::vector<TrafficCapture::Record> records;
+    size_t nextRecord = 0;
+    QElapsedTimer clock;
+    QTimer stepTimer;
+    QHash<quint64, ConnectionPtr> connections; /* открытые записанные соединения по id*/
+    QHash<QString, qint64> inFlight; /* ключ отправки -> момент отправки, нс*/
+    MetricHistogram latency;         /* мкс*/
+
+    qint64 finishedSendingNs = 0;
+    qint64 maxLagUs = 0;             /* отставание от расписания*/
+    quint64 connectionsOpened = 0;
+    quint64 connectErrors = 0;
+    quint64 framesSent = 0;
+    quint64 bytesSent = 0;
+    quint64 framesReceived = 0;
+    quint64 bytesReceived = 0;
+    quint64 messagesSent = 0;
+};
+
+#endif // REPLAYER_H
@@ -0,0 +1,48 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include "Replayer.h"
+
+/**
+ * @brief messenger-replay - воспроизведение записанного входящего трафика.
+ * Запись делает сервер при заданной настройке capture/file. Соединения
+ * идут с одного адреса, поэтому лимиты rate_limit/Address/... на время
+ * прогона стоит поднять, как и для messenger-loadgen.
+ */
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("messenger-replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Воспроизведение записи трафика мессенджера с замером задержки рассылки");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Файл записи трафика.");
+
+    ReplayConfig config;
+    QCommandLineOption host("host", "Адрес сервера.", "address", config.host);
+    QCommandLineOption port("port", "Порт сервера.", "port", QString::number(config.port));
+    QCommandLineOption speed({"s", "speed"}, "Множитель темпа: 1 - как в записи, 0 - без пауз.", "factor",
+                             QString::number(config.speed));
+    QCommandLineOption drain("drain", "Ожидание рассылки после последней записи, секунд.", "sec",
+                             QString::number(config.drainSec));
+    QCommandLineOption csv("csv", "Вывод в формате CSV.");
+    parser.addOptions({host, port, speed, drain, csv});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+    config.file = parser.positionalArguments().first();
+    config.host = parser.value(host);
+    config.port = quint16(parser.value(port).toUInt());
+    config.speed = qMax(0.0, parser.value(speed).toDouble());
+    config.drainSec = parser.value(drain).toInt();
+    config.csv = parser.isSet(csv);
+
+    Replayer replayer(config);
+    if (!replayer.load()) {
+        return 1;
+    }
+    QObject::connect(&replayer, &Replayer::finished, &app, &QCoreApplication::exit);
+    replayer.start();
+    return app.exec();
+}
@@ -0,0 +1,81 @@
+#include <QtTest>
+#include <algorithm>
+#include "ConnectionSlab.h"
+
+/**
+ * @brief Тесты пула записей соединений.
+ *
+ * Проверяется, что устаревший id не находит переиспользованную запись,
+ * список живых соединений остается согласованным после удаления
+ * и записи не перемещаются при росте пула.
+ * Запуск: connection-slab-test или ctest.
+ */
+class ConnectionSlabTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void findAfterRelease();
+    void activeAfterRelease();
+    void recordsDoNotMove();
+};
+
+/* Запись, отданная другому соединению, не находится по старому id*/
+void ConnectionSlabTest::findAfterRelease() {
+    ConnectionSlab slab;
+    QVERIFY(slab.find(0) == nullptr);
+
+    ClientConnection* first = slab.acquire();
+    const quint64 staleId = first->id;
+    QVERIFY(staleId != 0);
+    QCOMPARE(slab.find(staleId), first);
+
+    slab.release(first);
+    QVERIFY(slab.find(staleId) == nullptr);
+
+    ClientConnection* second = slab.acquire();
+    QCOMPARE(second, first);
+    QVERIFY(second->id != staleId);
+    QVERIFY(slab.find(staleId) == nullptr);
+    QCOMPARE(slab.find(second->id), second);
+    QVERIFY(slab.find((staleId & 0xffffffff00000000ull) | (ConnectionSlab::ChunkSize + 1)) == nullptr);
+}
+
+void ConnectionSlabTest::activeAfterRelease() {
+    ConnectionSlab slab;
+    ClientConnection* a = slab.acquire();
+    ClientConnection* b = slab.acquire();
+    ClientConnection* c = slab.acquire();
+    const quint64 idA = a->id;
+    const quint64 idC = c->id;
+
+    slab.release(b);
+    QCOMPARE(slab.size(), 2);
+    const std::vector<ClientConnection*>& live = slab.active();
+    QVERIFY(std::find(live.begin(), live.end(), a) != live.end());
+    QVERIFY(std::find(live.begin(), live.end(), c) != live.end());
+
+    /*последняя запись переехала на место удаленной и должна удаляться по-прежнему*/
+    slab.release(c);
+    QVERIFY(slab.find(idC) == nullptr);
+    QCOMPARE(slab.find(idA), a);
+    QCOMPARE(slab.size(), 1);
+}
+
+void ConnectionSlabTest::recordsDoNotMove() {
+    ConnectionSlab slab;
+    ClientConnection* first = slab.acquire();
+    const quint64 firstId = first->id;
+    std::vector<quint64> ids;
+    for (int i = 0; i < ConnectionSlab::ChunkSize * 2; ++i) {
+        ids.push_back(slab.acquire()->id);
+    }
+    QCOMPARE(slab.find(firstId), first);
+    QCOMPARE(slab.size(), ConnectionSlab::ChunkSize * 2 + 1);
+    for (quint64 id : ids) {
+        QVERIFY(slab.find(id) != nullptr);
+        QCOMPARE(slab.find(id)->id, id);
+    }
+}
+
+QTEST_GUILESS_MAIN(ConnectionSlabTest)
+#include "ConnectionSlabTest.moc"
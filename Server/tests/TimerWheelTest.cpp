@@ -0,0 +1,121 @@
+#include <QtTest>
+#include "TimerWheel.h"
+
+/**
+ * @brief Тесты колеса таймеров.
+ *
+ * Колесо проверяется с тактом 1 мс, чтобы сроки в тестах совпадали
+ * с номерами тактов: TimerWheel::Slots тактов на ячейку первого уровня,
+ * Slots^2 - второго и Slots^3 - третьего.
+ * Запуск: timer-wheel-test или ctest.
+ */
+class TimerWheelTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void wheelFiresAtDeadline();
+    void wheelCascades_data();
+    void wheelCascades();
+    void wheelWrapsAroundSlots();
+    void wheelPastDeadline();
+    void wheelCancel();
+    void wheelCancelAfterFire();
+};
+
+namespace {
+constexpr qint64 Level1 = TimerWheel::Slots;
+constexpr qint64 Level2 = Level1 * TimerWheel::Slots;
+constexpr qint64 Level3 = Level2 * TimerWheel::Slots;
+}
+
+void TimerWheelTest::wheelFiresAtDeadline() {
+    TimerWheel wheel(10, 0);
+    wheel.schedule(1, 50);
+    QCOMPARE(wheel.size(), 1);
+    QVERIFY(wheel.advance(49).isEmpty());
+    QCOMPARE(wheel.advance(50), QList<quint64>{1});
+    QCOMPARE(wheel.size(), 0);
+}
+
+void TimerWheelTest::wheelCascades_data() {
+    QTest::addColumn<qint64>("deadline");
+    QTest::newRow("level0-last") << Level1 - 1;
+    QTest::newRow("level1-first") << Level1;
+    QTest::newRow("level1") << Level1 * 5 + 7;
+    QTest::newRow("level2-first") << Level2;
+    QTest::newRow("level2") << Level2 + 904;
+    QTest::newRow("level3") << Level3 + 37856;
+}
+
+/* Таймер старшего уровня раскладывается вниз и срабатывает ровно в свой такт*/
+void TimerWheelTest::wheelCascades() {
+    QFETCH(qint64, deadline);
+    TimerWheel wheel(1, 0);
+    wheel.schedule(42, deadline);
+    QVERIFY(wheel.advance(deadline - 1).isEmpty());
+    QCOMPARE(wheel.size(), 1);
+    QCOMPARE(wheel.advance(deadline), QList<quint64>{42});
+    QCOMPARE(wheel.size(), 0);
+}
+
+/* Ячейка с номером меньше текущего означает следующий оборот уровня*/
+void TimerWheelTest::wheelWrapsAroundSlots() {
+    TimerWheel wheel(1, 0);
+    QVERIFY(wheel.advance(Level1 + 1).isEmpty());
+
+    const qint64 now = Level1 + 1;
+    /*ячейка нулевого уровня перед текущей*/
+    const qint64 level0 = now + Level1 - 1;
+    /*ячейка первого уровня за переходом через 0*/
+    const qint64 level1Wrapped = now + Level1 * (TimerWheel::Slots - 1);
+    /*текущая ячейка первого уровня, но следующий оборот*/
+    const qint64 level1 = now + Level2 - 1;
+    wheel.schedule(1, level0);
+    wheel.schedule(2, level1);
+    wheel.schedule(3, level1Wrapped);
+
+    QVERIFY(wheel.advance(level0 - 1).isEmpty());
+    QCOMPARE(wheel.advance(level0), QList<quint64>{1});
+    QVERIFY(wheel.advance(level1Wrapped - 1).isEmpty());
+    QCOMPARE(wheel.advance(level1Wrapped), QList<quint64>{3});
+    QVERIFY(wheel.advance(level1 - 1).isEmpty());
+    QCOMPARE(wheel.advance(level1), QList<quint64>{2});
+    QCOMPARE(wheel.size(), 0);
+}
+
+void TimerWheelTest::wheelPastDeadline() {
+    TimerWheel wheel(10, 0);
+    wheel.advance(100);
+    wheel.schedule(5, 40);
+    QCOMPARE(wheel.advance(110), QList<quint64>{5});
+}
+
+void TimerWheelTest::wheelCancel() {
+    TimerWheel wheel(10, 0);
+    const TimerWheel::TimerId first = wheel.schedule(1, 20);
+    wheel.schedule(2, 20);
+    QVERIFY(wheel.cancel(first));
+    QVERIFY(!wheel.cancel(first));
+    QVERIFY(!wheel.cancel(0));
+    QCOMPARE(wheel.size(), 1);
+    QCOMPARE(wheel.advance(100), QList<quint64>{2});
+}
+
+/* Идентификатор сработавшего таймера не отменяет таймер, занявший его узел*/
+void TimerWheelTest::wheelCancelAfterFire() {
+    TimerWheel wheel(10, 0);
+    const TimerWheel::TimerId fired = wheel.schedule(1, 10);
+    QCOMPARE(wheel.advance(10), QList<quint64>{1});
+    QVERIFY(!wheel.cancel(fired));
+
+    const TimerWheel::TimerId reused = wheel.schedule(2, 30);
+    QCOMPARE(reused & 0xffffffffu, fired & 0xffffffffu);
+    QVERIFY(reused != fired);
+    QVERIFY(!wheel.cancel(fired));
+    QCOMPARE(wheel.size(), 1);
+    QCOMPARE(wheel.advance(30), QList<quint64>{2});
+    QVERIFY(!wheel.cancel(reused));
+}
+
+QTEST_GUILESS_MAIN(TimerWheelTest)
+#include "TimerWheelTest.moc"